@@ -0,0 +1,339 @@
+/*
+
+  book_checksum measures how many book channel messages per second are
+  applied and checksum-verified, by KBook and by the naive way (keeping
+  the book as doubles and formatting the top 10 levels of both sides
+  for every checksum):
+
+    book_checksum [messages] [file price_decimals volume_decimals]
+
+  where:
+
+    [messages] - (optional) synthetic updates (by default 200000)
+    [file ...] - (optional) recorded feed messages, one per line, of one
+                 pair's book channel (e.g. written by a KFeed data
+                 handler) and the decimals of its prices and volumes
+
+  Messages are parsed before the clock starts. The synthetic stream is a
+  book-10 with valid checksums, so both engines must verify every update.
+
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <chrono>
+#include <random>
+#include <map>
+#include <vector>
+#include <functional>
+#include <iterator>
+#include <cstdlib>
+
+#include "../kraken/kbook.hpp"
+#include "../kraken/kwriter.hpp"
+#include "../libjson/libjson.h"
+
+using namespace std;
+using namespace Kraken;
+
+//------------------------------------------------------------------------------
+
+static unsigned long crc32(const string& s)
+{
+   static unsigned long table[256];
+   if (!table[1]) {
+      for (unsigned long i = 0; i < 256; ++i) {
+	 unsigned long c = i;
+	 for (int k = 0; k < 8; ++k)
+	    c = (c & 1) ? 0xEDB88320UL ^ (c >> 1) : c >> 1;
+	 table[i] = c;
+      }
+   }
+
+   unsigned long crc = 0xFFFFFFFFUL;
+   for (size_t i = 0; i < s.size(); ++i)
+      crc = table[(crc ^ (unsigned char)s[i]) & 0xFF] ^ (crc >> 8);
+   return ~crc & 0xFFFFFFFFUL;
+}
+
+//------------------------------------------------------------------------------
+// the naive engine: doubles in maps, the top 10 formatted every time
+struct NaiveBook {
+   map<double, double> asks;
+   map<double, double, greater<double> > bids;
+   int price_decimals, volume_decimals;
+
+   static void digits(ostringstream& oss, double v, int decimals, string& out)
+   {
+      oss.str("");
+      oss << fixed << setprecision(decimals) << v;
+      string s = oss.str();
+      size_t i = 0;
+      while (i < s.size() && (s[i] == '0' || s[i] == '.')) ++i;
+      for (; i < s.size(); ++i)
+	 if (s[i] != '.') out += s[i];
+   }
+
+   template <class M>
+   void append(const M& side, ostringstream& oss, string& out) const
+   {
+      int n = 0;
+      for (typename M::const_iterator it = side.begin();
+	   it != side.end() && n < 10; ++it, ++n) {
+	 digits(oss, it->first, price_decimals, out);
+	 digits(oss, it->second, volume_decimals, out);
+      }
+   }
+
+   unsigned long checksum() const
+   {
+      ostringstream oss;
+      string s;
+      append(asks, oss, s);
+      append(bids, oss, s);
+      return crc32(s);
+   }
+
+   template <class M>
+   static void set(M& side, double price, double volume, size_t depth)
+   {
+      if (volume == 0) side.erase(price);
+      else side[price] = volume;
+      while (side.size() > depth) {
+	 typename M::iterator last = side.end();
+	 side.erase(--last);
+      }
+   }
+
+   // returns false on a checksum mismatch
+   bool apply(const JSONNode& msg, size_t depth)
+   {
+      string c;
+      for (json_index_t i = 1; i + 2 < msg.size(); ++i) {
+	 const JSONNode& obj = msg[i];
+	 for (JSONNode::const_iterator it = obj.begin(); it != obj.end(); ++it) {
+	    string name = libjson::to_std_string(it->name());
+	    if (name == "c") {
+	       c = libjson::to_std_string(it->as_string());
+	       continue;
+	    }
+	    bool ask = name[0] == 'a';
+	    if (name == "as") asks.clear();
+	    if (name == "bs") bids.clear();
+	    for (JSONNode::const_iterator
+		    row = it->begin(); row != it->end(); ++row) {
+	       double p = (*row)[0].as_float(), v = (*row)[1].as_float();
+	       if (ask) set(asks, p, v, depth);
+	       else set(bids, p, v, depth);
+	    }
+	 }
+      }
+      return c.empty() || checksum() == strtoul(c.c_str(), 0, 10);
+   }
+};
+
+//------------------------------------------------------------------------------
+// the value the text of 'v' with 'decimals' decimals reads back as:
+static double rounded(double v, int decimals)
+{
+   ostringstream oss;
+   oss << fixed << setprecision(decimals) << v;
+   return strtod(oss.str().c_str(), 0);
+}
+
+//------------------------------------------------------------------------------
+// writes a level as the feed does:
+static void write_level(KWriter& w, double price, double volume, double time,
+			const NaiveBook& b, bool republish)
+{
+   ostringstream p, v, t;
+   p << fixed << setprecision(b.price_decimals) << price;
+   v << fixed << setprecision(b.volume_decimals) << volume;
+   t << fixed << setprecision(6) << time;
+   w.begin_array().value(p.str()).value(v.str()).value(t.str());
+   if (republish) w.value("r");
+   w.end_array();
+}
+
+//------------------------------------------------------------------------------
+// a book-10 stream: a snapshot, then volume changes, new levels and
+// removed levels (each followed by the republished level that enters
+// the top 10), every update with its checksum:
+static vector<string> make_stream(int count)
+{
+   NaiveBook b;
+   b.price_decimals = 2;
+   b.volume_decimals = 8;
+   mt19937 rng(42);
+   double now = 1500000000.0;
+
+   vector<string> out;
+   string msg;
+   {
+      KWriter w(msg);
+      w.begin_array().value(1).begin_object().key("as").begin_array();
+      for (int i = 0; i < 10; ++i) {
+	 double p = rounded(30000.1 + i * 0.1, 2), v = 1 + i * 0.25;
+	 b.asks[p] = v;
+	 write_level(w, p, v, now, b, false);
+      }
+      w.end_array().key("bs").begin_array();
+      for (int i = 0; i < 10; ++i) {
+	 double p = rounded(30000.0 - i * 0.1, 2), v = 2 + i * 0.5;
+	 b.bids[p] = v;
+	 write_level(w, p, v, now, b, false);
+      }
+      w.end_array().end_object().value("book-10").value("XBT/EUR").end_array();
+      out.push_back(msg);
+   }
+
+   while ((int)out.size() <= count) {
+      now += 0.001;
+      bool ask = rng() % 2;
+      int op = rng() % 10;
+      int idx = rng() % 10;
+
+      msg.clear();
+      KWriter w(msg);
+      w.begin_array().value(1).begin_object().key(ask ? "a" : "b").begin_array();
+
+      double best = ask ? b.asks.begin()->first : b.bids.begin()->first;
+      double sign = ask ? 1 : -1;
+      double level = best + sign * 0.1 * idx;
+      double volume = 0.01 * (1 + rng() % 1000);
+
+      if (op < 6) {
+	 // volume change of an existing level
+	 level = ask ? next(b.asks.begin(), idx)->first
+	    : next(b.bids.begin(), idx)->first;
+	 write_level(w, level, volume, now, b, false);
+	 if (ask) NaiveBook::set(b.asks, level, volume, 10);
+	 else NaiveBook::set(b.bids, level, volume, 10);
+      }
+      else if (op < 8) {
+	 // a new level between existing ones, the last one drops out
+	 level = rounded(level + sign * 0.05, 2);
+	 write_level(w, level, volume, now, b, false);
+	 if (ask) NaiveBook::set(b.asks, level, volume, 10);
+	 else NaiveBook::set(b.bids, level, volume, 10);
+      }
+      else {
+	 // a level goes away and the next one enters the top 10
+	 level = ask ? next(b.asks.begin(), idx)->first
+	    : next(b.bids.begin(), idx)->first;
+	 double last = ask ? b.asks.rbegin()->first : b.bids.rbegin()->first;
+	 double enter = rounded(last + sign * 0.1, 2);
+	 write_level(w, level, 0, now, b, false);
+	 write_level(w, enter, volume, now, b, true);
+	 if (ask) {
+	    NaiveBook::set(b.asks, level, 0, 10);
+	    NaiveBook::set(b.asks, enter, volume, 10);
+	 }
+	 else {
+	    NaiveBook::set(b.bids, level, 0, 10);
+	    NaiveBook::set(b.bids, enter, volume, 10);
+	 }
+      }
+
+      ostringstream c;
+      c << b.checksum();
+      w.end_array().key("c").value(c.str()).end_object()
+	 .value("book-10").value("XBT/EUR").end_array();
+      out.push_back(msg);
+   }
+   return out;
+}
+
+//------------------------------------------------------------------------------
+// reads the lines of a file:
+static vector<string> read_lines(const char* path)
+{
+   ifstream ifs(path);
+   if (!ifs)
+      throw runtime_error(string("can't open ") + path);
+
+   vector<string> lines;
+   string line;
+   while (getline(ifs, line))
+      if (!line.empty()) lines.push_back(line);
+   return lines;
+}
+
+//------------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+   try {
+      int count = 200000;
+      int price_decimals = 2, volume_decimals = 8;
+      vector<string> stream;
+
+      switch (argc) {
+      case 5:
+	 stream = read_lines(argv[2]);
+	 istringstream(argv[3]) >> price_decimals;
+	 istringstream(argv[4]) >> volume_decimals;
+      case 2:
+	 istringstream(argv[1]) >> count;
+      case 1:
+	 break;
+      default:
+	 throw runtime_error("wrong number of arguments");
+      };
+
+      if (stream.empty())
+	 stream = make_stream(count);
+
+      // parse everything up front, only the engines are timed
+      vector<JSONNode> msgs;
+      msgs.reserve(stream.size());
+      for (size_t i = 0; i < stream.size(); ++i) {
+	 msgs.push_back(libjson::parse(libjson::to_json_string(stream[i])));
+	 msgs.back().preparse();
+      }
+
+      size_t depth = 10;
+      string channel = libjson::to_std_string(
+	 msgs[0][msgs[0].size() - 2].as_string());
+      if (channel.compare(0, 5, "book-") == 0)
+	 istringstream(channel.substr(5)) >> depth;
+
+      NaiveBook naive;
+      naive.price_decimals = price_decimals;
+      naive.volume_decimals = volume_decimals;
+      size_t naive_mismatches = 0;
+
+      chrono::steady_clock::time_point start = chrono::steady_clock::now();
+      for (size_t i = 0; i < msgs.size(); ++i)
+	 if (!naive.apply(msgs[i], depth)) ++naive_mismatches;
+      chrono::duration<double> naive_time = chrono::steady_clock::now() - start;
+
+      KBook book("", int(depth), price_decimals, volume_decimals);
+
+      start = chrono::steady_clock::now();
+      for (size_t i = 0; i < msgs.size(); ++i)
+	 book.apply(msgs[i]);
+      chrono::duration<double> kbook_time = chrono::steady_clock::now() - start;
+
+      cout << "messages: " << msgs.size() << endl
+	   << fixed << setprecision(0)
+	   << "naive msgs/s: " << msgs.size() / naive_time.count()
+	   << " (mismatches " << naive_mismatches << ')' << endl
+	   << "KBook msgs/s: " << msgs.size() / kbook_time.count()
+	   << " (verified " << book.stats().verified
+	   << ", mismatches " << book.stats().mismatches << ')' << endl;
+   }
+   catch(exception& e) {
+      cerr << "Error: " << e.what() << endl;
+      return 1;
+   }
+   catch(...) {
+      cerr << "Unknown exception." << endl;
+      return 1;
+   }
+
+   return 0;
+}
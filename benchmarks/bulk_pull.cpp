@@ -0,0 +1,574 @@
+/*
+
+  bulk_pull compares ways of pulling a batch of large public responses
+  (OHLC-like JSON) with KClient against a local server that emulates a
+  shared link of a given bandwidth and a server delay:
+
+    bulk_pull [requests] [mbps] [delay_ms]
+
+  where:
+
+    [requests] - (optional) requests per case (by default 32)
+    [mbps]     - (optional) bandwidth of the emulated link in Mbit/s,
+                 0 for unlimited (by default 100)
+    [delay_ms] - (optional) time the server takes to answer each request
+                 (by default 20)
+
+  The server runs in this process and speaks HTTP/1.1 and HTTP/2 over
+  TLS, chosen by ALPN as with api.kraken.com, with a self-signed
+  certificate made at startup. HTTP/1.1 responses are gzipped when the
+  request accepts it; HTTP/2 ones when they are sent to the second port,
+  since the server doesn't decode request headers. For each case the
+  wall time, the bytes on the wire (TLS records included, handshakes
+  not) and the p50/p99 of the request times recorded by KMetrics are
+  printed.
+
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <csignal>
+#include <cstdlib>
+#include <cerrno>
+
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <zlib.h>
+
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+#include <openssl/x509v3.h>
+
+#include "../kraken/kclient.hpp"
+#include "../kraken/kwriter.hpp"
+
+using namespace std;
+using namespace Kraken;
+
+typedef chrono::steady_clock Clock;
+
+//------------------------------------------------------------------------------
+// what the server sends and how:
+struct Server {
+   string body;           // the response
+   string gzipped;        // the response, gzipped
+   double mbps;           // 0 = unlimited
+   chrono::milliseconds delay;
+
+   mutex link_mutex;      // the emulated link, shared by all connections
+   Clock::time_point link_free;
+   atomic<unsigned long long> wire_bytes;
+
+   SSL_CTX* tls;
+   string ca_file;        // the certificate, for the clients
+};
+
+static Server server;
+
+//------------------------------------------------------------------------------
+// a candle list like OHLC's, ~60 KB:
+static string make_body()
+{
+   string out;
+   KWriter w(out);
+   w.begin_object().key("error").begin_array().end_array()
+      .key("result").begin_object().key("XXBTZEUR").begin_array();
+   for (int i = 0; i < 720; ++i) {
+      ostringstream o, h, l, c, vw, v;
+      o << fixed << setprecision(1) << 30000 + (i % 37) * 1.5;
+      h << fixed << setprecision(1) << 30010 + (i % 37) * 1.5;
+      l << fixed << setprecision(1) << 29990 + (i % 37) * 1.5;
+      c << fixed << setprecision(1) << 30005 + (i % 41) * 1.5;
+      vw << fixed << setprecision(1) << 30002 + (i % 43) * 1.5;
+      v << fixed << setprecision(8) << 1.25 + (i % 17) * 0.1;
+      w.begin_array().value(1500000000 + i * 60)
+	 .value(o.str()).value(h.str()).value(l.str()).value(c.str())
+	 .value(vw.str()).value(v.str()).value(10 + i % 50).end_array();
+   }
+   w.end_array().key("last").value(1500043140).end_object().end_object();
+   return out;
+}
+
+//------------------------------------------------------------------------------
+
+static string gzip(const string& in)
+{
+   z_stream z;
+   memset(&z, 0, sizeof(z));
+   if (deflateInit2(&z, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 31, 8,
+		    Z_DEFAULT_STRATEGY) != Z_OK)
+      throw runtime_error("deflateInit2() failed");
+
+   string out(deflateBound(&z, in.size()) + 32, '\0');
+   z.next_in = (Bytef*)in.data();
+   z.avail_in = in.size();
+   z.next_out = (Bytef*)&out[0];
+   z.avail_out = out.size();
+   deflate(&z, Z_FINISH);
+   out.resize(z.total_out);
+   deflateEnd(&z);
+   return out;
+}
+
+//------------------------------------------------------------------------------
+// prefers h2 to http/1.1, as the client offers:
+static int select_alpn(SSL*, const unsigned char** out, unsigned char* outlen,
+		       const unsigned char* in, unsigned int inlen, void*)
+{
+   static const unsigned char ours[] = "\x02h2\x08http/1.1";
+   unsigned char* sel = 0;
+   if (SSL_select_next_proto(&sel, outlen, ours, sizeof(ours) - 1, in, inlen)
+       != OPENSSL_NPN_NEGOTIATED)
+      return SSL_TLSEXT_ERR_NOACK;
+   *out = sel;
+   return SSL_TLSEXT_ERR_OK;
+}
+
+//------------------------------------------------------------------------------
+// a TLS context with a fresh self-signed certificate for 127.0.0.1,
+// which is written to a temporary file for KClient::set_ca_file():
+static void setup_tls()
+{
+   EVP_PKEY* key = EVP_EC_gen("P-256");
+   X509* cert = X509_new();
+   if (!key || !cert)
+      throw runtime_error("can't make a certificate");
+
+   X509_set_version(cert, 2);
+   ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+   X509_gmtime_adj(X509_getm_notBefore(cert), -60);
+   X509_gmtime_adj(X509_getm_notAfter(cert), 86400);
+   X509_set_pubkey(cert, key);
+   X509_NAME* name = X509_get_subject_name(cert);
+   X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+			      (const unsigned char*)"127.0.0.1", -1, -1, 0);
+   X509_set_issuer_name(cert, name);
+
+   X509V3_CTX v3;
+   X509V3_set_ctx_nodb(&v3);
+   X509V3_set_ctx(&v3, cert, cert, 0, 0, 0);
+   X509_EXTENSION* san = X509V3_EXT_conf_nid(0, &v3, NID_subject_alt_name,
+					     (char*)"IP:127.0.0.1");
+   X509_add_ext(cert, san, -1);
+   X509_EXTENSION_free(san);
+   X509_sign(cert, key, EVP_sha256());
+
+   server.tls = SSL_CTX_new(TLS_server_method());
+   if (!server.tls || SSL_CTX_use_certificate(server.tls, cert) != 1 ||
+       SSL_CTX_use_PrivateKey(server.tls, key) != 1)
+      throw runtime_error("can't set up TLS");
+   SSL_CTX_set_alpn_select_cb(server.tls, select_alpn, 0);
+
+   char path[] = "/tmp/bulk_pull_XXXXXX";
+   int fd = mkstemp(path);
+   FILE* f = fd < 0 ? 0 : fdopen(fd, "w");
+   if (!f)
+      throw runtime_error(string("can't write the certificate: ") + strerror(errno));
+   PEM_write_X509(f, cert);
+   fclose(f);
+   server.ca_file = path;
+
+   X509_free(cert);
+   EVP_PKEY_free(key);
+}
+
+//------------------------------------------------------------------------------
+// reads what is there (waiting for something), false once closed:
+static bool read_some(SSL* ssl, string& buf)
+{
+   char chunk[16384];
+   int n = SSL_read(ssl, chunk, sizeof(chunk));
+   if (n <= 0) return false;
+   buf.append(chunk, n);
+   return true;
+}
+
+//------------------------------------------------------------------------------
+// writes through the emulated link: each write waits for its turn and
+// the time its bytes take at the link's bandwidth:
+static bool write_all(SSL* ssl, const char* p, size_t n)
+{
+   if (server.mbps > 0) {
+      Clock::time_point done;
+      {
+	 lock_guard<mutex> lock(server.link_mutex);
+	 Clock::time_point now = Clock::now();
+	 if (server.link_free < now) server.link_free = now;
+	 server.link_free += chrono::microseconds(
+	    (long long)(n * 8 / server.mbps));
+	 done = server.link_free;
+      }
+      this_thread::sleep_until(done);
+   }
+
+   BIO* wire = SSL_get_wbio(ssl);
+   unsigned long long before = BIO_number_written(wire);
+   int k = SSL_write(ssl, p, int(n));
+   server.wire_bytes += BIO_number_written(wire) - before;
+   return k == int(n);
+}
+
+//------------------------------------------------------------------------------
+// answers HTTP/1.1 requests of a connection, 'buf' holds what was read:
+static void serve_http1(SSL* ssl)
+{
+   string buf;
+   while (true) {
+      size_t head = buf.find("\r\n\r\n");
+      if (head == string::npos) {
+	 if (!read_some(ssl, buf)) return;
+	 continue;
+      }
+
+      size_t length = 0;
+      size_t cl = buf.find("Content-Length: ");
+      if (cl != string::npos && cl < head)
+	 length = strtoul(buf.c_str() + cl + 16, 0, 10);
+      while (buf.size() < head + 4 + length)
+	 if (!read_some(ssl, buf)) return;
+
+      string headers = buf.substr(0, head);
+      buf.erase(0, head + 4 + length);
+      bool gz = headers.find("gzip") != string::npos;
+      const string& body = gz ? server.gzipped : server.body;
+
+      this_thread::sleep_for(server.delay);
+
+      ostringstream oss;
+      oss << "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n"
+	  << (gz ? "Content-Encoding: gzip\r\n" : "")
+	  << "Content-Length: " << body.size() << "\r\n\r\n";
+      string h = oss.str();
+      if (!write_all(ssl, h.data(), h.size())) return;
+      for (size_t off = 0; off < body.size(); off += 16384)
+	 if (!write_all(ssl, body.data() + off, min<size_t>(16384, body.size() - off)))
+	    return;
+   }
+}
+
+//------------------------------------------------------------------------------
+// HTTP/2 frames:
+enum { DATA = 0, HEADERS = 1, SETTINGS = 4, PING = 6, GOAWAY = 7,
+       WINDOW_UPDATE = 8 };
+enum { END_STREAM = 1, ACK = 1, END_HEADERS = 4 };
+
+static string frame(int type, int flags, unsigned id, const string& payload)
+{
+   string f(9, '\0');
+   size_t n = payload.size();
+   f[0] = char(n >> 16); f[1] = char(n >> 8); f[2] = char(n);
+   f[3] = char(type); f[4] = char(flags);
+   f[5] = char(id >> 24 & 0x7F); f[6] = char(id >> 16);
+   f[7] = char(id >> 8); f[8] = char(id);
+   return f + payload;
+}
+
+static unsigned long get32(const string& s, size_t at)
+{
+   return (unsigned long)(unsigned char)s[at] << 24 |
+      (unsigned long)(unsigned char)s[at + 1] << 16 |
+      (unsigned long)(unsigned char)s[at + 2] << 8 |
+      (unsigned long)(unsigned char)s[at + 3];
+}
+
+//------------------------------------------------------------------------------
+// a minimal HTTP/2 server: request headers are not decoded, every
+// stream gets the response once the request is over (after the delay),
+// sent within the client's flow control windows:
+static void serve_http2(int fd, SSL* ssl, bool gz)
+{
+   struct Stream {
+      Clock::time_point due;
+      bool headers_sent;
+      size_t sent;
+      long window;
+   };
+
+   const string& body = gz ? server.gzipped : server.body;
+   string block("\x88", 1);  // :status 200
+   block += string("\x0F\x10\x10", 3) + "application/json";
+   if (gz) block += string("\x0F\x0B\x04", 3) + "gzip";
+
+   string buf;
+   while (buf.size() < 24)
+      if (!read_some(ssl, buf)) return;
+   if (buf.compare(0, 24, "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n") != 0) return;
+   buf.erase(0, 24);
+   string settings("\x00\x03\x00\x00\x00\x64", 6);  // 100 streams
+   string out = frame(SETTINGS, 0, 0, settings);
+   if (!write_all(ssl, out.data(), out.size())) return;
+
+   map<unsigned, Stream> streams;
+   long conn_window = 65535, initial_window = 65535;
+
+   while (true) {
+      // frames received so far
+      while (buf.size() >= 9) {
+	 size_t len = (unsigned char)buf[0] << 16 | (unsigned char)buf[1] << 8 |
+	    (unsigned char)buf[2];
+	 if (buf.size() < 9 + len) break;
+	 int type = buf[3], flags = (unsigned char)buf[4];
+	 unsigned id = get32(buf, 5) & 0x7FFFFFFF;
+	 string payload = buf.substr(9, len);
+	 buf.erase(0, 9 + len);
+
+	 out.clear();
+	 if (type == SETTINGS && !(flags & ACK)) {
+	    for (size_t i = 0; i + 6 <= payload.size(); i += 6) {
+	       int key = (unsigned char)payload[i] << 8 | (unsigned char)payload[i + 1];
+	       if (key == 4) {
+		  long v = long(get32(payload, i + 2));
+		  for (map<unsigned, Stream>::iterator
+			  it = streams.begin(); it != streams.end(); ++it)
+		     it->second.window += v - initial_window;
+		  initial_window = v;
+	       }
+	    }
+	    out = frame(SETTINGS, ACK, 0, "");
+	 }
+	 else if (type == PING && !(flags & ACK)) {
+	    out = frame(PING, ACK, 0, payload);
+	 }
+	 else if (type == WINDOW_UPDATE && payload.size() == 4) {
+	    long inc = long(get32(payload, 0) & 0x7FFFFFFF);
+	    if (id == 0) conn_window += inc;
+	    else if (streams.count(id)) streams[id].window += inc;
+	 }
+	 else if (type == GOAWAY) {
+	    return;
+	 }
+	 else if ((type == HEADERS || type == DATA) && id) {
+	    if (!streams.count(id)) {
+	       Stream s = { Clock::time_point::max(), false, 0, initial_window };
+	       streams[id] = s;
+	    }
+	    if (type == DATA && !payload.empty()) {
+	       // give back what the request body used
+	       string inc(4, '\0');
+	       inc[0] = char(len >> 24); inc[1] = char(len >> 16);
+	       inc[2] = char(len >> 8); inc[3] = char(len);
+	       out = frame(WINDOW_UPDATE, 0, 0, inc);
+	    }
+	    if (flags & END_STREAM)
+	       streams[id].due = Clock::now() + server.delay;
+	 }
+	 if (!out.empty() && !write_all(ssl, out.data(), out.size())) return;
+      }
+
+      // responses that are due and fit in the windows
+      Clock::time_point now = Clock::now(), next = Clock::time_point::max();
+      map<unsigned, Stream>::iterator it = streams.begin();
+      while (it != streams.end()) {
+	 Stream& s = it->second;
+	 if (s.due > now) {
+	    next = min(next, s.due);
+	    ++it;
+	    continue;
+	 }
+	 if (!s.headers_sent) {
+	    out = frame(HEADERS, END_HEADERS, it->first, block);
+	    if (!write_all(ssl, out.data(), out.size())) return;
+	    s.headers_sent = true;
+	 }
+	 while (s.sent < body.size() && conn_window > 0 && s.window > 0) {
+	    size_t n = min<size_t>(16384, body.size() - s.sent);
+	    n = min<size_t>(n, min(conn_window, s.window));
+	    bool last = s.sent + n == body.size();
+	    out = frame(DATA, last ? END_STREAM : 0, it->first, body.substr(s.sent, n));
+	    if (!write_all(ssl, out.data(), out.size())) return;
+	    s.sent += n;
+	    conn_window -= n;
+	    s.window -= n;
+	 }
+	 if (s.sent == body.size()) streams.erase(it++);
+	 else ++it;
+      }
+
+      // decrypted bytes may be waiting in 'ssl' with nothing on 'fd'
+      int timeout = -1;
+      if (next != Clock::time_point::max())
+	 timeout = int(chrono::duration_cast<chrono::milliseconds>(
+			  next - Clock::now()).count()) + 1;
+      pollfd p = { fd, POLLIN, 0 };
+      if (SSL_pending(ssl) > 0 || poll(&p, 1, timeout) > 0)
+	 if (!read_some(ssl, buf)) return;
+   }
+}
+
+//------------------------------------------------------------------------------
+
+static void serve(int fd, bool gz)
+{
+   int one = 1;
+   setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+   SSL* ssl = SSL_new(server.tls);
+   SSL_set_fd(ssl, fd);
+   if (SSL_accept(ssl) == 1) {
+      const unsigned char* alpn = 0;
+      unsigned int len = 0;
+      SSL_get0_alpn_selected(ssl, &alpn, &len);
+      if (len == 2 && memcmp(alpn, "h2", 2) == 0)
+	 serve_http2(fd, ssl, gz);
+      else
+	 serve_http1(ssl);
+      SSL_shutdown(ssl);
+   }
+   SSL_free(ssl);
+   close(fd);
+}
+
+//------------------------------------------------------------------------------
+// starts a listener, returns its port:
+static int listen_on(bool gz)
+{
+   int fd = socket(AF_INET, SOCK_STREAM, 0);
+   if (fd < 0)
+      throw runtime_error("socket() failed");
+
+   sockaddr_in addr;
+   memset(&addr, 0, sizeof(addr));
+   addr.sin_family = AF_INET;
+   addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+   socklen_t len = sizeof(addr);
+   if (bind(fd, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 64) != 0 ||
+       getsockname(fd, (sockaddr*)&addr, &len) != 0)
+      throw runtime_error(string("can't listen: ") + strerror(errno));
+
+   thread([fd, gz]() {
+	 while (true) {
+	    int c = accept(fd, 0, 0);
+	    if (c < 0) break;
+	    thread(serve, c, gz).detach();
+	 }
+      }).detach();
+
+   return ntohs(addr.sin_port);
+}
+
+//------------------------------------------------------------------------------
+// runs one case with a fresh client and prints its row:
+static void run(const char* name, int port, int requests, bool http2,
+		bool compression, bool batch)
+{
+   ostringstream url;
+   url << "https://127.0.0.1:" << port;
+   KClient kc("", "", url.str(), "0");
+   kc.set_ca_file(server.ca_file);
+   kc.set_http2(http2);
+   kc.set_compression(compression);
+
+   vector<KRequest> reqs(requests);
+   for (int i = 0; i < requests; ++i) {
+      reqs[i].method = "OHLC";
+      reqs[i].input.set("pair", "XXBTZEUR").set("since", i);
+   }
+
+   // a first request opens the connection
+   vector<string> responses;
+   if (batch) kc.public_methods(vector<KRequest>(1, reqs[0]), responses);
+   else kc.public_method("OHLC", reqs[0].input);
+
+   std::shared_ptr<KMetrics> metrics = std::make_shared<KMetrics>();
+   kc.set_metrics(metrics);
+   server.wire_bytes = 0;
+
+   Clock::time_point start = Clock::now();
+   if (batch) {
+      kc.public_methods(reqs, responses);
+   }
+   else {
+      responses.resize(requests);
+      for (int i = 0; i < requests; ++i)
+	 responses[i] = kc.public_method("OHLC", reqs[i].input);
+   }
+   chrono::duration<double, milli> wall = Clock::now() - start;
+
+   for (size_t i = 0; i < responses.size(); ++i)
+      if (responses[i] != server.body)
+	 throw runtime_error(string("wrong response in ") + name);
+
+   const KHistogram* total = metrics->histogram("OHLC", KMetrics::TOTAL);
+   cout << name << ',' << fixed << setprecision(1) << wall.count() << ','
+	<< server.wire_bytes.load() << ','
+	<< total->percentile(50) / 1000.0 << ','
+	<< total->percentile(99) / 1000.0 << endl;
+}
+
+//------------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+   try {
+      int requests = 32;
+      double mbps = 100;
+      int delay_ms = 20;
+
+      switch (argc) {
+      case 4:
+	 istringstream(argv[3]) >> delay_ms;
+      case 3:
+	 istringstream(argv[2]) >> mbps;
+      case 2:
+	 istringstream(argv[1]) >> requests;
+      case 1:
+	 break;
+      default:
+	 throw runtime_error("wrong number of arguments");
+      };
+      if (requests <= 0)
+	 throw runtime_error("requests must be positive");
+
+      Kraken::initialize();
+      signal(SIGPIPE, SIG_IGN);  // clients hang up
+
+      server.body = make_body();
+      server.gzipped = gzip(server.body);
+      server.mbps = mbps;
+      server.delay = chrono::milliseconds(delay_ms);
+      server.wire_bytes = 0;
+      setup_tls();
+
+      int plain = listen_on(false);
+      int gz = listen_on(true);
+
+      cout << "response bytes: " << server.body.size()
+	   << " (gzipped " << server.gzipped.size() << ')' << endl
+	   << "case,wall_ms,wire_bytes,p50_ms,p99_ms" << endl;
+      run("http1_sequential", plain, requests, false, false, false);
+      run("http1_sequential_gzip", plain, requests, false, true, false);
+      run("http1_parallel", plain, requests, false, false, true);
+      run("http1_parallel_gzip", plain, requests, false, true, true);
+      run("http2_multiplexed", plain, requests, true, false, true);
+      run("http2_multiplexed_gzip", gz, requests, true, true, true);
+
+      unlink(server.ca_file.c_str());
+      Kraken::terminate();
+   }
+   catch(exception& e) {
+      cerr << "Error: " << e.what() << endl;
+      return 1;
+   }
+   catch(...) {
+      cerr << "Unknown exception." << endl;
+      return 1;
+   }
+
+   return 0;
+}
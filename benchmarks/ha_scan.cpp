@@ -0,0 +1,175 @@
+/*
+
+  ha_scan measures Heikin-Ashi over long series: heikin_ashi() one
+  candle after the other, against the parallel heikin_ashi() of a
+  series and of many pairs at once:
+
+    ha_scan [candles] [pairs] [threads]
+
+  where:
+
+    [candles] - (optional) 1-minute candles per pair, random walks (by
+                default 525600, a year)
+    [pairs]   - (optional) pairs of the multi-pair case (by default 10)
+    [threads] - (optional) threads to use (by default 0, one per core)
+
+  Each case runs three times and the fastest run counts (the first one
+  allocates the output columns). It prints the time per candle, the
+  speedup over the sequential case and the largest difference from it
+  relative to the price, which should stay within a few ulps (1e-15).
+
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "../kraken/kindicator.hpp"
+
+using namespace std;
+using namespace Kraken;
+
+typedef chrono::steady_clock Clock;
+
+//------------------------------------------------------------------------------
+// a random walk from 'price', a candle a minute:
+static KCandles make_candles(size_t count, double price, unsigned seed)
+{
+   mt19937 rng(seed);
+   normal_distribution<double> step(0, 0.0005);
+   uniform_real_distribution<double> unit(0, 1);
+
+   KCandles candles;
+   candles.reserve(count);
+   for (size_t i = 0; i < count; ++i) {
+      double open = price;
+      double close = open * (1 + step(rng));
+      double high = max(open, close) * (1 + unit(rng) * 0.0002);
+      double low = min(open, close) * (1 - unit(rng) * 0.0002);
+      candles.put(1500000000 + time_t(i) * 60, open, high, low, close,
+		  (open + close) / 2, unit(rng) * 10, 1 + int(unit(rng) * 100));
+      price = close;
+   }
+   return candles;
+}
+
+//------------------------------------------------------------------------------
+// the largest difference between the columns of 'a' and 'b', relative
+// to the price:
+static double difference(const KCandles& a, const KCandles& b)
+{
+   double diff = 0;
+   for (size_t i = 0; i < a.size(); ++i) {
+      diff = max(diff, fabs(a.open[i] - b.open[i]) / fabs(a.open[i]));
+      diff = max(diff, fabs(a.high[i] - b.high[i]) / fabs(a.high[i]));
+      diff = max(diff, fabs(a.low[i] - b.low[i]) / fabs(a.low[i]));
+      diff = max(diff, fabs(a.close[i] - b.close[i]) / fabs(a.close[i]));
+   }
+   return diff;
+}
+
+//------------------------------------------------------------------------------
+// the fastest of three runs of 'f':
+template <class Function>
+static Clock::duration best_of_three(Function f)
+{
+   Clock::duration best = Clock::duration::max();
+   for (int run = 0; run < 3; ++run) {
+      Clock::time_point start = Clock::now();
+      f();
+      best = min(best, Clock::duration(Clock::now() - start));
+   }
+   return best;
+}
+
+//------------------------------------------------------------------------------
+
+static void print_row(const char* name, Clock::duration time, size_t candles,
+		      double sequential_ns, double diff)
+{
+   double ns = chrono::duration<double, nano>(time).count() / candles;
+   cout << name << ',' << fixed << setprecision(2) << ns << ','
+	<< setprecision(1) << (sequential_ns > 0 ? sequential_ns / ns : 1)
+	<< ',' << scientific << setprecision(2) << diff << endl;
+}
+
+//------------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+   try {
+      size_t count = 525600, pairs = 10;
+      unsigned threads = 0;
+
+      switch (argc) {
+      case 4:
+	 istringstream(argv[3]) >> threads;
+      case 3:
+	 istringstream(argv[2]) >> pairs;
+      case 2:
+	 istringstream(argv[1]) >> count;
+      case 1:
+	 break;
+      default:
+	 throw runtime_error("wrong number of arguments");
+      }
+      if (count == 0 || pairs == 0)
+	 throw runtime_error("[candles] and [pairs] must be positive");
+
+      vector<KCandles> series(pairs);
+      for (size_t k = 0; k < pairs; ++k)
+	 series[k] = make_candles(count, 1 + k * 300.0, unsigned(k));
+
+      cout << "case,ns_per_candle,speedup,max_rel_diff" << endl;
+
+      // one pair, sequential then parallel
+      KCandles expected, out;
+      Clock::duration sequential = best_of_three([&]() {
+	    heikin_ashi(series[0], expected);
+	 });
+      print_row("sequential", sequential, count, 0, 0);
+      double sequential_ns =
+	 chrono::duration<double, nano>(sequential).count() / count;
+
+      Clock::duration parallel = best_of_three([&]() {
+	    heikin_ashi(series[0], out, threads);
+	 });
+      print_row("parallel", parallel, count, sequential_ns,
+		difference(expected, out));
+
+      // many pairs, sequential then parallel
+      vector<KCandles> expected_all(pairs), out_all;
+      sequential = best_of_three([&]() {
+	    for (size_t k = 0; k < pairs; ++k)
+	       heikin_ashi(series[k], expected_all[k]);
+	 });
+      print_row("pairs_sequential", sequential, count * pairs, 0, 0);
+      sequential_ns =
+	 chrono::duration<double, nano>(sequential).count() / (count * pairs);
+
+      parallel = best_of_three([&]() {
+	    heikin_ashi(series, out_all, threads);
+	 });
+
+      double diff = 0;
+      for (size_t k = 0; k < pairs; ++k)
+	 diff = max(diff, difference(expected_all[k], out_all[k]));
+      print_row("pairs_parallel", parallel, count * pairs, sequential_ns, diff);
+   }
+   catch(exception& e) {
+      cerr << "Error: " << e.what() << endl;
+      return 1;
+   }
+   catch(...) {
+      cerr << "Unknown exception." << endl;
+      return 1;
+   }
+
+   return 0;
+}
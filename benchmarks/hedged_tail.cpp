@@ -0,0 +1,239 @@
+/*
+
+  hedged_tail measures what retries and hedging do for public requests
+  against a local server that stalls or fails some of them:
+
+    hedged_tail [requests] [stall_pct] [stall_ms]
+
+  where:
+
+    [requests]  - (optional) requests per case (by default 400)
+    [stall_pct] - (optional) percentage of requests the server stalls
+                  (by default 5)
+    [stall_ms]  - (optional) how long a stalled request takes (by
+                  default 200); the others take 2 ms
+
+  The server runs in this process on 127.0.0.1. Cases:
+
+    plain    one attempt, no hedging
+    hedged   hedging after the p95 of the times seen so far
+    flaky    the server answers 10% of requests with HTTP 503; one
+             attempt
+    retried  the same with up to 4 attempts and jittered backoff
+
+  For each case the p50, p99 and max request times (as seen by the
+  caller) and the number of failed calls are printed.
+
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "../kraken/kclient.hpp"
+
+using namespace std;
+using namespace Kraken;
+
+typedef chrono::steady_clock Clock;
+
+//------------------------------------------------------------------------------
+// how the server behaves:
+static int stall_pct = 5;
+static chrono::milliseconds stall(200);
+static atomic<int> fail_pct(0);
+static atomic<unsigned> served(0);
+
+//------------------------------------------------------------------------------
+// a well spread pseudo-random percentage of the n-th request:
+static unsigned percent(unsigned n)
+{
+   n ^= n >> 16;
+   n *= 0x45d9f3b;
+   n ^= n >> 16;
+   return n % 100;
+}
+
+//------------------------------------------------------------------------------
+// answers the requests of one connection until it is closed:
+static void serve(int fd)
+{
+   static const string body = "{\"error\":[],\"result\":{\"unixtime\":1500000000}}";
+   ostringstream ok, unavailable;
+   ok << "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n"
+      << "Content-Length: " << body.size() << "\r\n\r\n" << body;
+   unavailable << "HTTP/1.1 503 Service Unavailable\r\n"
+	       << "Content-Length: 0\r\n\r\n";
+   const string ok_response = ok.str(), failed_response = unavailable.str();
+
+   int one = 1;
+   setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+   string buf;
+   char chunk[4096];
+   while (true) {
+      ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+      if (n <= 0) break;
+      buf.append(chunk, n);
+
+      // a request is complete with its headers and Content-Length bytes
+      while (true) {
+	 size_t head = buf.find("\r\n\r\n");
+	 if (head == string::npos) break;
+	 size_t length = 0;
+	 size_t cl = buf.find("Content-Length: ");
+	 if (cl != string::npos && cl < head)
+	    length = strtoul(buf.c_str() + cl + 16, 0, 10);
+	 if (buf.size() < head + 4 + length) break;
+	 buf.erase(0, head + 4 + length);
+
+	 unsigned p = percent(served++);
+	 bool failed = int(p) < fail_pct;
+	 bool stalled = !failed && int((p * 7 + 3) % 100) < stall_pct;
+	 this_thread::sleep_for(stalled ? stall : chrono::milliseconds(2));
+
+	 const string& response = failed ? failed_response : ok_response;
+	 if (send(fd, response.data(), response.size(), MSG_NOSIGNAL) < 0) {
+	    close(fd);
+	    return;
+	 }
+      }
+   }
+   close(fd);
+}
+
+//------------------------------------------------------------------------------
+// starts the server, returns its port:
+static int start_server()
+{
+   int fd = socket(AF_INET, SOCK_STREAM, 0);
+   if (fd < 0)
+      throw runtime_error("socket() failed");
+
+   sockaddr_in addr;
+   memset(&addr, 0, sizeof(addr));
+   addr.sin_family = AF_INET;
+   addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+   addr.sin_port = 0;
+   socklen_t len = sizeof(addr);
+   if (bind(fd, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 16) != 0 ||
+       getsockname(fd, (sockaddr*)&addr, &len) != 0)
+      throw runtime_error(string("can't listen: ") + strerror(errno));
+
+   thread([fd]() {
+	 while (true) {
+	    int c = accept(fd, 0, 0);
+	    if (c < 0) break;
+	    thread(serve, c).detach();
+	 }
+      }).detach();
+
+   return ntohs(addr.sin_port);
+}
+
+//------------------------------------------------------------------------------
+// makes 'requests' Time calls and prints their times and failures; a
+// call fails if it throws or its response has errors:
+static void run(const char* name, const string& url, int requests,
+		const KRetryPolicy& policy)
+{
+   KClient kc("", "", url, "0");
+   kc.set_metrics(std::make_shared<KMetrics>());
+   kc.set_retry(policy);
+
+   vector<double> ms;
+   int failed = 0;
+   for (int i = 0; i < requests; ++i) {
+      Clock::time_point start = Clock::now();
+      try {
+	 if (kc.public_method("Time", KInput()).find("unixtime") == string::npos)
+	    ++failed;
+      }
+      catch (exception&) {
+	 ++failed;
+      }
+      ms.push_back(chrono::duration<double, milli>(Clock::now() - start).count());
+   }
+
+   sort(ms.begin(), ms.end());
+   cout << name << ',' << fixed << setprecision(1)
+	<< ms[ms.size() / 2] << ',' << ms[ms.size() * 99 / 100] << ','
+	<< ms.back() << ',' << failed << endl;
+}
+
+//------------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+   try {
+      int requests = 400;
+      int stall_ms = 200;
+
+      switch (argc) {
+      case 4:
+	 istringstream(argv[3]) >> stall_ms;
+      case 3:
+	 istringstream(argv[2]) >> stall_pct;
+      case 2:
+	 istringstream(argv[1]) >> requests;
+      case 1:
+	 break;
+      default:
+	 throw runtime_error("wrong number of arguments");
+      };
+      if (requests <= 0)
+	 throw runtime_error("requests must be positive");
+      stall = chrono::milliseconds(stall_ms);
+
+      Kraken::initialize();
+
+      ostringstream url;
+      url << "http://127.0.0.1:" << start_server();
+
+      KRetryPolicy plain;
+      KRetryPolicy hedged;
+      hedged.hedge = true;
+      hedged.hedge_delay = chrono::milliseconds(20);
+
+      cout << "case,p50_ms,p99_ms,max_ms,failed" << endl;
+      run("plain", url.str(), requests, plain);
+      run("hedged", url.str(), requests, hedged);
+
+      KRetryPolicy retried;
+      retried.attempts = 4;
+      retried.backoff = chrono::milliseconds(10);
+      retried.deadline = chrono::seconds(2);
+
+      fail_pct = 10;
+      run("flaky", url.str(), requests, plain);
+      run("retried", url.str(), requests, retried);
+
+      Kraken::terminate();
+   }
+   catch(exception& e) {
+      cerr << "Error: " << e.what() << endl;
+      return 1;
+   }
+   catch(...) {
+      cerr << "Unknown exception." << endl;
+      return 1;
+   }
+
+   return 0;
+}
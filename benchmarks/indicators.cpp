@@ -0,0 +1,219 @@
+/*
+
+  indicators measures the streaming operators of kindicator.hpp against
+  computing each output again from its whole window, as a chart does
+  when it redraws:
+
+    indicators [candles] [period]
+
+  where:
+
+    [candles] - (optional) candles of a synthetic random walk (by default
+                1000000)
+    [period]  - (optional) period of the indicators (by default 50)
+
+  For SMA, Bollinger bands and rolling min/max it prints the time per
+  candle of both ways and the largest difference between their outputs;
+  for Heikin-Ashi it compares KHeikinAshi with heikin_ashi() by column.
+  Differences should be rounding only.
+
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "../kraken/kindicator.hpp"
+
+using namespace std;
+using namespace Kraken;
+
+typedef chrono::steady_clock Clock;
+
+//------------------------------------------------------------------------------
+// a random walk around 30000, a candle a minute:
+static KCandles make_candles(size_t count)
+{
+   mt19937 rng(42);
+   normal_distribution<double> step(0, 5);
+   uniform_real_distribution<double> unit(0, 1);
+
+   KCandles candles;
+   candles.reserve(count);
+   double price = 30000;
+   for (size_t i = 0; i < count; ++i) {
+      double open = price;
+      double close = open + step(rng);
+      double high = max(open, close) + unit(rng) * 3;
+      double low = min(open, close) - unit(rng) * 3;
+      candles.put(1500000000 + time_t(i) * 60, open, high, low, close,
+		  (open + close) / 2, unit(rng) * 10, 1 + int(unit(rng) * 100));
+      price = close;
+   }
+   return candles;
+}
+
+//------------------------------------------------------------------------------
+// the window of 'period' inputs ending at 'i', recomputed:
+
+static double window_mean(const vector<double>& x, size_t i, size_t period)
+{
+   double sum = 0;
+   for (size_t k = i + 1 - period; k <= i; ++k)
+      sum += x[k];
+   return sum / period;
+}
+
+static double window_sd(const vector<double>& x, size_t i, size_t period)
+{
+   double mean = window_mean(x, i, period), m2 = 0;
+   for (size_t k = i + 1 - period; k <= i; ++k)
+      m2 += (x[k] - mean) * (x[k] - mean);
+   return sqrt(m2 / period);
+}
+
+//------------------------------------------------------------------------------
+// prints a row: name, ns per candle of both ways, largest difference
+static void print_row(const char* name, size_t count,
+		      Clock::duration naive, Clock::duration streaming,
+		      double diff)
+{
+   cout << name << ','
+	<< fixed << setprecision(1)
+	<< chrono::duration<double, nano>(naive).count() / count << ','
+	<< chrono::duration<double, nano>(streaming).count() / count << ','
+	<< scientific << setprecision(2) << diff << endl;
+}
+
+//------------------------------------------------------------------------------
+// runs 'op' over 'x' and 'naive' at every full window, returns the largest
+// difference and the times in 'naive_time' and 'op_time':
+template <class Op, class Naive>
+static double compare(Op op, Naive naive, const vector<double>& x,
+		      size_t period, Clock::duration& naive_time,
+		      Clock::duration& op_time)
+{
+   vector<double> a(x.size()), b(x.size());
+
+   Clock::time_point start = Clock::now();
+   for (size_t i = 0; i < x.size(); ++i)
+      a[i] = op.update(x[i]);
+   op_time = Clock::now() - start;
+
+   start = Clock::now();
+   for (size_t i = period - 1; i < x.size(); ++i)
+      b[i] = naive(x, i, period);
+   naive_time = Clock::now() - start;
+
+   double diff = 0;
+   for (size_t i = period - 1; i < x.size(); ++i)
+      diff = max(diff, fabs(a[i] - b[i]));
+   return diff;
+}
+
+//------------------------------------------------------------------------------
+
+static double upper_band(const vector<double>& x, size_t i, size_t period)
+{
+   return window_mean(x, i, period) + 2 * window_sd(x, i, period);
+}
+
+static double window_min(const vector<double>& x, size_t i, size_t period)
+{
+   return *min_element(x.begin() + (i + 1 - period), x.begin() + (i + 1));
+}
+
+static double window_max(const vector<double>& x, size_t i, size_t period)
+{
+   return *max_element(x.begin() + (i + 1 - period), x.begin() + (i + 1));
+}
+
+// KBollinger's upper band as a price operator
+struct UpperBand {
+   explicit UpperBand(size_t period) :bands(period, 2) { }
+   double update(double x) { return bands.update(x).upper; }
+   KBollinger bands;
+};
+
+//------------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+   try {
+      size_t count = 1000000, period = 50;
+
+      switch (argc) {
+      case 3:
+	 istringstream(argv[2]) >> period;
+      case 2:
+	 istringstream(argv[1]) >> count;
+      case 1:
+	 break;
+      default:
+	 throw runtime_error("wrong number of arguments");
+      }
+      if (period == 0 || count < period)
+	 throw runtime_error("[period] must be positive, at most [candles]");
+
+      KCandles candles = make_candles(count);
+      const vector<double>& close = candles.close;
+      Clock::duration naive, streaming;
+      double diff;
+
+      cout << "indicator,naive_ns,streaming_ns,max_diff" << endl;
+
+      diff = compare(KSma(period), window_mean, close, period,
+		     naive, streaming);
+      print_row("sma", count, naive, streaming, diff);
+
+      diff = compare(UpperBand(period), upper_band, close, period,
+		     naive, streaming);
+      print_row("bollinger", count, naive, streaming, diff);
+
+      diff = compare(KRollingMin(period), window_min, close, period,
+		     naive, streaming);
+      print_row("rolling_min", count, naive, streaming, diff);
+
+      diff = compare(KRollingMax(period), window_max, close, period,
+		     naive, streaming);
+      print_row("rolling_max", count, naive, streaming, diff);
+
+      // Heikin-Ashi: a candle at a time against by column
+      Clock::time_point start = Clock::now();
+      KHeikinAshi ha;
+      vector<KCandle> rows;
+      apply(ha, candles, rows);
+      streaming = Clock::now() - start;
+
+      start = Clock::now();
+      KCandles columns;
+      heikin_ashi(candles, columns);
+      naive = Clock::now() - start;
+
+      diff = 0;
+      for (size_t i = 0; i < count; ++i) {
+	 diff = max(diff, fabs(rows[i].open - columns.open[i]));
+	 diff = max(diff, fabs(rows[i].high - columns.high[i]));
+	 diff = max(diff, fabs(rows[i].low - columns.low[i]));
+	 diff = max(diff, fabs(rows[i].close - columns.close[i]));
+      }
+      cout << "# heikin_ashi: streaming then by column" << endl;
+      print_row("heikin_ashi", count, streaming, naive, diff);
+   }
+   catch(exception& e) {
+      cerr << "Error: " << e.what() << endl;
+      return 1;
+   }
+   catch(...) {
+      cerr << "Unknown exception." << endl;
+      return 1;
+   }
+
+   return 0;
+}
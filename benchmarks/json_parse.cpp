@@ -0,0 +1,141 @@
+/*
+
+  json_parse measures how fast recorded Kraken responses are parsed and
+  decoded into KTrade records. It is also the training run for the
+  profile guided builds (see KRAKENAPI_PGO in CMakeLists.txt):
+
+    json_parse [iterations] [file ...]
+
+  where:
+
+    [iterations] - (optional) passes over every payload (by default 20)
+    [file ...]   - (optional) recorded Trades responses, a synthetic
+                   one with 50000 trades is used when none is given
+
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <chrono>
+#include <vector>
+#include <utility>
+
+#include "../kraken/ktrade.hpp"
+#include "../libjson/libjson.h"
+
+using namespace std;
+using namespace Kraken;
+
+//------------------------------------------------------------------------------
+// builds a Trades response with 'count' trades:
+static string make_trades(int count)
+{
+   ostringstream oss;
+   oss << fixed << setprecision(5);
+   oss << "{\"error\":[],\"result\":{\"XXBTZEUR\":[";
+
+   for (int i = 0; i < count; ++i) {
+      if (i) oss << ',';
+      oss << "[\"" << 30000 + (i % 997) * 0.1 << "\",\""
+	  << setprecision(8) << 0.001 * (1 + i % 13) << setprecision(5)
+	  << "\"," << 1500000000 + i / 3 << ".1234,\""
+	  << ((i % 2) ? 'b' : 's') << "\",\""
+	  << ((i % 5) ? 'l' : 'm') << "\",\"\"]";
+   }
+
+   oss << "],\"last\":\"1500000000123456789\"}}";
+   return oss.str();
+}
+
+//------------------------------------------------------------------------------
+// reads a whole file:
+static string read_file(const char* path)
+{
+   ifstream ifs(path, ios::in | ios::binary);
+   if (!ifs)
+      throw runtime_error(string("can't open ") + path);
+
+   ostringstream oss;
+   oss << ifs.rdbuf();
+   return oss.str();
+}
+
+//------------------------------------------------------------------------------
+// parses a response and decodes the trades of its first pair:
+static size_t decode(const string& payload, vector<KTrade>& output)
+{
+   JSONNode root = libjson::parse(libjson::to_json_string(payload));
+   JSONNode& result_pair = root["result"][0];
+
+   // same decoding loop as KClient::trades()
+   output.clear();
+   for (JSONNode::iterator
+	   it = result_pair.begin(); it != result_pair.end(); ++it) {
+      JSONNode row(std::move(*it));
+      output.push_back(KTrade(row));
+   }
+
+   return output.size();
+}
+
+//------------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+   try {
+      int iterations = 20;
+      vector<string> payloads;
+
+      if (argc > 1)
+	 istringstream(argv[1]) >> iterations;
+      for (int i = 2; i < argc; ++i)
+	 payloads.push_back(read_file(argv[i]));
+      if (payloads.empty())
+	 payloads.push_back(make_trades(50000));
+
+      size_t bytes = 0, trades = 0;
+      vector<KTrade> output;
+
+      chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+      for (int n = 0; n < iterations; ++n) {
+	 for (size_t i = 0; i < payloads.size(); ++i) {
+	    trades += decode(payloads[i], output);
+	    bytes += payloads[i].size();
+	 }
+      }
+
+      chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+      cout << "build:"
+#ifdef JSON_DEBUG
+	   << " JSON_DEBUG"
+#endif
+#ifdef JSON_SAFE
+	   << " JSON_SAFE"
+#endif
+#ifdef JSON_OBJECT_STATS
+	   << " JSON_OBJECT_STATS"
+#endif
+#ifdef NDEBUG
+	   << " NDEBUG"
+#endif
+	   << endl
+	   << fixed << setprecision(1)
+	   << "MB/s: " << bytes / elapsed.count() / 1e6 << endl
+	   << "trades/s: " << trades / elapsed.count() << endl;
+   }
+   catch(exception& e) {
+      cerr << "Error: " << e.what() << endl;
+      return 1;
+   }
+   catch(...) {
+      cerr << "Unknown exception." << endl;
+      return 1;
+   }
+
+   return 0;
+}
@@ -0,0 +1,144 @@
+/*
+
+  json_shared measures how fast many threads can take their own handle
+  on one parsed Depth snapshot and read it, either by sharing the
+  reference counted tree (needs JSON_THREAD_SAFE_REF_COUNT) or by
+  making a deep copy of it per reader:
+
+    json_shared [levels] [iterations]
+
+  where:
+
+    [levels]     - (optional) price levels per side (by default 500)
+    [iterations] - (optional) reads per thread (by default 2000)
+
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "../libjson/libjson.h"
+
+using namespace std;
+
+//------------------------------------------------------------------------------
+// builds a Depth response with the given number of levels per side:
+static string make_depth(int levels)
+{
+   ostringstream oss;
+   oss << fixed << setprecision(5);
+   oss << "{\"error\":[],\"result\":{\"XXBTZEUR\":{";
+
+   const char* sides[] = { "asks", "bids" };
+   for (int s = 0; s < 2; ++s) {
+      if (s) oss << ',';
+      oss << '"' << sides[s] << "\":[";
+      for (int i = 0; i < levels; ++i) {
+	 if (i) oss << ',';
+	 double price = (s == 0) ? 30000 + i * 0.1 : 30000 - i * 0.1;
+	 oss << "[\"" << price << "\",\"" << (1.0 + i % 7) << "\","
+	     << 1500000000 + i << ']';
+      }
+      oss << ']';
+   }
+
+   oss << "}}}";
+   return oss.str();
+}
+
+//------------------------------------------------------------------------------
+// reads the snapshot through the const interface only:
+static double read_book(const JSONNode& root)
+{
+   const JSONNode& book = root["result"]["XXBTZEUR"];
+   const JSONNode& asks = book["asks"];
+   const JSONNode& bids = book["bids"];
+
+   double sum = 0;
+   for (json_index_t i = 0; i < asks.size(); ++i)
+      sum += asks[i][0].as_float() * asks[i][1].as_float();
+   for (json_index_t i = 0; i < bids.size(); ++i)
+      sum -= bids[i][0].as_float() * bids[i][1].as_float();
+   return sum;
+}
+
+//------------------------------------------------------------------------------
+// runs 'nthreads' readers and returns nanoseconds per read:
+static double run(const JSONNode& snapshot, int nthreads,
+		  int iterations, bool deep)
+{
+   vector<thread> threads;
+   vector<double> sums(nthreads);
+
+   chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+   for (int t = 0; t < nthreads; ++t) {
+      threads.push_back(thread([&, t]() {
+	       for (int i = 0; i < iterations; ++i) {
+		  JSONNode local = deep ? snapshot.duplicate() : snapshot;
+		  sums[t] += read_book(local);
+	       }
+	    }));
+   }
+
+   for (size_t t = 0; t < threads.size(); ++t)
+      threads[t].join();
+
+   chrono::nanoseconds elapsed = chrono::steady_clock::now() - start;
+   return double(elapsed.count()) / (double(nthreads) * iterations);
+}
+
+//------------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+   try {
+      int levels = 500;
+      int iterations = 2000;
+
+      switch (argc) {
+      case 3:
+	 istringstream(argv[2]) >> iterations;
+      case 2:
+	 istringstream(argv[1]) >> levels;
+      case 1:
+	 break;
+      default:
+	 throw runtime_error("wrong number of arguments");
+      };
+
+      JSONNode snapshot = libjson::parse(make_depth(levels));
+
+      // resolve every lazily parsed node before handing the tree out
+      snapshot.preparse();
+
+      unsigned int cores = thread::hardware_concurrency();
+      if (cores == 0) cores = 4;
+
+      cout << "threads,deep_copy_ns,shared_ns" << endl;
+      for (unsigned int n = 1; n <= cores; n *= 2) {
+	 cout << n << ',' << fixed << setprecision(1)
+	      << run(snapshot, n, iterations, true) << ',';
+#ifdef JSON_THREAD_SAFE_REF_COUNT
+	 cout << run(snapshot, n, iterations, false) << endl;
+#else
+	 cout << "n/a" << endl;
+#endif
+      }
+   }
+   catch(exception& e) {
+      cerr << "Error: " << e.what() << endl;
+      return 1;
+   }
+   catch(...) {
+      cerr << "Unknown exception." << endl;
+      return 1;
+   }
+
+   return 0;
+}
@@ -0,0 +1,247 @@
+/*
+
+  json_write compares KWriter with libjson's write() and write_formatted()
+  on the two kinds of JSON we produce most: order requests and order
+  book snapshot logs:
+
+    json_write [iterations] [levels]
+
+  where:
+
+    [iterations] - (optional) messages written per case (by default 20000)
+    [levels]     - (optional) price levels per side in a snapshot
+                   (by default 100)
+
+  write() and write_formatted() serialize trees that are built once up
+  front, build_write builds the tree every time as a caller without one
+  has to. KWriter writes the same data straight from the source
+  structures into a reused buffer.
+
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <chrono>
+#include <vector>
+
+#include "../kraken/kwriter.hpp"
+#include "../libjson/libjson.h"
+
+using namespace std;
+using namespace Kraken;
+
+//------------------------------------------------------------------------------
+
+struct Order {
+   string pair, type, ordertype, oflags;
+   double price, volume;
+   long long userref;
+   bool validate;
+};
+
+struct Level {
+   double price, volume;
+   long long time;
+};
+
+struct Book {
+   string pair;
+   long long time;
+   vector<Level> asks, bids;
+};
+
+//------------------------------------------------------------------------------
+
+static Order make_order()
+{
+   Order o = { "XXBTZEUR", "buy", "limit", "post", 30000.1, 0.0125, 42, true };
+   return o;
+}
+
+static Book make_book(int levels)
+{
+   Book b;
+   b.pair = "XXBTZEUR";
+   b.time = 1500000000;
+   for (int i = 0; i < levels; ++i) {
+      // the doubles nearest to decimal prices, as they are parsed
+      Level ask = { (300000 + i) / 10.0, 1.0 + (i % 7) * 0.125, 1500000000LL + i };
+      Level bid = { (300000 - i) / 10.0, 0.5 + (i % 5) * 0.25, 1500000000LL - i };
+      b.asks.push_back(ask);
+      b.bids.push_back(bid);
+   }
+   return b;
+}
+
+//------------------------------------------------------------------------------
+// libjson trees of the same data:
+static JSONNode order_tree(const Order& o)
+{
+   JSONNode n(JSON_NODE);
+   n.push_back(JSONNode("pair", o.pair));
+   n.push_back(JSONNode("type", o.type));
+   n.push_back(JSONNode("ordertype", o.ordertype));
+   n.push_back(JSONNode("price", o.price));
+   n.push_back(JSONNode("volume", o.volume));
+   n.push_back(JSONNode("userref", (json_int_t)o.userref));
+   n.push_back(JSONNode("oflags", o.oflags));
+   n.push_back(JSONNode("validate", o.validate));
+   return n;
+}
+
+static JSONNode levels_tree(const char* name, const vector<Level>& levels)
+{
+   JSONNode side(JSON_ARRAY);
+   side.set_name(name);
+   for (size_t i = 0; i < levels.size(); ++i) {
+      JSONNode row(JSON_ARRAY);
+      row.push_back(JSONNode("", levels[i].price));
+      row.push_back(JSONNode("", levels[i].volume));
+      row.push_back(JSONNode("", (json_int_t)levels[i].time));
+      side.push_back(row);
+   }
+   return side;
+}
+
+static JSONNode book_tree(const Book& b)
+{
+   JSONNode n(JSON_NODE);
+   n.push_back(JSONNode("pair", b.pair));
+   n.push_back(JSONNode("time", (json_int_t)b.time));
+   n.push_back(levels_tree("asks", b.asks));
+   n.push_back(levels_tree("bids", b.bids));
+   return n;
+}
+
+//------------------------------------------------------------------------------
+// the same data written with KWriter:
+static void write_order(KWriter& w, const Order& o)
+{
+   w.begin_object()
+      .key("pair").value(o.pair)
+      .key("type").value(o.type)
+      .key("ordertype").value(o.ordertype)
+      .key("price").value(o.price)
+      .key("volume").value(o.volume)
+      .key("userref").value(o.userref)
+      .key("oflags").value(o.oflags)
+      .key("validate").value(o.validate)
+      .end_object();
+}
+
+static void write_levels(KWriter& w, const vector<Level>& levels)
+{
+   w.begin_array();
+   for (size_t i = 0; i < levels.size(); ++i)
+      w.begin_array()
+	 .value(levels[i].price)
+	 .value(levels[i].volume)
+	 .value(levels[i].time)
+	 .end_array();
+   w.end_array();
+}
+
+static void write_book(KWriter& w, const Book& b)
+{
+   w.begin_object().key("pair").value(b.pair).key("time").value(b.time);
+   w.key("asks");
+   write_levels(w, b.asks);
+   w.key("bids");
+   write_levels(w, b.bids);
+   w.end_object();
+}
+
+//------------------------------------------------------------------------------
+// returns nanoseconds per call of f():
+template <class F>
+static double measure(int iterations, F f)
+{
+   chrono::steady_clock::time_point start = chrono::steady_clock::now();
+   for (int i = 0; i < iterations; ++i)
+      f();
+   chrono::nanoseconds elapsed = chrono::steady_clock::now() - start;
+   return double(elapsed.count()) / iterations;
+}
+
+//------------------------------------------------------------------------------
+// prints one row of the results:
+template <class T>
+static void run(const char* name, int iterations, const T& data,
+		JSONNode (*build)(const T&), void (*write)(KWriter&, const T&))
+{
+   JSONNode tree = build(data);
+   string buf;
+   size_t sink = 0;
+
+   {
+      KWriter w(buf);
+      write(w, data);
+      if (!libjson::is_valid(libjson::to_json_string(buf)))
+	 throw runtime_error(string("KWriter wrote invalid JSON for ") + name);
+   }
+
+   double plain = measure(iterations, [&]() {
+	 sink += tree.write().size();
+      });
+   double formatted = measure(iterations, [&]() {
+	 sink += tree.write_formatted().size();
+      });
+   double build_write = measure(iterations, [&]() {
+	 sink += build(data).write().size();
+      });
+   double kwriter = measure(iterations, [&]() {
+	 buf.clear();
+	 KWriter w(buf);
+	 write(w, data);
+	 sink += buf.size();
+      });
+
+   // keeps the writes from being optimized away
+   if (sink == 0)
+      throw runtime_error(string("nothing written for ") + name);
+
+   cout << name << ',' << buf.size() << ','
+	<< fixed << setprecision(1)
+	<< plain << ',' << formatted << ',' << build_write << ','
+	<< kwriter << endl;
+}
+
+//------------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+   try {
+      int iterations = 20000;
+      int levels = 100;
+
+      switch (argc) {
+      case 3:
+	 istringstream(argv[2]) >> levels;
+      case 2:
+	 istringstream(argv[1]) >> iterations;
+      case 1:
+	 break;
+      default:
+	 throw runtime_error("wrong number of arguments");
+      };
+
+      Order order = make_order();
+      Book book = make_book(levels);
+
+      cout << "payload,bytes,write_ns,write_formatted_ns,build_write_ns,kwriter_ns" << endl;
+      run("order", iterations, order, order_tree, write_order);
+      run("snapshot", iterations, book, book_tree, write_book);
+   }
+   catch(exception& e) {
+      cerr << "Error: " << e.what() << endl;
+      return 1;
+   }
+   catch(...) {
+      cerr << "Unknown exception." << endl;
+      return 1;
+   }
+
+   return 0;
+}
@@ -0,0 +1,198 @@
+/*
+
+  ohlc_decode compares two ways of getting a day of 15 minute candles:
+  downloading the day's trades and grouping them (what kph did), and
+  downloading Kraken's candles (OHLC), decoded with libjson or with
+  decode_ohlc() straight into KCandles:
+
+    ohlc_decode [iterations] [trades]
+
+  where:
+
+    [iterations] - (optional) decodes per case (by default 50)
+    [trades]     - (optional) trades in the day (by default 40000)
+
+  Responses are synthetic. For each case the response size, the time of
+  a decode and the candles it yields are printed.
+
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <chrono>
+#include <vector>
+#include <utility>
+
+#include "../kraken/ktrade.hpp"
+#include "../kraken/kcandle.hpp"
+#include "../libjson/libjson.h"
+
+using namespace std;
+using namespace Kraken;
+
+static const time_t DAY_START = 1500000000 - 1500000000 % 86400;
+static const time_t STEP = 15 * 60;
+
+//------------------------------------------------------------------------------
+// builds a Trades response with 'count' trades over a day:
+static string make_trades(int count)
+{
+   ostringstream oss;
+   oss << fixed << setprecision(5);
+   oss << "{\"error\":[],\"result\":{\"XXBTZEUR\":[";
+
+   for (int i = 0; i < count; ++i) {
+      if (i) oss << ',';
+      oss << "[\"" << 30000 + (i % 997) * 0.1 << "\",\""
+	  << setprecision(8) << 0.001 * (1 + i % 13) << setprecision(5)
+	  << "\"," << DAY_START + (long long)i * 86400 / count << ".1234,\""
+	  << ((i % 2) ? 'b' : 's') << "\",\""
+	  << ((i % 5) ? 'l' : 'm') << "\",\"\"]";
+   }
+
+   oss << "],\"last\":\"1500000000123456789\"}}";
+   return oss.str();
+}
+
+//------------------------------------------------------------------------------
+// builds an OHLC response of 720 candles ending with the day:
+static string make_ohlc()
+{
+   ostringstream oss;
+   oss << "{\"error\":[],\"result\":{\"XXBTZEUR\":[";
+
+   time_t first = DAY_START + 86400 - 720 * STEP;
+   for (int i = 0; i < 720; ++i) {
+      double o = 30000 + (i % 37) * 1.5;
+      if (i) oss << ',';
+      oss << '[' << first + i * STEP << fixed << setprecision(1)
+	  << ",\"" << o << "\",\"" << o + 10 << "\",\"" << o - 10
+	  << "\",\"" << o + 5 << "\",\"" << o + 2 << "\",\""
+	  << setprecision(8) << 1.25 + (i % 17) * 0.1 << "\"," << 10 + i % 50
+	  << ']';
+   }
+
+   oss << "],\"last\":" << first + 719 * STEP << "}}";
+   return oss.str();
+}
+
+//------------------------------------------------------------------------------
+// parses trades with libjson as KClient::trades() does and groups
+// them as kph does:
+static size_t trades_grouped(const string& payload, KCandles& output)
+{
+   JSONNode root = libjson::parse(libjson::to_json_string(payload));
+   JSONNode& result_pair = root["result"][0];
+
+   vector<KTrade> trades;
+   trades.reserve(result_pair.size());
+   for (JSONNode::iterator
+	   it = result_pair.begin(); it != result_pair.end(); ++it) {
+      JSONNode row(std::move(*it));
+      trades.push_back(KTrade(row));
+   }
+
+   output.clear();
+   for (size_t i = 0; i < trades.size(); ) {
+      time_t t = trades[i].time - trades[i].time % STEP;
+      double open = trades[i].price, high = open, low = open, close = open;
+      double volume = 0;
+      int count = 0;
+      for (; i < trades.size() && trades[i].time < t + STEP; ++i, ++count) {
+	 if (trades[i].price > high) high = trades[i].price;
+	 if (trades[i].price < low) low = trades[i].price;
+	 close = trades[i].price;
+	 volume += trades[i].volume;
+      }
+      output.put(t, open, high, low, close, 0, volume, count);
+   }
+   return output.size();
+}
+
+//------------------------------------------------------------------------------
+// parses candles with libjson:
+static size_t ohlc_libjson(const string& payload, KCandles& output)
+{
+   JSONNode root = libjson::parse(libjson::to_json_string(payload));
+   JSONNode& rows = root["result"][0];
+
+   output.clear();
+   output.reserve(rows.size());
+   for (JSONNode::const_iterator it = rows.begin(); it != rows.end(); ++it) {
+      const JSONNode& r = *it;
+      output.put(time_t(r[0].as_int()), r[1].as_float(), r[2].as_float(),
+		 r[3].as_float(), r[4].as_float(), r[5].as_float(),
+		 r[6].as_float(), int(r[7].as_int()));
+   }
+   return output.size();
+}
+
+//------------------------------------------------------------------------------
+// decodes candles as KClient::ohlc() does:
+static size_t ohlc_direct(const string& payload, KCandles& output)
+{
+   string last;
+   output.clear();
+   if (!decode_ohlc(payload, output, last))
+      throw runtime_error("decode_ohlc() failed");
+   return output.size();
+}
+
+//------------------------------------------------------------------------------
+// runs a case and prints its row:
+static void run(const char* name, const string& payload, int iterations,
+		size_t (*decode)(const string&, KCandles&))
+{
+   KCandles output;
+   size_t candles = 0;
+
+   chrono::steady_clock::time_point start = chrono::steady_clock::now();
+   for (int n = 0; n < iterations; ++n)
+      candles = decode(payload, output);
+   chrono::duration<double, micro> elapsed = chrono::steady_clock::now() - start;
+
+   cout << name << ',' << payload.size() << ',' << fixed << setprecision(1)
+	<< elapsed.count() / iterations << ',' << candles << endl;
+}
+
+//------------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+   try {
+      int iterations = 50;
+      int trades = 40000;
+
+      switch (argc) {
+      case 3:
+	 istringstream(argv[2]) >> trades;
+      case 2:
+	 istringstream(argv[1]) >> iterations;
+      case 1:
+	 break;
+      default:
+	 throw runtime_error("wrong number of arguments");
+      };
+      if (iterations <= 0 || trades <= 0)
+	 throw runtime_error("iterations and trades must be positive");
+
+      string day = make_trades(trades), candles = make_ohlc();
+
+      cout << "case,bytes,us_per_decode,candles" << endl;
+      run("trades_grouped", day, iterations, trades_grouped);
+      run("ohlc_libjson", candles, iterations, ohlc_libjson);
+      run("ohlc_direct", candles, iterations, ohlc_direct);
+   }
+   catch(exception& e) {
+      cerr << "Error: " << e.what() << endl;
+      return 1;
+   }
+   catch(...) {
+      cerr << "Unknown exception." << endl;
+      return 1;
+   }
+
+   return 0;
+}
@@ -0,0 +1,235 @@
+/*
+
+  order_entry measures decision-to-wire time of an AddOrder: from the
+  moment the order is decided (its price is known) to the moment its
+  first byte reaches a local HTTP server, for KClient::private_method()
+  and for KOrderEntry:
+
+    order_entry [orders]
+
+  where:
+
+    [orders] - (optional) orders sent per case (by default 5000)
+
+  The server runs in this process on 127.0.0.1 and stamps each request
+  with the same steady clock when its first bytes are read; it answers
+  every request at once. Connections are opened (and kept alive) before
+  the clock starts. The key and secret are dummies, nothing leaves the
+  machine.
+
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "../kraken/kclient.hpp"
+#include "../kraken/korderentry.hpp"
+
+using namespace std;
+using namespace Kraken;
+
+typedef chrono::steady_clock Clock;
+
+//------------------------------------------------------------------------------
+// arrival of the last request, in Clock ticks:
+static atomic<long long> last_arrival(0);
+
+//------------------------------------------------------------------------------
+// answers the requests of one connection until it is closed:
+static void serve(int fd)
+{
+   static const string body = "{\"error\":[],\"result\":{\"txid\":[\"O-TEST\"]}}";
+   ostringstream oss;
+   oss << "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n"
+       << "Content-Length: " << body.size() << "\r\n\r\n" << body;
+   const string response = oss.str();
+
+   int one = 1;
+   setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+   string buf;
+   char chunk[4096];
+   while (true) {
+      ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+      if (n <= 0) break;
+      if (buf.empty())
+	 last_arrival = Clock::now().time_since_epoch().count();
+      buf.append(chunk, n);
+
+      // a request is complete with its headers and Content-Length bytes
+      while (true) {
+	 size_t head = buf.find("\r\n\r\n");
+	 if (head == string::npos) break;
+	 size_t length = 0;
+	 size_t cl = buf.find("Content-Length: ");
+	 if (cl != string::npos && cl < head)
+	    length = strtoul(buf.c_str() + cl + 16, 0, 10);
+	 if (buf.size() < head + 4 + length) break;
+
+	 buf.erase(0, head + 4 + length);
+	 if (send(fd, response.data(), response.size(), MSG_NOSIGNAL) < 0) {
+	    close(fd);
+	    return;
+	 }
+      }
+   }
+   close(fd);
+}
+
+//------------------------------------------------------------------------------
+// starts the server, returns its port:
+static int start_server()
+{
+   int fd = socket(AF_INET, SOCK_STREAM, 0);
+   if (fd < 0)
+      throw runtime_error("socket() failed");
+
+   sockaddr_in addr;
+   memset(&addr, 0, sizeof(addr));
+   addr.sin_family = AF_INET;
+   addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+   addr.sin_port = 0;
+   socklen_t len = sizeof(addr);
+   if (bind(fd, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 16) != 0 ||
+       getsockname(fd, (sockaddr*)&addr, &len) != 0)
+      throw runtime_error(string("can't listen: ") + strerror(errno));
+
+   thread([fd]() {
+	 while (true) {
+	    int c = accept(fd, 0, 0);
+	    if (c < 0) break;
+	    thread(serve, c).detach();
+	 }
+      }).detach();
+
+   return ntohs(addr.sin_port);
+}
+
+//------------------------------------------------------------------------------
+// prints median, 99th percentile and mean of samples in microseconds:
+static void report(const char* name, vector<double>& us)
+{
+   sort(us.begin(), us.end());
+   double sum = 0;
+   for (size_t i = 0; i < us.size(); ++i) sum += us[i];
+
+   cout << name << ',' << fixed << setprecision(1)
+	<< us[us.size() / 2] << ',' << us[us.size() * 99 / 100] << ','
+	<< sum / us.size() << endl;
+}
+
+//------------------------------------------------------------------------------
+// the price of the n-th order:
+static string price(int n)
+{
+   ostringstream oss;
+   oss << fixed << setprecision(1) << 30000 + (n % 100) * 0.1;
+   return oss.str();
+}
+
+//------------------------------------------------------------------------------
+// sends 'orders' orders with send(price) and collects decision-to-wire
+// times:
+template <class F>
+static vector<double> run(int orders, F send)
+{
+   vector<double> us;
+   us.reserve(orders);
+   for (int n = 0; n < orders; ++n) {
+      string p = price(n);
+      Clock::time_point decided = Clock::now();
+      send(p);
+      Clock::time_point wire{Clock::duration(last_arrival.load())};
+      us.push_back(chrono::duration<double, micro>(wire - decided).count());
+   }
+   return us;
+}
+
+//------------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+   try {
+      int orders = 5000;
+
+      switch (argc) {
+      case 2:
+	 istringstream(argv[1]) >> orders;
+      case 1:
+	 break;
+      default:
+	 throw runtime_error("wrong number of arguments");
+      };
+      if (orders <= 0)
+	 throw runtime_error("orders must be positive");
+
+      Kraken::initialize();
+
+      ostringstream url;
+      url << "http://127.0.0.1:" << start_server();
+      const string key = "benchmark-key";
+      const string secret = string(86, 'A') + "==";
+
+      KClient kc(key, secret, url.str(), "0");
+      KInput in;
+      in["pair"] = "XXBTZEUR";
+      kc.private_method("AddOrder", in);  // opens the connection
+
+      vector<double> kclient = run(orders, [&](const string& p) {
+	    KInput in;
+	    in["pair"] = "XXBTZEUR";
+	    in["type"] = "buy";
+	    in["ordertype"] = "limit";
+	    in["price"] = p;
+	    in["volume"] = "0.01250000";
+	    in["oflags"] = "post";
+	    kc.private_method("AddOrder", in);
+	 });
+
+      KInput fixed_params;
+      fixed_params.set("pair", "XXBTZEUR").set("ordertype", "limit")
+	 .set("oflags", "post");
+      KOrderEntry entry(key, secret, fixed_params, 1, "AddOrder", url.str());
+      entry.warm();
+
+      KInput vars;
+      vector<double> fast = run(orders, [&](const string& p) {
+	    vars.clear();
+	    vars.set("type", "buy").set("price", p).set("volume", "0.01250000");
+	    entry.send(vars);
+	 });
+
+      cout << "case,median_us,p99_us,mean_us" << endl;
+      report("kclient", kclient);
+      report("korderentry", fast);
+
+      Kraken::terminate();
+   }
+   catch(exception& e) {
+      cerr << "Error: " << e.what() << endl;
+      return 1;
+   }
+   catch(...) {
+      cerr << "Unknown exception." << endl;
+      return 1;
+   }
+
+   return 0;
+}
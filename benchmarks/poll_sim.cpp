@@ -0,0 +1,259 @@
+/*
+
+  poll_sim replays trade streams against polling policies and measures
+  how fresh each keeps the trades for the requests it makes:
+
+    poll_sim [budget] [min] [max] [file ...]
+
+  where:
+
+    [budget] - (optional) requests per second over all pairs (by default 1)
+    [min]    - (optional) shortest interval between polls of a pair, in
+               seconds (by default 1)
+    [max]    - (optional) longest interval (by default 300)
+    [file]   - (optional) trades of a pair as krt writes them (e.g. the
+               <pair>.csv files of krt's daemon mode), one file per pair;
+               without files 50 synthetic pairs are simulated for a day,
+               with rates from one trade an hour to two a second and
+               bursts
+
+  The policies are:
+
+    fixed   - every pair in turn, as one krt per pair with the same interval
+    halving - krt's daemon before KPollScheduler: the interval of a pair
+              halves when trades came and doubles when none did
+    rate    - KPollScheduler
+
+  Every policy gets the same budget (a poll can't start before 1/budget
+  seconds after the one before) and pages of 1000 trades. The staleness
+  of a trade is the time from the trade to the poll that returns it
+  (trades never returned count until the end). For each policy the
+  requests made and the mean, median and 99th percentile staleness are
+  printed.
+
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <cmath>
+
+#include "../kraken/kpoll.hpp"
+
+using namespace std;
+using namespace Kraken;
+
+// trades per response of Trades
+static const size_t PAGE = 1000;
+
+typedef vector<double> Stream;   // trade times, oldest first
+
+//------------------------------------------------------------------------------
+// reads the trade times of a krt file, lines starting "<time>",...:
+static Stream read_stream(const string& path)
+{
+   ifstream in(path.c_str());
+   if (!in)
+      throw runtime_error("can't read " + path);
+
+   Stream s;
+   for (string line; getline(in, line); ) {
+      double t;
+      if (line.size() > 1 && istringstream(line.substr(1)) >> t)
+	 s.push_back(t);
+   }
+   sort(s.begin(), s.end());
+   return s;
+}
+
+//------------------------------------------------------------------------------
+// Poisson streams over a day, rates log-uniform from 1/3600 to 2 per
+// second, each with a burst of ten times its rate for half an hour:
+static vector<Stream> synthetic_streams()
+{
+   mt19937 rng(42);
+   uniform_real_distribution<double> unit(0, 1);
+   vector<Stream> streams(50);
+
+   for (size_t i = 0; i < streams.size(); ++i) {
+      double rate = exp(log(1.0 / 3600) + unit(rng) * log(7200.0));
+      double burst = unit(rng) * 84600;
+      for (double t = 0; ; ) {
+	 bool in_burst = t >= burst && t < burst + 1800;
+	 t += exponential_distribution<double>(in_burst ? rate * 10 : rate)(rng);
+	 if (t >= 86400) break;
+	 streams[i].push_back(t);
+      }
+   }
+   return streams;
+}
+
+//------------------------------------------------------------------------------
+// every pair in turn, each every size/budget seconds:
+class FixedPolicy {
+public:
+   FixedPolicy(size_t size, double budget)
+      :last_(size, -1), interval_(size / budget) { }
+
+   size_t next(double& due) const {
+      size_t first = 0;
+      due = HUGE_VAL;
+      for (size_t i = 0; i < last_.size(); ++i) {
+	 double d = last_[i] < 0 ? 0 : last_[i] + interval_;
+	 if (d < due) { due = d; first = i; }
+      }
+      return first;
+   }
+
+   void polled(size_t i, double now, const double*, size_t, bool) {
+      last_[i] = now;
+   }
+
+private:
+   vector<double> last_;
+   double interval_;
+};
+
+//------------------------------------------------------------------------------
+// halves the interval of a pair when trades came, doubles it otherwise:
+class HalvingPolicy {
+public:
+   HalvingPolicy(size_t size, double min, double max)
+      :last_(size, -1), interval_(size, min), min_(min), max_(max) { }
+
+   size_t next(double& due) const {
+      size_t first = 0;
+      due = HUGE_VAL;
+      for (size_t i = 0; i < last_.size(); ++i) {
+	 double d = last_[i] < 0 ? 0 : last_[i] + interval_[i];
+	 if (d < due) { due = d; first = i; }
+      }
+      return first;
+   }
+
+   void polled(size_t i, double now, const double*, size_t n, bool) {
+      last_[i] = now;
+      interval_[i] = n ? std::max(min_, interval_[i] / 2)
+	 : std::min(max_, interval_[i] * 2);
+   }
+
+private:
+   vector<double> last_, interval_;
+   double min_, max_;
+};
+
+//------------------------------------------------------------------------------
+// runs a policy over the streams and prints its row:
+template <class Policy>
+static void simulate(const char* name, Policy& policy,
+		     const vector<Stream>& streams, double budget)
+{
+   double start = HUGE_VAL, end = -HUGE_VAL;
+   for (size_t i = 0; i < streams.size(); ++i) {
+      if (streams[i].empty()) continue;
+      start = std::min(start, streams[i].front());
+      end = std::max(end, streams[i].back());
+   }
+
+   vector<size_t> seen(streams.size(), 0);
+   vector<double> staleness;
+   size_t calls = 0;
+   double now = start, gap = 1 / budget;
+
+   for (;;) {
+      double due;
+      size_t i = policy.next(due);
+      now = std::max(due, calls ? now + gap : start);
+      if (now > end)
+	 break;
+
+      // the trades up to 'now' not returned yet, a page at most
+      const Stream& s = streams[i];
+      size_t from = seen[i], to = from;
+      while (to < s.size() && s[to] <= now && to - from < PAGE)
+	 ++to;
+      for (size_t k = from; k < to; ++k)
+	 staleness.push_back(now - s[k]);
+      bool backlog = to < s.size() && s[to] <= now;
+
+      policy.polled(i, now, s.data() + from, to - from, backlog);
+      seen[i] = to;
+      ++calls;
+   }
+
+   for (size_t i = 0; i < streams.size(); ++i)
+      for (size_t k = seen[i]; k < streams[i].size(); ++k)
+	 staleness.push_back(end - streams[i][k]);
+
+   double mean = 0;
+   for (size_t k = 0; k < staleness.size(); ++k)
+      mean += staleness[k];
+   mean /= staleness.empty() ? 1 : staleness.size();
+
+   double p50 = 0, p99 = 0;
+   if (!staleness.empty()) {
+      sort(staleness.begin(), staleness.end());
+      p50 = staleness[staleness.size() / 2];
+      p99 = staleness[size_t(staleness.size() * 0.99)];
+   }
+
+   cout << name << ',' << calls << ',' << fixed << setprecision(1)
+	<< mean << ',' << p50 << ',' << p99 << endl;
+}
+
+//------------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+   try {
+      double budget = 1, min = 1, max = 300;
+
+      if (argc > 1) istringstream(argv[1]) >> budget;
+      if (argc > 2) istringstream(argv[2]) >> min;
+      if (argc > 3) istringstream(argv[3]) >> max;
+      if (budget <= 0 || min <= 0 || max < min)
+	 throw runtime_error("budget and intervals must be positive, "
+			     "[min] <= [max]");
+
+      vector<Stream> streams;
+      for (int i = 4; i < argc; ++i)
+	 streams.push_back(read_stream(argv[i]));
+      if (streams.empty())
+	 streams = synthetic_streams();
+
+      size_t trades = 0;
+      for (size_t i = 0; i < streams.size(); ++i)
+	 trades += streams[i].size();
+      cout << "# " << streams.size() << " pairs, " << trades << " trades"
+	   << endl;
+
+      cout << "policy,requests,mean_s,p50_s,p99_s" << endl;
+
+      FixedPolicy fixed_policy(streams.size(), budget);
+      simulate("fixed", fixed_policy, streams, budget);
+
+      HalvingPolicy halving(streams.size(), min, max);
+      simulate("halving", halving, streams, budget);
+
+      KPollScheduler rate(budget, min, max);
+      for (size_t i = 0; i < streams.size(); ++i)
+	 rate.add();
+      simulate("rate", rate, streams, budget);
+   }
+   catch(exception& e) {
+      cerr << "Error: " << e.what() << endl;
+      return 1;
+   }
+   catch(...) {
+      cerr << "Unknown exception." << endl;
+      return 1;
+   }
+
+   return 0;
+}
@@ -0,0 +1,127 @@
+/*
+
+  query_build compares the ways of building the postdata of an AddOrder
+  request (nonce included):
+
+    query_build [iterations]
+
+  where:
+
+    [iterations] - (optional) queries built per case (by default 1000000)
+
+  map_ostream is what KClient did before KInput: a std::map filled for
+  every request and written through an ostringstream, without encoding.
+  kinput fills a reused KInput and writes into a reused buffer, template
+  encodes the fixed parameters once (KInputTemplate) and only the price,
+  volume and nonce per request.
+
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <chrono>
+#include <map>
+#include <string>
+
+#include "../kraken/kinput.hpp"
+
+using namespace std;
+using namespace Kraken;
+
+//------------------------------------------------------------------------------
+// returns nanoseconds per call of f():
+template <class F>
+static double measure(int iterations, F f)
+{
+   chrono::steady_clock::time_point start = chrono::steady_clock::now();
+   for (int i = 0; i < iterations; ++i)
+      f(i);
+   chrono::nanoseconds elapsed = chrono::steady_clock::now() - start;
+   return double(elapsed.count()) / iterations;
+}
+
+//------------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+   try {
+      int iterations = 1000000;
+
+      switch (argc) {
+      case 2:
+	 istringstream(argv[1]) >> iterations;
+      case 1:
+	 break;
+      default:
+	 throw runtime_error("wrong number of arguments");
+      };
+
+      const string nonce = "1500000000123456";
+      const string prices[] = { "30000.1", "30000.2", "30000.3", "30000.4" };
+      size_t sink = 0;
+
+      double map_ostream = measure(iterations, [&](int i) {
+	    map<string, string> in;
+	    in["pair"] = "XXBTZEUR";
+	    in["type"] = "buy";
+	    in["ordertype"] = "limit";
+	    in["price"] = prices[i & 3];
+	    in["volume"] = "0.01250000";
+	    in["oflags"] = "post";
+	    in["userref"] = "42";
+
+	    ostringstream oss;
+	    oss << "nonce=" << nonce;
+	    for (map<string, string>::const_iterator
+		    it = in.begin(); it != in.end(); ++it)
+	       oss << '&' << it->first << '=' << it->second;
+	    sink += oss.str().size();
+	 });
+
+      KInput in;
+      string buf;
+      double kinput = measure(iterations, [&](int i) {
+	    in.clear();
+	    in.set("pair", "XXBTZEUR").set("type", "buy").set("ordertype", "limit")
+	       .set("price", prices[i & 3]).set("volume", "0.01250000")
+	       .set("oflags", "post").set("userref", 42);
+	    buf.assign("nonce=").append(nonce);
+	    in.append_query(buf);
+	    sink += buf.size();
+	 });
+
+      KInput constant;
+      constant.set("pair", "XXBTZEUR").set("type", "buy").set("ordertype", "limit")
+	 .set("oflags", "post").set("userref", 42);
+      KInputTemplate tmpl(constant);
+      double templ = measure(iterations, [&](int i) {
+	    in.clear();
+	    in.set("price", prices[i & 3]).set("volume", "0.01250000")
+	       .set("nonce", nonce);
+	    tmpl.build(in, buf);
+	    sink += buf.size();
+	 });
+
+      // keeps the queries from being optimized away
+      if (sink == 0)
+	 throw runtime_error("nothing built");
+
+      cout << "case,ns_per_query" << endl
+	   << fixed << setprecision(1)
+	   << "map_ostream," << map_ostream << endl
+	   << "kinput," << kinput << endl
+	   << "template," << templ << endl;
+   }
+   catch(exception& e) {
+      cerr << "Error: " << e.what() << endl;
+      return 1;
+   }
+   catch(...) {
+      cerr << "Unknown exception." << endl;
+      return 1;
+   }
+
+   return 0;
+}
@@ -0,0 +1,285 @@
+/*
+
+  resample measures putting the trades of many pairs on one dense time
+  grid: grouping each pair's trades into candles as kph does, merging
+  them by time in a map and filling the gaps (what we did), against
+  KCandleGrid:
+
+    resample [pairs] [step] [hours]
+
+  where:
+
+    [pairs] - (optional) pairs of synthetic trades (by default 50), from
+              one trade every ten minutes to two a second, so the less
+              traded pairs leave most buckets empty
+    [step]  - (optional) seconds of a bucket (by default 60)
+    [hours] - (optional) hours of trades (by default 24)
+
+  Both ways carry the close forward into empty buckets and must give the
+  same closes (checked). Then the correlation matrix of the pairs' close
+  to close returns is computed from the grid's rows. Each prints its
+  time, the fastest of three runs.
+
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+#include <map>
+#include <limits>
+#include <utility>
+#include <random>
+#include <chrono>
+#include <cmath>
+
+#include "../kraken/kresample.hpp"
+
+using namespace std;
+using namespace Kraken;
+
+typedef chrono::steady_clock Clock;
+
+//------------------------------------------------------------------------------
+// Poisson trades on random walks, rates log-uniform from 1/600 to 2 per
+// second:
+static vector<vector<KTrade> > make_trades(size_t pairs, time_t from,
+					   time_t to)
+{
+   mt19937 rng(42);
+   uniform_real_distribution<double> unit(0, 1);
+   normal_distribution<double> step(0, 0.0005);
+   vector<vector<KTrade> > trades(pairs);
+
+   for (size_t p = 0; p < pairs; ++p) {
+      double rate = exp(log(1.0 / 600) + unit(rng) * log(1200.0));
+      double price = 100 * (1 + p);
+      exponential_distribution<double> gap(rate);
+      for (double t = double(from); ; ) {
+	 t += gap(rng);
+	 if (t >= double(to)) break;
+	 KTrade trade;
+	 price *= 1 + step(rng);
+	 trade.price = price;
+	 trade.volume = unit(rng);
+	 trade.time = time_t(t);
+	 trades[p].push_back(trade);
+      }
+   }
+   return trades;
+}
+
+//------------------------------------------------------------------------------
+// kph's group_by_time(), the closes of the buckets with trades only:
+static void group_by_time(const vector<KTrade>& trades, time_t step,
+			  vector<KCandle>& candles)
+{
+   vector<KTrade>::const_iterator it = trades.begin();
+   while (it != trades.end()) {
+      KCandle c;
+      c.volume = 0;
+      c.open = c.low = c.high = it->price;
+      c.time = it->time - (it->time % step);
+      while (it != trades.end() && it->time < c.time + step) {
+	 if (it->price < c.low) c.low = it->price;
+	 if (it->price > c.high) c.high = it->price;
+	 c.volume += it->volume;
+	 c.close = it->price;
+	 ++it;
+      }
+      candles.push_back(c);
+   }
+}
+
+//------------------------------------------------------------------------------
+// the closes of every pair on the grid [start, start + steps * step),
+// carried forward, through a map from time to the closes of the pairs:
+static vector<vector<double> > map_merge(const vector<vector<KTrade> >& trades,
+					 time_t start, time_t step,
+					 size_t steps)
+{
+   size_t pairs = trades.size();
+   double nan = numeric_limits<double>::quiet_NaN();
+   map<time_t, vector<double> > by_time;
+
+   for (size_t p = 0; p < pairs; ++p) {
+      vector<KCandle> candles;
+      group_by_time(trades[p], step, candles);
+      for (size_t i = 0; i < candles.size(); ++i) {
+	 vector<double>& row = by_time[candles[i].time];
+	 if (row.empty())
+	    row.assign(pairs, nan);
+	 row[p] = candles[i].close;
+      }
+   }
+
+   vector<vector<double> > closes(pairs, vector<double>(steps, nan));
+   vector<double> carry(pairs, nan);
+   for (size_t k = 0; k < steps; ++k) {
+      map<time_t, vector<double> >::const_iterator it =
+	 by_time.find(start + time_t(k) * step);
+      for (size_t p = 0; p < pairs; ++p) {
+	 if (it != by_time.end() && it->second[p] == it->second[p])
+	    carry[p] = it->second[p];
+	 closes[p][k] = carry[p];
+      }
+   }
+   return closes;
+}
+
+//------------------------------------------------------------------------------
+// the correlations of the returns of every two pairs, from the grid's
+// rows; buckets where a pair has no price yet count as no change:
+static vector<double> correlations(const KCandleGrid& grid)
+{
+   size_t pairs = grid.pairs(), n = grid.steps();
+   size_t stride = grid.stride();
+   vector<double> returns(pairs * stride, 0);
+
+   // returns, centered and scaled to unit length
+   for (size_t p = 0; p < pairs; ++p) {
+      const double* close = grid.close(p);
+      double* r = &returns[p * stride];
+      for (size_t k = 1; k < n; ++k)
+	 r[k] = close[k] > 0 && close[k - 1] > 0 ? log(close[k] / close[k - 1])
+	    : 0;
+
+      double mean = 0, norm = 0;
+      for (size_t k = 1; k < n; ++k)
+	 mean += r[k];
+      mean /= n > 1 ? n - 1 : 1;
+      for (size_t k = 1; k < n; ++k) {
+	 r[k] -= mean;
+	 norm += r[k] * r[k];
+      }
+      norm = norm > 0 ? 1 / sqrt(norm) : 0;
+      for (size_t k = 1; k < n; ++k)
+	 r[k] *= norm;
+   }
+
+   // dot products of the rows
+   vector<double> corr(pairs * pairs);
+   for (size_t a = 0; a < pairs; ++a)
+      for (size_t b = a; b < pairs; ++b) {
+	 const double* x = &returns[a * stride];
+	 const double* y = &returns[b * stride];
+	 double dot = 0;
+	 for (size_t k = 0; k < stride; ++k)
+	    dot += x[k] * y[k];
+	 corr[a * pairs + b] = corr[b * pairs + a] = dot;
+      }
+   return corr;
+}
+
+//------------------------------------------------------------------------------
+// the fastest of three runs of 'f':
+template <class Function>
+static Clock::duration best_of_three(Function f)
+{
+   Clock::duration best = Clock::duration::max();
+   for (int run = 0; run < 3; ++run) {
+      Clock::time_point start = Clock::now();
+      f();
+      best = min(best, Clock::duration(Clock::now() - start));
+   }
+   return best;
+}
+
+//------------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+   try {
+      size_t pairs = 50;
+      time_t step = 60, hours = 24;
+
+      switch (argc) {
+      case 4:
+	 istringstream(argv[3]) >> hours;
+      case 3:
+	 istringstream(argv[2]) >> step;
+      case 2:
+	 istringstream(argv[1]) >> pairs;
+      case 1:
+	 break;
+      default:
+	 throw runtime_error("wrong number of arguments");
+      }
+      if (pairs == 0 || step <= 0 || hours <= 0)
+	 throw runtime_error("[pairs], [step] and [hours] must be positive");
+
+      time_t from = 1500000000, to = from + hours * 3600;
+      vector<vector<KTrade> > trades = make_trades(pairs, from, to);
+      size_t count = 0;
+      for (size_t p = 0; p < pairs; ++p)
+	 count += trades[p].size();
+
+      vector<vector<double> > closes;
+      KCandleGrid grid(from, to, step, pairs);
+
+      Clock::duration merge_time = best_of_three([&]() {
+	    closes = map_merge(trades, grid.start(), step, grid.steps());
+	 });
+
+      Clock::duration grid_time = best_of_three([&]() {
+	    KCandleGrid g(from, to, step, pairs);
+	    for (size_t p = 0; p < pairs; ++p)
+	       g.add(p, trades[p]);
+	    g.fill(KFILL_CARRY);
+	    grid = std::move(g);
+	 });
+
+      size_t mismatches = 0, empty = 0;
+      for (size_t p = 0; p < pairs; ++p)
+	 for (size_t k = 0; k < grid.steps(); ++k) {
+	    double a = closes[p][k], b = grid.close(p)[k];
+	    if (a != b && (a == a || b == b))
+	       ++mismatches;
+	    if (grid.count(p)[k] == 0)
+	       ++empty;
+	 }
+
+      vector<double> corr;
+      Clock::duration corr_time = best_of_three([&]() {
+	    corr = correlations(grid);
+	 });
+
+      double mean_corr = 0;
+      for (size_t a = 0; a < pairs; ++a)
+	 for (size_t b = 0; b < pairs; ++b)
+	    if (a != b) mean_corr += fabs(corr[a * pairs + b]);
+      mean_corr /= pairs > 1 ? pairs * (pairs - 1) : 1;
+
+      cout << "# " << pairs << " pairs, " << count << " trades, "
+	   << grid.steps() << " buckets of " << step << " s, " << empty
+	   << " of " << pairs * grid.steps() << " empty" << endl;
+      cout << "case,ms,ns_per_trade" << endl;
+      cout << fixed << setprecision(3)
+	   << "map_merge," << chrono::duration<double, milli>(merge_time).count()
+	   << ',' << setprecision(1)
+	   << chrono::duration<double, nano>(merge_time).count() / count << endl
+	   << setprecision(3)
+	   << "grid," << chrono::duration<double, milli>(grid_time).count()
+	   << ',' << setprecision(1)
+	   << chrono::duration<double, nano>(grid_time).count() / count << endl
+	   << setprecision(3)
+	   << "correlations," << chrono::duration<double, milli>(corr_time).count()
+	   << ",-" << endl;
+      cout << "# closes that differ: " << mismatches
+	   << ", mean |correlation|: " << setprecision(4) << mean_corr << endl;
+
+      if (mismatches)
+	 throw runtime_error("the grid's closes differ from the map's");
+   }
+   catch(exception& e) {
+      cerr << "Error: " << e.what() << endl;
+      return 1;
+   }
+   catch(...) {
+      cerr << "Unknown exception." << endl;
+      return 1;
+   }
+
+   return 0;
+}
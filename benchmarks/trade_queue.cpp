@@ -0,0 +1,251 @@
+/*
+
+  trade_queue measures the handoff of trades from fetching threads to a
+  processing thread: batches of std::vector<KTrade> through a mutex
+  guarded queue (what we did), and KTradeRecords through KSpscQueue
+  and KMpscQueue:
+
+    trade_queue [trades] [batch] [producers]
+
+  where:
+
+    [trades]    - (optional) trades handed over per case (by default 4000000)
+    [batch]     - (optional) trades per push, as in a Trades response
+                  (by default 100)
+    [producers] - (optional) producer threads of the MPSC case (by
+                  default 4)
+
+  The consumer folds every trade into a running sum, so nothing is
+  optimized away; each case prints the time per trade and the sum,
+  which is the same for all of them (up to rounding: the MPSC consumer
+  sees the batches in another order).
+
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <chrono>
+
+#include "../kraken/ktrade.hpp"
+#include "../kraken/kqueue.hpp"
+
+using namespace std;
+using namespace Kraken;
+
+typedef chrono::steady_clock Clock;
+
+//------------------------------------------------------------------------------
+// trades the producers hand over, over and over:
+static vector<KTrade> make_trades(size_t count)
+{
+   vector<KTrade> v(count);
+   for (size_t i = 0; i < count; ++i) {
+      v[i].price = 30000 + (i % 997) * 0.1;
+      v[i].volume = 0.001 * (1 + i % 13);
+      v[i].time = 1500000000 + i;
+      v[i].order = (i % 2) ? KTrade::BUY : KTrade::SELL;
+      v[i].otype = (i % 5) ? KTrade::LIMIT : KTrade::MARKET;
+      v[i].misc = (i % 7) ? "" : "i";
+   }
+   return v;
+}
+
+//------------------------------------------------------------------------------
+// prints the row of a case:
+static void report(const char* name, size_t trades, Clock::duration d,
+		   double sum)
+{
+   chrono::duration<double, nano> ns = d;
+   cout << name << ',' << fixed << setprecision(1) << ns.count() / trades
+	<< ',' << setprecision(3) << sum << endl;
+}
+
+//------------------------------------------------------------------------------
+// vectors of KTrade through a std::deque, a mutex and a condition variable:
+static void mutex_vector(const vector<KTrade>& source, size_t trades,
+			 size_t batch)
+{
+   deque<vector<KTrade> > q;
+   mutex m;
+   condition_variable cv;
+   bool done = false;
+   double sum = 0;
+
+   Clock::time_point start = Clock::now();
+   thread consumer([&]() {
+	 vector<KTrade> v;
+	 for (;;) {
+	    {
+	       unique_lock<mutex> lock(m);
+	       cv.wait(lock, [&]() { return !q.empty() || done; });
+	       if (q.empty()) return;
+	       v = std::move(q.front());
+	       q.pop_front();
+	    }
+	    for (size_t i = 0; i < v.size(); ++i)
+	       sum += v[i].price * v[i].volume;
+	 }
+      });
+
+   for (size_t sent = 0; sent < trades; sent += batch) {
+      size_t at = sent % source.size();
+      vector<KTrade> v(source.begin() + at, source.begin() + at + batch);
+      {
+	 lock_guard<mutex> lock(m);
+	 q.push_back(std::move(v));
+      }
+      cv.notify_one();
+   }
+   {
+      lock_guard<mutex> lock(m);
+      done = true;
+   }
+   cv.notify_one();
+   consumer.join();
+
+   report("mutex_vector", trades, Clock::now() - start, sum);
+}
+
+//------------------------------------------------------------------------------
+// records through a KSpscQueue:
+static void spsc(const vector<KTrade>& source, size_t trades, size_t batch)
+{
+   KSpscQueue<KTradeRecord> q(8192);
+   atomic<bool> done(false);
+   double sum = 0;
+
+   Clock::time_point start = Clock::now();
+   thread consumer([&]() {
+	 vector<KTradeRecord> v(q.capacity());
+	 for (;;) {
+	    bool last = done.load();
+	    size_t n = q.pop(v.data(), v.size());
+	    for (size_t i = 0; i < n; ++i)
+	       sum += v[i].price * v[i].volume;
+	    if (n == 0) {
+	       if (last) return;
+	       this_thread::yield();
+	    }
+	 }
+      });
+
+   vector<KTradeRecord> r(batch);
+   for (size_t sent = 0; sent < trades; sent += batch) {
+      size_t at = sent % source.size();
+      for (size_t i = 0; i < batch; ++i)
+	 r[i] = source[at + i].record();
+      for (size_t pushed = 0; pushed < batch; ) {
+	 size_t n = q.push(r.data() + pushed, batch - pushed);
+	 if (n == 0) this_thread::yield();
+	 pushed += n;
+      }
+   }
+   done = true;
+   consumer.join();
+
+   report("spsc", trades, Clock::now() - start, sum);
+}
+
+//------------------------------------------------------------------------------
+// records through a KMpscQueue from 'producers' threads:
+static void mpsc(const vector<KTrade>& source, size_t trades, size_t batch,
+		 int producers)
+{
+   KMpscQueue<KTradeRecord> q(8192);
+   atomic<int> running(producers);
+   double sum = 0;
+
+   Clock::time_point start = Clock::now();
+   thread consumer([&]() {
+	 vector<KTradeRecord> v(q.capacity());
+	 for (;;) {
+	    bool last = running.load() == 0;
+	    size_t n = q.pop(v.data(), v.size());
+	    for (size_t i = 0; i < n; ++i)
+	       sum += v[i].price * v[i].volume;
+	    if (n == 0) {
+	       if (last) return;
+	       this_thread::yield();
+	    }
+	 }
+      });
+
+   // the batches are dealt round robin, the sum doesn't change
+   vector<thread> threads;
+   for (int p = 0; p < producers; ++p) {
+      threads.push_back(thread([&, p]() {
+	       vector<KTradeRecord> r(batch);
+	       for (size_t sent = p * batch; sent < trades;
+		    sent += producers * batch) {
+		  size_t at = sent % source.size();
+		  for (size_t i = 0; i < batch; ++i)
+		     r[i] = source[at + i].record(p);
+		  for (size_t pushed = 0; pushed < batch; ) {
+		     size_t n = q.push(r.data() + pushed, batch - pushed);
+		     if (n == 0) this_thread::yield();
+		     pushed += n;
+		  }
+	       }
+	       --running;
+	    }));
+   }
+   for (size_t i = 0; i < threads.size(); ++i)
+      threads[i].join();
+   consumer.join();
+
+   report("mpsc", trades, Clock::now() - start, sum);
+}
+
+//------------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+   try {
+      size_t trades = 4000000;
+      size_t batch = 100;
+      int producers = 4;
+
+      switch (argc) {
+      case 4:
+	 istringstream(argv[3]) >> producers;
+      case 3:
+	 istringstream(argv[2]) >> batch;
+      case 2:
+	 istringstream(argv[1]) >> trades;
+      case 1:
+	 break;
+      default:
+	 throw runtime_error("wrong number of arguments");
+      };
+      if (trades == 0 || batch == 0 || producers <= 0)
+	 throw runtime_error("trades, batch and producers must be positive");
+
+      // whole batches, from a source that holds a whole number of them
+      trades -= trades % batch;
+      vector<KTrade> source = make_trades(batch * 1000);
+
+      cout << "case,ns_per_trade,sum" << endl;
+      mutex_vector(source, trades, batch);
+      spsc(source, trades, batch);
+      mpsc(source, trades, batch, producers);
+   }
+   catch(exception& e) {
+      cerr << "Error: " << e.what() << endl;
+      return 1;
+   }
+   catch(...) {
+      cerr << "Unknown exception." << endl;
+      return 1;
+   }
+
+   return 0;
+}
@@ -0,0 +1,231 @@
+/*
+
+  feed_server is a local stand-in for Kraken's public WebSocket feed, to
+  run KFeed (and krt in WebSocket mode) offline:
+
+    feed_server [port] [rate] [file]
+
+  where:
+
+    [port] - (optional) TCP port on 127.0.0.1 (by default 8765)
+    [rate] - (optional) messages per second per client (by default 10)
+    [file] - (optional) recorded feed messages, one per line, replayed
+             in order to every client after its first subscription;
+             without it synthetic trades are sent for each pair
+             subscribed to the trade channel
+
+  Every subscription is confirmed with a subscriptionStatus event, pings
+  are answered with pongs and a heartbeat is sent when there is nothing
+  else to send.
+
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <cstring>
+#include <cerrno>
+
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "../kraken/kwebsocket.hpp"
+#include "../kraken/kwriter.hpp"
+#include "../libjson/libjson.h"
+
+using namespace std;
+using namespace Kraken;
+
+//------------------------------------------------------------------------------
+// reads the lines of a file:
+static vector<string> read_lines(const char* path)
+{
+   ifstream ifs(path);
+   if (!ifs)
+      throw runtime_error(string("can't open ") + path);
+
+   vector<string> lines;
+   string line;
+   while (getline(ifs, line))
+      if (!line.empty()) lines.push_back(line);
+   return lines;
+}
+
+//------------------------------------------------------------------------------
+// a trade message like Kraken's: [channelID,[[price,volume,time,side,
+// type,misc]],"trade",pair]
+static string make_trade(int channel, const string& pair, long seq)
+{
+   double now = chrono::duration<double>(
+      chrono::system_clock::now().time_since_epoch()).count();
+
+   ostringstream price, volume, time;
+   price << fixed << setprecision(5) << 30000 + (seq % 997) * 0.1;
+   volume << fixed << setprecision(8) << 0.001 * (1 + seq % 13);
+   time << fixed << setprecision(6) << now;
+
+   string msg;
+   KWriter w(msg);
+   w.begin_array().value(channel)
+      .begin_array().begin_array()
+      .value(price.str()).value(volume.str()).value(time.str())
+      .value((seq % 2) ? "b" : "s").value((seq % 5) ? "l" : "m").value("")
+      .end_array().end_array()
+      .value("trade").value(pair)
+      .end_array();
+   return msg;
+}
+
+//------------------------------------------------------------------------------
+// serves one client until it goes away:
+static void serve(int fd, int rate, const vector<string>* recorded)
+{
+   KWebSocket ws;
+   try {
+      ws.accept(fd);
+
+      struct Sub { int channel; string pair; };
+      vector<Sub> trades;
+      bool subscribed = false;
+      size_t replayed = 0;
+      long seq = 0;
+      int next_channel = 1;
+
+      chrono::microseconds period(rate > 0 ? 1000000 / rate : 1000000);
+      chrono::steady_clock::time_point next = chrono::steady_clock::now();
+
+      while (true) {
+	 // wait for requests until the next message is due
+	 long wait = chrono::duration_cast<chrono::milliseconds>(
+	    next - chrono::steady_clock::now()).count();
+
+	 string req;
+	 if (ws.receive(req, wait > 0 ? (int)wait : 0)) {
+	    JSONNode node = libjson::parse(libjson::to_json_string(req));
+	    string event = libjson::to_std_string(node["event"].as_string());
+
+	    if (event == "ping") {
+	       string msg;
+	       KWriter w(msg);
+	       w.begin_object().key("event").value("pong");
+	       if (node.find("reqid") != node.end())
+		  w.key("reqid").value((long long)node["reqid"].as_int());
+	       w.end_object();
+	       ws.send_text(msg);
+	    }
+	    else if (event == "subscribe") {
+	       string name = libjson::to_std_string(
+		  node["subscription"]["name"].as_string());
+	       const JSONNode& pairs = node["pair"];
+	       for (json_index_t i = 0; i < pairs.size(); ++i) {
+		  string pair = libjson::to_std_string(pairs[i].as_string());
+		  int channel = next_channel++;
+		  if (name == "trade") {
+		     Sub s = { channel, pair };
+		     trades.push_back(s);
+		  }
+
+		  string msg;
+		  KWriter w(msg);
+		  w.begin_object()
+		     .key("channelID").value(channel)
+		     .key("channelName").value(name)
+		     .key("event").value("subscriptionStatus")
+		     .key("pair").value(pair)
+		     .key("status").value("subscribed")
+		     .key("subscription").begin_object()
+		     .key("name").value(name).end_object()
+		     .end_object();
+		  ws.send_text(msg);
+	       }
+	       subscribed = true;
+	    }
+	    continue;
+	 }
+
+	 // one message per period: recorded, synthetic or a heartbeat
+	 next += period;
+	 if (recorded && subscribed && replayed < recorded->size()) {
+	    ws.send_text((*recorded)[replayed++]);
+	 }
+	 else if (!recorded && !trades.empty()) {
+	    const Sub& s = trades[seq % trades.size()];
+	    ws.send_text(make_trade(s.channel, s.pair, seq++));
+	 }
+	 else {
+	    ws.send_text("{\"event\":\"heartbeat\"}");
+	 }
+      }
+   }
+   catch(exception& e) {
+      cerr << "client: " << e.what() << endl;
+   }
+}
+
+//------------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+   try {
+      int port = 8765;
+      int rate = 10;
+      vector<string> recorded;
+
+      switch (argc) {
+      case 4:
+	 recorded = read_lines(argv[3]);
+      case 3:
+	 istringstream(argv[2]) >> rate;
+      case 2:
+	 istringstream(argv[1]) >> port;
+      case 1:
+	 break;
+      default:
+	 throw runtime_error("wrong number of arguments");
+      };
+
+      int lfd = socket(AF_INET, SOCK_STREAM, 0);
+      if (lfd < 0)
+	 throw runtime_error("socket() failed");
+
+      int one = 1;
+      setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+      sockaddr_in addr;
+      memset(&addr, 0, sizeof(addr));
+      addr.sin_family = AF_INET;
+      addr.sin_port = htons(port);
+      addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+      if (bind(lfd, (sockaddr*)&addr, sizeof(addr)) != 0 ||
+	  listen(lfd, 16) != 0)
+	 throw runtime_error(string("can't listen: ") + strerror(errno));
+
+      cerr << "listening on ws://127.0.0.1:" << port << endl;
+
+      const vector<string>* replay = recorded.empty() ? 0 : &recorded;
+      while (true) {
+	 int fd = accept(lfd, 0, 0);
+	 if (fd < 0) continue;
+	 thread(serve, fd, rate, replay).detach();
+      }
+   }
+   catch(exception& e) {
+      cerr << "Error: " << e.what() << endl;
+      return 1;
+   }
+   catch(...) {
+      cerr << "Unknown exception." << endl;
+      return 1;
+   }
+
+   return 0;
+}
@@ -0,0 +1,173 @@
+/*
+
+  trade_bus shares one poller's trades with every process on the machine
+  through a trade bus (see KTradeBus): one process polls Kraken and
+  publishes, the others tail the bus instead of polling themselves.
+
+    trade_bus write <bus> <pairs> [interval] [since]
+    trade_bus read <bus> [oldest]
+
+  where:
+
+    <bus>      - the bus file, best under /dev/shm (e.g. /dev/shm/trades)
+    <pairs>    - pairs to poll, separated by commas (e.g. XXBTZEUR,XETHZEUR)
+    [interval] - (optional) seconds between polls of a pair (by default 5)
+    [since]    - (optional) where polling starts, as Trades' 'since'
+                 (by default 0, the oldest trades)
+    [oldest]   - (optional) the word "oldest", to start with the oldest
+                 trades the bus keeps rather than with new ones
+
+  The writer prints nothing; readers print "<pair>,<trade>" lines as
+  krt does, report trades they lost by falling behind on stderr, and
+  open the bus again when a writer replaced it.
+  KRAKENAPI_RECORD and KRAKENAPI_REPLAY work for the writer as for krt.
+
+*/
+
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <memory>
+
+#include "../kraken/kclient.hpp"
+#include "../kraken/kbus.hpp"
+
+using namespace std;
+using namespace Kraken;
+
+//------------------------------------------------------------------------------
+// polls 'pairs' and publishes their trades until killed:
+static void write_bus(const string& path, const vector<string>& pairs,
+		      int interval, const string& since)
+{
+   KTradeBusWriter bus(path);
+
+   vector<KPairId> ids;
+   for (size_t i = 0; i < pairs.size(); ++i)
+      ids.push_back(bus.add_pair(pairs[i]));
+
+   KClient kc;
+   kc.set_transport(transport_from_env());
+
+   // ride out transient failures (about 1 public call/s is allowed)
+   KRetryPolicy retry;
+   retry.attempts = 5;
+   retry.deadline = chrono::seconds(30);
+   kc.set_retry(retry);
+   kc.set_rate_limiter(make_shared<KRateLimiter>(1, 1));
+
+   vector<string> last(pairs.size(), since);
+   vector<KTrade> vt;
+   vector<KTradeRecord> records;
+
+   while (true) {
+      for (size_t i = 0; i < pairs.size(); ++i) {
+	 try {
+	    last[i] = kc.trades(ids[i], last[i], vt);
+	 }
+	 catch(exception& e) {
+	    cerr << "Error: " << pairs[i] << ": " << e.what() << endl;
+	    continue;
+	 }
+
+	 records.clear();
+	 for (size_t j = 0; j < vt.size(); ++j)
+	    records.push_back(vt[j].record(ids[i]));
+	 bus.publish(records.data(), records.size());
+      }
+      this_thread::sleep_for(chrono::seconds(interval));
+   }
+}
+
+//------------------------------------------------------------------------------
+// prints the trades of a bus as they are published, until killed; a bus
+// replaced by a writer of another capacity is opened again:
+static void read_bus(const string& path, bool oldest)
+{
+   unique_ptr<KTradeBusReader> bus(new KTradeBusReader(path, oldest));
+   vector<KTradeRecord> records(4096);
+   uint64_t lost = 0;
+
+   while (true) {
+      size_t n;
+      try {
+	 n = bus->read(records.data(), records.size());
+      }
+      catch (runtime_error& e) {
+	 cerr << "Warning: " << e.what() << ", reopening it" << endl;
+	 bus.reset(new KTradeBusReader(path, true));
+	 lost = 0;
+	 continue;
+      }
+
+      for (size_t i = 0; i < n; ++i)
+	 cout << bus->pair_name(records[i].pair) << ','
+	      << KTrade(records[i]) << '\n';
+      cout.flush();
+
+      if (bus->lost() != lost) {
+	 cerr << "Warning: lost " << bus->lost() - lost
+	      << " trades, the reader is too slow" << endl;
+	 lost = bus->lost();
+      }
+
+      // readers poll: a new trade is seen within 10 ms
+      if (n == 0)
+	 this_thread::sleep_for(chrono::milliseconds(10));
+   }
+}
+
+//------------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+   try {
+      Kraken::initialize();
+
+      string mode = argc > 1 ? argv[1] : "";
+      if (mode == "write" && argc >= 4 && argc <= 6) {
+	 int interval = 5;
+	 string since = "0";
+
+	 switch (argc) {
+	 case 6:
+	    since = argv[5];
+	 case 5:
+	    istringstream(argv[4]) >> interval;
+	 }
+
+	 vector<string> pairs;
+	 istringstream list(argv[3]);
+	 for (string p; getline(list, p, ','); )
+	    if (!p.empty()) pairs.push_back(p);
+	 if (pairs.empty())
+	    throw runtime_error("no pairs");
+
+	 write_bus(argv[2], pairs, interval, since);
+      }
+      else if (mode == "read" && (argc == 3 || argc == 4)) {
+	 if (argc == 4 && string(argv[3]) != "oldest")
+	    throw runtime_error("unknown option " + string(argv[3]));
+	 read_bus(argv[2], argc == 4);
+      }
+      else {
+	 throw runtime_error("wrong arguments");
+      }
+
+      Kraken::terminate();
+   }
+   catch(exception& e) {
+      cerr << "Error: " << e.what() << endl;
+      return 1;
+   }
+   catch(...) {
+      cerr << "Unknown exception." << endl;
+      return 1;
+   }
+
+   return 0;
+}
@@ -1,21 +1,23 @@
 #ifndef _KRAKEN_KAPI_HPP_
 #define _KRAKEN_KAPI_HPP_
 
-#include <map>
 #include <string>
 #include <vector>
-#include <curl/curl.h>
+#include <memory>
+
+#include "kraken/kclient.hpp"
 
 //------------------------------------------------------------------------------
 
 namespace Kraken {
 
 //------------------------------------------------------------------------------
-
+// the original interface, kept for existing programs: requests are made
+// by a KClient, which new code should use directly.
 class KAPI {
 public:  
    // helper type to make requests
-   typedef std::map<std::string,std::string> Input;
+   typedef KInput Input;
 
    // constructor with all explicit parameters
    KAPI(const std::string& key, const std::string& secret, 
@@ -38,32 +40,20 @@ public:
    std::string private_method(const std::string& method,
 			      const KAPI::Input& input) const;
 
+   // sends every request through 'transport' (see KTransport) rather
+   // than the curl handle, 0 to go back
+   void set_transport(const std::shared_ptr<KTransport>& transport) { client_.set_transport(transport); }
+
+   // the client making the requests, for its other options
+   KClient& client() { return client_; }
+
    
    // TODO: public market data
    //void time();
    //void assets();
 
 private:
-   // init CURL and other stuffs
-   void init();
-
-   // TODO: gather common commands from public_method and 
-   // private_method in a single method: curl_perform
-
-   // create signature for private requests
-   std::string signature(const std::string& path,
-			 const std::string& nonce,
-			 const std::string& postdata) const;
-
-   // CURL callback
-   static size_t write_cb(char* ptr, size_t size, 
-			  size_t nmemb, void* userdata);
-
-   std::string key_;     // API key
-   std::string secret_;  // API secret
-   std::string url_;     // API base URL
-   std::string version_; // API version
-   CURL*  curl_;         // CURL handle
+   KClient client_;
 
    // disallow copying
    KAPI(const KAPI&);
@@ -71,12 +61,7 @@ private:
 };
 
 //------------------------------------------------------------------------------
-// helper functions to initialize and terminate Kraken API library.
-// KAPI uses CURL, the latter has a no thread-safe function called 
-// curl_global_init(). 
-
-void initialize();
-void terminate();
+// initialize() and terminate() are declared in kraken/kclient.hpp
 
 //------------------------------------------------------------------------------
 
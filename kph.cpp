@@ -18,6 +18,14 @@
     [seconds] - (optional) the seconds of the period (by default 15*60)
     [last]    - (optional) the last seconds to consider from the last 
                 trade (by default 24*60*60) 
+
+  When the period is one of OHLC's intervals (1, 5, 15, 30 or 60
+  minutes, 4 hours, 1 day, 1 or 15 weeks) kph downloads Kraken's own
+  candles, up to 720 of them; otherwise it groups the recent trades.
+
+  With KRAKENAPI_RECORD=<file> in the environment the exchanges with
+  kraken.com are recorded to <file>, with KRAKENAPI_REPLAY=<file> they
+  are answered from it (see KReplayer).
   
 */
 
@@ -29,6 +37,8 @@
 
 #include "kraken/kclient.hpp"
 #include "kraken/ktrade.hpp"
+#include "kraken/kcandle.hpp"
+#include "kraken/kindicator.hpp"
 #include "libjson/libjson.h"
 
 using namespace std;
@@ -41,38 +51,7 @@ typedef map<time_t,Period> Period_map;
 
 //------------------------------------------------------------------------------
 // deal with candlesticks:
-struct Candlestick {
-   double open, close, low, high;
-   double volume;
-   time_t time;
-};
-
-//------------------------------------------------------------------------------
-struct HA_Candlestick : public Candlestick {
-
-   // create a candlestick from current period
-   HA_Candlestick(const Candlestick& curr)
-   {
-      time = curr.time;
-      volume = curr.volume;
-      close =  (curr.open + curr.close + curr.low + curr.high) / 4;
-      open = (curr.open + curr.close) / 2;
-      low = min(curr.low, min(open, close)); 
-      high = max(curr.high, max(open, close));
-   }
-
-   // create a HA candlestick from current period
-   // and WITH a prior HA candlestick
-   HA_Candlestick(const Candlestick& curr, const HA_Candlestick& prior) 
-   {
-      time = curr.time;
-      volume = curr.volume;
-      close =  (curr.open + curr.close + curr.low + curr.high) / 4;
-      open = (prior.open + prior.close) / 2;
-      low = min(curr.low, min(open, close)); 
-      high = max(curr.high, max(open, close));
-   }
-};
+typedef KCandle Candlestick;
 
 //------------------------------------------------------------------------------
 // prints out a Candlestick
@@ -170,26 +149,37 @@ int main(int argc, char* argv[])
       Kraken::initialize();
 
       KClient kc;
+      kc.set_transport(transport_from_env());
+      vector<Candlestick> candlesticks;
 
-      vector<KTrade> trades;
-      kc.trades(pair, "0", trades);
-
+      if (step % 60 == 0 && ohlc_interval(int(step / 60))) {
+	 // Kraken's candles
+	 KCandles candles;
+	 kc.ohlc(pair, int(step / 60), "", candles);
+	 candlesticks.reserve(candles.size());
+	 for (size_t i = 0; i < candles.size(); ++i)
+	    candlesticks.push_back(candles.row(i));
+      }
+      else {
+	 vector<KTrade> trades;
+	 kc.trades(pair, "0", trades);
 
-      // group trades by time
-      vector<Candlestick> candlesticks;
-      group_by_time(trades, step, candlesticks);
+	 // group trades by time
+	 group_by_time(trades, step, candlesticks);
+      }
       
       if (!candlesticks.empty()) {
 	 // print candlestick after this threshold
 	 time_t thresh = candlesticks.back().time - last;
 
 	 std::vector<Candlestick>::const_iterator it = candlesticks.begin();
-	 HA_Candlestick ha(*it);
+	 KHeikinAshi heikin_ashi;
+	 Candlestick ha = heikin_ashi.update(*it);
 	 if (ha.time > thresh) 
 	    cout << ha << endl;
 	 
 	 for (++it; it != candlesticks.end(); ++it) {	   
-	    ha = HA_Candlestick(*it, ha);
+	    ha = heikin_ashi.update(*it);
 	    if (ha.time >= thresh) 
 	       cout << ha << endl;
 	 }
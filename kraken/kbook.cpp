@@ -0,0 +1,332 @@
+#include <stdexcept>
+#include <algorithm>
+#include <cstdlib>
+#include <utility>
+
+#include "kbook.hpp"
+#include "kclient.hpp"
+
+//------------------------------------------------------------------------------
+
+namespace Kraken {
+
+//------------------------------------------------------------------------------
+// levels covered by the checksum on each side:
+static const size_t CHECKSUM_LEVELS = 10;
+
+// seconds between two failed resyncs
+static const int RESYNC_RETRY = 1;
+
+// updates kept while a resync is in flight
+static const size_t MAX_PENDING = 100000;
+
+//------------------------------------------------------------------------------
+// helper function to update a CRC32 (the zlib one) state:
+static unsigned long crc32_update(unsigned long crc, const std::string& s)
+{
+   struct Table {
+      unsigned long t[256];
+      Table() {
+	 for (unsigned long i = 0; i < 256; ++i) {
+	    unsigned long c = i;
+	    for (int k = 0; k < 8; ++k)
+	       c = (c & 1) ? 0xEDB88320UL ^ (c >> 1) : c >> 1;
+	    t[i] = c;
+	 }
+      }
+   };
+   static const Table table;
+
+   for (size_t i = 0; i < s.size(); ++i)
+      crc = table.t[(crc ^ (unsigned char)s[i]) & 0xFF] ^ (crc >> 8);
+   return crc;
+}
+
+//------------------------------------------------------------------------------
+// helper function to append the digits of a decimal to 'out', with
+// exactly 'decimals' fractional digits (as sent when decimals < 0):
+static void append_digits(const std::string& num, int decimals,
+			  std::string& out)
+{
+   size_t dot = num.find('.');
+   out.append(num, 0, dot);
+   if (decimals < 0) {
+      if (dot != std::string::npos)
+	 out.append(num, dot + 1, std::string::npos);
+      return;
+   }
+
+   size_t frac = (dot == std::string::npos) ? 0 : num.size() - dot - 1;
+   if (frac > size_t(decimals)) frac = decimals;
+   if (frac) out.append(num, dot + 1, frac);
+   out.append(decimals - frac, '0');
+}
+
+//------------------------------------------------------------------------------
+// helper function to drop leading zeros:
+static void strip_zeros(std::string& s, size_t from)
+{
+   size_t i = from;
+   while (i < s.size() && s[i] == '0') ++i;
+   s.erase(from, i - from);
+}
+
+//------------------------------------------------------------------------------
+
+KBook::KBook(const std::string& pair, int depth,
+	     int price_decimals, int volume_decimals,
+	     const ClientFactory& client)
+   :pair_(pair), depth_(depth > 0 ? depth : 10), client_(client),
+    price_decimals_(price_decimals), volume_decimals_(volume_decimals),
+    ask_dirty_(0), bid_dirty_(0), synced_(false)
+{
+   Stats s = { 0, 0, 0, 0 };
+   stats_ = s;
+}
+
+//------------------------------------------------------------------------------
+
+KBook::~KBook()
+{
+   if (resync_.valid())
+      resync_.wait();
+}
+
+//------------------------------------------------------------------------------
+// builds the key and checksum digits of a level:
+KBook::Entry KBook::make_entry(const KLevel& level) const
+{
+   Entry e;
+   e.price = std::strtod(level.price.c_str(), 0);
+   e.volume = std::strtod(level.volume.c_str(), 0);
+   e.time = level.time;
+
+   e.digits.reserve(level.price.size() + level.volume.size());
+   append_digits(level.price, price_decimals_, e.digits);
+   strip_zeros(e.digits, 0);
+
+   e.key = 0;
+   for (size_t i = 0; i < e.digits.size(); ++i)
+      e.key = e.key * 10 + (e.digits[i] - '0');
+
+   size_t vol = e.digits.size();
+   append_digits(level.volume, volume_decimals_, e.digits);
+   strip_zeros(e.digits, vol);
+   return e;
+}
+
+//------------------------------------------------------------------------------
+
+void KBook::snapshot(const std::vector<KLevel>& asks,
+		     const std::vector<KLevel>& bids)
+{
+   asks_.clear();
+   bids_.clear();
+   for (size_t i = 0; i < asks.size(); ++i)
+      update(true, asks[i]);
+   for (size_t i = 0; i < bids.size(); ++i)
+      update(false, bids[i]);
+   truncate(true);
+   truncate(false);
+
+   ask_dirty_ = bid_dirty_ = 0;
+   synced_ = true;
+}
+
+//------------------------------------------------------------------------------
+// keeps the side sorted and marks the first changed level of the top 10:
+void KBook::update(bool ask, const KLevel& level)
+{
+   std::vector<Entry>& v = ask ? asks_ : bids_;
+   size_t& dirty = ask ? ask_dirty_ : bid_dirty_;
+   Entry e = make_entry(level);
+
+   size_t lo = 0, hi = v.size();
+   while (lo < hi) {
+      size_t mid = (lo + hi) / 2;
+      bool before = ask ? v[mid].key < e.key : v[mid].key > e.key;
+      if (before) lo = mid + 1;
+      else hi = mid;
+   }
+
+   bool found = lo < v.size() && v[lo].key == e.key;
+   if (e.volume == 0) {
+      if (!found) return;
+      v.erase(v.begin() + lo);
+   }
+   else if (found) {
+      std::swap(v[lo], e);
+   }
+   else {
+      v.insert(v.begin() + lo, std::move(e));
+   }
+
+   if (lo < dirty) dirty = lo;
+}
+
+//------------------------------------------------------------------------------
+// the book keeps only the subscribed depth, Kraken sends the levels that
+// move into it:
+void KBook::truncate(bool ask)
+{
+   std::vector<Entry>& v = ask ? asks_ : bids_;
+   size_t& dirty = ask ? ask_dirty_ : bid_dirty_;
+
+   if (v.size() > depth_) {
+      v.resize(depth_);
+      if (depth_ < dirty) dirty = depth_;
+   }
+}
+
+//------------------------------------------------------------------------------
+// the CRC is resumed from the state before the first changed level; the
+// bids follow the asks, so any change in the asks rehashes them all:
+unsigned long KBook::checksum()
+{
+   const unsigned long init = 0xFFFFFFFFUL;
+   size_t na = std::min(asks_.size(), CHECKSUM_LEVELS);
+   size_t nb = std::min(bids_.size(), CHECKSUM_LEVELS);
+
+   if (ask_dirty_ < CHECKSUM_LEVELS)
+      bid_dirty_ = 0;
+
+   for (size_t i = ask_dirty_; i < na; ++i)
+      ask_crc_[i] = crc32_update(i ? ask_crc_[i - 1] : init, asks_[i].digits);
+   unsigned long crc = na ? ask_crc_[na - 1] : init;
+
+   for (size_t i = bid_dirty_; i < nb; ++i)
+      bid_crc_[i] = crc32_update(i ? bid_crc_[i - 1] : crc, bids_[i].digits);
+   if (nb) crc = bid_crc_[nb - 1];
+
+   ask_dirty_ = bid_dirty_ = CHECKSUM_LEVELS;
+   return ~crc & 0xFFFFFFFFUL;
+}
+
+//------------------------------------------------------------------------------
+// a message is [channelID, {...}, [{...},] channelName, pair] with
+// "as"/"bs" in snapshots, "a"/"b" and "c" in updates:
+std::string KBook::apply_updates(const JSONNode& message, double after,
+				 bool& snapshot)
+{
+   std::string c;
+   snapshot = false;
+
+   json_index_t n = message.size();
+   for (json_index_t i = 1; i + 2 < n; ++i) {
+      const JSONNode& obj = message[i];
+      for (JSONNode::const_iterator it = obj.begin(); it != obj.end(); ++it) {
+	 std::string name = libjson::to_std_string(it->name());
+	 if (name == "c") {
+	    c = libjson::to_std_string(it->as_string());
+	    continue;
+	 }
+	 if (name.empty() || (name[0] != 'a' && name[0] != 'b'))
+	    continue;
+
+	 bool ask = (name[0] == 'a');
+	 if (name.size() == 2 && name[1] == 's') {
+	    (ask ? asks_ : bids_).clear();
+	    (ask ? ask_dirty_ : bid_dirty_) = 0;
+	    snapshot = true;
+	 }
+
+	 for (JSONNode::const_iterator
+		 row = it->begin(); row != it->end(); ++row) {
+	    KLevel level(*row);
+	    if (level.time > after)
+	       update(ask, level);
+	 }
+      }
+   }
+
+   truncate(true);
+   truncate(false);
+   return c;
+}
+
+//------------------------------------------------------------------------------
+// updates wait while a resync is in flight, otherwise they are applied
+// and verified when they carry a checksum:
+bool KBook::apply(const JSONNode& message)
+{
+   if (resync_.valid()) {
+      std::future_status st = resync_.wait_for(std::chrono::seconds(0));
+      if (st != std::future_status::ready) {
+	 // bounded, the checksums catch anything dropped here
+	 if (pending_.size() >= MAX_PENDING)
+	    pending_.clear();
+	 pending_.push_back(message);
+	 return false;
+      }
+      finish_resync();
+   }
+
+   ++stats_.updates;
+   bool snap;
+   std::string c = apply_updates(message, -1, snap);
+   if (snap)
+      synced_ = true;
+
+   if (!c.empty()) {
+      synced_ = (checksum() == std::strtoul(c.c_str(), 0, 10));
+      if (synced_) ++stats_.verified;
+      else ++stats_.mismatches;
+   }
+
+   if (!synced_ && !pair_.empty() && !resync_.valid() &&
+       std::chrono::steady_clock::now() >= retry_at_)
+      start_resync();
+
+   return synced_;
+}
+
+//------------------------------------------------------------------------------
+// KClient isn't shared between threads, the request gets its own:
+void KBook::start_resync()
+{
+   std::string pair = pair_;
+   int count = int(depth_);
+   ClientFactory client = client_;
+
+   resync_ = std::async(std::launch::async, [pair, count, client]() {
+	 std::unique_ptr<KClient> kc(client ? client() : 0);
+	 if (!kc)
+	    kc.reset(new KClient);
+	 Snapshot s;
+	 kc->depth(pair, count, s.first, s.second);
+	 return s;
+      });
+}
+
+//------------------------------------------------------------------------------
+// installs the snapshot and replays only what is newer than it:
+void KBook::finish_resync()
+{
+   try {
+      Snapshot s = resync_.get();
+      snapshot(s.first, s.second);
+      ++stats_.resyncs;
+      last_error_.clear();
+
+      double newest = 0;
+      for (size_t i = 0; i < s.first.size(); ++i)
+	 newest = std::max(newest, s.first[i].time);
+      for (size_t i = 0; i < s.second.size(); ++i)
+	 newest = std::max(newest, s.second[i].time);
+
+      bool snap;
+      for (size_t i = 0; i < pending_.size(); ++i)
+	 apply_updates(pending_[i], newest, snap);
+   }
+   catch (std::exception& e) {
+      last_error_ = e.what();
+      retry_at_ = std::chrono::steady_clock::now() +
+	 std::chrono::seconds(RESYNC_RETRY);
+   }
+
+   pending_.clear();
+}
+
+//------------------------------------------------------------------------------
+
+}; // namespace Kraken
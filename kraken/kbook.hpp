@@ -0,0 +1,139 @@
+#ifndef _KRAKEN_KBOOK_HPP_
+#define _KRAKEN_KBOOK_HPP_
+
+#include <string>
+#include <vector>
+#include <future>
+#include <chrono>
+#include <memory>
+#include <functional>
+
+#include "klevel.hpp"
+#include "../libjson/libjson.h"
+
+//------------------------------------------------------------------------------
+
+namespace Kraken {
+
+class KClient;
+
+//------------------------------------------------------------------------------
+// keeps a Level-2 book from the book channel of the WebSocket feed and
+// verifies it against the CRC32 checksum Kraken sends with every update
+// (top 10 asks then top 10 bids, price and volume digits without the
+// decimal point and leading zeros).
+//
+// Each level keeps its checksum digits, and the CRC state after every
+// one of the top 10 levels is cached, so an update only hashes from the
+// first level it changed. On a mismatch the book asks KClient for a
+// Depth snapshot on another thread; updates received in the meantime
+// are kept and replayed on top of it, so apply() never waits for HTTP.
+class KBook {
+public:
+
+   // makes the client of a resync, on the thread of the resync (a
+   // KClient isn't shared between threads): the place to give it a URL,
+   // a transport, a retry policy, a limiter or metrics
+   typedef std::function<std::unique_ptr<KClient>()> ClientFactory;
+
+   // a level of the book
+   struct Entry {
+      long long key;      // price digits as an integer, orders the book
+      double price, volume, time;
+      std::string digits; // what this level adds to the checksum
+   };
+
+   // counters since construction
+   struct Stats {
+      unsigned long long updates;    // messages applied
+      unsigned long long verified;   // checksums that matched
+      unsigned long long mismatches; // checksums that didn't
+      unsigned long long resyncs;    // Depth snapshots installed
+   };
+
+   // 'pair' is the REST name used for resyncs (no resync when empty),
+   // 'depth' the subscribed depth; prices and volumes are read with the
+   // pair's pair_decimals and lot_decimals (AssetPairs), as the feed
+   // sends them. Resyncs use clients from 'client', default KClients
+   // if it is empty
+   KBook(const std::string& pair, int depth,
+	 int price_decimals, int volume_decimals,
+	 const ClientFactory& client = ClientFactory());
+
+   // waits for a resync in progress
+   ~KBook();
+
+   // applies a message of the book channel as passed to a
+   // KFeed::DataHandler, returns true while the book is in sync
+   bool apply(const JSONNode& message);
+
+   // replaces both sides of the book
+   void snapshot(const std::vector<KLevel>& asks,
+		 const std::vector<KLevel>& bids);
+
+   // asks by increasing price, bids by decreasing price
+   const std::vector<Entry>& asks() const { return asks_; }
+   const std::vector<Entry>& bids() const { return bids_; }
+
+   // checksum of the current book
+   unsigned long checksum();
+
+   bool synced() const { return synced_; }
+   const Stats& stats() const { return stats_; }
+
+   // error of the last failed resync, if any
+   const std::string& last_error() const { return last_error_; }
+
+private:
+   typedef std::pair< std::vector<KLevel>, std::vector<KLevel> > Snapshot;
+
+   // sets, changes or (volume 0) removes a level of a side
+   void update(bool ask, const KLevel& level);
+
+   // updates from the objects of a message, skipping levels not newer
+   // than 'after'; returns the checksum field or an empty string and
+   // tells whether the message was a snapshot
+   std::string apply_updates(const JSONNode& message, double after,
+			     bool& snapshot);
+
+   // drops the levels past the subscribed depth
+   void truncate(bool ask);
+
+   // builds an Entry from the text of a level
+   Entry make_entry(const KLevel& level) const;
+
+   // starts a Depth request on another thread
+   void start_resync();
+
+   // installs a finished resync and replays the updates kept meanwhile
+   void finish_resync();
+
+   std::string pair_;
+   size_t depth_;
+   ClientFactory client_;
+   int price_decimals_, volume_decimals_;
+
+   std::vector<Entry> asks_, bids_;
+   unsigned long ask_crc_[10], bid_crc_[10]; // CRC state after each level
+   size_t ask_dirty_, bid_dirty_;   // first changed level of the top 10
+
+   bool synced_;
+   Stats stats_;
+
+   std::future<Snapshot> resync_;        // the Depth request in flight
+   std::vector<JSONNode> pending_;       // updates received meanwhile
+   std::chrono::steady_clock::time_point retry_at_;
+   std::string last_error_;
+
+   // disallow copying
+   KBook(const KBook&);
+   KBook& operator=(const KBook&);
+};
+
+//------------------------------------------------------------------------------
+
+}; // namespace Kraken
+
+//------------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,372 @@
+#include <stdexcept>
+#include <sstream>
+#include <atomic>
+#include <cstring>
+#include <cerrno>
+#include <cstdio>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "kbus.hpp"
+
+//------------------------------------------------------------------------------
+
+namespace Kraken {
+
+//------------------------------------------------------------------------------
+// the file is a header followed by the slots of the ring:
+struct KTradeBus::Header {
+   char magic[8];                     // "KRKNBUS"
+   uint32_t version;                  // FORMAT_VERSION
+   uint32_t record_size;              // sizeof(KTradeRecord) of the writer
+   uint64_t capacity;                 // slots, a power of two
+   std::atomic<uint32_t> pair_count;
+   std::atomic<uint32_t> superseded;  // 1 once replaced by another file
+   char pairs[MAX_PAIRS][MAX_PAIR_NAME + 1];
+
+   // records published, on a line of its own: readers poll it
+   alignas(64) std::atomic<uint64_t> head;
+};
+
+//------------------------------------------------------------------------------
+// record number n is in slot n % capacity. 'seq' is n + 1 once the
+// record is written and 0 while it is, so a reader can tell a record
+// that changed under it (a sequence lock):
+struct KTradeBus::Slot {
+   std::atomic<uint64_t> seq;
+   KTradeRecord record;
+};
+
+static const char BUS_MAGIC[8] = "KRKNBUS";
+
+//------------------------------------------------------------------------------
+// helper function to throw an error about 'path' with errno:
+static void throw_errno(const char* what, const std::string& path)
+{
+   std::ostringstream oss;
+   oss << what << ' ' << path << ": " << strerror(errno);
+   throw std::runtime_error(oss.str());
+}
+
+//------------------------------------------------------------------------------
+// helper function to compute the file size of a bus:
+static size_t bus_size(uint64_t capacity)
+{
+   return sizeof(KTradeBus::Header) + capacity * sizeof(KTradeBus::Slot);
+}
+
+//------------------------------------------------------------------------------
+// helper function to check a mapped header; 0 capacity accepts any:
+static bool valid_header(const KTradeBus::Header* h, size_t size,
+			 uint64_t capacity)
+{
+   return size >= sizeof(KTradeBus::Header) &&
+      std::memcmp(h->magic, BUS_MAGIC, sizeof(BUS_MAGIC)) == 0 &&
+      h->version == KTradeBus::FORMAT_VERSION &&
+      h->record_size == sizeof(KTradeRecord) &&
+      h->capacity != 0 && (h->capacity & (h->capacity - 1)) == 0 &&
+      (capacity == 0 || h->capacity == capacity) &&
+      size == bus_size(h->capacity);
+}
+
+//------------------------------------------------------------------------------
+// maps a whole file, 0 if it can't be:
+static void* map_file(int fd, size_t size, bool writable)
+{
+   void* map = mmap(0, size, writable ? PROT_READ | PROT_WRITE : PROT_READ,
+		    MAP_SHARED, fd, 0);
+   return map == MAP_FAILED ? 0 : map;
+}
+
+//------------------------------------------------------------------------------
+// the lock is on a file of its own, because a bus of another capacity
+// is replaced by rename(): readers keep the old one mapped, and never
+// see a file shrink under them. The old one is marked superseded once
+// the new one is in place, for its readers to reopen.
+KTradeBusWriter::KTradeBusWriter(const std::string& path, size_t capacity)
+   :fd_(-1), size_(0), header_(0), slots_(0), mask_(0)
+{
+   size_t n = 1;
+   while (n < capacity) n <<= 1;
+
+   std::string lock_path = path + ".lock";
+   fd_ = open(lock_path.c_str(), O_RDWR | O_CREAT, 0644);
+   if (fd_ < 0)
+      throw_errno("can't open", lock_path);
+   if (flock(fd_, LOCK_EX | LOCK_NB) != 0) {
+      close(fd_);
+      throw std::runtime_error("another writer has " + path);
+   }
+
+   // carry on with the existing bus if it fits, keep it to be marked
+   // superseded otherwise
+   KTradeBus::Header* old = 0;
+   size_t old_size = 0;
+   int fd = open(path.c_str(), O_RDWR);
+   if (fd >= 0) {
+      struct stat st;
+      if (fstat(fd, &st) == 0 &&
+	  size_t(st.st_size) >= sizeof(KTradeBus::Header)) {
+	 old_size = size_t(st.st_size);
+	 void* map = map_file(fd, old_size, true);
+	 KTradeBus::Header* h = static_cast<KTradeBus::Header*>(map);
+	 if (map && valid_header(h, old_size, n))
+	    header_ = h;
+	 else if (map && valid_header(h, old_size, 0))
+	    old = h;
+	 else if (map)
+	    munmap(map, old_size);
+      }
+      close(fd);
+   }
+
+   if (!header_) {
+      std::ostringstream tmp;
+      tmp << path << ".tmp." << getpid();
+      std::string tmp_path = tmp.str();
+
+      fd = open(tmp_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+      if (fd < 0) {
+	 close(fd_);
+	 throw_errno("can't create", tmp_path);
+      }
+
+      // the file is zero filled: every slot is unwritten
+      void* map = 0;
+      if (ftruncate(fd, off_t(bus_size(n))) == 0)
+	 map = map_file(fd, bus_size(n), true);
+      int err = errno;
+      close(fd);
+      if (map) {
+	 KTradeBus::Header* h = static_cast<KTradeBus::Header*>(map);
+	 h->version = KTradeBus::FORMAT_VERSION;
+	 h->record_size = sizeof(KTradeRecord);
+	 h->capacity = n;
+	 h->pair_count.store(0);
+	 h->superseded.store(0);
+	 h->head.store(0);
+	 std::memcpy(h->magic, BUS_MAGIC, sizeof(BUS_MAGIC));
+	 if (rename(tmp_path.c_str(), path.c_str()) == 0)
+	    header_ = h;
+	 else
+	    err = errno;
+      }
+      if (old) {
+	 if (header_)
+	    old->superseded.store(1, std::memory_order_release);
+	 munmap(old, old_size);
+      }
+      if (!header_) {
+	 if (map) munmap(map, bus_size(n));
+	 unlink(tmp_path.c_str());
+	 close(fd_);
+	 errno = err;
+	 throw_errno("can't create", path);
+      }
+   }
+
+   size_ = bus_size(n);
+   slots_ = reinterpret_cast<KTradeBus::Slot*>(header_ + 1);
+   mask_ = n - 1;
+}
+
+//------------------------------------------------------------------------------
+
+KTradeBusWriter::~KTradeBusWriter()
+{
+   munmap(header_, size_);
+   close(fd_);
+}
+
+//------------------------------------------------------------------------------
+
+KPairId KTradeBusWriter::add_pair(const std::string& pair)
+{
+   int index = bus_index(pair);
+   KPairId id = KRegistry::global().intern_pair(pair);
+   bus_indices_[id] = index + 1;
+   return id;
+}
+
+//------------------------------------------------------------------------------
+
+int KTradeBusWriter::bus_index(const std::string& pair)
+{
+   uint32_t count = header_->pair_count.load(std::memory_order_relaxed);
+   for (uint32_t i = 0; i < count; ++i)
+      if (pair == header_->pairs[i])
+	 return int(i);
+
+   if (count == KTradeBus::MAX_PAIRS)
+      throw std::runtime_error("too many pairs on the bus");
+   if (pair.empty() || pair.size() > KTradeBus::MAX_PAIR_NAME)
+      throw std::runtime_error("bad pair name for the bus: " + pair);
+
+   std::memset(header_->pairs[count], 0, KTradeBus::MAX_PAIR_NAME + 1);
+   std::memcpy(header_->pairs[count], pair.data(), pair.size());
+   header_->pair_count.store(count + 1, std::memory_order_release);
+   return int(count);
+}
+
+//------------------------------------------------------------------------------
+
+int KTradeBusWriter::bus_index(KPairId pair)
+{
+   if (pair < 0)
+      return -1;
+   int& index = bus_indices_[pair];
+   if (!index)
+      index = bus_index(KRegistry::global().pair(pair).name) + 1;
+   return index - 1;
+}
+
+//------------------------------------------------------------------------------
+// the head moves with every record, so readers see each one as soon
+// as it is written:
+void KTradeBusWriter::publish(const KTradeRecord* records, size_t n)
+{
+   uint64_t head = header_->head.load(std::memory_order_relaxed);
+   for (size_t i = 0; i < n; ++i, ++head) {
+      KTradeRecord r = records[i];
+      r.pair = bus_index(r.pair);
+
+      KTradeBus::Slot& s = slots_[head & mask_];
+      s.seq.store(0, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+      s.record = r;
+      s.seq.store(head + 1, std::memory_order_release);
+      header_->head.store(head + 1, std::memory_order_release);
+   }
+}
+
+//------------------------------------------------------------------------------
+
+uint64_t KTradeBusWriter::sequence() const
+{
+   return header_->head.load(std::memory_order_acquire);
+}
+
+//------------------------------------------------------------------------------
+
+KTradeBusReader::KTradeBusReader(const std::string& path, bool from_oldest)
+   :path_(path), size_(0), header_(0), slots_(0), mask_(0), next_(0), lost_(0)
+{
+   int fd = open(path.c_str(), O_RDONLY);
+   if (fd < 0)
+      throw_errno("can't open", path);
+
+   struct stat st;
+   void* map = 0;
+   if (fstat(fd, &st) == 0 && size_t(st.st_size) >= sizeof(KTradeBus::Header))
+      map = map_file(fd, size_t(st.st_size), false);
+   close(fd);
+
+   if (!map || !valid_header(static_cast<const KTradeBus::Header*>(map),
+			     size_t(st.st_size), 0)) {
+      if (map) munmap(map, size_t(st.st_size));
+      throw std::runtime_error(path + " is not a trade bus of this build");
+   }
+
+   size_ = size_t(st.st_size);
+   header_ = static_cast<const KTradeBus::Header*>(map);
+   slots_ = reinterpret_cast<const KTradeBus::Slot*>(header_ + 1);
+   mask_ = size_t(header_->capacity - 1);
+
+   uint64_t head = header_->head.load(std::memory_order_acquire);
+   if (!from_oldest)
+      next_ = head;
+   else if (head > capacity())
+      next_ = head - capacity();
+}
+
+//------------------------------------------------------------------------------
+
+KTradeBusReader::~KTradeBusReader()
+{
+   munmap(const_cast<KTradeBus::Header*>(header_), size_);
+}
+
+//------------------------------------------------------------------------------
+// a record is taken if its slot has the same, expected, seq before and
+// after the copy. Otherwise the writer is overwriting it with the record
+// 'capacity' ahead, so it is lost: the reader never waits on a slot,
+// even one a dead writer left half written. The head is read again only
+// then, or to know whether the reader was overrun at all:
+size_t KTradeBusReader::read(KTradeRecord* out, size_t max)
+{
+   uint64_t head = header_->head.load(std::memory_order_acquire);
+   size_t n = 0;
+   while (n < max && next_ != head) {
+      if (head - next_ > capacity()) {
+	 lost_ += head - capacity() - next_;
+	 next_ = head - capacity();
+      }
+
+      const KTradeBus::Slot& s = slots_[next_ & mask_];
+      uint64_t before = s.seq.load(std::memory_order_acquire);
+      KTradeRecord r = s.record;
+      std::atomic_thread_fence(std::memory_order_acquire);
+      uint64_t after = s.seq.load(std::memory_order_relaxed);
+      if (before != next_ + 1 || after != before) {
+	 ++lost_;
+	 ++next_;
+	 head = header_->head.load(std::memory_order_acquire);
+	 continue;
+      }
+
+      r.pair = pair_id(r.pair);
+      out[n++] = r;
+      ++next_;
+   }
+
+   if (n == 0 && header_->superseded.load(std::memory_order_acquire) &&
+       next_ == header_->head.load(std::memory_order_acquire))
+      throw std::runtime_error(path_ + " was replaced by another bus");
+   return n;
+}
+
+//------------------------------------------------------------------------------
+
+std::string KTradeBusReader::pair_name(KPairId pair) const
+{
+   if (pair < 0 || size_t(pair) >= KRegistry::global().pair_count())
+      return std::string();
+   return KRegistry::global().pair(pair).name;
+}
+
+//------------------------------------------------------------------------------
+// names are added before the records that use them are published, so a
+// record's index is known once the head shows the record:
+KPairId KTradeBusReader::pair_id(int index)
+{
+   if (index < 0)
+      return -1;
+   if (size_t(index) >= pair_ids_.size()) {
+      uint32_t count = header_->pair_count.load(std::memory_order_acquire);
+      if (count > KTradeBus::MAX_PAIRS)
+	 count = KTradeBus::MAX_PAIRS;
+      for (size_t i = pair_ids_.size(); i < count; ++i)
+	 pair_ids_.push_back(KRegistry::global().intern_pair(
+				std::string(header_->pairs[i],
+					    strnlen(header_->pairs[i],
+						    KTradeBus::MAX_PAIR_NAME))));
+      if (size_t(index) >= pair_ids_.size())
+	 return -1;
+   }
+   return pair_ids_[index];
+}
+
+//------------------------------------------------------------------------------
+
+uint64_t KTradeBusReader::lag() const
+{
+   return header_->head.load(std::memory_order_acquire) - next_;
+}
+
+//------------------------------------------------------------------------------
+
+}; // namespace Kraken
@@ -0,0 +1,150 @@
+#ifndef _KRAKEN_KBUS_HPP_
+#define _KRAKEN_KBUS_HPP_
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <stdint.h>
+
+#include "ktrade.hpp"
+
+//------------------------------------------------------------------------------
+
+namespace Kraken {
+
+//------------------------------------------------------------------------------
+// a trade bus is a ring of KTradeRecords in a file mapped shared (best
+// under /dev/shm) by one writer, the process that polls Kraken, and any
+// number of readers on the same machine, which read the records straight
+// from the mapping: no requests, no decoding, no system calls.
+//
+// Records are numbered from 0 in the order they are published and the
+// ring keeps the last 'capacity' of them. A reader that falls further
+// behind than that loses the records overwritten, and is told so (see
+// KTradeBusReader::lost()).
+//
+// KPairIds are dense only within a process (see KRegistry), so the file
+// names the pair of a record by its index in the bus's own table of pair
+// names, which every process sees the same. The writer translates the
+// KPairIds of the records it publishes into bus indices, and readers
+// translate them back into the KPairIds of KRegistry::global(): records
+// outside the file always carry KPairIds. The file is in native byte
+// order, like KMetadata's.
+struct KTradeBus {
+   // version of the file layout, bumped whenever it changes
+   static const uint32_t FORMAT_VERSION = 2;
+
+   // pairs a bus can name, and the longest name
+   static const size_t MAX_PAIRS = 256;
+   static const size_t MAX_PAIR_NAME = 31;
+
+   struct Header;
+   struct Slot;
+};
+
+//------------------------------------------------------------------------------
+// the writer of a bus; there is one at a time, others throw.
+class KTradeBusWriter {
+public:
+
+   // opens the bus in 'path', created with room for 'capacity' records
+   // (rounded up to a power of two) unless it exists with that capacity,
+   // in which case its records, pairs and numbering carry on
+   KTradeBusWriter(const std::string& path, size_t capacity = 1 << 20);
+
+   ~KTradeBusWriter();
+
+   // interns 'pair' in KRegistry::global() and adds it to the bus's
+   // table if new, as publish() would; throws if the table is full or
+   // the name too long
+   KPairId add_pair(const std::string& pair);
+
+   // appends records, the oldest records are overwritten once the ring
+   // is full. Pairs new to the bus are added by their registry name
+   // (and throw as add_pair() does)
+   void publish(const KTradeRecord* records, size_t n);
+
+   void publish(const KTradeRecord& record) { publish(&record, 1); }
+
+   // number of the next record to be published
+   uint64_t sequence() const;
+
+   size_t capacity() const { return mask_ + 1; }
+
+private:
+   // the bus index of a pair name or a KPairId, added if new
+   int bus_index(const std::string& pair);
+   int bus_index(KPairId pair);
+
+   int fd_;                    // open and locked while the writer lives
+   size_t size_;
+   KTradeBus::Header* header_; // the mapping
+   KTradeBus::Slot* slots_;
+   size_t mask_;
+   KPairTable<int> bus_indices_;  // bus index + 1, 0 if not looked up yet
+
+   // disallow copying
+   KTradeBusWriter(const KTradeBusWriter&);
+   KTradeBusWriter& operator=(const KTradeBusWriter&);
+};
+
+//------------------------------------------------------------------------------
+// a reader of a bus. Readers don't write to the file, any number of
+// them (in any number of processes) can tail the same bus.
+class KTradeBusReader {
+public:
+
+   // maps the bus in 'path', which must exist; reading starts with the
+   // next record published or, if 'from_oldest', with the oldest kept
+   KTradeBusReader(const std::string& path, bool from_oldest = false);
+
+   ~KTradeBusReader();
+
+   // copies up to 'max' records into 'out', in order, returns how many
+   // (0 if there are no new ones); their pairs are KPairIds of
+   // KRegistry::global(), interned as they appear. When the reader was
+   // overrun it goes on from the oldest record kept, and lost() grows.
+   // Once a writer has replaced the bus with one of another capacity,
+   // and the records left in the old one are read, throws
+   // std::runtime_error: the reader has to be opened again.
+   size_t read(KTradeRecord* out, size_t max);
+
+   // the name of the pair of a record, "" if unknown
+   std::string pair_name(KPairId pair) const;
+
+   // records published but not read yet
+   uint64_t lag() const;
+
+   // records overwritten before they were read, since the reader opened
+   uint64_t lost() const { return lost_; }
+
+   // number of the next record to be read
+   uint64_t sequence() const { return next_; }
+
+   size_t capacity() const { return mask_ + 1; }
+
+private:
+   std::string path_;
+   size_t size_;
+   const KTradeBus::Header* header_;  // the mapping
+   const KTradeBus::Slot* slots_;
+   size_t mask_;
+   uint64_t next_;
+   uint64_t lost_;
+   std::vector<KPairId> pair_ids_;  // of the bus indices seen so far
+
+   // the KPairId of a bus index, -1 if the bus doesn't name it
+   KPairId pair_id(int index);
+
+   // disallow copying
+   KTradeBusReader(const KTradeBusReader&);
+   KTradeBusReader& operator=(const KTradeBusReader&);
+};
+
+//------------------------------------------------------------------------------
+
+}; // namespace Kraken
+
+//------------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,141 @@
+#include <exception>
+#include <algorithm>
+#include "kcache.hpp"
+
+//------------------------------------------------------------------------------
+
+namespace Kraken {
+
+//------------------------------------------------------------------------------
+
+const size_t KCache::PURGE_SIZE;
+
+//------------------------------------------------------------------------------
+
+void KCache::set_ttl(const std::string& method, std::chrono::milliseconds ttl)
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   ttl_[method] = ttl;
+}
+
+//------------------------------------------------------------------------------
+// the first caller of a key makes the request with mutex_ released and
+// publishes it through a promise, the others wait on its future:
+std::string KCache::get(const std::string& method, const std::string& query,
+			const Fetch& fetch)
+{
+   std::string key = method + '?' + query;
+   std::promise<std::string> promise;
+
+   {
+      std::unique_lock<std::mutex> lock(mutex_);
+      Clock::time_point now = Clock::now();
+      Stats& stats = stats_[method];
+
+      std::map<std::string, Entry>::iterator it = entries_.find(key);
+      if (it != entries_.end()) {
+	 if (!it->second.ready) {
+	    ++stats.coalesced;
+	    std::shared_future<std::string> response = it->second.response;
+	    lock.unlock();
+	    return response.get();
+	 }
+	 if (now < it->second.expires) {
+	    ++stats.hits;
+	    return it->second.response.get();
+	 }
+	 entries_.erase(it);
+      }
+
+      ++stats.misses;
+      if (entries_.size() >= purge_at_)
+	 purge(now);
+
+      Entry& e = entries_[key];
+      e.response = promise.get_future().share();
+      e.ready = false;
+   }
+
+   std::string response;
+   try {
+      response = fetch();
+   }
+   catch (...) {
+      {
+	 std::lock_guard<std::mutex> lock(mutex_);
+	 entries_.erase(key);
+      }
+      promise.set_exception(std::current_exception());
+      throw;
+   }
+
+   {
+      std::lock_guard<std::mutex> lock(mutex_);
+      std::map<std::string, Entry>::iterator it = entries_.find(key);
+      std::map<std::string, std::chrono::milliseconds>::const_iterator
+	 ttl = ttl_.find(method);
+
+      // only successful responses are worth keeping
+      bool ok = response.compare(0, 11, "{\"error\":[]") == 0;
+
+      if (it != entries_.end()) {
+	 if (ok && ttl != ttl_.end() && ttl->second.count() > 0) {
+	    it->second.ready = true;
+	    it->second.expires = Clock::now() + ttl->second;
+	 }
+	 else {
+	    entries_.erase(it);
+	 }
+      }
+   }
+
+   promise.set_value(response);
+   return response;
+}
+
+//------------------------------------------------------------------------------
+
+KCache::Stats KCache::stats(const std::string& method) const
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   Stats total = { 0, 0, 0 };
+
+   std::map<std::string, Stats>::const_iterator it = stats_.begin();
+   for (; it != stats_.end(); ++it) {
+      if (!method.empty() && it->first != method)
+	 continue;
+      total.hits += it->second.hits;
+      total.misses += it->second.misses;
+      total.coalesced += it->second.coalesced;
+   }
+   return total;
+}
+
+//------------------------------------------------------------------------------
+
+void KCache::clear()
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   std::map<std::string, Entry>::iterator it = entries_.begin();
+   while (it != entries_.end()) {
+      if (it->second.ready) entries_.erase(it++);
+      else ++it;
+   }
+}
+
+//------------------------------------------------------------------------------
+// the next purge happens when the map has doubled from what is left, so
+// purging stays amortized O(1) per request:
+void KCache::purge(Clock::time_point now)
+{
+   std::map<std::string, Entry>::iterator it = entries_.begin();
+   while (it != entries_.end()) {
+      if (it->second.ready && it->second.expires <= now) entries_.erase(it++);
+      else ++it;
+   }
+   purge_at_ = std::max(PURGE_SIZE, 2 * entries_.size());
+}
+
+//------------------------------------------------------------------------------
+
+}; // namespace Kraken
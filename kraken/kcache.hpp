@@ -0,0 +1,86 @@
+#ifndef _KRAKEN_KCACHE_HPP_
+#define _KRAKEN_KCACHE_HPP_
+
+#include <map>
+#include <string>
+#include <mutex>
+#include <future>
+#include <chrono>
+#include <functional>
+
+//------------------------------------------------------------------------------
+
+namespace Kraken {
+
+//------------------------------------------------------------------------------
+// responses of public methods shared between KClients (see
+// KClient::set_cache()), usually one KClient per thread:
+//
+//  - identical requests (same method and input) made while one of them
+//    is in flight wait for it and get its response (single-flight);
+//  - methods with a TTL keep their last responses that long.
+//
+// Only responses with an empty "error" list are kept; a failed request
+// throws in every caller that was waiting for it.
+class KCache {
+public:
+
+   // counters of a method
+   struct Stats {
+      unsigned long long hits;       // answered from the cache
+      unsigned long long misses;     // sent to Kraken
+      unsigned long long coalesced;  // waited for an identical request
+   };
+
+   typedef std::function<std::string()> Fetch;
+
+   KCache() :purge_at_(PURGE_SIZE) { }
+
+   // keeps responses of 'method' for 'ttl' (0, the default, only
+   // coalesces concurrent requests)
+   void set_ttl(const std::string& method, std::chrono::milliseconds ttl);
+
+   // returns the response to 'method' with 'query', calling fetch() if
+   // it is neither cached nor in flight
+   std::string get(const std::string& method, const std::string& query,
+		   const Fetch& fetch);
+
+   // counters of a method, or of all methods when empty
+   Stats stats(const std::string& method = std::string()) const;
+
+   // drops the cached responses (requests in flight are not affected)
+   void clear();
+
+private:
+   typedef std::chrono::steady_clock Clock;
+
+   struct Entry {
+      std::shared_future<std::string> response;
+      bool ready;              // false while the request is in flight
+      Clock::time_point expires;
+   };
+
+   // drops expired responses, called with mutex_ held
+   void purge(Clock::time_point now);
+
+   // entries kept before expired ones are purged
+   static const size_t PURGE_SIZE = 1024;
+
+   mutable std::mutex mutex_;
+   std::map<std::string, Entry> entries_;   // by method and query
+   std::map<std::string, std::chrono::milliseconds> ttl_;
+   std::map<std::string, Stats> stats_;
+   size_t purge_at_;
+
+   // disallow copying
+   KCache(const KCache&);
+   KCache& operator=(const KCache&);
+};
+
+//------------------------------------------------------------------------------
+
+}; // namespace Kraken
+
+//------------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,244 @@
+#include <cstdlib>
+#include <cstring>
+#include "kcandle.hpp"
+
+//------------------------------------------------------------------------------
+
+namespace Kraken {
+
+//------------------------------------------------------------------------------
+
+void KCandles::clear()
+{
+   time.clear();
+   open.clear(); high.clear(); low.clear(); close.clear();
+   vwap.clear(); volume.clear();
+   count.clear();
+}
+
+//------------------------------------------------------------------------------
+
+void KCandles::reserve(size_t n)
+{
+   time.reserve(n);
+   open.reserve(n); high.reserve(n); low.reserve(n); close.reserve(n);
+   vwap.reserve(n); volume.reserve(n);
+   count.reserve(n);
+}
+
+//------------------------------------------------------------------------------
+
+void KCandles::truncate(size_t n)
+{
+   if (n >= size())
+      return;
+   time.resize(n);
+   open.resize(n); high.resize(n); low.resize(n); close.resize(n);
+   vwap.resize(n); volume.resize(n);
+   count.resize(n);
+}
+
+//------------------------------------------------------------------------------
+
+void KCandles::put(time_t t, double o, double h, double l, double c,
+		   double vw, double v, int n)
+{
+   if (!time.empty() && time.back() == t) {
+      size_t i = time.size() - 1;
+      open[i] = o; high[i] = h; low[i] = l; close[i] = c;
+      vwap[i] = vw; volume[i] = v;
+      count[i] = n;
+      return;
+   }
+
+   time.push_back(t);
+   open.push_back(o); high.push_back(h); low.push_back(l); close.push_back(c);
+   vwap.push_back(vw); volume.push_back(v);
+   count.push_back(n);
+}
+
+//------------------------------------------------------------------------------
+
+KCandle KCandles::row(size_t i) const
+{
+   KCandle c;
+   c.open = open[i];
+   c.close = close[i];
+   c.low = low[i];
+   c.high = high[i];
+   c.volume = volume[i];
+   c.time = time[i];
+   return c;
+}
+
+//------------------------------------------------------------------------------
+
+bool ohlc_interval(int minutes)
+{
+   switch (minutes) {
+   case 1: case 5: case 15: case 30: case 60: case 240:
+   case 1440: case 10080: case 21600:
+      return true;
+   default:
+      return false;
+   }
+}
+
+//------------------------------------------------------------------------------
+// a cursor over a JSON text that reads just what an OHLC response has;
+// the text is NUL terminated, so strtod() and friends stop in it:
+struct OhlcScanner {
+   const char* p;
+
+   void skip() {
+      while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r') ++p;
+   }
+
+   bool eat(char c) {
+      skip();
+      if (*p != c) return false;
+      ++p;
+      return true;
+   }
+
+   // a key or string without escapes, [b, e)
+   bool string(const char*& b, const char*& e) {
+      if (!eat('"')) return false;
+      for (b = p; *p != '"'; ++p)
+	 if (*p == '\\' || *p == '\0') return false;
+      e = p++;
+      return true;
+   }
+
+   // a number, bare or quoted as Kraken sends prices
+   bool number(double& v) {
+      skip();
+      bool quoted = *p == '"';
+      if (quoted) ++p;
+      char* stop;
+      v = std::strtod(p, &stop);
+      if (stop == p) return false;
+      p = stop;
+      return !quoted || *p++ == '"';
+   }
+
+   // any value, for keys that don't matter
+   bool skip_value() {
+      skip();
+      int depth = 0;
+      do {
+	 switch (*p) {
+	 case '\0':
+	    return false;
+	 case '"':
+	    for (++p; *p != '"'; ++p) {
+	       if (*p == '\0') return false;
+	       if (*p == '\\' && p[1] != '\0') ++p;
+	    }
+	    break;
+	 case '[': case '{':
+	    ++depth;
+	    break;
+	 case ']': case '}':
+	    if (depth == 0) return true;
+	    --depth;
+	    break;
+	 case ',':
+	    if (depth == 0) return true;
+	    break;
+	 }
+	 ++p;
+      } while (depth > 0 || (*p != ',' && *p != ']' && *p != '}'));
+      return true;
+   }
+};
+
+//------------------------------------------------------------------------------
+// helper function to compare a key with a literal:
+static bool is(const char* b, const char* e, const char* key)
+{
+   size_t n = std::strlen(key);
+   return size_t(e - b) == n && std::memcmp(b, key, n) == 0;
+}
+
+//------------------------------------------------------------------------------
+// [time, open, high, low, close, vwap, volume, count]:
+static bool decode_candle(OhlcScanner& s, KCandles& output)
+{
+   double v[8];
+   if (!s.eat('[')) return false;
+   for (int i = 0; i < 8; ++i)
+      if ((i && !s.eat(',')) || !s.number(v[i])) return false;
+   if (!s.eat(']')) return false;
+
+   output.put(time_t(v[0]), v[1], v[2], v[3], v[4], v[5], v[6], int(v[7]));
+   return true;
+}
+
+//------------------------------------------------------------------------------
+// {"<pair>": [candle, ...], "last": <time>}:
+static bool decode_result(OhlcScanner& s, KCandles& output, std::string& last)
+{
+   if (!s.eat('{')) return false;
+   if (s.eat('}')) return true;
+
+   do {
+      const char *b, *e;
+      if (!s.string(b, e) || !s.eat(':')) return false;
+
+      if (is(b, e, "last")) {
+	 s.skip();
+	 bool quoted = *s.p == '"';
+	 if (quoted) ++s.p;
+	 const char* digits = s.p;
+	 while (*s.p >= '0' && *s.p <= '9') ++s.p;
+	 last.assign(digits, s.p);
+	 if (quoted && *s.p++ != '"') return false;
+      }
+      else {
+	 if (!s.eat('[')) return false;
+	 if (!s.eat(']')) {
+	    do {
+	       if (!decode_candle(s, output)) return false;
+	    } while (s.eat(','));
+	    if (!s.eat(']')) return false;
+	 }
+      }
+   } while (s.eat(','));
+
+   return s.eat('}');
+}
+
+//------------------------------------------------------------------------------
+
+bool decode_ohlc(const std::string& response, KCandles& output,
+		 std::string& last)
+{
+   OhlcScanner s = { response.c_str() };
+   bool error = false, result = false;
+
+   if (!s.eat('{')) return false;
+   do {
+      const char *b, *e;
+      if (!s.string(b, e) || !s.eat(':')) return false;
+
+      if (is(b, e, "error")) {
+	 // only an empty list will do
+	 if (!s.eat('[') || !s.eat(']')) return false;
+	 error = true;
+      }
+      else if (is(b, e, "result")) {
+	 if (!decode_result(s, output, last)) return false;
+	 result = true;
+      }
+      else if (!s.skip_value()) {
+	 return false;
+      }
+   } while (s.eat(','));
+
+   return s.eat('}') && error && result;
+}
+
+//------------------------------------------------------------------------------
+
+}; // namespace Kraken
@@ -0,0 +1,66 @@
+#ifndef _KRAKEN_KCANDLE_HPP_
+#define _KRAKEN_KCANDLE_HPP_
+
+#include <string>
+#include <vector>
+#include <ctime>
+
+//------------------------------------------------------------------------------
+
+namespace Kraken {
+
+//------------------------------------------------------------------------------
+// a candle as a row, with the layout of kph's Candlestick:
+struct KCandle {
+   double open, close, low, high;
+   double volume;
+   time_t time;
+};
+
+//------------------------------------------------------------------------------
+// candles by column, oldest first, as the OHLC method returns them (see
+// KClient::ohlc()). 'time' is the start of the candle's interval.
+struct KCandles {
+
+   std::vector<time_t> time;
+   std::vector<double> open, high, low, close;
+   std::vector<double> vwap, volume;
+   std::vector<int> count;
+
+   size_t size() const { return time.size(); }
+   bool empty() const { return time.empty(); }
+
+   void clear();
+   void reserve(size_t n);
+
+   // drops the candles from the n-th on
+   void truncate(size_t n);
+
+   // appends a candle, or replaces the last one if it has the same time
+   // (the newest candle of OHLC is still forming, and comes again)
+   void put(time_t t, double o, double h, double l, double c,
+	    double vwap, double volume, int count);
+
+   // the i-th candle as a row
+   KCandle row(size_t i) const;
+};
+
+//------------------------------------------------------------------------------
+// true if OHLC has candles of 'minutes' (1, 5, 15, 30, 60, 240, 1440,
+// 10080 or 21600)
+bool ohlc_interval(int minutes);
+
+//------------------------------------------------------------------------------
+// decodes an OHLC response into 'output' (put() per candle) without a
+// JSON tree, and its "last" into 'last'; false if the response reports
+// errors or isn't shaped as expected, 'output' may have been changed
+bool decode_ohlc(const std::string& response, KCandles& output,
+		 std::string& last);
+
+//------------------------------------------------------------------------------
+
+}; // namespace Kraken
+
+//------------------------------------------------------------------------------
+
+#endif
@@ -5,250 +5,671 @@
 #include <cstring>
 #include <ctime>
 #include <cerrno>
-
-#include <openssl/buffer.h>
-#include <openssl/sha.h>
-#include <openssl/hmac.h>
-#include <openssl/bio.h>
+#include <utility>
+#include <random>
+#include <thread>
 
 #include "kclient.hpp"
 #include "../libjson/libjson.h"
 
-#define CURL_VERBOSE 0L //1L = enabled, 0L = disabled
-
 //------------------------------------------------------------------------------
 
 namespace Kraken {
 
 //------------------------------------------------------------------------------
-// helper function to compute SHA256:
-static std::vector<unsigned char> sha256(const std::string& data)
+// helper function to throw an exception if a parsed response reports
+// errors or has no result:
+static void check_response(const JSONNode& root)
 {
-   std::vector<unsigned char> digest(SHA256_DIGEST_LENGTH);
+   // throw an exception if there are errors in the JSON response
+   if (!root.at("error").empty()) {
+      std::ostringstream oss;
+      oss << "Kraken response contains errors: ";
+      
+      // append errors to output string stream
+      for (JSONNode::const_iterator
+	      it = root["error"].begin(); it != root["error"].end(); ++it) 
+	 oss << std::endl << " * " << libjson::to_std_string(it->as_string());
+      
+      throw std::runtime_error(oss.str());
+   }
 
-   SHA256_CTX ctx;
-   SHA256_Init(&ctx);
-   SHA256_Update(&ctx, data.c_str(), data.length());
-   SHA256_Final(digest.data(), &ctx);
+   // throw an exception if result is empty   
+   if (root.at("result").empty()) {
+      throw std::runtime_error("Kraken response doesn't contain result data");
+   }
+}
 
-   return digest;
+//------------------------------------------------------------------------------
+// constructor with all explicit parameters
+KClient::KClient(const std::string& key, const std::string& secret, 
+	   const std::string& url, const std::string& version)
+   :key_(key), signer_(secret), url_(url), version_(version)
+{ 
+   init(); 
 }
 
 //------------------------------------------------------------------------------
-// helper function to decode a base64 string to a vector of bytes:
-static std::vector<unsigned char> b64_decode(const std::string& data) 
-{
-   BIO* b64 = BIO_new(BIO_f_base64());
-   BIO_set_flags(b64, BIO_FLAGS_BASE64_NO_NL);
+// default API base URL and API version
+KClient::KClient(const std::string& key, const std::string& secret)
+   :key_(key), signer_(secret), url_("https://api.kraken.com"), version_("0")
+{ 
+   init(); 
+}
 
-   BIO* bmem = BIO_new_mem_buf((void*)data.c_str(),data.length());
-   bmem = BIO_push(b64, bmem);
-   
-   std::vector<unsigned char> output(data.length());
-   int decoded_size = BIO_read(bmem, output.data(), output.size());
-   BIO_free_all(bmem);
+//------------------------------------------------------------------------------
+// constructor with empty API key and API secret
+KClient::KClient() 
+   :key_(""), signer_(""), url_("https://api.kraken.com"), version_("0")
+{ 
+   init(); 
+}
 
-   if (decoded_size < 0)
-      throw std::runtime_error("failed while decoding base64.");
-   
-   return output;
+//------------------------------------------------------------------------------
+// initializes libcurl:
+void KClient::init()
+{
+   metadata_ = std::make_shared<KMetadata>();
+   multi_ = 0;
+   hedge_ = 0;
+
+   curl_ = curl_easy_init();
+   if (curl_) {
+      setup(curl_);
+   }
+   else {
+      throw std::runtime_error("can't create curl handle");
+   }
 }
 
 //------------------------------------------------------------------------------
-// helper function to encode a vector of bytes to a base64 string:
-static std::string b64_encode(const std::vector<unsigned char>& data) 
+// sets the options shared by curl_ and the handles of batches:
+void KClient::setup(CURL* curl) const
 {
-   BIO* b64 = BIO_new(BIO_f_base64());
-   BIO_set_flags(b64, BIO_FLAGS_BASE64_NO_NL);
+   setup_handle(curl, options_);
+   curl_easy_setopt(curl, CURLOPT_POST, 1L);
+}
 
-   BIO* bmem = BIO_new(BIO_s_mem());
-   b64 = BIO_push(b64, bmem);
-   
-   BIO_write(b64, data.data(), data.size());
-   BIO_flush(b64);
+//------------------------------------------------------------------------------
+// h2c (HTTP/2 without TLS) has no negotiation, it has to be assumed:
+void KClient::set_http2(bool on)
+{
+   if (!on)
+      options_.http_version = CURL_HTTP_VERSION_1_1;
+   else if (url_.compare(0, 7, "http://") == 0)
+      options_.http_version = CURL_HTTP_VERSION_2_PRIOR_KNOWLEDGE;
+   else
+      options_.http_version = CURL_HTTP_VERSION_2TLS;
+
+   setup_all();
+}
 
-   BUF_MEM* bptr = NULL;
-   BIO_get_mem_ptr(b64, &bptr);
-   
-   std::string output(bptr->data, bptr->length);
-   BIO_free_all(b64);
+//------------------------------------------------------------------------------
 
-   return output;
+void KClient::set_compression(bool on)
+{
+   options_.compression = on;
+   setup_all();
 }
 
 //------------------------------------------------------------------------------
-// helper function to hash with HMAC algorithm:
-static std::vector<unsigned char> 
-hmac_sha512(const std::vector<unsigned char>& data, 
-	    const std::vector<unsigned char>& key)
-{   
-   unsigned int len = EVP_MAX_MD_SIZE;
-   std::vector<unsigned char> digest(len);
 
-   HMAC_CTX *ctx = HMAC_CTX_new();
-   //HMAC_CTX_init(&ctx);
+void KClient::set_ca_file(const std::string& path)
+{
+   options_.ca_file = path;
+   setup_all();
+}
 
-   HMAC_Init_ex(ctx, key.data(), key.size(), EVP_sha512(), NULL);
-   HMAC_Update(ctx, data.data(), data.size());
-   HMAC_Final(ctx, digest.data(), &len);
-   
-   HMAC_CTX_free(ctx);
-   //HMAC_CTX_cleanup(&ctx);
-   
-   return digest;
+//------------------------------------------------------------------------------
+
+void KClient::setup_all()
+{
+   setup(curl_);
+   if (hedge_)
+      setup(hedge_);
+   for (size_t i = 0; i < batch_.size(); ++i)
+      setup(batch_[i]);
+   if (transport_)
+      transport_->configure(options_);
 }
 
+//------------------------------------------------------------------------------
+
+void KClient::set_transport(const std::shared_ptr<KTransport>& transport)
+{
+   transport_ = transport;
+   if (transport_)
+      transport_->configure(options_);
+}
 
 //------------------------------------------------------------------------------
-// builds a query string from KAPI::Input (a=1&b=2&...)
-static std::string build_query(const KInput& input)
+
+CURLM* KClient::multi() const
 {
-   std::ostringstream oss;
-   KInput::const_iterator it = input.begin();
-   for (; it != input.end(); ++it) {
-      if (it != input.begin()) oss << '&';  // delimiter
-      oss << it->first <<'='<< it->second;
+   if (!multi_) {
+      multi_ = curl_multi_init();
+      if (!multi_)
+	 throw std::runtime_error("can't create curl multi handle");
+      curl_multi_setopt(multi_, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
    }
+   return multi_;
+}
 
-   return oss.str();
+//------------------------------------------------------------------------------
+// distructor:
+KClient::~KClient() 
+{
+   if (refresh_.valid())
+      refresh_.wait();
+   for (size_t i = 0; i < batch_.size(); ++i)
+      curl_easy_cleanup(batch_[i]);
+   if (hedge_)
+      curl_easy_cleanup(hedge_);
+   if (multi_)
+      curl_multi_cleanup(multi_);
+   curl_easy_cleanup(curl_);
 }
 
 //------------------------------------------------------------------------------
-// helper function to create a nonce:
-static std::string create_nonce()
+// deals with public API methods:
+std::string KClient::public_method(const std::string& method, 
+				const KInput& input) const
 {
-   std::ostringstream oss;
+   // build postdata 
+   postdata_.clear();
+   input.append_query(postdata_);
+   return public_query(method);
+}
 
-   timeval tp;
-   if (gettimeofday(&tp, NULL) != 0) {
-      oss << "gettimeofday() failed: " << strerror(errno); 
-      throw std::runtime_error(oss.str());
+//------------------------------------------------------------------------------
+
+std::string KClient::public_query(const std::string& method) const
+{
+   if (!cache_)
+      return public_request(method, postdata_);
+
+   return cache_->get(method, postdata_, [&]() {
+	 return public_request(method, postdata_);
+      });
+}
+
+//------------------------------------------------------------------------------
+// the pair comes first, as trades(), ohlc() and depth() always set it
+// first, so both overloads send (and cache) the same query:
+void KClient::begin_pair_query(const std::string& pair) const
+{
+   postdata_.assign("pair=");
+   KInput::append_encoded(postdata_, pair);
+}
+
+void KClient::begin_pair_query(KPairId pair)
+{
+   const KPairEntry& e = KRegistry::global().pair(pair);
+   PairQuery& q = pair_queries_[pair];
+   if (q.entry != &e) {
+      q.entry = &e;
+      q.query.assign("pair=");
+      KInput::append_encoded(q.query, e.name);
    }
-   else {
-      // format output string 
-      oss << std::setfill('0') 
-	  << std::setw(10) << tp.tv_sec 
-	  << std::setw(6)  << tp.tv_usec;
+   postdata_.assign(q.query);
+}
+
+//------------------------------------------------------------------------------
+// what a finished attempt calls for:
+enum Outcome { DONE, RETRY, RATE_LIMITED };
+
+static Outcome classify(CURLcode result, long status, const std::string& response)
+{
+   switch (result) {
+   case CURLE_OK:
+      break;
+   case CURLE_COULDNT_RESOLVE_HOST:
+   case CURLE_COULDNT_CONNECT:
+   case CURLE_OPERATION_TIMEDOUT:
+   case CURLE_SEND_ERROR:
+   case CURLE_RECV_ERROR:
+   case CURLE_GOT_NOTHING:
+   case CURLE_PARTIAL_FILE:
+   case CURLE_SSL_CONNECT_ERROR:
+   case CURLE_HTTP2:
+   case CURLE_HTTP2_STREAM:
+      return RETRY;
+   default:
+      return DONE;
    }
-   return oss.str();
+
+   if (status == 429)
+      return RATE_LIMITED;
+   if (status >= 500)
+      return RETRY;
+
+   // an error list comes first in a response, a failed one is short
+   static const char ERROR_START[] = "{\"error\":[\"";
+   if (response.compare(0, sizeof(ERROR_START) - 1, ERROR_START) != 0)
+      return DONE;
+   std::string errors = response.substr(0, 256);
+   if (errors.find("EAPI:Rate limit") != std::string::npos)
+      return RATE_LIMITED;
+   if (errors.find("EService:Unavailable") != std::string::npos ||
+       errors.find("EService:Busy") != std::string::npos)
+      return RETRY;
+   return DONE;
 }
 
 //------------------------------------------------------------------------------
-// constructor with all explicit parameters
-KClient::KClient(const std::string& key, const std::string& secret, 
-	   const std::string& url, const std::string& version)
-   :key_(key), secret_(secret), url_(url), version_(version) 
-{ 
-   init(); 
+// a random backoff up to 'cap' ("full jitter"), so clients that failed
+// together don't retry together:
+static std::chrono::milliseconds jitter(std::chrono::milliseconds cap)
+{
+   static thread_local std::minstd_rand rng(std::random_device{}());
+   std::uniform_int_distribution<long long> d(0, cap.count());
+   return std::chrono::milliseconds(d(rng));
 }
 
 //------------------------------------------------------------------------------
-// default API base URL and API version
-KClient::KClient(const std::string& key, const std::string& secret)
-   :key_(key), secret_(secret), url_("https://api.kraken.com"), version_("0") 
-{ 
-   init(); 
+// sends a public request, again while it fails for a reason worth a
+// retry and the policy allows, and throws if the last attempt still
+// failed that way; any other response with errors is returned as it
+// is, for the caller to report:
+std::string KClient::public_request(const std::string& method, 
+				    const std::string& postdata) const
+{
+   typedef std::chrono::steady_clock Clock;
+
+   // build method URL
+   std::string method_url = url_ + "/" + version_ + "/public/" + method;
+
+   Clock::time_point deadline = Clock::time_point::max();
+   if (retry_.deadline.count() > 0)
+      deadline = Clock::now() + retry_.deadline;
+
+   std::string response;
+   CURLcode result = CURLE_OK;
+   Outcome outcome = DONE;
+   long status = 0;
+   int attempt = 0;
+   while (true) {
+      if (limiter_ && !limiter_->acquire(deadline)) {
+	 if (attempt > 0) break;
+	 throw std::runtime_error(method + ": deadline exceeded waiting for "
+				  "the rate limiter");
+      }
+
+      // the attempt gets what is left of the deadline
+      long timeout_ms = 0;
+      if (deadline != Clock::time_point::max()) {
+	 timeout_ms = long(std::chrono::duration_cast<std::chrono::milliseconds>(
+			      deadline - Clock::now()).count());
+	 if (timeout_ms <= 0) {
+	    if (attempt > 0) break;
+	    timeout_ms = 1;
+	 }
+      }
+
+      ++attempt;
+      status = 0;
+      response.clear();
+      result = retry_.hedge
+	 ? send_hedged(method, method_url, postdata, timeout_ms, response, status)
+	 : send_public(method, method_url, postdata, timeout_ms, response, status);
+
+      outcome = classify(result, status, response);
+      if (outcome == DONE || attempt >= retry_.attempts)
+	 break;
+
+      // backoff * 2^(attempt - 1), at most max_backoff
+      std::chrono::milliseconds cap = retry_.backoff;
+      for (int i = 1; i < attempt && cap < retry_.max_backoff; ++i)
+	 cap *= 2;
+      cap = std::min(cap, retry_.max_backoff);
+
+      // the limiter makes every client wait, not just this one
+      if (outcome == RATE_LIMITED && limiter_) {
+	 limiter_->pause(cap);
+	 continue;
+      }
+
+      std::chrono::milliseconds pause = jitter(cap);
+      if (deadline - Clock::now() <= pause)
+	 break;
+      std::this_thread::sleep_for(pause);
+   }
+
+   if (result != CURLE_OK) {
+      std::ostringstream oss;
+      oss << perform_error(result);
+      if (attempt > 1)
+	 oss << " (" << attempt << " attempts)";
+      throw std::runtime_error(oss.str());
+   }
+
+   // an error page or a transient error list isn't a response to parse
+   if (outcome != DONE) {
+      std::ostringstream oss;
+      oss << method << ": "
+	  << (outcome == RATE_LIMITED ? "rate limited" : "service unavailable")
+	  << " (HTTP " << status;
+      if (response.compare(0, 10, "{\"error\":[") == 0)
+	 oss << ", " << response.substr(0, std::min(response.find(']'),
+						    size_t(200)) + 1);
+      oss << ", " << attempt << (attempt > 1 ? " attempts)" : " attempt)");
+      throw std::runtime_error(oss.str());
+   }
+
+   return response;
 }
 
 //------------------------------------------------------------------------------
-// constructor with empty API key and API secret
-KClient::KClient() 
-   :key_(""), secret_(""), url_("https://api.kraken.com"), version_("0") 
-{ 
-   init(); 
+
+CURLcode KClient::send_public(const std::string& method, const std::string& url,
+			      const std::string& postdata, long timeout_ms,
+			      std::string& response, long& status) const
+{
+   if (transport_) {
+      KHttpRequest request;
+      request.url = url;
+      request.body = postdata;
+      request.timeout_ms = timeout_ms;
+      KHttpResponse exchange;
+      CURLcode result = transport_->perform(request, exchange);
+      record_exchange(method, request, exchange);
+      response.swap(exchange.body);
+      status = exchange.status;
+      return result;
+   }
+
+   prepare_handle(curl_, url, &postdata, 0, timeout_ms, response);
+   CURLcode result = curl_easy_perform(curl_);
+   record_request(method, curl_);
+   curl_easy_getinfo(curl_, CURLINFO_RESPONSE_CODE, &status);
+   return result;
 }
 
 //------------------------------------------------------------------------------
-// initializes libcurl:
-void KClient::init()
+// curl_ and hedge_ run in multi_: the hedge is added once curl_ has run
+// for hedge_delay() (if the limiter has a token for it). The first to
+// complete with a response classify() takes as DONE wins and the other
+// is abandoned; a failure (a 5xx, a 429, EService:Unavailable...) only
+// wins if nothing else is running, for public_request() to retry. Over
+// HTTP/2 both share the connection, so the hedge helps with a slow
+// server, not a slow link:
+CURLcode KClient::send_hedged(const std::string& method, const std::string& url,
+			      const std::string& postdata, long timeout_ms,
+			      std::string& response, long& status) const
 {
-   curl_ = curl_easy_init();
-   if (curl_) {
-      curl_easy_setopt(curl_, CURLOPT_VERBOSE, CURL_VERBOSE);
-      curl_easy_setopt(curl_, CURLOPT_SSL_VERIFYPEER, 1L);
-      curl_easy_setopt(curl_, CURLOPT_SSL_VERIFYHOST, 2L);
-      curl_easy_setopt(curl_, CURLOPT_USERAGENT, "Kraken C++ API Client");
-      curl_easy_setopt(curl_, CURLOPT_POST, 1L);
-      // set callback function 
-      curl_easy_setopt(curl_, CURLOPT_WRITEFUNCTION, KClient::write_cb);
+   typedef std::chrono::steady_clock Clock;
+
+   if (transport_)
+      return send_public(method, url, postdata, timeout_ms, response, status);
+
+   CURLM* multi = this->multi();
+   if (!hedge_) {
+      hedge_ = curl_easy_init();
+      if (!hedge_)
+	 throw std::runtime_error("can't create curl handle");
+      setup(hedge_);
    }
-   else {
-      throw std::runtime_error("can't create curl handle");
+
+   CURL* handles[2] = { curl_, hedge_ };
+   std::string output[2];
+   for (int i = 0; i < 2; ++i)
+      prepare_handle(handles[i], url, &postdata, 0, timeout_ms, output[i]);
+
+   Clock::time_point hedge_at = Clock::now() + hedge_delay(method);
+   curl_multi_add_handle(multi, curl_);
+   int active = 1, winner = -1;
+   bool hedged = false;
+   CURLcode result = CURLE_OK;
+   CURLMcode mc = CURLM_OK;
+
+   while (mc == CURLM_OK && winner < 0 && active > 0) {
+      int running = 0;
+      mc = curl_multi_perform(multi, &running);
+
+      int left;
+      while (CURLMsg* msg = curl_multi_info_read(multi, &left)) {
+	 if (msg->msg != CURLMSG_DONE) continue;
+	 record_request(method, msg->easy_handle);
+	 --active;
+	 if (winner >= 0) continue;
+
+	 int i = msg->easy_handle == curl_ ? 0 : 1;
+	 long code = 0;
+	 curl_easy_getinfo(msg->easy_handle, CURLINFO_RESPONSE_CODE, &code);
+	 if (active == 0 || classify(msg->data.result, code, output[i]) == DONE) {
+	    winner = i;
+	    result = msg->data.result;
+	    status = code;
+	 }
+      }
+      if (mc != CURLM_OK || winner >= 0 || active == 0)
+	 break;
+
+      int wait_ms = 1000;
+      if (!hedged) {
+	 Clock::time_point now = Clock::now();
+	 if (now >= hedge_at) {
+	    if (!limiter_ || limiter_->try_acquire()) {
+	       curl_multi_add_handle(multi, hedge_);
+	       ++active;
+	    }
+	    hedged = true;
+	    continue;
+	 }
+	 wait_ms = int(std::min<long long>(wait_ms,
+	    std::chrono::duration_cast<std::chrono::milliseconds>(
+	       hedge_at - now).count() + 1));
+      }
+      mc = curl_multi_poll(multi, NULL, 0, wait_ms, NULL);
    }
+
+   curl_multi_remove_handle(multi, curl_);
+   curl_multi_remove_handle(multi, hedge_);
+
+   if (mc != CURLM_OK) {
+      std::ostringstream oss;
+      oss << "curl_multi_perform() failed: " << curl_multi_strerror(mc);
+      throw std::runtime_error(oss.str());
+   }
+   if (winner >= 0)
+      response.swap(output[winner]);
+   return result;
 }
 
 //------------------------------------------------------------------------------
-// distructor:
-KClient::~KClient() 
+// the policy's percentile of the method's times once there are enough
+// of them, its fixed delay until then:
+std::chrono::milliseconds KClient::hedge_delay(const std::string& method) const
 {
-   curl_easy_cleanup(curl_);
+   if (metrics_) {
+      const KHistogram& total = endpoint(method).phases[KMetrics::TOTAL];
+      if (total.count() >= KRetryPolicy::HEDGE_SAMPLES)
+	 return std::chrono::milliseconds(
+	    total.percentile(retry_.hedge_percentile) / 1000);
+   }
+   return retry_.hedge_delay;
 }
 
 //------------------------------------------------------------------------------
-// returns message signature generated from a URI path, a nonce 
-// and postdata, message signature is created as a follows:
-// 
-//   hmac_sha512(path + sha256(nonce + postdata), b64decode(secret)) 
-//
-// and the result is converted in a base64 string: 
-std::string KClient::signature(const std::string& path, 
-			    const std::string& nonce, 
-			    const std::string& postdata) const
+// the handles wait for a connection that can multiplex (PIPEWAIT)
+// rather than opening one each; connections stay in multi_'s cache for
+// the next batch. Each request joins the batch once the limiter gives
+// it a token, so a batch is paced like single requests. Requests that
+// failed for a reason worth a retry are sent again one by one through
+// public_request(), if the policy allows more than one attempt:
+void KClient::public_methods(const std::vector<KRequest>& requests,
+			     std::vector<std::string>& responses)
 {
-   // add path to data to encrypt
-   std::vector<unsigned char> data(path.begin(), path.end());
+   if (transport_) {
+      std::vector<std::string> output(requests.size());
+      for (size_t i = 0; i < requests.size(); ++i) {
+	 postdata_.clear();
+	 requests[i].input.append_query(postdata_);
+	 output[i] = public_request(requests[i].method, postdata_);
+      }
+      responses.swap(output);
+      return;
+   }
+
+   CURLM* multi = this->multi();
+
+   size_t n = requests.size();
+   while (batch_.size() < n) {
+      CURL* curl = curl_easy_init();
+      if (!curl)
+	 throw std::runtime_error("can't create curl handle");
+      setup(curl);
+      curl_easy_setopt(curl, CURLOPT_PIPEWAIT, 1L);
+      batch_.push_back(curl);
+   }
+
+   std::vector<std::string> output(n), postdata(n), urls(n);
+   for (size_t i = 0; i < n; ++i) {
+      urls[i] = url_ + "/" + version_ + "/public/" + requests[i].method;
+      requests[i].input.append_query(postdata[i]);
+
+      prepare_handle(batch_[i], urls[i], &postdata[i], 0, 0, output[i]);
+      curl_easy_setopt(batch_[i], CURLOPT_PRIVATE, reinterpret_cast<char*>(i));
+   }
+
+   // with nothing running, the next token is waited for
+   size_t added = 0;
+   int running = 0;
+   CURLMcode mc = CURLM_OK;
+   do {
+      while (added < n && (!limiter_ || limiter_->try_acquire()))
+	 curl_multi_add_handle(multi, batch_[added++]);
+
+      mc = curl_multi_perform(multi, &running);
+      if (mc != CURLM_OK)
+	 break;
+      if (running)
+	 mc = curl_multi_poll(multi, NULL, 0, added < n ? 10 : 1000, NULL);
+      else if (added < n) {
+	 limiter_->acquire();
+	 curl_multi_add_handle(multi, batch_[added++]);
+	 running = 1;  // not performed yet
+      }
+   } while (mc == CURLM_OK && (running || added < n));
+
+   std::ostringstream errors;
+   if (mc != CURLM_OK)
+      errors << "curl_multi_perform() failed: " << curl_multi_strerror(mc);
+
+   std::vector<CURLcode> results(n, CURLE_OK);
+   int left;
+   while (CURLMsg* msg = curl_multi_info_read(multi, &left)) {
+      if (msg->msg != CURLMSG_DONE) continue;
+      char* priv = 0;
+      curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, &priv);
+      size_t i = reinterpret_cast<size_t>(priv);
+      record_request(requests[i].method, msg->easy_handle);
+      results[i] = msg->data.result;
+   }
 
-   // concatenate nonce and postdata and compute SHA256
-   std::vector<unsigned char> nonce_postdata = sha256(nonce + postdata);
+   for (size_t i = 0; i < n; ++i)
+      curl_multi_remove_handle(multi, batch_[i]);
 
-   // concatenate path and nonce_postdata (path + sha256(nonce + postdata))
-   data.insert(data.end(), nonce_postdata.begin(), nonce_postdata.end());
+   if (errors.tellp() != 0)
+      throw std::runtime_error(errors.str());
 
-   // and compute HMAC
-   return b64_encode( hmac_sha512(data, b64_decode(secret_)) );
+   for (size_t i = 0; i < n; ++i) {
+      long status = 0;
+      curl_easy_getinfo(batch_[i], CURLINFO_RESPONSE_CODE, &status);
+      Outcome outcome = classify(results[i], status, output[i]);
+      if (outcome == DONE && results[i] == CURLE_OK)
+	 continue;
+
+      if (outcome != DONE && retry_.attempts > 1) {
+	 output[i] = public_request(requests[i].method, postdata[i]);
+	 continue;
+      }
+
+      std::ostringstream oss;
+      oss << requests[i].method << ": ";
+      if (results[i] != CURLE_OK)
+	 oss << perform_error(results[i]);
+      else
+	 oss << (outcome == RATE_LIMITED ? "rate limited" : "service unavailable")
+	     << " (HTTP " << status << ")";
+      throw std::runtime_error(oss.str());
+   }
+   responses.swap(output);
 }
 
 //------------------------------------------------------------------------------
-// CURL write function callback:
-size_t KClient::write_cb(char* ptr, size_t size, size_t nmemb, void* userdata)
+// KMetrics looks endpoints up under its lock, shared by every KClient;
+// this cache is the client's own:
+KMetrics::Endpoint& KClient::endpoint(const std::string& method) const
 {
-   std::string* response = reinterpret_cast<std::string*>(userdata);
-   size_t real_size = size * nmemb;
-
-   response->append(ptr, real_size);
-   return real_size;
+   KMetrics::Endpoint*& e = endpoints_[method];
+   if (!e)
+      e = &metrics_->endpoint(method);
+   return *e;
 }
 
 //------------------------------------------------------------------------------
-// deals with public API methods:
-std::string KClient::public_method(const std::string& method, 
-				const KInput& input) const
+
+void KClient::record_request(const std::string& method, CURL* curl) const
 {
-   // build method URL
-   std::string path = "/" + version_ + "/public/" + method;
-   std::string method_url = url_ + path;   
-   curl_easy_setopt(curl_, CURLOPT_URL, method_url.c_str());
+   if (!metrics_)
+      return;
 
-   // build postdata 
-   std::string postdata = build_query(input);
-   curl_easy_setopt(curl_, CURLOPT_POSTFIELDS, postdata.c_str());
+   curl_off_t in = 0, out = 0;
+   curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD_T, &in);
+   curl_easy_getinfo(curl, CURLINFO_SIZE_UPLOAD_T, &out);
+   record_times(method, handle_times(curl), in, out);
+}
 
-   // reset the http header
-   curl_easy_setopt(curl_, CURLOPT_HTTPHEADER, NULL);
+//------------------------------------------------------------------------------
+// a replayed exchange only has its total time:
+void KClient::record_exchange(const std::string& method,
+			      const KHttpRequest& request,
+			      const KHttpResponse& response) const
+{
+   if (!metrics_)
+      return;
 
-   // where CURL write callback function stores the response
-   std::string response;
-   curl_easy_setopt(curl_, CURLOPT_WRITEDATA, static_cast<void*>(&response));
- 
-   // perform CURL request
-   CURLcode result = curl_easy_perform(curl_);
-   if (result != CURLE_OK) {
-      std::ostringstream oss;  
-      oss << "curl_easy_perform() failed: "<< curl_easy_strerror(result);
-      throw std::runtime_error(oss.str());
+   KHttpTimes times = response.times;
+   if (times.total < 0)
+      times.total = curl_off_t(response.seconds * 1e6);
+   record_times(method, times, response.body.size(), request.body.size());
+}
+
+//------------------------------------------------------------------------------
+// curl reports each phase as the time from the start of the request to
+// its end, the histograms get their durations:
+void KClient::record_times(const std::string& method, const KHttpTimes& t,
+			   uint64_t in, uint64_t out) const
+{
+   uint64_t v[KMetrics::PHASES];
+   for (int p = 0; p < KMetrics::PHASES; ++p)
+      v[p] = KMetrics::NONE;
+   if (t.dns >= 0) {
+      v[KMetrics::DNS] = t.dns;
+      v[KMetrics::CONNECT] = t.connect > t.dns ? t.connect - t.dns : 0;
+      v[KMetrics::TLS] = t.tls > t.connect ? t.tls - t.connect : 0;
+      v[KMetrics::SERVER] = t.start > t.pretransfer ? t.start - t.pretransfer : 0;
+      v[KMetrics::TRANSFER] = t.total > t.start ? t.total - t.start : 0;
    }
+   v[KMetrics::TOTAL] = t.total;
+   v[KMetrics::BYTES_IN] = in;
+   v[KMetrics::BYTES_OUT] = out;
+   KMetrics::record(endpoint(method), v);
+}
 
-   return response;
+//------------------------------------------------------------------------------
+
+void KClient::record_parse(const std::string& method,
+			   std::chrono::steady_clock::time_point start) const
+{
+   if (!metrics_)
+      return;
+
+   std::chrono::microseconds us =
+      std::chrono::duration_cast<std::chrono::microseconds>(
+	 std::chrono::steady_clock::now() - start);
+   endpoint(method).phases[KMetrics::PARSE].record(uint64_t(us.count()));
 }
 
 //------------------------------------------------------------------------------
@@ -260,44 +681,49 @@ std::string KClient::private_method(const std::string& method,
    std::string path = "/" + version_ + "/private/" + method;
    std::string method_url = url_ + path;
 
-   curl_easy_setopt(curl_, CURLOPT_URL, method_url.c_str());
-
    // create a nonce and and postdata 
-   std::string nonce = create_nonce();
-   std::string postdata = "nonce=" + nonce;
+   char digits[24];
+   char* end = digits + sizeof(digits);
+   std::string nonce(KSigner::format_nonce(KSigner::next_nonce(), end), end);
+   postdata_.assign("nonce=").append(nonce);
 
    // if 'input' is not empty generate other postdata
-   if (!input.empty())
-      postdata = postdata + "&" + build_query(input);
-   curl_easy_setopt(curl_, CURLOPT_POSTFIELDS, postdata.c_str());
-
-   // add custom header
-   curl_slist* chunk = NULL;
+   input.append_query(postdata_);
 
    std::string key_header =  "API-Key: "  + key_;
-   std::string sign_header = "API-Sign: " + signature(path, nonce, postdata);
+   std::string sign_header = "API-Sign: " + signer_.sign(path, nonce, postdata_);
+
+   if (transport_) {
+      KHttpRequest request;
+      request.url = method_url;
+      request.body = postdata_;
+      request.headers.push_back(key_header);
+      request.headers.push_back(sign_header);
+      KHttpResponse response;
+      CURLcode result = transport_->perform(request, response);
+      record_exchange(method, request, response);
+      check_perform(result);
+      return response.body;
+   }
 
+   // add custom header
+   curl_slist* chunk = NULL;
    chunk = curl_slist_append(chunk, key_header.c_str());
    chunk = curl_slist_append(chunk, sign_header.c_str());
-   curl_easy_setopt(curl_, CURLOPT_HTTPHEADER, chunk);
-   
-   // where CURL write callback function stores the response
+
+   // private methods are not retried, nor have deadlines
    std::string response;
-   curl_easy_setopt(curl_, CURLOPT_WRITEDATA, static_cast<void*>(&response));
+   prepare_handle(curl_, method_url, &postdata_, chunk, 0, response);
 
    // perform CURL request
    CURLcode result = curl_easy_perform(curl_);
+   record_request(method, curl_);
 
    // free the custom headers
+   curl_easy_setopt(curl_, CURLOPT_HTTPHEADER, NULL);
    curl_slist_free_all(chunk);
-  
-   // check perform result
-   if (result != CURLE_OK) {
-      std::ostringstream oss;
-      oss << "curl_easy_perform() failed: " << curl_easy_strerror(result);
-      throw std::runtime_error(oss.str());
-   }
-   
+
+   check_perform(result);
    return response;
 }
 
@@ -306,48 +732,249 @@ std::string KClient::private_method(const std::string& method,
 std::string KClient::trades(const std::string& pair, 
 			    const std::string& since,
 			    std::vector<KTrade>& output)
+{
+   begin_pair_query(pair);
+   return trades_query(since, output);
+}
+
+//------------------------------------------------------------------------------
+// pairs interned in KRegistry::global() are sent by name, encoded once:
+std::string KClient::trades(KPairId pair, const std::string& since,
+			    std::vector<KTrade>& output)
+{
+   begin_pair_query(pair);
+   return trades_query(since, output);
+}
+
+//------------------------------------------------------------------------------
+
+std::string KClient::trades_query(const std::string& since,
+				  std::vector<KTrade>& output)
 {
    KInput ki;
-   ki["pair"] = pair;
    ki["since"] = since;
+   ki.append_query(postdata_);
 
    // download and parse data
-   json_string data = libjson::to_json_string( public_method("Trades", ki) ); 
+   json_string data = libjson::to_json_string( public_query("Trades") ); 
+   std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
    JSONNode root = libjson::parse(data);
+   check_response(root);
 
+   JSONNode &result = root["result"];
+   JSONNode &result_pair = result[0];
+   std::string last = libjson::to_std_string( result.at("last").as_string() );
 
-
-   // throw an exception if there are errors in the JSON response
-   if (!root.at("error").empty()) {
-      std::ostringstream oss;
-      oss << "Kraken response contains errors: ";
-      
-      // append errors to output string stream
-      for (JSONNode::const_iterator
-	      it = root["error"].begin(); it != root["error"].end(); ++it) 
-	 oss << std::endl << " * " << libjson::to_std_string(it->as_string());
+   // rows are moved out of the result and decoded one at a time, so
+   // each parsed row is released as soon as it has been read
+   std::vector<KTrade> buf;
+   buf.reserve(result_pair.size());
+   for (JSONNode::iterator 
+	   it = result_pair.begin(); it != result_pair.end(); ++it) {
+      JSONNode row(std::move(*it));
+      buf.push_back(KTrade(row));
+   }
       
-      throw std::runtime_error(oss.str());
+   output.swap(buf);
+   record_parse("Trades", start);
+   return last;
+}
+
+//------------------------------------------------------------------------------
+// downloads candles, decoded without a JSON tree; libjson only parses a
+// response the decoder rejects, to report its errors:
+std::string KClient::ohlc(const std::string& pair, int interval,
+			  const std::string& since, KCandles& output)
+{
+   begin_pair_query(pair);
+   return ohlc_query(interval, since, output);
+}
+
+//------------------------------------------------------------------------------
+
+std::string KClient::ohlc(KPairId pair, int interval, const std::string& since,
+			  KCandles& output)
+{
+   begin_pair_query(pair);
+   return ohlc_query(interval, since, output);
+}
+
+//------------------------------------------------------------------------------
+
+std::string KClient::ohlc_query(int interval, const std::string& since,
+				KCandles& output)
+{
+   KInput ki;
+   ki.set("interval", interval);
+   if (!since.empty())
+      ki["since"] = since;
+   ki.append_query(postdata_);
+
+   std::string response = public_query("OHLC");
+   std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+   // decoded straight into 'output', which gets back what it had on a
+   // failure: its size, and its last candle, which the first candle
+   // decoded replaces if it has the same time
+   size_t size = output.size();
+   KCandles kept;
+   if (size)
+      kept.put(output.time[size - 1], output.open[size - 1],
+	       output.high[size - 1], output.low[size - 1],
+	       output.close[size - 1], output.vwap[size - 1],
+	       output.volume[size - 1], output.count[size - 1]);
+
+   std::string last;
+   if (!decode_ohlc(response, output, last)) {
+      output.truncate(size);
+      if (size)
+	 output.put(kept.time[0], kept.open[0], kept.high[0], kept.low[0],
+		    kept.close[0], kept.vwap[0], kept.volume[0], kept.count[0]);
+      check_response(libjson::parse(libjson::to_json_string(response)));
+      throw std::runtime_error("unexpected OHLC response");
    }
 
-   // throw an exception if result is empty   
-   if (root.at("result").empty()) {
-      throw std::runtime_error("Kraken response doesn't contain result data");
+   record_parse("OHLC", start);
+   return last;
+}
+
+//------------------------------------------------------------------------------
+// downloads the order book:
+void KClient::depth(const std::string& pair, int count,
+		    std::vector<KLevel>& asks, std::vector<KLevel>& bids)
+{
+   begin_pair_query(pair);
+   depth_query(count, asks, bids);
+}
+
+//------------------------------------------------------------------------------
+
+void KClient::depth(KPairId pair, int count,
+		    std::vector<KLevel>& asks, std::vector<KLevel>& bids)
+{
+   begin_pair_query(pair);
+   depth_query(count, asks, bids);
+}
+
+//------------------------------------------------------------------------------
+
+void KClient::depth_query(int count,
+			  std::vector<KLevel>& asks, std::vector<KLevel>& bids)
+{
+   if (count > 0) {
+      KInput ki;
+      ki.set("count", count);
+      ki.append_query(postdata_);
    }
 
+   // download and parse data
+   json_string data = libjson::to_json_string( public_query("Depth") ); 
+   std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+   JSONNode root = libjson::parse(data);
+   check_response(root);
 
+   JSONNode &book = root["result"][0];
+   std::vector<KLevel> buf_asks, buf_bids;
 
-   JSONNode &result = root["result"];
-   JSONNode &result_pair = result[0];
-   std::string last = libjson::to_std_string( result.at("last").as_string() );
+   const JSONNode& a = book.at("asks");
+   buf_asks.reserve(a.size());
+   for (JSONNode::const_iterator it = a.begin(); it != a.end(); ++it)
+      buf_asks.push_back(KLevel(*it));
 
-   std::vector<KTrade> buf;
-   for (JSONNode::const_iterator 
-	   it = result_pair.begin(); it != result_pair.end(); ++it)
-      buf.push_back(KTrade(*it));
-      
-   output.swap(buf);
-   return last;
+   const JSONNode& b = book.at("bids");
+   buf_bids.reserve(b.size());
+   for (JSONNode::const_iterator it = b.begin(); it != b.end(); ++it)
+      buf_bids.push_back(KLevel(*it));
+
+   asks.swap(buf_asks);
+   bids.swap(buf_bids);
+   record_parse("Depth", start);
+}
+
+//------------------------------------------------------------------------------
+// downloads the asset and pair catalog:
+void KClient::fetch_metadata(KMetadata& output)
+{
+   json_string data = libjson::to_json_string( public_method("Assets", KInput()) );
+   JSONNode assets = libjson::parse(data);
+   check_response(assets);
+
+   data = libjson::to_json_string( public_method("AssetPairs", KInput()) );
+   JSONNode pairs = libjson::parse(data);
+   check_response(pairs);
+
+   output.build(assets["result"], pairs["result"], std::time(0));
+}
+
+//------------------------------------------------------------------------------
+// the refresh runs on its own KClient (a curl handle isn't shared between
+// threads) and replaces metadata_ only when the catalog has changed:
+bool KClient::load_metadata(const std::string& path,
+			    std::chrono::seconds max_age)
+{
+   if (refresh_.valid())
+      refresh_.wait();
+
+   std::shared_ptr<KMetadata> cached = std::make_shared<KMetadata>();
+   bool loaded = cached->load(path);
+   if (loaded) {
+      KRegistry::global().install(*cached);
+      std::lock_guard<std::mutex> lock(metadata_mutex_);
+      metadata_ = cached;
+   }
+
+   if (loaded && std::time(0) - cached->fetched() < max_age.count())
+      return true;
+
+   // the refresh has its own client, set up as this one
+   std::string url = url_, version = version_;
+   KCurlOptions options = options_;
+   KRetryPolicy retry = retry_;
+   std::shared_ptr<KCache> cache = cache_;
+   std::shared_ptr<KMetrics> metrics = metrics_;
+   std::shared_ptr<KRateLimiter> limiter = limiter_;
+   std::shared_ptr<KTransport> transport = transport_;
+
+   refresh_ = std::async(std::launch::async,
+			 [this, path, url, version, options, retry, cache,
+			  metrics, limiter, transport]() {
+	 KClient kc("", "", url, version);
+	 kc.options_ = options;
+	 kc.setup_all();
+	 kc.set_retry(retry);
+	 kc.set_cache(cache);
+	 kc.set_metrics(metrics);
+	 kc.set_rate_limiter(limiter);
+	 kc.set_transport(transport);
+
+	 std::shared_ptr<KMetadata> fresh = std::make_shared<KMetadata>();
+	 kc.fetch_metadata(*fresh);
+	 fresh->save(path);
+
+	 std::lock_guard<std::mutex> lock(metadata_mutex_);
+	 if (!fresh->same_catalog(*metadata_)) {
+	    KRegistry::global().install(*fresh);
+	    metadata_ = fresh;
+	 }
+      });
+
+   return loaded;
+}
+
+//------------------------------------------------------------------------------
+
+std::shared_ptr<const KMetadata> KClient::metadata() const
+{
+   std::lock_guard<std::mutex> lock(metadata_mutex_);
+   return metadata_;
+}
+
+//------------------------------------------------------------------------------
+
+void KClient::wait_metadata()
+{
+   if (refresh_.valid())
+      refresh_.get();
 }
 
 //------------------------------------------------------------------------------
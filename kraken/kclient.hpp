@@ -1,20 +1,37 @@
 #ifndef _KRAKEN_KCLIENT_HPP_
 #define _KRAKEN_KCLIENT_HPP_
 
-#include <map>
 #include <string>
 #include <vector>
+#include <memory>
+#include <mutex>
+#include <future>
+#include <chrono>
+#include <unordered_map>
 #include <curl/curl.h>
 
 #include "ktrade.hpp"
+#include "klevel.hpp"
+#include "kcandle.hpp"
+#include "kinput.hpp"
+#include "kcache.hpp"
+#include "kmetrics.hpp"
+#include "kretry.hpp"
+#include "ksigner.hpp"
+#include "ktransport.hpp"
+#include "kmetadata.hpp"
+#include "kregistry.hpp"
 
 //------------------------------------------------------------------------------
 
 namespace Kraken {
 
 //------------------------------------------------------------------------------
-// helper type to make requests
-typedef std::map<std::string,std::string> KInput;
+// a public request of a batch (see KClient::public_methods())
+struct KRequest {
+   std::string method;
+   KInput input;
+};
 
 //------------------------------------------------------------------------------
 
@@ -38,6 +55,52 @@ public:
    std::string public_method(const std::string& method,
 			     const KInput& input) const;
 
+   // shares responses of public methods with other KClients (see
+   // KCache), 0 to stop
+   void set_cache(const std::shared_ptr<KCache>& cache) { cache_ = cache; }
+
+   // records the timings of every request in 'metrics' (see KMetrics),
+   // 0 to stop
+   void set_metrics(const std::shared_ptr<KMetrics>& metrics)
+   {
+      metrics_ = metrics;
+      endpoints_.clear();
+   }
+
+   // retries, deadlines and hedging of public methods (see KRetryPolicy)
+   void set_retry(const KRetryPolicy& policy) { retry_ = policy; }
+
+   // takes a token from 'limiter' before every public request (retries
+   // and hedges included), 0 to stop
+   void set_rate_limiter(const std::shared_ptr<KRateLimiter>& limiter) { limiter_ = limiter; }
+
+   // sends every request through 'transport' (see KTransport) rather
+   // than the client's own curl handles, 0 to go back; batches are then
+   // sent one after the other and attempts aren't hedged. The transport
+   // takes the client's curl options (see KTransport::configure())
+   void set_transport(const std::shared_ptr<KTransport>& transport);
+
+   // makes public methods concurrently, over one HTTP/2 connection when
+   // set_http2() is on (as many connections as requests otherwise), each
+   // once the rate limiter has a token for it; responses are in the
+   // order of the requests. Requests that fail for a reason worth a
+   // retry are sent again one by one as the retry policy says, and any
+   // failure left throws once all of them are over. The cache isn't used.
+   void public_methods(const std::vector<KRequest>& requests,
+		       std::vector<std::string>& responses);
+
+   // asks for HTTP/2 (negotiated with ALPN on https://, assumed on
+   // http://) or, when false, for HTTP/1.1; curl's default otherwise
+   void set_http2(bool on);
+
+   // asks for compressed responses (every encoding curl supports: gzip,
+   // deflate, br, zstd), decoded as they arrive
+   void set_compression(bool on);
+
+   // verifies servers against the CA certificates in 'path' (PEM)
+   // rather than the system's
+   void set_ca_file(const std::string& path);
+
    // makes private method to kraken.com
    std::string private_method(const std::string& method,
 			      const KInput& input) const;
@@ -46,9 +109,44 @@ public:
    std::string trades(const std::string& pair, const std::string& since,
 		      std::vector<KTrade>& output);
 
+   std::string trades(KPairId pair, const std::string& since,
+		      std::vector<KTrade>& output);
+
+   // downloads candles of 'interval' minutes (see ohlc_interval())
+   // newer than 'since' and appends them to 'output' (the last one it
+   // has is replaced when it comes again); returns the "last" to pass
+   // as 'since' next time
+   std::string ohlc(const std::string& pair, int interval,
+		    const std::string& since, KCandles& output);
+
+   std::string ohlc(KPairId pair, int interval, const std::string& since,
+		    KCandles& output);
+
+   // downloads the order book ('count' levels per side, 0 = all)
+   void depth(const std::string& pair, int count,
+	      std::vector<KLevel>& asks, std::vector<KLevel>& bids);
+
+   void depth(KPairId pair, int count,
+	      std::vector<KLevel>& asks, std::vector<KLevel>& bids);
+
+   // downloads the asset and pair catalog (Assets and AssetPairs)
+   void fetch_metadata(KMetadata& output);
+
+   // maps the catalog cached in 'path' and, unless it is younger than
+   // 'max_age', refreshes it in the background and rewrites the file;
+   // both are installed in KRegistry::global(). Returns false if there
+   // was no usable cache (metadata() is empty until the refresh is over)
+   bool load_metadata(const std::string& path,
+		      std::chrono::seconds max_age = std::chrono::hours(1));
+
+   // the current catalog, never null
+   std::shared_ptr<const KMetadata> metadata() const;
+
+   // waits for the background refresh, rethrows its error
+   void wait_metadata();
+
    // TODO: public market data
    // void time();
-   // void assets();
    // ...
 
 
@@ -56,23 +154,97 @@ private:
    // init CURL and other stuffs
    void init();
 
-   // TODO: gather common commands from public_method and 
-   // private_method in a single method: curl_perfom
+   // sets the options every handle has
+   void setup(CURL* curl) const;
+
+   // setup() of every handle, and the transport's options, after an
+   // option changed
+   void setup_all();
+
+   // the multi handle, created on first use
+   CURLM* multi() const;
+
+   // sends postdata_ to a public method, through the cache if any
+   std::string public_query(const std::string& method) const;
+
+   // start postdata_ with the encoded pair; the one of an interned pair
+   // is encoded once and kept by ID
+   void begin_pair_query(const std::string& pair) const;
+   void begin_pair_query(KPairId pair);
+
+   // the rest of trades(), ohlc() and depth() once postdata_ has the pair
+   std::string trades_query(const std::string& since,
+			    std::vector<KTrade>& output);
+   std::string ohlc_query(int interval, const std::string& since,
+			  KCandles& output);
+   void depth_query(int count,
+		    std::vector<KLevel>& asks, std::vector<KLevel>& bids);
+
+   // sends a public request to kraken.com, as the retry policy says
+   std::string public_request(const std::string& method,
+			      const std::string& postdata) const;
 
-   // create signature for private requests
-   std::string signature(const std::string& path,
-			 const std::string& nonce,
-			 const std::string& postdata) const;
+   // one attempt of a public request, without and with a hedge;
+   // 'timeout_ms' 0 is none
+   CURLcode send_public(const std::string& method, const std::string& url,
+			const std::string& postdata, long timeout_ms,
+			std::string& response, long& status) const;
 
-   // CURL writefunction callback
-   static size_t write_cb(char* ptr, size_t size, 
-			  size_t nmemb, void* userdata);
+   CURLcode send_hedged(const std::string& method, const std::string& url,
+			const std::string& postdata, long timeout_ms,
+			std::string& response, long& status) const;
+
+   // how long an attempt of 'method' runs before it is hedged
+   std::chrono::milliseconds hedge_delay(const std::string& method) const;
+
+   // the histograms of 'method' in metrics_, resolved once per method
+   KMetrics::Endpoint& endpoint(const std::string& method) const;
+
+   // records the timings of the last request of 'curl', if metrics are on
+   void record_request(const std::string& method, CURL* curl) const;
+
+   // records an exchange made through transport_, if metrics are on
+   void record_exchange(const std::string& method, const KHttpRequest& request,
+			const KHttpResponse& response) const;
+
+   // records 'times' and the body sizes of a request
+   void record_times(const std::string& method, const KHttpTimes& times,
+		     uint64_t in, uint64_t out) const;
+
+   // records the time since 'start' as the PARSE phase of 'method'
+   void record_parse(const std::string& method,
+		     std::chrono::steady_clock::time_point start) const;
 
    std::string key_;     // API key
-   std::string secret_;  // API secret
+   KSigner signer_;      // of private requests
    std::string url_;     // API base URL
    std::string version_; // API version
    CURL*  curl_;         // CURL handle
+   mutable CURLM* multi_;  // batches and hedges (created on first use)
+   mutable CURL* hedge_;   // duplicates of hedged requests (the same)
+   std::vector<CURL*> batch_;  // handles of batches, kept for reuse
+   KCurlOptions options_;  // of every handle, and of transport_
+   std::shared_ptr<KCache> cache_; // public responses (optional)
+   std::shared_ptr<KMetrics> metrics_; // request timings (optional)
+   mutable std::unordered_map<std::string, KMetrics::Endpoint*> endpoints_; // of metrics_
+   KRetryPolicy retry_;                // of public methods
+   std::shared_ptr<KRateLimiter> limiter_; // of public methods (optional)
+   std::shared_ptr<KTransport> transport_; // instead of curl_ (optional)
+   mutable std::string postdata_;  // reused by every request
+
+   // the encoded pair parameter of interned pairs, and the registry
+   // entry it was encoded from (a pair interned by an alias is renamed
+   // when the catalog comes)
+   struct PairQuery {
+      const KPairEntry* entry;
+      std::string query;
+      PairQuery() :entry(0) { }
+   };
+   KPairTable<PairQuery> pair_queries_;
+
+   mutable std::mutex metadata_mutex_;
+   std::shared_ptr<const KMetadata> metadata_; // asset and pair catalog
+   std::future<void> refresh_;                 // background refresh
 
    // disallow copying
    KClient(const KClient&);
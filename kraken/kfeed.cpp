@@ -0,0 +1,218 @@
+#include <stdexcept>
+#include <utility>
+#include <chrono>
+#include <algorithm>
+
+#include "kfeed.hpp"
+#include "kwebsocket.hpp"
+#include "kwriter.hpp"
+
+//------------------------------------------------------------------------------
+
+namespace Kraken {
+
+//------------------------------------------------------------------------------
+// milliseconds the reader waits for a message before it looks for new
+// subscriptions to send and checks whether it has been stopped:
+static const int POLL_MS = 100;
+
+// longest wait between two reconnection attempts, in seconds
+static const int MAX_BACKOFF = 30;
+
+//------------------------------------------------------------------------------
+
+KFeed::KFeed(const std::string& url)
+   :url_(url), running_(false)
+{
+}
+
+//------------------------------------------------------------------------------
+
+KFeed::~KFeed()
+{
+   stop();
+}
+
+//------------------------------------------------------------------------------
+
+void KFeed::subscribe_trades(const std::vector<std::string>& pairs)
+{
+   subscribe(pairs, "trade", 0, 0);
+}
+
+void KFeed::subscribe_book(const std::vector<std::string>& pairs, int depth)
+{
+   subscribe(pairs, "book", "depth", depth);
+}
+
+void KFeed::subscribe_ticker(const std::vector<std::string>& pairs)
+{
+   subscribe(pairs, "ticker", 0, 0);
+}
+
+void KFeed::subscribe_spread(const std::vector<std::string>& pairs)
+{
+   subscribe(pairs, "spread", 0, 0);
+}
+
+void KFeed::subscribe_ohlc(const std::vector<std::string>& pairs, int interval)
+{
+   subscribe(pairs, "ohlc", "interval", interval);
+}
+
+//------------------------------------------------------------------------------
+// builds {"event":"subscribe","pair":[...],"subscription":{"name":...}}:
+void KFeed::subscribe(const std::vector<std::string>& pairs,
+		      const std::string& name, const char* option, int value)
+{
+   std::string msg;
+   KWriter w(msg);
+   w.begin_object().key("event").value("subscribe").key("pair").begin_array();
+   for (size_t i = 0; i < pairs.size(); ++i)
+      w.value(pairs[i]);
+   w.end_array().key("subscription").begin_object().key("name").value(name);
+   if (option)
+      w.key(option).value(value);
+   w.end_object().end_object();
+
+   std::lock_guard<std::mutex> lock(mutex_);
+   subs_.push_back(msg);
+   outbox_.push_back(msg);
+}
+
+//------------------------------------------------------------------------------
+
+void KFeed::start()
+{
+   if (running_)
+      throw std::runtime_error("KFeed is already running");
+
+   running_ = true;
+   reader_ = std::thread(&KFeed::run, this);
+}
+
+//------------------------------------------------------------------------------
+
+void KFeed::stop()
+{
+   running_ = false;
+   if (reader_.joinable())
+      reader_.join();
+}
+
+//------------------------------------------------------------------------------
+// connects, sends the subscriptions and dispatches messages until
+// stop(), reconnecting with an exponential backoff:
+void KFeed::run()
+{
+   KWebSocket ws;
+   int backoff = 1;
+
+   while (running_) {
+      try {
+	 ws.connect(url_);
+	 backoff = 1;
+
+	 // a new connection has no subscriptions yet
+	 {
+	    std::lock_guard<std::mutex> lock(mutex_);
+	    outbox_ = subs_;
+	 }
+
+	 std::string msg;
+	 while (running_) {
+	    std::vector<std::string> out;
+	    {
+	       std::lock_guard<std::mutex> lock(mutex_);
+	       out.swap(outbox_);
+	    }
+	    for (size_t i = 0; i < out.size(); ++i)
+	       ws.send_text(out[i]);
+
+	    if (!ws.receive(msg, POLL_MS))
+	       continue;
+
+	    // a message we can't handle mustn't drop the connection
+	    try {
+	       dispatch(msg);
+	    }
+	    catch (std::exception& e) {
+	       error(std::string("can't handle message: ") + e.what());
+	    }
+	 }
+      }
+      catch (std::exception& e) {
+	 error(e.what());
+      }
+      ws.close();
+
+      // wait before reconnecting, still reacting to stop()
+      for (int i = 0; running_ && i < backoff * 1000 / POLL_MS; ++i)
+	 std::this_thread::sleep_for(std::chrono::milliseconds(POLL_MS));
+      backoff = std::min(backoff * 2, MAX_BACKOFF);
+   }
+}
+
+//------------------------------------------------------------------------------
+// events are objects, channel data are arrays ending with channel name
+// and pair:
+void KFeed::dispatch(const std::string& msg)
+{
+   JSONNode root = libjson::parse(libjson::to_json_string(msg));
+
+   if (root.type() == JSON_NODE) {
+      JSONNode::const_iterator it = root.find("event");
+      if (it == root.end())
+	 return;
+
+      std::string event = libjson::to_std_string(it->as_string());
+      bool failed = (event == "error");
+      if (event == "subscriptionStatus") {
+	 JSONNode::const_iterator status = root.find("status");
+	 failed = (status != root.end() && status->as_string() == "error");
+      }
+
+      if (failed) {
+	 JSONNode::const_iterator what = root.find("errorMessage");
+	 error("Kraken feed error: " + ((what != root.end())
+	       ? libjson::to_std_string(what->as_string()) : msg));
+      }
+
+      // heartbeat, systemStatus, pong and successful subscriptions
+      return;
+   }
+
+   if (root.type() != JSON_ARRAY || root.size() < 4)
+      return;
+
+   json_index_t n = root.size();
+   std::string channel = libjson::to_std_string(root[n - 2].as_string());
+   std::string pair = libjson::to_std_string(root[n - 1].as_string());
+
+   if (channel == "trade" && trade_handler_) {
+      // same rows as the REST Trades method, see KClient::trades()
+      JSONNode& rows = root[1];
+      std::vector<KTrade> trades;
+      trades.reserve(rows.size());
+      for (JSONNode::iterator it = rows.begin(); it != rows.end(); ++it) {
+	 JSONNode row(std::move(*it));
+	 trades.push_back(KTrade(row));
+      }
+      trade_handler_(pair, trades);
+   }
+   else if (data_handler_) {
+      data_handler_(channel, pair, root);
+   }
+}
+
+//------------------------------------------------------------------------------
+
+void KFeed::error(const std::string& what)
+{
+   if (error_handler_)
+      error_handler_(what);
+}
+
+//------------------------------------------------------------------------------
+
+}; // namespace Kraken
@@ -0,0 +1,102 @@
+#ifndef _KRAKEN_KFEED_HPP_
+#define _KRAKEN_KFEED_HPP_
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <atomic>
+
+#include "ktrade.hpp"
+#include "../libjson/libjson.h"
+
+//------------------------------------------------------------------------------
+
+namespace Kraken {
+
+//------------------------------------------------------------------------------
+// streams Kraken's public WebSocket feed (trade, book, ticker, ohlc and
+// spread channels). A single reader thread owns the connection, sends
+// the subscriptions and calls the handlers; after a disconnection it
+// reconnects and subscribes again on its own.
+//
+// Pairs are WebSocket names (e.g. "XBT/EUR"), not REST names (XXBTZEUR).
+// Handlers run on the reader thread and must be set before start().
+class KFeed {
+public:
+
+   // trades of one message, decoded
+   typedef std::function<void(const std::string& pair,
+			      const std::vector<KTrade>& trades)> TradeHandler;
+
+   // any other channel message: [channelID, payload..., channelName, pair]
+   typedef std::function<void(const std::string& channel,
+			      const std::string& pair,
+			      const JSONNode& message)> DataHandler;
+
+   // connection failures and subscription errors (dropped without a
+   // handler), the feed keeps going
+   typedef std::function<void(const std::string& error)> ErrorHandler;
+
+   // the public feed by default, e.g. "ws://127.0.0.1:8765" for a local one
+   explicit KFeed(const std::string& url = "wss://ws.kraken.com");
+
+   // stops the reader thread
+   ~KFeed();
+
+   void on_trades(const TradeHandler& handler) { trade_handler_ = handler; }
+   void on_data(const DataHandler& handler)    { data_handler_ = handler; }
+   void on_error(const ErrorHandler& handler)  { error_handler_ = handler; }
+
+   // subscriptions can be added before or after start()
+   void subscribe_trades(const std::vector<std::string>& pairs);
+   void subscribe_book(const std::vector<std::string>& pairs, int depth = 10);
+   void subscribe_ticker(const std::vector<std::string>& pairs);
+   void subscribe_spread(const std::vector<std::string>& pairs);
+   void subscribe_ohlc(const std::vector<std::string>& pairs, int interval = 1);
+
+   // starts the reader thread
+   void start();
+
+   // stops the reader thread and closes the connection
+   void stop();
+
+private:
+   // queues a subscribe message and remembers it for reconnections
+   void subscribe(const std::vector<std::string>& pairs,
+		  const std::string& name, const char* option, int value);
+
+   // body of the reader thread
+   void run();
+
+   // decodes one message and calls the handlers
+   void dispatch(const std::string& msg);
+
+   // reports an error to the error handler
+   void error(const std::string& what);
+
+   std::string url_;
+   TradeHandler trade_handler_;
+   DataHandler data_handler_;
+   ErrorHandler error_handler_;
+
+   std::mutex mutex_;                 // guards the two below
+   std::vector<std::string> subs_;    // every subscribe message so far
+   std::vector<std::string> outbox_;  // messages not sent yet
+
+   std::atomic<bool> running_;
+   std::thread reader_;
+
+   // disallow copying
+   KFeed(const KFeed&);
+   KFeed& operator=(const KFeed&);
+};
+
+//------------------------------------------------------------------------------
+
+}; // namespace Kraken
+
+//------------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,480 @@
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <atomic>
+#include <cstdint>
+#include "kindicator.hpp"
+
+//------------------------------------------------------------------------------
+
+namespace Kraken {
+
+//------------------------------------------------------------------------------
+// throws unless 'period' is positive:
+static size_t check_period(const char* name, size_t period)
+{
+   if (period == 0)
+      throw std::runtime_error(std::string(name) + ": period must be positive");
+   return period;
+}
+
+//------------------------------------------------------------------------------
+
+KCandle KHeikinAshi::update(const KCandle& c)
+{
+   KCandle ha;
+   ha.time = c.time;
+   ha.volume = c.volume;
+   ha.close = (c.open + c.close + c.low + c.high) / 4;
+   ha.open = started_ ? (open_ + close_) / 2 : (c.open + c.close) / 2;
+   ha.low = std::min(c.low, std::min(ha.open, ha.close));
+   ha.high = std::max(c.high, std::max(ha.open, ha.close));
+
+   started_ = true;
+   open_ = ha.open;
+   close_ = ha.close;
+   return ha;
+}
+
+//------------------------------------------------------------------------------
+
+KSma::KSma(size_t period)
+   :ring_(check_period("sma", period)), next_(0), count_(0), sum_(0)
+{ }
+
+//------------------------------------------------------------------------------
+// the running sum is summed again from the ring at every turn, so that
+// rounding errors don't pile up over long series:
+double KSma::update(double x)
+{
+   if (count_ >= ring_.size())
+      sum_ -= ring_[next_];
+   ring_[next_] = x;
+   sum_ += x;
+   ++count_;
+
+   if (++next_ == ring_.size()) {
+      next_ = 0;
+      sum_ = 0;
+      for (size_t i = 0; i < ring_.size(); ++i)
+	 sum_ += ring_[i];
+   }
+   return value();
+}
+
+//------------------------------------------------------------------------------
+
+KEma::KEma(size_t period)
+   :period_(check_period("ema", period)), alpha_(2.0 / (period + 1)),
+    count_(0), ema_(0)
+{ }
+
+//------------------------------------------------------------------------------
+
+double KEma::update(double x)
+{
+   if (count_ < period_) {
+      ema_ += x;
+      if (++count_ == period_)
+	 ema_ /= period_;
+   }
+   else
+      ema_ += alpha_ * (x - ema_);
+   return value();
+}
+
+//------------------------------------------------------------------------------
+
+KRsi::KRsi(size_t period)
+   :period_(check_period("rsi", period)), count_(0), prior_(0),
+    gain_(0), loss_(0)
+{ }
+
+//------------------------------------------------------------------------------
+// the first averages are simple ones over 'period' changes:
+double KRsi::update(double x)
+{
+   if (count_ > 0) {
+      double change = x - prior_;
+      double gain = change > 0 ? change : 0;
+      double loss = change < 0 ? -change : 0;
+
+      if (count_ <= period_) {
+	 gain_ += gain;
+	 loss_ += loss;
+	 if (count_ == period_) {
+	    gain_ /= period_;
+	    loss_ /= period_;
+	 }
+      }
+      else {
+	 gain_ = (gain_ * (period_ - 1) + gain) / period_;
+	 loss_ = (loss_ * (period_ - 1) + loss) / period_;
+      }
+   }
+
+   prior_ = x;
+   ++count_;
+   return value();
+}
+
+//------------------------------------------------------------------------------
+// 100 - 100 / (1 + gain/loss), 50 when prices didn't move:
+double KRsi::value() const
+{
+   if (!ready())
+      return knan();
+   if (gain_ + loss_ == 0)
+      return 50;
+   return 100 * gain_ / (gain_ + loss_);
+}
+
+//------------------------------------------------------------------------------
+
+KAtr::KAtr(size_t period)
+   :period_(check_period("atr", period)), count_(0), prior_close_(0), atr_(0)
+{ }
+
+//------------------------------------------------------------------------------
+// the true range of the first candle is its range:
+double KAtr::update(const KCandle& c)
+{
+   double range = c.high - c.low;
+   if (count_ > 0)
+      range = std::max(range, std::max(std::fabs(c.high - prior_close_),
+				       std::fabs(c.low - prior_close_)));
+   prior_close_ = c.close;
+
+   if (count_ < period_) {
+      atr_ += range;
+      if (++count_ == period_)
+	 atr_ /= period_;
+   }
+   else
+      atr_ = (atr_ * (period_ - 1) + range) / period_;
+   return value();
+}
+
+//------------------------------------------------------------------------------
+
+KVwap::KVwap(size_t period)
+   :pv_ring_(period), volume_ring_(period), next_(0), count_(0),
+    pv_(0), volume_(0)
+{ }
+
+//------------------------------------------------------------------------------
+// as KSma, the sums are summed again from the rings at every turn:
+double KVwap::update(const KCandle& c)
+{
+   double pv = (c.high + c.low + c.close) / 3 * c.volume;
+
+   if (pv_ring_.empty()) {
+      pv_ += pv;
+      volume_ += c.volume;
+      return value();
+   }
+
+   if (count_ >= pv_ring_.size()) {
+      pv_ -= pv_ring_[next_];
+      volume_ -= volume_ring_[next_];
+   }
+   pv_ring_[next_] = pv;
+   volume_ring_[next_] = c.volume;
+   pv_ += pv;
+   volume_ += c.volume;
+   ++count_;
+
+   if (++next_ == pv_ring_.size()) {
+      next_ = 0;
+      pv_ = volume_ = 0;
+      for (size_t i = 0; i < pv_ring_.size(); ++i) {
+	 pv_ += pv_ring_[i];
+	 volume_ += volume_ring_[i];
+      }
+   }
+   return value();
+}
+
+//------------------------------------------------------------------------------
+
+KBollinger::KBollinger(size_t period, double k)
+   :ring_(check_period("bollinger", period)), k_(k), next_(0), count_(0),
+    mean_(0), m2_(0)
+{ }
+
+//------------------------------------------------------------------------------
+// Welford's updates, adding an input while the ring fills and replacing
+// the oldest one after; mean and squares are computed again from the
+// ring at every turn:
+KBand KBollinger::update(double x)
+{
+   size_t n = ring_.size();
+
+   if (count_ < n) {
+      double delta = x - mean_;
+      mean_ += delta / (count_ + 1);
+      m2_ += delta * (x - mean_);
+   }
+   else {
+      double old = ring_[next_];
+      double mean = mean_ + (x - old) / n;
+      m2_ += (x - old) * (x - mean + old - mean_);
+      mean_ = mean;
+   }
+   ring_[next_] = x;
+   ++count_;
+
+   if (++next_ == n) {
+      next_ = 0;
+      mean_ = 0;
+      for (size_t i = 0; i < n; ++i)
+	 mean_ += ring_[i];
+      mean_ /= n;
+      m2_ = 0;
+      for (size_t i = 0; i < n; ++i)
+	 m2_ += (ring_[i] - mean_) * (ring_[i] - mean_);
+   }
+   return value();
+}
+
+//------------------------------------------------------------------------------
+
+KBand KBollinger::value() const
+{
+   KBand band;
+   if (!ready()) {
+      band.lower = band.middle = band.upper = knan();
+      return band;
+   }
+
+   double sd = std::sqrt(std::max(m2_, 0.0) / ring_.size());
+   band.middle = mean_;
+   band.lower = mean_ - k_ * sd;
+   band.upper = mean_ + k_ * sd;
+   return band;
+}
+
+//------------------------------------------------------------------------------
+
+void heikin_ashi(const KCandles& in, KCandles& out)
+{
+   if (&in == &out) {
+      KCandles copy(in);
+      heikin_ashi(copy, out);
+      return;
+   }
+
+   size_t n = in.size();
+   out.time = in.time;
+   out.volume = in.volume;
+   out.vwap.assign(n, 0);
+   out.count.assign(n, 0);
+   out.open.resize(n);
+   out.high.resize(n);
+   out.low.resize(n);
+   out.close.resize(n);
+
+   const double* o = in.open.data();
+   const double* h = in.high.data();
+   const double* l = in.low.data();
+   const double* c = in.close.data();
+   double* ha_open = out.open.data();
+   double* ha_high = out.high.data();
+   double* ha_low = out.low.data();
+   double* ha_close = out.close.data();
+
+   for (size_t i = 0; i < n; ++i)
+      ha_close[i] = (o[i] + c[i] + l[i] + h[i]) / 4;
+
+   if (n > 0)
+      ha_open[0] = (o[0] + c[0]) / 2;
+   for (size_t i = 1; i < n; ++i)
+      ha_open[i] = (ha_open[i - 1] + ha_close[i - 1]) / 2;
+
+   for (size_t i = 0; i < n; ++i) {
+      double top = ha_open[i] > ha_close[i] ? ha_open[i] : ha_close[i];
+      double bottom = ha_open[i] < ha_close[i] ? ha_open[i] : ha_close[i];
+      ha_high[i] = h[i] > top ? h[i] : top;
+      ha_low[i] = l[i] < bottom ? l[i] : bottom;
+   }
+}
+
+//------------------------------------------------------------------------------
+// pieces of a series a thread runs interleaved:
+static const size_t HA_LANES = 4;
+
+// the least candles worth a thread of their own:
+static const size_t HA_MIN_THREAD = 1 << 16;
+
+//------------------------------------------------------------------------------
+// the threads to use for 'n' candles, at most 'threads' (0 for one per
+// core):
+static size_t ha_threads(size_t n, unsigned threads)
+{
+   size_t t = threads ? threads : std::thread::hardware_concurrency();
+   return std::max(size_t(1), std::min(t, n / HA_MIN_THREAD));
+}
+
+//------------------------------------------------------------------------------
+// runs fn(0) ... fn(count - 1), all but the first on their own thread
+// (on this one when no more threads can be started):
+template <class Function>
+static void for_each_thread(size_t count, Function fn)
+{
+   std::vector<std::thread> workers;
+   size_t spawned = 1;
+   try {
+      workers.reserve(count);
+      for (; spawned < count; ++spawned)
+	 workers.push_back(std::thread(fn, spawned));
+   }
+   catch (std::system_error&) { }
+
+   for (size_t i = spawned; i < count; ++i)
+      fn(i);
+   fn(0);
+   for (size_t i = 0; i < workers.size(); ++i)
+      workers[i].join();
+}
+
+//------------------------------------------------------------------------------
+// the columns of a Heikin-Ashi in the making:
+struct HaColumns {
+   HaColumns(const KCandles& in, KCandles& out)
+      :o(in.open.data()), h(in.high.data()), l(in.low.data()),
+       c(in.close.data()), ha_open(out.open.data()),
+       ha_high(out.high.data()), ha_low(out.low.data()),
+       ha_close(out.close.data()) { }
+
+   // the HA close of candle i:
+   double close(size_t i) const { return (o[i] + c[i] + l[i] + h[i]) / 4; }
+
+   // HA candle i, 'x' its open; 'x' becomes the open of candle i + 1
+   void step(size_t i, double& x) const
+   {
+      double close_i = close(i);
+      double top = x > close_i ? x : close_i;
+      double bottom = x < close_i ? x : close_i;
+      ha_open[i] = x;
+      ha_close[i] = close_i;
+      ha_high[i] = h[i] > top ? h[i] : top;
+      ha_low[i] = l[i] < bottom ? l[i] : bottom;
+      x = (x + close_i) / 2;
+   }
+
+   const double *o, *h, *l, *c;
+   double *ha_open, *ha_high, *ha_low, *ha_close;
+};
+
+//------------------------------------------------------------------------------
+// runs the pieces [start[k], start[k + 1]) for k < HA_LANES side by side,
+// 'first' their first opens, and copies the columns kept as they are:
+static void ha_pieces(const KCandles& in, KCandles& out, const size_t* start,
+		      const double* first)
+{
+   HaColumns columns(in, out);
+   double x[HA_LANES];
+   size_t common = SIZE_MAX;
+
+   for (size_t k = 0; k < HA_LANES; ++k) {
+      x[k] = first[k];
+      common = std::min(common, start[k + 1] - start[k]);
+   }
+
+   for (size_t j = 0; j < common; ++j)
+      for (size_t k = 0; k < HA_LANES; ++k)
+	 columns.step(start[k] + j, x[k]);
+
+   for (size_t k = 0; k < HA_LANES; ++k)
+      for (size_t i = start[k] + common; i < start[k + 1]; ++i)
+	 columns.step(i, x[k]);
+
+   size_t from = start[0], to = start[HA_LANES];
+   std::copy(in.time.begin() + from, in.time.begin() + to,
+	     out.time.begin() + from);
+   std::copy(in.volume.begin() + from, in.volume.begin() + to,
+	     out.volume.begin() + from);
+   std::fill(out.vwap.begin() + from, out.vwap.begin() + to, 0.0);
+   std::fill(out.count.begin() + from, out.count.begin() + to, 0);
+}
+
+//------------------------------------------------------------------------------
+// a single pass: the open at the start of each piece comes from the one
+// of the piece before, over the whole piece between them or its last
+// HA_HORIZON steps, then the threads run their pieces:
+void heikin_ashi(const KCandles& in, KCandles& out, unsigned threads)
+{
+   if (&in == &out) {
+      KCandles copy(in);
+      heikin_ashi(copy, out, threads);
+      return;
+   }
+
+   size_t n = in.size();
+   out.time.resize(n);
+   out.open.resize(n);
+   out.high.resize(n);
+   out.low.resize(n);
+   out.close.resize(n);
+   out.vwap.resize(n);
+   out.volume.resize(n);
+   out.count.resize(n);
+   if (n == 0)
+      return;
+
+   size_t t = ha_threads(n, threads), pieces = t * HA_LANES;
+   std::vector<size_t> start(pieces + 1);
+   for (size_t p = 0; p <= pieces; ++p)
+      start[p] = n * p / pieces;
+
+   HaColumns columns(in, out);
+   std::vector<double> first(pieces);
+   first[0] = (in.open[0] + in.close[0]) / 2;
+   for (size_t p = 1; p < pieces; ++p) {
+      size_t from = start[p - 1], to = start[p];
+      double x = first[p - 1];
+      for (size_t i = to - from > HA_HORIZON ? to - HA_HORIZON : from;
+	   i < to; ++i)
+	 x = (x + columns.close(i)) / 2;
+      first[p] = x;
+   }
+
+   for_each_thread(t, [&](size_t k) {
+	 ha_pieces(in, out, &start[k * HA_LANES], &first[k * HA_LANES]);
+      });
+}
+
+//------------------------------------------------------------------------------
+// the threads take the next pair left until none is:
+void heikin_ashi(const std::vector<KCandles>& in, std::vector<KCandles>& out,
+		 unsigned threads)
+{
+   if (&in == &out) {
+      std::vector<KCandles> copy(in);
+      heikin_ashi(copy, out, threads);
+      return;
+   }
+
+   out.resize(in.size());
+   size_t t = threads ? threads : std::thread::hardware_concurrency();
+   if (t == 0)
+      t = 1;
+
+   if (in.size() < t) {
+      for (size_t i = 0; i < in.size(); ++i)
+	 heikin_ashi(in[i], out[i], unsigned(t));
+      return;
+   }
+
+   std::atomic<size_t> next(0);
+   for_each_thread(t, [&](size_t) {
+	 for (size_t i; (i = next++) < in.size(); )
+	    heikin_ashi(in[i], out[i], 1);
+      });
+}
+
+//------------------------------------------------------------------------------
+
+}; // namespace Kraken
@@ -0,0 +1,326 @@
+#ifndef _KRAKEN_KINDICATOR_HPP_
+#define _KRAKEN_KINDICATOR_HPP_
+
+#include <vector>
+#include <limits>
+#include <functional>
+#include <stdexcept>
+#include <cstddef>
+
+#include "kcandle.hpp"
+
+//------------------------------------------------------------------------------
+
+namespace Kraken {
+
+//------------------------------------------------------------------------------
+// streaming indicators: each operator takes one input at a time (a
+// price or a candle, oldest first) with update(), in O(1) and with
+// memory bounded by its period, and returns its output for that input.
+// Outputs are NaN until an operator has seen enough input (ready()).
+//
+// Operators on prices also take candles, of which they use the close,
+// so they can follow KHeikinAshi or any operator giving candles; see
+// KCompose. apply() runs an operator over a whole series.
+
+//------------------------------------------------------------------------------
+// what operators return before they are ready:
+inline double knan() { return std::numeric_limits<double>::quiet_NaN(); }
+
+//------------------------------------------------------------------------------
+// Heikin-Ashi candles: close is the mean of open, high, low and close,
+// open the mean of the previous HA open and close (of the candle's own
+// open and close for the first one), high and low extended to them:
+class KHeikinAshi {
+public:
+   typedef KCandle Output;
+
+   KHeikinAshi() :started_(false), open_(0), close_(0) { }
+
+   KCandle update(const KCandle& c);
+
+   bool ready() const { return started_; }
+
+private:
+   bool started_;
+   double open_, close_;   // of the last HA candle
+};
+
+//------------------------------------------------------------------------------
+// simple moving average:
+class KSma {
+public:
+   typedef double Output;
+
+   explicit KSma(size_t period);
+
+   double update(double x);
+   double update(const KCandle& c) { return update(c.close); }
+
+   bool ready() const { return count_ >= ring_.size(); }
+   double value() const { return ready() ? sum_ / ring_.size() : knan(); }
+
+private:
+   std::vector<double> ring_;   // the last 'period' inputs
+   size_t next_;
+   size_t count_;
+   double sum_;
+};
+
+//------------------------------------------------------------------------------
+// exponential moving average, alpha = 2 / (period + 1), starting from the
+// simple average of the first 'period' inputs:
+class KEma {
+public:
+   typedef double Output;
+
+   explicit KEma(size_t period);
+
+   double update(double x);
+   double update(const KCandle& c) { return update(c.close); }
+
+   bool ready() const { return count_ >= period_; }
+   double value() const { return ready() ? ema_ : knan(); }
+
+private:
+   size_t period_;
+   double alpha_;
+   size_t count_;
+   double ema_;    // the sum of the inputs until ready
+};
+
+//------------------------------------------------------------------------------
+// relative strength index with Wilder's smoothing, 0 to 100:
+class KRsi {
+public:
+   typedef double Output;
+
+   explicit KRsi(size_t period = 14);
+
+   double update(double x);
+   double update(const KCandle& c) { return update(c.close); }
+
+   bool ready() const { return count_ > period_; }
+   double value() const;
+
+private:
+   size_t period_;
+   size_t count_;    // inputs seen
+   double prior_;    // the last input
+   double gain_, loss_;
+};
+
+//------------------------------------------------------------------------------
+// average true range with Wilder's smoothing:
+class KAtr {
+public:
+   typedef double Output;
+
+   explicit KAtr(size_t period = 14);
+
+   double update(const KCandle& c);
+
+   bool ready() const { return count_ >= period_; }
+   double value() const { return ready() ? atr_ : knan(); }
+
+private:
+   size_t period_;
+   size_t count_;
+   double prior_close_;
+   double atr_;      // the sum of true ranges until ready
+};
+
+//------------------------------------------------------------------------------
+// volume weighted average of the typical price, (high + low + close) / 3,
+// since the start or, with a period, over the last 'period' candles:
+class KVwap {
+public:
+   typedef double Output;
+
+   explicit KVwap(size_t period = 0);
+
+   double update(const KCandle& c);
+
+   bool ready() const { return volume_ > 0; }
+   double value() const { return ready() ? pv_ / volume_ : knan(); }
+
+private:
+   std::vector<double> pv_ring_, volume_ring_;  // empty without a period
+   size_t next_;
+   size_t count_;
+   double pv_, volume_;
+};
+
+//------------------------------------------------------------------------------
+// Bollinger bands, the simple average of the last 'period' inputs and 'k'
+// (population) standard deviations around it:
+struct KBand {
+   double lower, middle, upper;
+};
+
+class KBollinger {
+public:
+   typedef KBand Output;
+
+   explicit KBollinger(size_t period = 20, double k = 2);
+
+   KBand update(double x);
+   KBand update(const KCandle& c) { return update(c.close); }
+
+   bool ready() const { return count_ >= ring_.size(); }
+   KBand value() const;
+
+private:
+   std::vector<double> ring_;
+   double k_;
+   size_t next_;
+   size_t count_;
+   double mean_, m2_;   // of the inputs in the ring (Welford)
+};
+
+//------------------------------------------------------------------------------
+// the least (KRollingMin) or greatest (KRollingMax) of the last 'period'
+// inputs, with a monotonic deque: the inputs still able to be the
+// extreme of a later window, in a ring of 'period' entries.
+template <class Compare>
+class KRollingExtreme {
+public:
+   typedef double Output;
+
+   explicit KRollingExtreme(size_t period)
+      :value_(period), index_(period), front_(0), back_(0), size_(0),
+       count_(0)
+   {
+      if (period == 0)
+	 throw std::runtime_error("rolling extreme: period must be positive");
+   }
+
+   double update(double x)
+   {
+      size_t n = value_.size();
+
+      // the front leaves the window
+      if (size_ > 0 && index_[front_] + n <= count_) {
+	 if (++front_ == n) front_ = 0;
+	 --size_;
+      }
+
+      // inputs that x beats can't be the extreme anymore
+      while (size_ > 0) {
+	 size_t last = back_ ? back_ - 1 : n - 1;
+	 if (compare_(value_[last], x))
+	    break;
+	 back_ = last;
+	 --size_;
+      }
+
+      value_[back_] = x;
+      index_[back_] = count_;
+      if (++back_ == n) back_ = 0;
+      ++size_;
+      ++count_;
+      return value();
+   }
+
+   double update(const KCandle& c) { return update(c.close); }
+
+   bool ready() const { return count_ >= value_.size(); }
+   double value() const { return ready() ? value_[front_] : knan(); }
+
+private:
+   std::vector<double> value_;
+   std::vector<size_t> index_;   // input number of each entry
+   size_t front_, back_;   // the deque is [front_, back_) around the ring
+   size_t size_;
+   size_t count_;
+   Compare compare_;
+};
+
+typedef KRollingExtreme<std::less<double> > KRollingMin;
+typedef KRollingExtreme<std::greater<double> > KRollingMax;
+
+//------------------------------------------------------------------------------
+// two operators in a row, the output of the first the input of the
+// second, e.g. KCompose<KHeikinAshi, KEma> for an EMA of HA closes:
+template <class First, class Second>
+class KCompose {
+public:
+   typedef typename Second::Output Output;
+
+   KCompose(const First& first, const Second& second)
+      :first_(first), second_(second) { }
+
+   template <class Input>
+   Output update(const Input& x) { return second_.update(first_.update(x)); }
+
+   bool ready() const { return first_.ready() && second_.ready(); }
+
+   First& first() { return first_; }
+   Second& second() { return second_; }
+
+private:
+   First first_;
+   Second second_;
+};
+
+//------------------------------------------------------------------------------
+// batch mode: runs 'op' over a series, oldest first, appending its
+// outputs to 'out'
+
+template <class Op>
+void apply(Op& op, const std::vector<double>& in,
+	   std::vector<typename Op::Output>& out)
+{
+   out.reserve(out.size() + in.size());
+   for (size_t i = 0; i < in.size(); ++i)
+      out.push_back(op.update(in[i]));
+}
+
+template <class Op>
+void apply(Op& op, const KCandles& in, std::vector<typename Op::Output>& out)
+{
+   out.reserve(out.size() + in.size());
+   for (size_t i = 0; i < in.size(); ++i)
+      out.push_back(op.update(in.row(i)));
+}
+
+//------------------------------------------------------------------------------
+// Heikin-Ashi of a whole series by column: close, high and low are
+// computed a column at a time (loops the compiler vectorizes), only the
+// open is a recurrence. 'out' gets time and volume as they are, vwap
+// and count zeroed.
+void heikin_ashi(const KCandles& in, KCandles& out);
+
+//------------------------------------------------------------------------------
+// parallel Heikin-Ashi: the open recurrence is the affine map
+//
+//   open[i] = open[i-1] / 2 + close[i-1] / 2
+//
+// and affine maps compose (associatively) into x -> x / 2^k + b, so the
+// series is cut into pieces, the open at the start of each piece found
+// by composing the steps before it, and the pieces run at once: a few
+// per thread, interleaved in one loop so that their chains of additions
+// overlap. Past HA_HORIZON steps the x / 2^k term is far under the last
+// bit of any open, so a piece's start takes HA_HORIZON steps from the
+// previous start rather than the whole piece before it. The results
+// match heikin_ashi() within a few ulps.
+
+// the steps composed for the start of a piece
+static const size_t HA_HORIZON = 128;
+
+// heikin_ashi() on 'threads' threads (0 for one per core)
+void heikin_ashi(const KCandles& in, KCandles& out, unsigned threads);
+
+// heikin_ashi() of many series (pairs), out[i] of in[i]: the pairs are
+// shared out among the threads, or each runs on all of them when there
+// are fewer pairs than threads
+void heikin_ashi(const std::vector<KCandles>& in, std::vector<KCandles>& out,
+		 unsigned threads = 0);
+
+//------------------------------------------------------------------------------
+
+}; // namespace Kraken
+
+//------------------------------------------------------------------------------
+
+#endif
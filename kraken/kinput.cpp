@@ -0,0 +1,148 @@
+#include <stdexcept>
+
+#include "kinput.hpp"
+
+//------------------------------------------------------------------------------
+
+namespace Kraken {
+
+//------------------------------------------------------------------------------
+
+const size_t KInput::INLINE_PARAMS;
+
+//------------------------------------------------------------------------------
+// helper table of the characters sent as they are (RFC 3986 unreserved):
+struct Unreserved {
+   bool t[256];
+   Unreserved() {
+      for (int c = 0; c < 256; ++c)
+	 t[c] = (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') ||
+	    (c >= '0' && c <= '9') || c == '-' || c == '.' || c == '_' || c == '~';
+   }
+};
+
+static const Unreserved unreserved;
+
+//------------------------------------------------------------------------------
+// runs of unreserved characters are appended at once:
+void KInput::append_encoded(std::string& out, const std::string& s)
+{
+   static const char hex[] = "0123456789ABCDEF";
+   const char* p = s.data();
+   const char* end = p + s.size();
+
+   while (p < end) {
+      const char* run = p;
+      while (p < end && unreserved.t[(unsigned char)*p]) ++p;
+      out.append(run, p - run);
+      if (p == end) break;
+
+      unsigned char c = (unsigned char)*p++;
+      char esc[3] = { '%', hex[c >> 4], hex[c & 15] };
+      out.append(esc, 3);
+   }
+}
+
+//------------------------------------------------------------------------------
+
+KInput::Param& KInput::add()
+{
+   if (size_ >= INLINE_PARAMS && more_.size() < size_ + 1 - INLINE_PARAMS)
+      more_.resize(size_ + 1 - INLINE_PARAMS);
+   return param(size_++);
+}
+
+//------------------------------------------------------------------------------
+// requests have a handful of parameters, a linear search beats a map:
+const std::string* KInput::find(const std::string& key) const
+{
+   for (size_t i = 0; i < size_; ++i) {
+      const Param& p = param(i);
+      if (p.key == key) return &p.value;
+   }
+   return 0;
+}
+
+//------------------------------------------------------------------------------
+
+std::string& KInput::operator[](const std::string& key)
+{
+   for (size_t i = 0; i < size_; ++i) {
+      Param& p = param(i);
+      if (p.key == key) return p.value;
+   }
+
+   Param& p = add();
+   p.key.assign(key);
+   p.value.clear();
+   return p.value;
+}
+
+//------------------------------------------------------------------------------
+
+const std::string& KInput::at(const std::string& key) const
+{
+   const std::string* v = find(key);
+   if (!v)
+      throw std::out_of_range("KInput: no parameter " + key);
+   return *v;
+}
+
+//------------------------------------------------------------------------------
+
+KInput& KInput::set(const std::string& key, const std::string& value)
+{
+   (*this)[key].assign(value);
+   return *this;
+}
+
+KInput& KInput::set(const std::string& key, const char* value)
+{
+   (*this)[key].assign(value);
+   return *this;
+}
+
+//------------------------------------------------------------------------------
+
+KInput& KInput::set(const std::string& key, long long value)
+{
+   char buf[24];
+   char* end = buf + sizeof(buf);
+   char* p = end;
+   unsigned long long u = value < 0 ? 0ULL - (unsigned long long)value
+      : (unsigned long long)value;
+   do {
+      *--p = char('0' + u % 10);
+      u /= 10;
+   } while (u);
+   if (value < 0) *--p = '-';
+
+   (*this)[key].assign(p, end - p);
+   return *this;
+}
+
+//------------------------------------------------------------------------------
+
+void KInput::append_query(std::string& out) const
+{
+   for (size_t i = 0; i < size_; ++i) {
+      const Param& p = param(i);
+      if (!out.empty()) out += '&';  // delimiter
+      append_encoded(out, p.key);
+      out += '=';
+      append_encoded(out, p.value);
+   }
+}
+
+//------------------------------------------------------------------------------
+
+std::string KInput::query() const
+{
+   std::string out;
+   append_query(out);
+   return out;
+}
+
+//------------------------------------------------------------------------------
+
+}; // namespace Kraken
@@ -0,0 +1,111 @@
+#ifndef _KRAKEN_KINPUT_HPP_
+#define _KRAKEN_KINPUT_HPP_
+
+#include <string>
+#include <vector>
+#include <utility>
+
+//------------------------------------------------------------------------------
+
+namespace Kraken {
+
+//------------------------------------------------------------------------------
+// the parameters of a request, in the order they were set. The first
+// INLINE_PARAMS live inside the object and short keys and values fit in
+// their strings, so a typical request allocates nothing; clear() keeps
+// the storage for the next one.
+//
+// Keys and values are percent-encoded (application/x-www-form-urlencoded)
+// when the query is written, so they are set as plain text.
+class KInput {
+public:
+
+   // parameters stored inline, the others go to the heap
+   static const size_t INLINE_PARAMS = 10;
+
+   KInput() :size_(0) { }
+
+   // sets a parameter, replacing its value if it is already set
+   KInput& set(const std::string& key, const std::string& value);
+   KInput& set(const std::string& key, const char* value);
+   KInput& set(const std::string& key, long long value);
+   KInput& set(const std::string& key, int value) { return set(key, (long long)value); }
+
+   // the value of a parameter, added empty if it isn't set
+   std::string& operator[](const std::string& key);
+
+   // the value of a parameter, std::out_of_range if it isn't set
+   const std::string& at(const std::string& key) const;
+
+   // adds a parameter unless it is already set (as std::map::insert())
+   template <class K, class V>
+   void insert(const std::pair<K, V>& p)
+   {
+      std::string key(p.first);
+      if (!find(key)) set(key, std::string(p.second));
+   }
+
+   // the value of a parameter, 0 if it isn't set
+   const std::string* find(const std::string& key) const;
+
+   bool empty() const { return size_ == 0; }
+   size_t size() const { return size_; }
+
+   // drops the parameters, keeping their storage
+   void clear() { size_ = 0; }
+
+   // appends the encoded query (a=1&b=2...) to 'out', after a '&' if
+   // 'out' isn't empty
+   void append_query(std::string& out) const;
+
+   // the encoded query
+   std::string query() const;
+
+   // appends 's' percent-encoded to 'out'
+   static void append_encoded(std::string& out, const std::string& s);
+
+private:
+   struct Param {
+      std::string key;
+      std::string value;
+   };
+
+   Param& param(size_t i) { return i < INLINE_PARAMS ? inline_[i] : more_[i - INLINE_PARAMS]; }
+   const Param& param(size_t i) const { return i < INLINE_PARAMS ? inline_[i] : more_[i - INLINE_PARAMS]; }
+
+   // the slot of a new parameter
+   Param& add();
+
+   Param inline_[INLINE_PARAMS];
+   std::vector<Param> more_;
+   size_t size_;
+};
+
+//------------------------------------------------------------------------------
+// a query whose fixed parameters (e.g. the pair and order type of an
+// endpoint) are encoded once; requests only encode the variable ones:
+class KInputTemplate {
+public:
+   explicit KInputTemplate(const KInput& fixed) :prefix_(fixed.query()) { }
+
+   // writes the fixed and then the variable parameters to 'out',
+   // reusing its capacity
+   void build(const KInput& vars, std::string& out) const
+   {
+      out.assign(prefix_);
+      vars.append_query(out);
+   }
+
+   const std::string& prefix() const { return prefix_; }
+
+private:
+   std::string prefix_;
+};
+
+//------------------------------------------------------------------------------
+
+}; // namespace Kraken
+
+//------------------------------------------------------------------------------
+
+#endif
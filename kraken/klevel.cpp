@@ -0,0 +1,20 @@
+#include "klevel.hpp"
+
+//------------------------------------------------------------------------------
+
+namespace Kraken { 
+
+//------------------------------------------------------------------------------
+// construct from a JSONNode:
+KLevel::KLevel(const JSONNode& node) 
+{
+   price  = libjson::to_std_string(node[0].as_string());
+   volume = libjson::to_std_string(node[1].as_string());
+
+   // a number in Depth, a string on the feed (JSON_CASTABLE reads both)
+   time = node[2].as_float();
+}
+
+//------------------------------------------------------------------------------
+
+}; // namespace Kraken
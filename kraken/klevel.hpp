@@ -0,0 +1,33 @@
+#ifndef _KRAKEN_KLEVEL_HPP_
+#define _KRAKEN_KLEVEL_HPP_
+
+#include <string>
+#include "../libjson/libjson.h"
+
+//------------------------------------------------------------------------------
+
+namespace Kraken { 
+
+//------------------------------------------------------------------------------
+// deals with a price level of an order book, as returned by the REST
+// Depth method and sent on the book channel of the WebSocket feed:
+struct KLevel {
+
+   // the text Kraken sent, book checksums are computed on it
+   std::string price, volume;
+   double time;
+
+   // default ctor
+   KLevel() :time(0) { }
+
+   // construct from a JSONNode [price, volume, timestamp, ...]
+   KLevel(const JSONNode& node);
+};
+
+//------------------------------------------------------------------------------
+
+}; // namespace Kraken
+
+//------------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,485 @@
+#include <stdexcept>
+#include <sstream>
+#include <algorithm>
+#include <utility>
+#include <map>
+#include <cstring>
+#include <cerrno>
+#include <cstdio>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "kmetadata.hpp"
+
+//------------------------------------------------------------------------------
+
+namespace Kraken {
+
+//------------------------------------------------------------------------------
+// the file starts with a header, followed by the asset records, the pair
+// records and the strings they point to (all NUL terminated, offset 0 is
+// the empty string):
+struct KMetadata::Header {
+   char magic[8];           // "KRAKMETA"
+   uint32_t version;        // FORMAT_VERSION
+   uint32_t byte_order;     // BYTE_ORDER_MARK as written
+   uint32_t header_size;    // sizes of the structs, so a build with
+   uint32_t asset_size;     // another layout rejects the file
+   uint32_t pair_size;
+   uint32_t asset_count;
+   uint32_t pair_count;
+   uint32_t assets_off;
+   uint32_t pairs_off;
+   uint32_t strings_off;
+   uint32_t strings_size;
+   uint32_t reserved;
+   int64_t fetched;         // unix time of the download
+   uint64_t checksum;       // FNV-1a of everything after the header
+};
+
+struct KMetadata::AssetRecord {
+   uint32_t name, altname, aclass;
+   int32_t decimals, display_decimals;
+};
+
+struct KMetadata::PairRecord {
+   uint32_t name, altname, wsname;
+   uint32_t aclass_base, base, aclass_quote, quote;
+   uint32_t lot, fee_volume_currency, ordermin;
+   int32_t base_id, quote_id;
+   int32_t pair_decimals, lot_decimals, lot_multiplier;
+   int32_t margin_call, margin_stop;
+};
+
+//------------------------------------------------------------------------------
+
+const uint32_t KMetadata::FORMAT_VERSION;
+
+static const char MAGIC[8] = { 'K','R','A','K','M','E','T','A' };
+static const uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+//------------------------------------------------------------------------------
+// helper function to hash bytes with 64-bit FNV-1a:
+static uint64_t fnv1a(const char* p, size_t n)
+{
+   uint64_t h = 14695981039346656037ULL;
+   for (size_t i = 0; i < n; ++i) {
+      h ^= (unsigned char)p[i];
+      h *= 1099511628211ULL;
+   }
+   return h;
+}
+
+//------------------------------------------------------------------------------
+// helper function to round an offset up to 8 bytes:
+static size_t align8(size_t n)
+{
+   return (n + 7) & ~size_t(7);
+}
+
+//------------------------------------------------------------------------------
+// helper functions to read an optional field of a catalog entry:
+static std::string str_field(const JSONNode& node, const char* name)
+{
+   JSONNode::const_iterator it = node.find(name);
+   if (it == node.end() || it->type() == JSON_NULL)
+      return std::string();
+   return libjson::to_std_string(it->as_string());
+}
+
+static int32_t int_field(const JSONNode& node, const char* name)
+{
+   JSONNode::const_iterator it = node.find(name);
+   if (it == node.end() || it->type() == JSON_NULL)
+      return 0;
+   return int32_t(it->as_int());
+}
+
+//------------------------------------------------------------------------------
+// helper class to build the string table, equal strings are stored once:
+class StringTable {
+public:
+   StringTable() :blob_(1, '\0') { }
+
+   uint32_t add(const std::string& s)
+   {
+      if (s.empty()) return 0;
+      std::map<std::string, uint32_t>::const_iterator it = offsets_.find(s);
+      if (it != offsets_.end()) return it->second;
+
+      uint32_t off = uint32_t(blob_.size());
+      blob_.append(s).push_back('\0');
+      offsets_[s] = off;
+      return off;
+   }
+
+   const std::string& blob() const { return blob_; }
+
+private:
+   std::string blob_;
+   std::map<std::string, uint32_t> offsets_;
+};
+
+//------------------------------------------------------------------------------
+// helper function to sort the entries of a catalog object by name:
+typedef std::vector<std::pair<std::string, const JSONNode*> > Entries;
+
+static Entries sorted_entries(const JSONNode& obj)
+{
+   Entries v;
+   v.reserve(obj.size());
+   for (JSONNode::const_iterator it = obj.begin(); it != obj.end(); ++it)
+      v.push_back(std::make_pair(libjson::to_std_string(it->name()), &*it));
+   std::sort(v.begin(), v.end());
+   return v;
+}
+
+//------------------------------------------------------------------------------
+
+KMetadata::KMetadata()
+   :data_(0), size_(0), map_(0)
+{
+   // an empty image, so the accessors never see a null header
+   JSONNode empty(JSON_NODE);
+   build(empty, empty, 0);
+}
+
+//------------------------------------------------------------------------------
+
+KMetadata::~KMetadata()
+{
+   reset();
+}
+
+//------------------------------------------------------------------------------
+
+void KMetadata::reset()
+{
+   if (map_)
+      munmap(map_, size_);
+   map_ = 0;
+   data_ = 0;
+   size_ = 0;
+   std::vector<char>().swap(image_);
+}
+
+//------------------------------------------------------------------------------
+// IDs are indices in name order, so base_id and quote_id are resolved
+// once the assets have been sorted:
+void KMetadata::build(const JSONNode& assets, const JSONNode& pairs,
+		      time_t fetched)
+{
+   Entries a = sorted_entries(assets);
+   Entries p = sorted_entries(pairs);
+   StringTable strings;
+
+   std::vector<AssetRecord> arecs(a.size());
+   for (size_t i = 0; i < a.size(); ++i) {
+      const JSONNode& n = *a[i].second;
+      AssetRecord& r = arecs[i];
+      r.name = strings.add(a[i].first);
+      r.altname = strings.add(str_field(n, "altname"));
+      r.aclass = strings.add(str_field(n, "aclass"));
+      r.decimals = int_field(n, "decimals");
+      r.display_decimals = int_field(n, "display_decimals");
+   }
+
+   std::vector<PairRecord> precs(p.size());
+   for (size_t i = 0; i < p.size(); ++i) {
+      const JSONNode& n = *p[i].second;
+      PairRecord& r = precs[i];
+      std::string base = str_field(n, "base");
+      std::string quote = str_field(n, "quote");
+
+      r.name = strings.add(p[i].first);
+      r.altname = strings.add(str_field(n, "altname"));
+      r.wsname = strings.add(str_field(n, "wsname"));
+      r.aclass_base = strings.add(str_field(n, "aclass_base"));
+      r.base = strings.add(base);
+      r.aclass_quote = strings.add(str_field(n, "aclass_quote"));
+      r.quote = strings.add(quote);
+      r.lot = strings.add(str_field(n, "lot"));
+      r.fee_volume_currency = strings.add(str_field(n, "fee_volume_currency"));
+      r.ordermin = strings.add(str_field(n, "ordermin"));
+      r.base_id = r.quote_id = -1;
+      r.pair_decimals = int_field(n, "pair_decimals");
+      r.lot_decimals = int_field(n, "lot_decimals");
+      r.lot_multiplier = int_field(n, "lot_multiplier");
+      r.margin_call = int_field(n, "margin_call");
+      r.margin_stop = int_field(n, "margin_stop");
+
+      Entries::value_type key(base, 0);
+      Entries::const_iterator it = std::lower_bound(a.begin(), a.end(), key);
+      if (it != a.end() && it->first == base) r.base_id = int32_t(it - a.begin());
+      key.first = quote;
+      it = std::lower_bound(a.begin(), a.end(), key);
+      if (it != a.end() && it->first == quote) r.quote_id = int32_t(it - a.begin());
+   }
+
+   Header h;
+   std::memset(&h, 0, sizeof(h));
+   std::memcpy(h.magic, MAGIC, sizeof(MAGIC));
+   h.version = FORMAT_VERSION;
+   h.byte_order = BYTE_ORDER_MARK;
+   h.header_size = sizeof(Header);
+   h.asset_size = sizeof(AssetRecord);
+   h.pair_size = sizeof(PairRecord);
+   h.asset_count = uint32_t(arecs.size());
+   h.pair_count = uint32_t(precs.size());
+   h.assets_off = uint32_t(align8(sizeof(Header)));
+   h.pairs_off = uint32_t(align8(h.assets_off + arecs.size() * sizeof(AssetRecord)));
+   h.strings_off = uint32_t(align8(h.pairs_off + precs.size() * sizeof(PairRecord)));
+   h.strings_size = uint32_t(strings.blob().size());
+   h.fetched = int64_t(fetched);
+
+   std::vector<char> image(h.strings_off + h.strings_size, '\0');
+   if (!arecs.empty())
+      std::memcpy(&image[h.assets_off], &arecs[0], arecs.size() * sizeof(AssetRecord));
+   if (!precs.empty())
+      std::memcpy(&image[h.pairs_off], &precs[0], precs.size() * sizeof(PairRecord));
+   std::memcpy(&image[h.strings_off], strings.blob().data(), h.strings_size);
+
+   h.checksum = fnv1a(&image[sizeof(Header)], image.size() - sizeof(Header));
+   std::memcpy(&image[0], &h, sizeof(Header));
+
+   reset();
+   image_.swap(image);
+   data_ = &image_[0];
+   size_ = image_.size();
+}
+
+//------------------------------------------------------------------------------
+// everything the accessors rely on is checked here, once, so they can
+// read the mapping without further checks:
+bool KMetadata::valid(const char* data, size_t size)
+{
+   if (size < sizeof(Header))
+      return false;
+
+   Header h;
+   std::memcpy(&h, data, sizeof(Header));
+   if (std::memcmp(h.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+       h.version != FORMAT_VERSION || h.byte_order != BYTE_ORDER_MARK ||
+       h.header_size != sizeof(Header) || h.asset_size != sizeof(AssetRecord) ||
+       h.pair_size != sizeof(PairRecord))
+      return false;
+
+   uint64_t assets_end = uint64_t(h.assets_off) +
+      uint64_t(h.asset_count) * sizeof(AssetRecord);
+   uint64_t pairs_end = uint64_t(h.pairs_off) +
+      uint64_t(h.pair_count) * sizeof(PairRecord);
+   if (h.assets_off < sizeof(Header) || h.assets_off % 8 ||
+       h.pairs_off < assets_end || h.pairs_off % 8 ||
+       h.strings_off < pairs_end || h.strings_size == 0 ||
+       uint64_t(h.strings_off) + h.strings_size != size)
+      return false;
+
+   if (fnv1a(data + sizeof(Header), size - sizeof(Header)) != h.checksum)
+      return false;
+
+   // strings must be terminated and every offset inside the table
+   const char* s = data + h.strings_off;
+   if (s[0] != '\0' || s[h.strings_size - 1] != '\0')
+      return false;
+
+   const AssetRecord* a = reinterpret_cast<const AssetRecord*>(data + h.assets_off);
+   for (uint32_t i = 0; i < h.asset_count; ++i)
+      if (a[i].name >= h.strings_size || a[i].altname >= h.strings_size ||
+	  a[i].aclass >= h.strings_size)
+	 return false;
+
+   const PairRecord* p = reinterpret_cast<const PairRecord*>(data + h.pairs_off);
+   for (uint32_t i = 0; i < h.pair_count; ++i) {
+      const uint32_t* offs = &p[i].name;
+      for (int k = 0; k < 10; ++k)
+	 if (offs[k] >= h.strings_size) return false;
+      if (p[i].base_id < -1 || p[i].base_id >= int32_t(h.asset_count) ||
+	  p[i].quote_id < -1 || p[i].quote_id >= int32_t(h.asset_count))
+	 return false;
+   }
+
+   return true;
+}
+
+//------------------------------------------------------------------------------
+// the file is mapped read-only and private: save() replaces it by rename,
+// so a mapping keeps the catalog it was loaded with:
+bool KMetadata::load(const std::string& path)
+{
+   int fd = open(path.c_str(), O_RDONLY);
+   if (fd < 0)
+      return false;
+
+   struct stat st;
+   if (fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(Header)) {
+      close(fd);
+      return false;
+   }
+
+   size_t size = size_t(st.st_size);
+   void* map = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+   close(fd);
+   if (map == MAP_FAILED)
+      return false;
+
+   if (!valid(static_cast<const char*>(map), size)) {
+      munmap(map, size);
+      return false;
+   }
+
+   reset();
+   map_ = map;
+   data_ = static_cast<const char*>(map);
+   size_ = size;
+   return true;
+}
+
+//------------------------------------------------------------------------------
+
+void KMetadata::save(const std::string& path) const
+{
+   std::ostringstream tmp;
+   tmp << path << ".tmp." << getpid();
+   std::string tmp_path = tmp.str();
+
+   int fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+   if (fd < 0) {
+      std::ostringstream oss;
+      oss << "can't create " << tmp_path << ": " << strerror(errno);
+      throw std::runtime_error(oss.str());
+   }
+
+   size_t done = 0;
+   while (done < size_) {
+      ssize_t n = write(fd, data_ + done, size_ - done);
+      if (n < 0 && errno == EINTR) continue;
+      if (n <= 0) break;
+      done += size_t(n);
+   }
+
+   int err = (done == size_) ? 0 : errno;
+   if (close(fd) != 0 && !err) err = errno;
+   if (!err && rename(tmp_path.c_str(), path.c_str()) != 0) err = errno;
+
+   if (err) {
+      unlink(tmp_path.c_str());
+      std::ostringstream oss;
+      oss << "can't write " << path << ": " << strerror(err);
+      throw std::runtime_error(oss.str());
+   }
+}
+
+//------------------------------------------------------------------------------
+// the download time isn't part of the catalog:
+bool KMetadata::same_catalog(const KMetadata& other) const
+{
+   return size_ == other.size_ &&
+      header()->checksum == other.header()->checksum &&
+      std::memcmp(data_ + sizeof(Header), other.data_ + sizeof(Header),
+		  size_ - sizeof(Header)) == 0;
+}
+
+//------------------------------------------------------------------------------
+
+const KMetadata::Header* KMetadata::header() const
+{
+   return reinterpret_cast<const Header*>(data_);
+}
+
+const KMetadata::AssetRecord* KMetadata::assets() const
+{
+   return reinterpret_cast<const AssetRecord*>(data_ + header()->assets_off);
+}
+
+const KMetadata::PairRecord* KMetadata::pairs() const
+{
+   return reinterpret_cast<const PairRecord*>(data_ + header()->pairs_off);
+}
+
+const char* KMetadata::str(uint32_t offset) const
+{
+   return data_ + header()->strings_off + offset;
+}
+
+//------------------------------------------------------------------------------
+
+size_t KMetadata::asset_count() const
+{
+   return header()->asset_count;
+}
+
+size_t KMetadata::pair_count() const
+{
+   return header()->pair_count;
+}
+
+time_t KMetadata::fetched() const
+{
+   return time_t(header()->fetched);
+}
+
+//------------------------------------------------------------------------------
+
+KAssetInfo KMetadata::asset(int id) const
+{
+   const AssetRecord& r = assets()[id];
+   KAssetInfo info = {
+      str(r.name), str(r.altname), str(r.aclass),
+      r.decimals, r.display_decimals
+   };
+   return info;
+}
+
+//------------------------------------------------------------------------------
+
+KPairInfo KMetadata::pair(int id) const
+{
+   const PairRecord& r = pairs()[id];
+   KPairInfo info = {
+      str(r.name), str(r.altname), str(r.wsname),
+      str(r.aclass_base), str(r.base), str(r.aclass_quote), str(r.quote),
+      str(r.lot), str(r.fee_volume_currency), str(r.ordermin),
+      r.base_id, r.quote_id, r.pair_decimals, r.lot_decimals,
+      r.lot_multiplier, r.margin_call, r.margin_stop
+   };
+   return info;
+}
+
+//------------------------------------------------------------------------------
+// records are sorted by name, a binary search finds them:
+int KMetadata::find_asset(const std::string& name) const
+{
+   const AssetRecord* a = assets();
+   int lo = 0, hi = int(asset_count());
+   while (lo < hi) {
+      int mid = (lo + hi) / 2;
+      int c = std::strcmp(str(a[mid].name), name.c_str());
+      if (c == 0) return mid;
+      if (c < 0) lo = mid + 1;
+      else hi = mid;
+   }
+   return -1;
+}
+
+//------------------------------------------------------------------------------
+
+int KMetadata::find_pair(const std::string& name) const
+{
+   const PairRecord* p = pairs();
+   int lo = 0, hi = int(pair_count());
+   while (lo < hi) {
+      int mid = (lo + hi) / 2;
+      int c = std::strcmp(str(p[mid].name), name.c_str());
+      if (c == 0) return mid;
+      if (c < 0) lo = mid + 1;
+      else hi = mid;
+   }
+   return -1;
+}
+
+//------------------------------------------------------------------------------
+
+}; // namespace Kraken
@@ -0,0 +1,128 @@
+#ifndef _KRAKEN_KMETADATA_HPP_
+#define _KRAKEN_KMETADATA_HPP_
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <ctime>
+#include <stdint.h>
+
+#include "../libjson/libjson.h"
+
+//------------------------------------------------------------------------------
+
+namespace Kraken {
+
+//------------------------------------------------------------------------------
+// an asset of the catalog (strings point into the KMetadata image):
+struct KAssetInfo {
+   const char* name;      // e.g. XXBT
+   const char* altname;   // e.g. XBT
+   const char* aclass;
+   int decimals;
+   int display_decimals;
+};
+
+//------------------------------------------------------------------------------
+// an asset pair of the catalog (strings point into the KMetadata image):
+struct KPairInfo {
+   const char* name;      // e.g. XXBTZEUR
+   const char* altname;   // e.g. XBTEUR
+   const char* wsname;    // e.g. XBT/EUR, empty if not on the feed
+   const char* aclass_base;
+   const char* base;
+   const char* aclass_quote;
+   const char* quote;
+   const char* lot;
+   const char* fee_volume_currency;
+   const char* ordermin;  // empty if not given
+   int base_id;           // asset IDs of base and quote, -1 if unknown
+   int quote_id;
+   int pair_decimals;
+   int lot_decimals;
+   int lot_multiplier;
+   int margin_call;
+   int margin_stop;
+};
+
+//------------------------------------------------------------------------------
+// the asset and pair catalog (Assets and AssetPairs) as one binary image
+// that can be saved to a file and mapped back with mmap(), so a process
+// starts with the whole catalog without a request or a JSON parse.
+//
+// Assets and pairs are sorted by name and their index is their ID:
+// dense, small and the same in every process that loads the same image.
+//
+// The file is written in native byte order and is rejected, not
+// converted, by a build with another layout, byte order or FORMAT_VERSION.
+class KMetadata {
+public:
+
+   // version of the file layout, bumped whenever it changes
+   static const uint32_t FORMAT_VERSION = 1;
+
+   // an empty catalog
+   KMetadata();
+
+   // unmaps the file, if any
+   ~KMetadata();
+
+   // builds the catalog from the "result" objects of Assets and
+   // AssetPairs; 'fetched' is when they were downloaded (unix time)
+   void build(const JSONNode& assets, const JSONNode& pairs, time_t fetched);
+
+   // maps a file written by save(), returns false (and keeps the current
+   // catalog) if it is missing, of another version or damaged
+   bool load(const std::string& path);
+
+   // writes the image to 'path' atomically (temporary file and rename)
+   void save(const std::string& path) const;
+
+   // true if both catalogs have the same content
+   bool same_catalog(const KMetadata& other) const;
+
+   size_t asset_count() const;
+   size_t pair_count() const;
+   time_t fetched() const;
+
+   // lookups by ID (no range check)
+   KAssetInfo asset(int id) const;
+   KPairInfo pair(int id) const;
+
+   // lookups by name, -1 if not found
+   int find_asset(const std::string& name) const;
+   int find_pair(const std::string& name) const;
+
+private:
+   struct Header;
+   struct AssetRecord;
+   struct PairRecord;
+
+   const Header* header() const;
+   const AssetRecord* assets() const;
+   const PairRecord* pairs() const;
+   const char* str(uint32_t offset) const;
+
+   // checks a mapped or built image, returns false if it is unusable
+   static bool valid(const char* data, size_t size);
+
+   // releases the image
+   void reset();
+
+   const char* data_;       // the image, mapped or in image_
+   size_t size_;
+   void* map_;              // mmap()ed file, 0 if the image is in image_
+   std::vector<char> image_;
+
+   // disallow copying
+   KMetadata(const KMetadata&);
+   KMetadata& operator=(const KMetadata&);
+};
+
+//------------------------------------------------------------------------------
+
+}; // namespace Kraken
+
+//------------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,237 @@
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+#include <ctime>
+
+#include "kmetrics.hpp"
+
+//------------------------------------------------------------------------------
+
+namespace Kraken {
+
+//------------------------------------------------------------------------------
+
+const int KHistogram::BUCKETS;
+const uint64_t KMetrics::NONE;
+
+//------------------------------------------------------------------------------
+// values below 32 are their own bucket; from 32 on, a value with its
+// highest bit at 'msb' falls in bucket e * 16 + (value >> e), where
+// e = msb - 4 keeps the five top bits:
+int KHistogram::index(uint64_t value)
+{
+   if (value < 32)
+      return int(value);
+
+   int msb = 63 - __builtin_clzll(value);
+   int e = msb - 4;
+   int i = e * 16 + int(value >> e);
+   return i < BUCKETS ? i : BUCKETS - 1;
+}
+
+//------------------------------------------------------------------------------
+
+uint64_t KHistogram::upper_bound(int index)
+{
+   if (index < 32)
+      return uint64_t(index);
+
+   int e = index / 16 - 1;
+   uint64_t m = uint64_t(index - e * 16);
+   return ((m + 1) << e) - 1;
+}
+
+//------------------------------------------------------------------------------
+
+void KHistogram::record(uint64_t value)
+{
+   counts_[index(value)].fetch_add(1, std::memory_order_relaxed);
+   count_.fetch_add(1, std::memory_order_relaxed);
+   sum_.fetch_add(value, std::memory_order_relaxed);
+
+   uint64_t m = max_.load(std::memory_order_relaxed);
+   while (value > m &&
+	  !max_.compare_exchange_weak(m, value, std::memory_order_relaxed))
+      ;
+}
+
+//------------------------------------------------------------------------------
+
+double KHistogram::mean() const
+{
+   uint64_t n = count();
+   return n ? double(sum_.load(std::memory_order_relaxed)) / n : 0;
+}
+
+//------------------------------------------------------------------------------
+// the buckets are read one at a time while others may record, so the
+// result is as of some moment during the scan:
+uint64_t KHistogram::percentile(double p) const
+{
+   uint64_t n = count();
+   if (n == 0)
+      return 0;
+
+   uint64_t rank = uint64_t(p / 100 * n + 0.5);
+   if (rank < 1) rank = 1;
+   if (rank > n) rank = n;
+
+   uint64_t seen = 0;
+   for (int i = 0; i < BUCKETS; ++i) {
+      seen += counts_[i].load(std::memory_order_relaxed);
+      if (seen >= rank) {
+	 uint64_t v = upper_bound(i);
+	 return v < max() ? v : max();
+      }
+   }
+   return max();
+}
+
+//------------------------------------------------------------------------------
+
+void KHistogram::reset()
+{
+   for (int i = 0; i < BUCKETS; ++i)
+      counts_[i].store(0, std::memory_order_relaxed);
+   count_.store(0, std::memory_order_relaxed);
+   sum_.store(0, std::memory_order_relaxed);
+   max_.store(0, std::memory_order_relaxed);
+}
+
+//------------------------------------------------------------------------------
+
+const char* KMetrics::phase_name(Phase p)
+{
+   static const char* names[PHASES] = {
+      "dns_us", "connect_us", "tls_us", "server_us", "transfer_us",
+      "total_us", "parse_us", "bytes_in", "bytes_out"
+   };
+   return names[p];
+}
+
+//------------------------------------------------------------------------------
+
+KMetrics::KMetrics()
+   :dumping_(false)
+{
+}
+
+//------------------------------------------------------------------------------
+
+KMetrics::~KMetrics()
+{
+   stop_dump();
+}
+
+//------------------------------------------------------------------------------
+// endpoints are never removed, so the reference stays valid without
+// the lock:
+KMetrics::Endpoint& KMetrics::endpoint(const std::string& name)
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   std::unique_ptr<Endpoint>& e = endpoints_[name];
+   if (!e)
+      e.reset(new Endpoint);
+   return *e;
+}
+
+//------------------------------------------------------------------------------
+
+void KMetrics::record(const std::string& endpoint_name, Phase p, uint64_t value)
+{
+   endpoint(endpoint_name).phases[p].record(value);
+}
+
+//------------------------------------------------------------------------------
+
+void KMetrics::record(const std::string& endpoint_name,
+		      const uint64_t (&values)[PHASES])
+{
+   record(endpoint(endpoint_name), values);
+}
+
+//------------------------------------------------------------------------------
+
+void KMetrics::record(Endpoint& e, const uint64_t (&values)[PHASES])
+{
+   for (int p = 0; p < PHASES; ++p)
+      if (values[p] != NONE) e.phases[p].record(values[p]);
+}
+
+//------------------------------------------------------------------------------
+
+const KHistogram* KMetrics::histogram(const std::string& endpoint,
+				      Phase p) const
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   std::map<std::string, std::unique_ptr<Endpoint> >::const_iterator
+      it = endpoints_.find(endpoint);
+   return it == endpoints_.end() ? 0 : &it->second->phases[p];
+}
+
+//------------------------------------------------------------------------------
+
+std::vector<std::string> KMetrics::endpoints() const
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   std::vector<std::string> names;
+   std::map<std::string, std::unique_ptr<Endpoint> >::const_iterator
+      it = endpoints_.begin();
+   for (; it != endpoints_.end(); ++it)
+      names.push_back(it->first);
+   return names;
+}
+
+//------------------------------------------------------------------------------
+
+void KMetrics::dump(std::ostream& os) const
+{
+   std::vector<std::string> names = endpoints();
+   for (size_t i = 0; i < names.size(); ++i) {
+      for (int p = 0; p < PHASES; ++p) {
+	 const KHistogram* h = histogram(names[i], Phase(p));
+	 if (!h->count()) continue;
+	 os << names[i] << ' ' << phase_name(Phase(p))
+	    << " count=" << h->count()
+	    << std::fixed << std::setprecision(1) << " mean=" << h->mean()
+	    << " p50=" << h->percentile(50) << " p90=" << h->percentile(90)
+	    << " p99=" << h->percentile(99) << " p99.9=" << h->percentile(99.9)
+	    << " max=" << h->max() << std::endl;
+      }
+   }
+}
+
+//------------------------------------------------------------------------------
+// the file is reopened for every dump, so it can be rotated:
+void KMetrics::start_dump(const std::string& path, std::chrono::seconds interval)
+{
+   stop_dump();
+
+   std::lock_guard<std::mutex> lock(dump_mutex_);
+   dumping_ = true;
+   dumper_ = std::thread([this, path, interval]() {
+	 std::unique_lock<std::mutex> lock(dump_mutex_);
+	 while (!dump_cv_.wait_for(lock, interval, [this]() { return !dumping_; })) {
+	    std::ofstream ofs(path.c_str(), std::ios::app);
+	    ofs << "# " << std::time(0) << std::endl;
+	    dump(ofs);
+	 }
+      });
+}
+
+//------------------------------------------------------------------------------
+
+void KMetrics::stop_dump()
+{
+   {
+      std::lock_guard<std::mutex> lock(dump_mutex_);
+      dumping_ = false;
+   }
+   dump_cv_.notify_all();
+   if (dumper_.joinable())
+      dumper_.join();
+}
+
+//------------------------------------------------------------------------------
+
+}; // namespace Kraken
@@ -0,0 +1,143 @@
+#ifndef _KRAKEN_KMETRICS_HPP_
+#define _KRAKEN_KMETRICS_HPP_
+
+#include <map>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <ostream>
+#include <condition_variable>
+#include <stdint.h>
+
+//------------------------------------------------------------------------------
+
+namespace Kraken {
+
+//------------------------------------------------------------------------------
+// a log-linear histogram in the style of HdrHistogram: values below 32
+// are counted exactly, larger ones in 16 buckets per power of two (about
+// 3% apart). record() is a few relaxed atomic operations, so any number
+// of threads can record while another one reads.
+class KHistogram {
+public:
+
+   KHistogram() { reset(); }
+
+   void record(uint64_t value);
+
+   uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+   uint64_t max() const   { return max_.load(std::memory_order_relaxed); }
+   double mean() const;
+
+   // the value below which 'p' percent of the values are (0..100), as
+   // the upper bound of its bucket
+   uint64_t percentile(double p) const;
+
+   // not atomic with respect to concurrent record()s
+   void reset();
+
+private:
+   static const int BUCKETS = 640;   // up to 2^40
+
+   static int index(uint64_t value);
+   static uint64_t upper_bound(int index);
+
+   std::atomic<uint64_t> counts_[BUCKETS];
+   std::atomic<uint64_t> count_;
+   std::atomic<uint64_t> sum_;
+   std::atomic<uint64_t> max_;
+
+   // disallow copying
+   KHistogram(const KHistogram&);
+   KHistogram& operator=(const KHistogram&);
+};
+
+//------------------------------------------------------------------------------
+// per-endpoint histograms of requests, shared between KClients (see
+// KClient::set_metrics()). Times are in microseconds:
+//
+//   DNS       name lookup
+//   CONNECT   TCP connect
+//   TLS       TLS handshake
+//   SERVER    request sent to first response byte
+//   TRANSFER  first to last response byte
+//   TOTAL     the whole request
+//   PARSE     parsing and decoding the response (typed methods only)
+//
+// and BYTES_IN, BYTES_OUT are body sizes. Reused connections record 0
+// for DNS, CONNECT and TLS.
+class KMetrics {
+public:
+
+   enum Phase {
+      DNS, CONNECT, TLS, SERVER, TRANSFER, TOTAL, PARSE,
+      BYTES_IN, BYTES_OUT, PHASES
+   };
+
+   // name of a phase as dumped
+   static const char* phase_name(Phase p);
+
+   KMetrics();
+
+   // stops the periodic dump
+   ~KMetrics();
+
+   // a value record() skips
+   static const uint64_t NONE = ~uint64_t(0);
+
+   // an endpoint's histogram of each phase
+   struct Endpoint {
+      KHistogram phases[PHASES];
+   };
+
+   // the histograms of an endpoint, created on first use. Endpoints are
+   // never removed, so a caller can resolve one once and record through
+   // it without the lock (see KClient)
+   Endpoint& endpoint(const std::string& name);
+
+   // adds a value to an endpoint's histogram
+   void record(const std::string& endpoint, Phase p, uint64_t value);
+
+   // adds the phases of a request at once, but those that are NONE
+   void record(const std::string& endpoint, const uint64_t (&values)[PHASES]);
+   static void record(Endpoint& endpoint, const uint64_t (&values)[PHASES]);
+
+   // the histogram of an endpoint, 0 if nothing was recorded for it
+   const KHistogram* histogram(const std::string& endpoint, Phase p) const;
+
+   // endpoints with recorded requests
+   std::vector<std::string> endpoints() const;
+
+   // writes one line per endpoint and phase: count, mean, p50, p90,
+   // p99, p99.9 and max
+   void dump(std::ostream& os) const;
+
+   // appends a dump to 'path' every 'interval' from a thread of its own
+   void start_dump(const std::string& path, std::chrono::seconds interval);
+   void stop_dump();
+
+private:
+   mutable std::mutex mutex_;   // guards endpoints_
+   std::map<std::string, std::unique_ptr<Endpoint> > endpoints_;
+
+   std::mutex dump_mutex_;      // guards the two below
+   std::condition_variable dump_cv_;
+   bool dumping_;
+   std::thread dumper_;
+
+   // disallow copying
+   KMetrics(const KMetrics&);
+   KMetrics& operator=(const KMetrics&);
+};
+
+//------------------------------------------------------------------------------
+
+}; // namespace Kraken
+
+//------------------------------------------------------------------------------
+
+#endif
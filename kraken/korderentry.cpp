@@ -0,0 +1,165 @@
+#include <stdexcept>
+#include <cstring>
+#include <thread>
+
+#include "korderentry.hpp"
+
+//------------------------------------------------------------------------------
+
+namespace Kraken {
+
+//------------------------------------------------------------------------------
+// the header the signature is written into:
+static const char SIGN_HEADER[] = "API-Sign: ";
+
+//------------------------------------------------------------------------------
+// a slot frees its own handles, so the ones made before a failure in
+// KOrderEntry's constructor don't leak:
+struct KOrderEntry::Slot {
+   CURL* curl;
+   curl_slist* headers;
+   char* sign;             // the API-Sign value inside 'headers'
+   HMAC_CTX* hmac;
+   std::string postdata;
+   std::string response;
+   std::atomic<bool> busy;
+
+   Slot() :curl(curl_easy_init()), headers(0), sign(0), hmac(HMAC_CTX_new()),
+	   busy(false) { }
+
+   ~Slot()
+   {
+      curl_easy_cleanup(curl);
+      curl_slist_free_all(headers);
+      HMAC_CTX_free(hmac);
+   }
+};
+
+//------------------------------------------------------------------------------
+
+KOrderEntry::KOrderEntry(const std::string& key, const std::string& secret,
+			 const KInput& fixed, size_t slots,
+			 const std::string& method,
+			 const std::string& url, const std::string& version)
+   :key_(key), path_("/" + version + "/private/" + method),
+    method_url_(url + path_), time_url_(url + "/" + version + "/public/Time"),
+    fixed_(fixed), signer_(secret), next_slot_(0)
+{
+   std::string key_header = "API-Key: " + key_;
+   std::string sign_header = SIGN_HEADER + std::string(KSigner::SIZE, 'A');
+
+   if (slots == 0) slots = 1;
+   for (size_t i = 0; i < slots; ++i) {
+      slots_.push_back(std::unique_ptr<Slot>(new Slot));
+      Slot& slot = *slots_.back();
+      if (!slot.curl)
+	 throw std::runtime_error("can't create curl handle");
+      if (!slot.hmac)
+	 throw std::runtime_error("can't create HMAC context");
+      slot.postdata.reserve(512);
+      slot.response.reserve(1024);
+
+      slot.headers = curl_slist_append(slot.headers, key_header.c_str());
+      slot.headers = curl_slist_append(slot.headers, sign_header.c_str());
+      slot.sign = slot.headers->next->data + std::strlen(SIGN_HEADER);
+
+      setup_handle(slot.curl, KCurlOptions());
+      curl_easy_setopt(slot.curl, CURLOPT_WRITEDATA,
+		       static_cast<void*>(&slot.response));
+      set_options(slot);
+   }
+}
+
+//------------------------------------------------------------------------------
+// the slots free their handles:
+KOrderEntry::~KOrderEntry()
+{
+}
+
+//------------------------------------------------------------------------------
+
+void KOrderEntry::set_options(Slot& s)
+{
+   curl_easy_setopt(s.curl, CURLOPT_URL, method_url_.c_str());
+   curl_easy_setopt(s.curl, CURLOPT_POST, 1L);
+   curl_easy_setopt(s.curl, CURLOPT_HTTPHEADER, s.headers);
+}
+
+//------------------------------------------------------------------------------
+// the connections stay in the handles' caches for the orders:
+void KOrderEntry::warm()
+{
+   for (size_t i = 0; i < slots_.size(); ++i) {
+      Slot& s = acquire();
+      curl_easy_setopt(s.curl, CURLOPT_URL, time_url_.c_str());
+      curl_easy_setopt(s.curl, CURLOPT_HTTPGET, 1L);
+      curl_easy_setopt(s.curl, CURLOPT_HTTPHEADER, NULL);
+      s.response.clear();
+      CURLcode result = curl_easy_perform(s.curl);
+      set_options(s);
+      s.busy = false;
+      check_perform(result);
+   }
+}
+
+//------------------------------------------------------------------------------
+// slots are tried round robin from a moving start, so concurrent senders
+// rarely try the same one:
+KOrderEntry::Slot& KOrderEntry::acquire()
+{
+   size_t n = slots_.size();
+   for (;;) {
+      size_t start = next_slot_++;
+      for (size_t i = 0; i < n; ++i) {
+	 Slot& s = *slots_[(start + i) % n];
+	 bool expected = false;
+	 if (s.busy.compare_exchange_strong(expected, true))
+	    return s;
+      }
+      std::this_thread::yield();
+   }
+}
+
+//------------------------------------------------------------------------------
+// the signature is written straight into the slot's header, which keeps
+// its length. The nonce is drawn here, after the slot was acquired, so
+// it's as close as it can be to the request going out:
+void KOrderEntry::prepare(Slot& s, const KInput& vars)
+{
+   char digits[24];
+   char* end = digits + sizeof(digits);
+   char* nonce = KSigner::format_nonce(KSigner::next_nonce(), end);
+   size_t nonce_len = end - nonce;
+
+   s.postdata.assign("nonce=").append(nonce, nonce_len);
+   if (!fixed_.prefix().empty())
+      s.postdata.append(1, '&').append(fixed_.prefix());
+   vars.append_query(s.postdata);
+
+   signer_.sign(path_, nonce, nonce_len, s.postdata, s.hmac, s.sign);
+
+   curl_easy_setopt(s.curl, CURLOPT_POSTFIELDS, s.postdata.c_str());
+   curl_easy_setopt(s.curl, CURLOPT_POSTFIELDSIZE, long(s.postdata.size()));
+}
+
+//------------------------------------------------------------------------------
+
+std::string KOrderEntry::send(const KInput& vars)
+{
+   Slot& s = acquire();
+
+   // releases the slot on the way out
+   struct Release {
+      Slot& s;
+      ~Release() { s.busy = false; }
+   } release = { s };
+
+   s.response.clear();
+   prepare(s, vars);
+   check_perform(curl_easy_perform(s.curl));
+   return s.response;
+}
+
+//------------------------------------------------------------------------------
+
+}; // namespace Kraken
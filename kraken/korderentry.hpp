@@ -0,0 +1,93 @@
+#ifndef _KRAKEN_KORDERENTRY_HPP_
+#define _KRAKEN_KORDERENTRY_HPP_
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <curl/curl.h>
+#include <openssl/hmac.h>
+
+#include "kinput.hpp"
+#include "ksigner.hpp"
+#include "ktransport.hpp"
+
+//------------------------------------------------------------------------------
+
+namespace Kraken {
+
+//------------------------------------------------------------------------------
+// the fast path of a private method called over and over with the same
+// fixed parameters, AddOrder above all. Everything that doesn't depend on
+// the order is done in the constructor:
+//
+//  - the fixed parameters are encoded once (KInputTemplate);
+//  - the secret is decoded and the HMAC keyed once (KSigner);
+//  - each slot has its own curl handle (URL and options set, connection
+//    kept alive), its header list with room for the signature, which is
+//    written in place, and its postdata and response buffers.
+//
+// send() only fills in the nonce and the variable parameters, signs and
+// performs. Up to 'slots' threads can send at the same time; more wait
+// for a free slot.
+//
+// With more than one slot, a request can reach Kraken after one holding
+// a larger nonce, which Kraken rejects with EAPI:Invalid nonce unless the
+// key has a nonce window: use slots > 1 only with such a key. The nonce
+// is drawn as late as possible, right before the request is performed,
+// which narrows the window but can't close it.
+class KOrderEntry {
+public:
+
+   // 'fixed' are the parameters of every request (e.g. pair and
+   // ordertype), 'url' and 'version' as in KClient
+   KOrderEntry(const std::string& key, const std::string& secret,
+	       const KInput& fixed, size_t slots = 1,
+	       const std::string& method = "AddOrder",
+	       const std::string& url = "https://api.kraken.com",
+	       const std::string& version = "0");
+
+   ~KOrderEntry();
+
+   // opens the connection of every slot ahead of the first order, with
+   // a public Time request each
+   void warm();
+
+   // sends a request with the variable parameters (e.g. type, price and
+   // volume), returns the response
+   std::string send(const KInput& vars);
+
+private:
+   struct Slot;
+
+   // a free slot, spinning until one is
+   Slot& acquire();
+
+   // fills in the nonce, postdata and signature of a slot; call it
+   // last before performing
+   void prepare(Slot& s, const KInput& vars);
+
+   // sets the options of a request to the method
+   void set_options(Slot& s);
+
+   std::string key_;
+   std::string path_;         // e.g. /0/private/AddOrder
+   std::string method_url_;
+   std::string time_url_;     // used by warm()
+   KInputTemplate fixed_;
+   KSigner signer_;
+   std::vector<std::unique_ptr<Slot> > slots_;
+   std::atomic<size_t> next_slot_;
+
+   // disallow copying
+   KOrderEntry(const KOrderEntry&);
+   KOrderEntry& operator=(const KOrderEntry&);
+};
+
+//------------------------------------------------------------------------------
+
+}; // namespace Kraken
+
+//------------------------------------------------------------------------------
+
+#endif
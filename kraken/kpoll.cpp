@@ -0,0 +1,141 @@
+#include <cmath>
+#include "kpoll.hpp"
+
+//------------------------------------------------------------------------------
+
+namespace Kraken {
+
+//------------------------------------------------------------------------------
+
+KPollScheduler::KPollScheduler(double budget, double min_interval,
+			       double max_interval, double half_life)
+   :budget_(budget), min_interval_(min_interval),
+    max_interval_(max_interval), half_life_(half_life)
+{ }
+
+//------------------------------------------------------------------------------
+
+size_t KPollScheduler::add()
+{
+   Stream s;
+   s.count = 0;
+   s.exposure = 0;
+   s.last_poll = -1;
+   s.backlog = false;
+   s.interval = max_interval_;
+   streams_.push_back(s);
+   allocate();
+   return streams_.size() - 1;
+}
+
+//------------------------------------------------------------------------------
+// streams never polled are due at time 0, that is at once:
+size_t KPollScheduler::next(double& due) const
+{
+   size_t first = 0;
+   due = HUGE_VAL;
+   for (size_t i = 0; i < streams_.size(); ++i) {
+      const Stream& s = streams_[i];
+      double d = 0;
+      if (s.last_poll >= 0)
+	 d = s.last_poll + (s.backlog ? min_interval_ : s.interval);
+      if (d < due) {
+	 due = d;
+	 first = i;
+      }
+   }
+   return first;
+}
+
+//------------------------------------------------------------------------------
+// a regular poll observed the stream since the last one. The first poll
+// and a backlog page return older trades, whose stamps tell the time
+// they cover:
+void KPollScheduler::polled(size_t i, double now, const double* times,
+			    size_t n, bool backlog)
+{
+   Stream& s = streams_[i];
+
+   double count, exposure;
+   if (s.last_poll < 0 || s.backlog) {
+      count = n > 1 ? double(n - 1) : 0;
+      exposure = n > 1 ? times[n - 1] - times[0] : 0;
+   }
+   else {
+      count = double(n);
+      exposure = now - s.last_poll;
+   }
+
+   if (exposure > 0) {
+      double decay = std::pow(0.5, exposure / half_life_);
+      s.count = s.count * decay + count;
+      s.exposure = s.exposure * decay + exposure;
+   }
+
+   s.last_poll = now;
+   s.backlog = backlog;
+   allocate();
+}
+
+//------------------------------------------------------------------------------
+
+double KPollScheduler::rate(size_t i) const
+{
+   const Stream& s = streams_[i];
+   return s.exposure > 0 ? s.count / s.exposure : 0;
+}
+
+//------------------------------------------------------------------------------
+// polls per second f(i) = 1/T(i) are proportional to sqrt(rate); a pass
+// fixes the streams whose share falls outside [1/max, 1/min] at the
+// bound and takes them out, until a pass fixes none:
+void KPollScheduler::allocate()
+{
+   size_t n = streams_.size();
+   double f_min = 1 / max_interval_, f_max = 1 / min_interval_;
+   std::vector<double> weight(n), f(n, 0);
+   std::vector<bool> fixed(n, false);
+   double left = budget_;
+
+   for (size_t i = 0; i < n; ++i) {
+      weight[i] = std::sqrt(rate(i));
+      if (weight[i] == 0) {
+	 f[i] = f_min;
+	 fixed[i] = true;
+	 left -= f_min;
+      }
+   }
+
+   for (;;) {
+      double sum = 0;
+      for (size_t i = 0; i < n; ++i)
+	 if (!fixed[i]) sum += weight[i];
+      if (sum == 0)
+	 break;
+
+      bool clamped = false;
+      double pass_left = left;
+      for (size_t i = 0; i < n; ++i) {
+	 if (fixed[i]) continue;
+	 double share = pass_left * weight[i] / sum;
+	 if (share >= f_min && share <= f_max) continue;
+	 f[i] = share > f_max ? f_max : f_min;
+	 fixed[i] = true;
+	 clamped = true;
+	 left -= f[i];
+      }
+      if (clamped)
+	 continue;
+
+      for (size_t i = 0; i < n; ++i)
+	 if (!fixed[i]) f[i] = left * weight[i] / sum;
+      break;
+   }
+
+   for (size_t i = 0; i < n; ++i)
+      streams_[i].interval = 1 / f[i];
+}
+
+//------------------------------------------------------------------------------
+
+}; // namespace Kraken
@@ -0,0 +1,81 @@
+#ifndef _KRAKEN_KPOLL_HPP_
+#define _KRAKEN_KPOLL_HPP_
+
+#include <vector>
+#include <cstddef>
+
+//------------------------------------------------------------------------------
+
+namespace Kraken {
+
+//------------------------------------------------------------------------------
+// decides when to poll each of many trade streams (pairs) within a
+// budget of requests per second, from their observed arrival rates.
+//
+// The rate of a stream is its trade count over its time observed, both
+// decayed with a half-life, so it follows changes in activity. Polling
+// a stream of rate r every T seconds leaves its trades unseen for T/2
+// on average; the intervals that minimize that delay over all trades
+// for a budget B are
+//
+//   1/T(i) = B * sqrt(r(i)) / sum(sqrt(r(j)))
+//
+// clamped to [min_interval, max_interval], with what the clamps free
+// or take shared by the others. Streams that never traded are polled
+// every max_interval.
+//
+// Times are seconds as doubles on any clock, the same for every call:
+// unix time for krt (trade stamps are unix time), simulated time in
+// benchmarks/poll_sim.cpp.
+class KPollScheduler {
+public:
+
+   // 'budget' requests per second over all streams, intervals between
+   // polls of a stream in [min_interval, max_interval]
+   KPollScheduler(double budget, double min_interval, double max_interval,
+		  double half_life = 900);
+
+   // adds a stream, due at once; returns its index
+   size_t add();
+
+   size_t size() const { return streams_.size(); }
+
+   // the stream due first, and when in 'due'
+   size_t next(double& due) const;
+
+   // a poll of stream 'i' at 'now' returned 'n' trades stamped 'times'
+   // (oldest first); 'backlog' if more are waiting (a full page), the
+   // stream is then due again after min_interval
+   void polled(size_t i, double now, const double* times, size_t n,
+	       bool backlog = false);
+
+   // trades per second and interval of stream 'i'
+   double rate(size_t i) const;
+   double interval(size_t i) const { return streams_[i].interval; }
+
+private:
+   struct Stream {
+      double count;      // decayed trades seen
+      double exposure;   // decayed seconds observed
+      double last_poll;  // < 0 before the first poll
+      bool backlog;      // the last poll returned a full page
+      double interval;
+   };
+
+   // spreads the budget over the streams (see above)
+   void allocate();
+
+   double budget_;
+   double min_interval_;
+   double max_interval_;
+   double half_life_;
+   std::vector<Stream> streams_;
+};
+
+//------------------------------------------------------------------------------
+
+}; // namespace Kraken
+
+//------------------------------------------------------------------------------
+
+#endif
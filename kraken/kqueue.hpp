@@ -0,0 +1,217 @@
+#ifndef _KRAKEN_KQUEUE_HPP_
+#define _KRAKEN_KQUEUE_HPP_
+
+#include <vector>
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
+
+//------------------------------------------------------------------------------
+
+namespace Kraken {
+
+//------------------------------------------------------------------------------
+// what the indices of a queue are padded to, so the producer's and the
+// consumer's don't share a cache line:
+static const size_t KCACHE_LINE = 64;
+
+//------------------------------------------------------------------------------
+// a bounded ring of trivially copyable items (KTradeRecord above all)
+// from one producer thread to one consumer thread, without locks.
+// 'capacity' is rounded up to a power of two. push() and pop() never
+// block: they move as many items as they can and say how many.
+template <class T>
+class KSpscQueue {
+public:
+   static_assert(std::is_trivially_copyable<T>::value,
+		 "queued items are copied as bytes");
+
+   explicit KSpscQueue(size_t capacity)
+      :tail_(0), head_cache_(0), head_(0), tail_cache_(0)
+   {
+      size_t n = 1;
+      while (n < capacity) n <<= 1;
+      ring_.resize(n);
+      mask_ = n - 1;
+   }
+
+   size_t capacity() const { return mask_ + 1; }
+
+   // producer: appends up to 'n' items, returns how many
+   size_t push(const T* items, size_t n)
+   {
+      size_t tail = tail_.load(std::memory_order_relaxed);
+      if (capacity() - (tail - head_cache_) < n)
+	 head_cache_ = head_.load(std::memory_order_acquire);
+
+      size_t room = capacity() - (tail - head_cache_);
+      if (n > room) n = room;
+      for (size_t i = 0; i < n; ++i)
+	 ring_[(tail + i) & mask_] = items[i];
+      tail_.store(tail + n, std::memory_order_release);
+      return n;
+   }
+
+   bool push(const T& item) { return push(&item, 1) == 1; }
+
+   // consumer: takes up to 'max' items into 'out', returns how many
+   size_t pop(T* out, size_t max)
+   {
+      size_t head = head_.load(std::memory_order_relaxed);
+      if (tail_cache_ - head < max)
+	 tail_cache_ = tail_.load(std::memory_order_acquire);
+
+      size_t n = tail_cache_ - head;
+      if (n > max) n = max;
+      for (size_t i = 0; i < n; ++i)
+	 out[i] = ring_[(head + i) & mask_];
+      head_.store(head + n, std::memory_order_release);
+      return n;
+   }
+
+   bool pop(T& item) { return pop(&item, 1) == 1; }
+
+   // consumer: appends everything queued to 'out', returns how many
+   size_t pop_all(std::vector<T>& out)
+   {
+      size_t size = out.size();
+      out.resize(size + capacity());
+      size_t n = pop(out.data() + size, capacity());
+      out.resize(size + n);
+      return n;
+   }
+
+   // items queued, exact only on the consumer's side
+   size_t size() const
+   {
+      return tail_.load(std::memory_order_acquire)
+	 - head_.load(std::memory_order_acquire);
+   }
+
+private:
+   std::vector<T> ring_;
+   size_t mask_;
+
+   // written by the producer
+   alignas(KCACHE_LINE) std::atomic<size_t> tail_;
+   size_t head_cache_;   // head_ as last seen, to read it rarely
+
+   // written by the consumer
+   alignas(KCACHE_LINE) std::atomic<size_t> head_;
+   size_t tail_cache_;   // tail_ as last seen
+
+   // disallow copying
+   KSpscQueue(const KSpscQueue&);
+   KSpscQueue& operator=(const KSpscQueue&);
+};
+
+//------------------------------------------------------------------------------
+// the same with any number of producer threads. A push reserves its
+// slots with one compare-and-swap, copies its items and marks each slot
+// as published; the consumer takes the published slots in order, so
+// items of one push stay together and in order. A producer preempted
+// between reserving and publishing holds the consumer back until it
+// resumes.
+template <class T>
+class KMpscQueue {
+public:
+   static_assert(std::is_trivially_copyable<T>::value,
+		 "queued items are copied as bytes");
+
+   explicit KMpscQueue(size_t capacity)
+      :tail_(0), head_(0)
+   {
+      size_t n = 1;
+      while (n < capacity) n <<= 1;
+      ring_ = std::vector<Slot>(n);
+      for (size_t i = 0; i < n; ++i)
+	 ring_[i].seq.store(0, std::memory_order_relaxed);
+      mask_ = n - 1;
+   }
+
+   size_t capacity() const { return mask_ + 1; }
+
+   // producers: appends up to 'n' items, returns how many
+   size_t push(const T* items, size_t n)
+   {
+      size_t tail = tail_.load(std::memory_order_relaxed);
+      size_t k;
+      do {
+	 size_t head = head_.load(std::memory_order_acquire);
+	 size_t room = capacity() - (tail - head);
+	 k = n < room ? n : room;
+	 if (k == 0)
+	    return 0;
+      } while (!tail_.compare_exchange_weak(tail, tail + k,
+					    std::memory_order_relaxed));
+
+      // slot of position p is published when its seq is p + 1
+      for (size_t i = 0; i < k; ++i) {
+	 Slot& s = ring_[(tail + i) & mask_];
+	 s.item = items[i];
+	 s.seq.store(tail + i + 1, std::memory_order_release);
+      }
+      return k;
+   }
+
+   bool push(const T& item) { return push(&item, 1) == 1; }
+
+   // consumer: takes up to 'max' published items into 'out', returns
+   // how many
+   size_t pop(T* out, size_t max)
+   {
+      size_t head = head_.load(std::memory_order_relaxed);
+      size_t n = 0;
+      for (; n < max; ++n) {
+	 const Slot& s = ring_[(head + n) & mask_];
+	 if (s.seq.load(std::memory_order_acquire) != head + n + 1)
+	    break;
+	 out[n] = s.item;
+      }
+      head_.store(head + n, std::memory_order_release);
+      return n;
+   }
+
+   bool pop(T& item) { return pop(&item, 1) == 1; }
+
+   // consumer: appends everything published to 'out', returns how many
+   size_t pop_all(std::vector<T>& out)
+   {
+      size_t size = out.size();
+      out.resize(size + capacity());
+      size_t n = pop(out.data() + size, capacity());
+      out.resize(size + n);
+      return n;
+   }
+
+   // items reserved or queued, approximate
+   size_t size() const
+   {
+      return tail_.load(std::memory_order_acquire)
+	 - head_.load(std::memory_order_acquire);
+   }
+
+private:
+   struct Slot {
+      std::atomic<size_t> seq;
+      T item;
+   };
+
+   std::vector<Slot> ring_;
+   size_t mask_;
+
+   alignas(KCACHE_LINE) std::atomic<size_t> tail_;  // producers
+   alignas(KCACHE_LINE) std::atomic<size_t> head_;  // consumer
+
+   // disallow copying
+   KMpscQueue(const KMpscQueue&);
+   KMpscQueue& operator=(const KMpscQueue&);
+};
+
+//------------------------------------------------------------------------------
+
+}; // namespace Kraken
+
+//------------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,207 @@
+#include <functional>
+
+#include "kregistry.hpp"
+
+//------------------------------------------------------------------------------
+
+namespace Kraken {
+
+//------------------------------------------------------------------------------
+// helper functions to compare entries without their IDs:
+static bool same(const KAssetEntry& a, const KAssetEntry& b)
+{
+   return a.name == b.name && a.altname == b.altname &&
+      a.decimals == b.decimals && a.display_decimals == b.display_decimals;
+}
+
+static bool same(const KPairEntry& a, const KPairEntry& b)
+{
+   return a.name == b.name && a.altname == b.altname && a.wsname == b.wsname &&
+      a.base == b.base && a.quote == b.quote &&
+      a.pair_decimals == b.pair_decimals && a.lot_decimals == b.lot_decimals;
+}
+
+//------------------------------------------------------------------------------
+
+KRegistry::Aliases::Aliases()
+{
+   for (size_t i = 0; i < BUCKETS; ++i)
+      buckets_[i].store(0, std::memory_order_relaxed);
+}
+
+//------------------------------------------------------------------------------
+
+const KRegistry::Aliases::Node*
+KRegistry::Aliases::node(const std::string& alias, size_t bucket) const
+{
+   const Node* n = buckets_[bucket].load(std::memory_order_acquire);
+   while (n && n->alias != alias)
+      n = n->next;
+   return n;
+}
+
+//------------------------------------------------------------------------------
+
+int KRegistry::Aliases::find(const std::string& alias) const
+{
+   const Node* n = node(alias, std::hash<std::string>()(alias) % BUCKETS);
+   return n ? n->id.load(std::memory_order_acquire) : -1;
+}
+
+//------------------------------------------------------------------------------
+// a node is complete before it is linked, so readers never see half of
+// one:
+void KRegistry::Aliases::set(const std::string& alias, int id)
+{
+   size_t bucket = std::hash<std::string>()(alias) % BUCKETS;
+   if (const Node* n = node(alias, bucket)) {
+      const_cast<Node*>(n)->id.store(id, std::memory_order_release);
+      return;
+   }
+
+   std::unique_ptr<Node> n(new Node);
+   n->alias = alias;
+   n->id.store(id, std::memory_order_relaxed);
+   n->next = buckets_[bucket].load(std::memory_order_relaxed);
+   buckets_[bucket].store(n.get(), std::memory_order_release);
+   nodes_.push_back(std::move(n));
+}
+
+//------------------------------------------------------------------------------
+
+void KRegistry::Aliases::insert(const std::string& alias, int id)
+{
+   if (find(alias) < 0)
+      set(alias, id);
+}
+
+//------------------------------------------------------------------------------
+
+KRegistry& KRegistry::global()
+{
+   static KRegistry registry;
+   return registry;
+}
+
+//------------------------------------------------------------------------------
+
+KRegistry::KRegistry()
+{
+}
+
+//------------------------------------------------------------------------------
+// names win over aliases: an altname equal to another pair's name
+// doesn't take it over. A pair interned by one of its aliases before
+// the catalog knew it keeps its ID. The entry is published before the
+// aliases that lead to it:
+void KRegistry::put_pair(KPairEntry& e)
+{
+   e.id = -1;
+
+   const std::string* keys[] = { &e.name, &e.altname, &e.wsname };
+   for (int k = 0; k < 3; ++k) {
+      if (keys[k]->empty())
+	 continue;
+      KPairId id = pair_aliases_.find(*keys[k]);
+      if (id < 0)
+	 continue;
+      const KPairEntry& known = *pairs_.get(id);
+      if (k == 0 ? known.name == e.name
+	  : known.name == *keys[k] && known.base < 0 && known.altname.empty()) {
+	 e.id = id;
+	 break;
+      }
+   }
+
+   if (e.id >= 0 && same(*pairs_.get(e.id), e))
+      return;
+
+   pair_entries_.push_back(std::unique_ptr<KPairEntry>(new KPairEntry(e)));
+   KPairEntry* p = pair_entries_.back().get();
+   if (p->id < 0)
+      e.id = p->id = pairs_.push(p);
+   else
+      pairs_.set(p->id, p);
+
+   pair_aliases_.set(p->name, p->id);
+   if (!p->altname.empty()) pair_aliases_.insert(p->altname, p->id);
+   if (!p->wsname.empty()) pair_aliases_.insert(p->wsname, p->id);
+}
+
+//------------------------------------------------------------------------------
+// assets first, so the pairs can refer to them by registry ID; entries
+// that didn't change aren't written at all:
+void KRegistry::install(const KMetadata& meta)
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+
+   std::vector<KAssetId> asset_ids(meta.asset_count());
+   for (size_t i = 0; i < meta.asset_count(); ++i) {
+      KAssetInfo info = meta.asset(int(i));
+      KAssetEntry e;
+      e.name = info.name;
+      e.altname = info.altname;
+      e.decimals = info.decimals;
+      e.display_decimals = info.display_decimals;
+
+      e.id = asset_aliases_.find(e.name);
+      if (e.id >= 0 && assets_.get(e.id)->name != e.name)
+	 e.id = -1;
+      if (e.id >= 0 && same(*assets_.get(e.id), e)) {
+	 asset_ids[i] = e.id;
+	 continue;
+      }
+
+      asset_entries_.push_back(std::unique_ptr<KAssetEntry>(new KAssetEntry(e)));
+      KAssetEntry* a = asset_entries_.back().get();
+      if (a->id < 0)
+	 a->id = assets_.push(a);
+      else
+	 assets_.set(a->id, a);
+      asset_ids[i] = a->id;
+
+      asset_aliases_.set(a->name, a->id);
+      if (!a->altname.empty())
+	 asset_aliases_.insert(a->altname, a->id);
+   }
+
+   for (size_t i = 0; i < meta.pair_count(); ++i) {
+      KPairInfo info = meta.pair(int(i));
+      KPairEntry e;
+      e.name = info.name;
+      e.altname = info.altname;
+      e.wsname = info.wsname;
+      e.base = info.base_id < 0 ? -1 : asset_ids[info.base_id];
+      e.quote = info.quote_id < 0 ? -1 : asset_ids[info.quote_id];
+      e.pair_decimals = info.pair_decimals;
+      e.lot_decimals = info.lot_decimals;
+      put_pair(e);
+   }
+}
+
+//------------------------------------------------------------------------------
+
+KPairId KRegistry::intern_pair(const std::string& name)
+{
+   KPairId id = pair_id(name);
+   if (id >= 0 || name.empty())
+      return id;
+
+   std::lock_guard<std::mutex> lock(mutex_);
+
+   // another thread may have interned it meanwhile
+   id = pair_id(name);
+   if (id >= 0)
+      return id;
+
+   KPairEntry e;
+   e.name = name;
+   e.base = e.quote = -1;
+   e.pair_decimals = e.lot_decimals = 0;
+   put_pair(e);
+   return e.id;
+}
+
+//------------------------------------------------------------------------------
+
+}; // namespace Kraken
@@ -0,0 +1,234 @@
+#ifndef _KRAKEN_KREGISTRY_HPP_
+#define _KRAKEN_KREGISTRY_HPP_
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <stdexcept>
+
+#include "kmetadata.hpp"
+
+//------------------------------------------------------------------------------
+
+namespace Kraken {
+
+//------------------------------------------------------------------------------
+// dense IDs of interned pairs and assets, -1 for none:
+typedef int KPairId;
+typedef int KAssetId;
+
+//------------------------------------------------------------------------------
+// an interned asset:
+struct KAssetEntry {
+   KAssetId id;
+   std::string name;      // e.g. XXBT
+   std::string altname;   // e.g. XBT
+   int decimals;
+   int display_decimals;
+};
+
+//------------------------------------------------------------------------------
+// an interned pair:
+struct KPairEntry {
+   KPairId id;
+   std::string name;      // e.g. XXBTZEUR, what REST results are keyed by
+   std::string altname;   // e.g. XBTEUR
+   std::string wsname;    // e.g. XBT/EUR, what the WebSocket feed uses
+   KAssetId base;
+   KAssetId quote;
+   int pair_decimals;
+   int lot_decimals;
+};
+
+//------------------------------------------------------------------------------
+// the process wide table of pairs and assets: names, altnames and
+// wsnames all resolve to one dense ID, so per-pair state can live in
+// vectors (see KPairTable) and compare IDs instead of strings.
+//
+// IDs are given in catalog order by the first install() and never
+// change or go away afterwards: pairs added by a later catalog get new
+// IDs at the end. Lookups don't lock and don't count references: entries
+// live in chunks that never move, up to a count published atomically,
+// and aliases in chains that writers only push onto. install() and
+// intern_pair() write only what changed, entry by entry, so a lookup
+// during an install() may see some of the catalog's changes but not yet
+// others. Replaced entries are kept, a reference stays valid.
+class KRegistry {
+public:
+
+   // the registry of the process (KClient::load_metadata() fills it)
+   static KRegistry& global();
+
+   KRegistry();
+
+   // interns the assets and pairs of a catalog, updating known ones
+   void install(const KMetadata& meta);
+
+   // interns a pair the catalog doesn't know (e.g. before it is loaded)
+   KPairId intern_pair(const std::string& name);
+
+   // IDs by name or alias, -1 if unknown
+   KPairId pair_id(const std::string& alias) const { return pair_aliases_.find(alias); }
+   KAssetId asset_id(const std::string& alias) const { return asset_aliases_.find(alias); }
+
+   // entries by ID (no range check), valid for the life of the process
+   const KPairEntry& pair(KPairId id) const { return *pairs_.get(id); }
+   const KAssetEntry& asset(KAssetId id) const { return *assets_.get(id); }
+
+   size_t pair_count() const { return pairs_.size(); }
+   size_t asset_count() const { return assets_.size(); }
+
+private:
+   // entries by ID in chunks that never move; one writer at a time
+   template <class Entry>
+   class Entries {
+   public:
+      static const size_t CHUNK = 256;
+      static const size_t CHUNKS = 256;   // up to 65536 entries
+
+      Entries() :count_(0)
+      {
+	 for (size_t i = 0; i < CHUNKS; ++i)
+	    chunks_[i].store(0, std::memory_order_relaxed);
+      }
+
+      ~Entries()
+      {
+	 for (size_t i = 0; i < CHUNKS; ++i)
+	    delete[] chunks_[i].load(std::memory_order_relaxed);
+      }
+
+      size_t size() const { return count_.load(std::memory_order_acquire); }
+
+      const Entry* get(int id) const
+      {
+	 return chunks_[id / CHUNK].load(std::memory_order_acquire)
+	    [id % CHUNK].load(std::memory_order_acquire);
+      }
+
+      // replaces the entry of an ID below size()
+      void set(int id, const Entry* e)
+      {
+	 chunks_[id / CHUNK].load(std::memory_order_relaxed)
+	    [id % CHUNK].store(e, std::memory_order_release);
+      }
+
+      // adds an entry, returns its ID
+      int push(const Entry* e);
+
+   private:
+      std::atomic<std::atomic<const Entry*>*> chunks_[CHUNKS];
+      std::atomic<size_t> count_;
+
+      // disallow copying
+      Entries(const Entries&);
+      Entries& operator=(const Entries&);
+   };
+
+   // aliases to IDs: chains from a fixed number of buckets, which grow
+   // in place (a writer pushes a node at the head of its chain, readers
+   // walk them); one writer at a time
+   class Aliases {
+   public:
+      static const size_t BUCKETS = 4096;
+
+      Aliases();
+
+      // the ID of 'alias', -1 if unknown
+      int find(const std::string& alias) const;
+
+      // sets the ID of 'alias', added if new
+      void set(const std::string& alias, int id);
+
+      // adds 'alias' unless it is known
+      void insert(const std::string& alias, int id);
+
+   private:
+      struct Node {
+	 std::string alias;
+	 std::atomic<int> id;
+	 const Node* next;
+      };
+
+      const Node* node(const std::string& alias, size_t bucket) const;
+
+      std::atomic<const Node*> buckets_[BUCKETS];
+      std::vector<std::unique_ptr<Node> > nodes_;
+
+      // disallow copying
+      Aliases(const Aliases&);
+      Aliases& operator=(const Aliases&);
+   };
+
+   // adds a pair or replaces its entry
+   void put_pair(KPairEntry& e);
+
+   Entries<KPairEntry> pairs_;
+   Entries<KAssetEntry> assets_;
+   Aliases pair_aliases_;
+   Aliases asset_aliases_;
+
+   std::mutex mutex_;  // serializes writers and guards the two below
+   std::vector<std::unique_ptr<KPairEntry> > pair_entries_;
+   std::vector<std::unique_ptr<KAssetEntry> > asset_entries_;
+
+   // disallow copying
+   KRegistry(const KRegistry&);
+   KRegistry& operator=(const KRegistry&);
+};
+
+//------------------------------------------------------------------------------
+// the chunk of a new entry is allocated before the count covers it:
+template <class Entry>
+int KRegistry::Entries<Entry>::push(const Entry* e)
+{
+   size_t id = count_.load(std::memory_order_relaxed);
+   if (id == CHUNK * CHUNKS)
+      throw std::runtime_error("registry: too many entries");
+
+   std::atomic<const Entry*>* chunk =
+      chunks_[id / CHUNK].load(std::memory_order_relaxed);
+   if (!chunk) {
+      chunk = new std::atomic<const Entry*>[CHUNK];
+      for (size_t i = 0; i < CHUNK; ++i)
+	 chunk[i].store(0, std::memory_order_relaxed);
+      chunks_[id / CHUNK].store(chunk, std::memory_order_release);
+   }
+   chunk[id % CHUNK].store(e, std::memory_order_release);
+   count_.store(id + 1, std::memory_order_release);
+   return int(id);
+}
+
+//------------------------------------------------------------------------------
+// per-pair state indexed by KPairId, growing as pairs are interned:
+template <class T>
+class KPairTable {
+public:
+   T& operator[](KPairId id)
+   {
+      if (size_t(id) >= v_.size())
+	 v_.resize(id + 1);
+      return v_[id];
+   }
+
+   // 0 for pairs never touched
+   const T* find(KPairId id) const
+   {
+      return (id >= 0 && size_t(id) < v_.size()) ? &v_[id] : 0;
+   }
+
+   size_t size() const { return v_.size(); }
+
+private:
+   std::vector<T> v_;
+};
+
+//------------------------------------------------------------------------------
+
+}; // namespace Kraken
+
+//------------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,174 @@
+#include <limits>
+#include <stdexcept>
+#include "kresample.hpp"
+
+//------------------------------------------------------------------------------
+
+namespace Kraken {
+
+//------------------------------------------------------------------------------
+
+KCandleGrid::KCandleGrid(time_t from, time_t to, time_t step, size_t pairs)
+   :step_(step), pairs_(pairs), filled_(false)
+{
+   if (step <= 0)
+      throw std::runtime_error("candle grid: step must be positive");
+   if (to <= from)
+      throw std::runtime_error("candle grid: 'to' must be after 'from'");
+
+   start_ = from - (from % step);
+   steps_ = size_t((to - start_ + step - 1) / step);
+
+   // a whole number of alignments in ints, so in doubles too
+   size_t lanes = KGRID_ALIGN / sizeof(int);
+   stride_ = (steps_ + lanes - 1) / lanes * lanes;
+
+   size_t size = pairs_ * stride_;
+   open_.assign(size, 0);
+   high_.assign(size, 0);
+   low_.assign(size, 0);
+   close_.assign(size, 0);
+   vwap_.assign(size, 0);
+   volume_.assign(size, 0);
+   count_.assign(size, 0);
+
+   double nan = std::numeric_limits<double>::quiet_NaN();
+   for (size_t p = 0; p < pairs_; ++p)
+      for (size_t k = 0; k < steps_; ++k)
+	 close_[p * stride_ + k] = nan;
+
+   prior_close_.assign(pairs_, nan);
+   prior_time_.assign(pairs_, 0);
+}
+
+//------------------------------------------------------------------------------
+
+void KCandleGrid::add(size_t pair, const std::vector<KTrade>& trades)
+{
+   if (filled_)
+      throw std::runtime_error("candle grid: already filled");
+   if (pair >= pairs_)
+      throw std::runtime_error("candle grid: no such pair");
+
+   // a run of trades in one bucket is merged at once
+   for (size_t i = 0; i < trades.size(); ) {
+      const KTrade& t = trades[i++];
+      double high = t.price, low = t.price, close = t.price;
+      double pv = t.price * t.volume, volume = t.volume;
+      int count = 1;
+
+      if (t.time >= start_) {
+	 time_t begin = t.time - (t.time - start_) % step_;
+	 time_t end = begin + step_;
+	 for (; i < trades.size() && trades[i].time >= begin
+		 && trades[i].time < end; ++i) {
+	    const KTrade& u = trades[i];
+	    if (u.price > high) high = u.price;
+	    if (u.price < low) low = u.price;
+	    close = u.price;
+	    pv += u.price * u.volume;
+	    volume += u.volume;
+	    ++count;
+	 }
+      }
+
+      merge(pair, t.time, t.price, high, low, close, pv, volume, count);
+   }
+}
+
+//------------------------------------------------------------------------------
+
+void KCandleGrid::add(size_t pair, const KCandles& candles)
+{
+   if (filled_)
+      throw std::runtime_error("candle grid: already filled");
+   if (pair >= pairs_)
+      throw std::runtime_error("candle grid: no such pair");
+
+   for (size_t i = 0; i < candles.size(); ++i)
+      merge(pair, candles.time[i], candles.open[i], candles.high[i],
+	    candles.low[i], candles.close[i],
+	    candles.vwap[i] * candles.volume[i], candles.volume[i],
+	    candles.count[i]);
+}
+
+//------------------------------------------------------------------------------
+// a NaN close marks a bucket nothing was merged into yet:
+void KCandleGrid::merge(size_t pair, time_t t, double open, double high,
+			double low, double close, double pv, double volume,
+			int count)
+{
+   if (t < start_) {
+      if (t >= prior_time_[pair]) {
+	 prior_close_[pair] = close;
+	 prior_time_[pair] = t;
+      }
+      return;
+   }
+
+   size_t k = size_t((t - start_) / step_);
+   if (k >= steps_)
+      return;
+
+   size_t i = pair * stride_ + k;
+   if (close_[i] != close_[i]) {
+      open_[i] = open;
+      high_[i] = high;
+      low_[i] = low;
+      vwap_[i] = pv;
+      volume_[i] = volume;
+      count_[i] = count;
+   }
+   else {
+      if (high > high_[i]) high_[i] = high;
+      if (low < low_[i]) low_[i] = low;
+      vwap_[i] += pv;
+      volume_[i] += volume;
+      count_[i] += count;
+   }
+   close_[i] = close;
+}
+
+//------------------------------------------------------------------------------
+// buckets before a pair's first trade carry its close before the grid,
+// NaN if none was added:
+void KCandleGrid::fill(KFill rule)
+{
+   if (filled_)
+      throw std::runtime_error("candle grid: already filled");
+   filled_ = true;
+
+   double nan = std::numeric_limits<double>::quiet_NaN();
+   for (size_t p = 0; p < pairs_; ++p) {
+      double carry = rule == KFILL_CARRY ? prior_close_[p] : nan;
+
+      for (size_t i = p * stride_, end = i + steps_; i < end; ++i) {
+	 if (close_[i] != close_[i]) {
+	    open_[i] = high_[i] = low_[i] = close_[i] = vwap_[i] = carry;
+	    continue;
+	 }
+
+	 vwap_[i] = volume_[i] > 0 ? vwap_[i] / volume_[i] : close_[i];
+	 if (rule == KFILL_CARRY)
+	    carry = close_[i];
+      }
+   }
+}
+
+//------------------------------------------------------------------------------
+
+void KCandleGrid::series(size_t pair, KCandles& output) const
+{
+   if (pair >= pairs_)
+      throw std::runtime_error("candle grid: no such pair");
+
+   output.clear();
+   output.reserve(steps_);
+   for (size_t k = 0, i = pair * stride_; k < steps_; ++k, ++i)
+      output.put(time(k), open_[i], high_[i], low_[i], close_[i],
+		 vwap_[i], volume_[i], count_[i]);
+}
+
+//------------------------------------------------------------------------------
+
+}; // namespace Kraken
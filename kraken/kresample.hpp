@@ -0,0 +1,133 @@
+#ifndef _KRAKEN_KRESAMPLE_HPP_
+#define _KRAKEN_KRESAMPLE_HPP_
+
+#include <vector>
+#include <new>
+#include <cstdlib>
+#include <cstddef>
+#include <ctime>
+
+#include "ktrade.hpp"
+#include "kcandle.hpp"
+
+//------------------------------------------------------------------------------
+
+namespace Kraken {
+
+//------------------------------------------------------------------------------
+// the alignment of KCandleGrid's rows: a cache line, and the widest
+// vector registers (AVX-512)
+static const size_t KGRID_ALIGN = 64;
+
+//------------------------------------------------------------------------------
+// allocates std::vector's elements at KGRID_ALIGN:
+template <class T>
+struct KAlignedAllocator {
+   typedef T value_type;
+
+   KAlignedAllocator() { }
+   template <class U> KAlignedAllocator(const KAlignedAllocator<U>&) { }
+
+   T* allocate(size_t n)
+   {
+      void* p = 0;
+      if (posix_memalign(&p, KGRID_ALIGN, n * sizeof(T) ? n * sizeof(T) : 1))
+	 throw std::bad_alloc();
+      return static_cast<T*>(p);
+   }
+
+   void deallocate(T* p, size_t) { free(p); }
+};
+
+template <class T, class U>
+bool operator==(const KAlignedAllocator<T>&, const KAlignedAllocator<U>&)
+{ return true; }
+
+template <class T, class U>
+bool operator!=(const KAlignedAllocator<T>&, const KAlignedAllocator<U>&)
+{ return false; }
+
+//------------------------------------------------------------------------------
+// what KCandleGrid::fill() puts in buckets without trades; their volume
+// and count are 0 either way:
+enum KFill {
+   KFILL_CARRY,   // open, high, low, close and vwap are the close before
+   KFILL_NAN      // NaN prices
+};
+
+//------------------------------------------------------------------------------
+// candles of many pairs on one time grid: bucket k of every pair starts
+// at start() + k * step(), with or without trades. Each field is a
+// matrix with a row per pair, so a pair's series is contiguous and
+// computations across pairs (returns, correlations) run down aligned
+// rows: rows are stride() values apart, padded with zeros, so that each
+// starts at KGRID_ALIGN.
+//
+// Trades and candles are added pair by pair, oldest first, then fill()
+// completes the buckets without trades, once. Trades and candles older
+// than the grid give the close carried into its first buckets, newer
+// ones are ignored.
+class KCandleGrid {
+public:
+   typedef std::vector<double, KAlignedAllocator<double> > Matrix;
+   typedef std::vector<int, KAlignedAllocator<int> > CountMatrix;
+
+   // buckets of 'step' seconds from 'from' (down to a multiple of
+   // 'step', as kph groups trades) up to 'to', for 'pairs' pairs
+   KCandleGrid(time_t from, time_t to, time_t step, size_t pairs);
+
+   // adds the trades or candles of 'pair'; candles are merged into the
+   // buckets they start in
+   void add(size_t pair, const std::vector<KTrade>& trades);
+   void add(size_t pair, const KCandles& candles);
+
+   // fills the buckets without trades and computes the vwaps
+   void fill(KFill rule = KFILL_CARRY);
+
+   size_t pairs() const { return pairs_; }
+   size_t steps() const { return steps_; }
+   size_t stride() const { return stride_; }
+   time_t start() const { return start_; }
+   time_t step() const { return step_; }
+
+   // the start of bucket 'k'
+   time_t time(size_t k) const { return start_ + time_t(k) * step_; }
+
+   // the row of 'pair' in each matrix, steps() values
+   const double* open(size_t pair) const { return &open_[pair * stride_]; }
+   const double* high(size_t pair) const { return &high_[pair * stride_]; }
+   const double* low(size_t pair) const { return &low_[pair * stride_]; }
+   const double* close(size_t pair) const { return &close_[pair * stride_]; }
+   const double* vwap(size_t pair) const { return &vwap_[pair * stride_]; }
+   const double* volume(size_t pair) const { return &volume_[pair * stride_]; }
+   const int* count(size_t pair) const { return &count_[pair * stride_]; }
+
+   // the series of 'pair' as candles
+   void series(size_t pair, KCandles& output) const;
+
+private:
+   // merges a trade or a candle of 'pair' stamped 't'
+   void merge(size_t pair, time_t t, double open, double high, double low,
+	      double close, double pv, double volume, int count);
+
+   time_t start_, step_;
+   size_t pairs_, steps_, stride_;
+   bool filled_;
+
+   // until fill(), buckets without trades have a NaN close and vwap_
+   // holds the sums of price * volume
+   Matrix open_, high_, low_, close_, vwap_, volume_;
+   CountMatrix count_;
+
+   // the last close before the grid of each pair, and its time
+   std::vector<double> prior_close_;
+   std::vector<time_t> prior_time_;
+};
+
+//------------------------------------------------------------------------------
+
+}; // namespace Kraken
+
+//------------------------------------------------------------------------------
+
+#endif
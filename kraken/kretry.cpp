@@ -0,0 +1,98 @@
+#include <thread>
+#include <algorithm>
+#include "kretry.hpp"
+
+//------------------------------------------------------------------------------
+
+namespace Kraken {
+
+//------------------------------------------------------------------------------
+
+const unsigned KRetryPolicy::HEDGE_SAMPLES;
+
+//------------------------------------------------------------------------------
+
+KRetryPolicy::KRetryPolicy()
+   :attempts(1), deadline(0), backoff(100), max_backoff(5000),
+    hedge(false), hedge_percentile(95), hedge_delay(1000)
+{
+}
+
+//------------------------------------------------------------------------------
+
+KRateLimiter::KRateLimiter(double rate, double burst)
+   :rate_(rate), burst_(burst), tokens_(burst), refilled_(Clock::now()),
+    paused_until_(refilled_)
+{
+}
+
+//------------------------------------------------------------------------------
+
+void KRateLimiter::refill(Clock::time_point now)
+{
+   if (now <= refilled_)
+      return;
+   std::chrono::duration<double> elapsed = now - refilled_;
+   tokens_ = std::min(burst_, tokens_ + elapsed.count() * rate_);
+   refilled_ = now;
+}
+
+//------------------------------------------------------------------------------
+// sleeps until the next token is due and tries again, so waiters are
+// served in no particular order:
+bool KRateLimiter::acquire(Clock::time_point deadline)
+{
+   while (true) {
+      Clock::time_point due;
+      {
+	 std::lock_guard<std::mutex> lock(mutex_);
+	 Clock::time_point now = Clock::now();
+	 if (now >= paused_until_) {
+	    refill(now);
+	    if (tokens_ >= 1) {
+	       tokens_ -= 1;
+	       return true;
+	    }
+	    due = now + std::chrono::duration_cast<Clock::duration>(
+	       std::chrono::duration<double>((1 - tokens_) / rate_));
+	 }
+	 else {
+	    due = paused_until_;
+	 }
+      }
+      if (due > deadline)
+	 return false;
+      std::this_thread::sleep_until(due);
+   }
+}
+
+//------------------------------------------------------------------------------
+
+bool KRateLimiter::try_acquire()
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   Clock::time_point now = Clock::now();
+   if (now < paused_until_)
+      return false;
+   refill(now);
+   if (tokens_ < 1)
+      return false;
+   tokens_ -= 1;
+   return true;
+}
+
+//------------------------------------------------------------------------------
+// the bucket is emptied too, so requests resume at the steady rate:
+void KRateLimiter::pause(std::chrono::milliseconds pause)
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   Clock::time_point until = Clock::now() + pause;
+   if (until > paused_until_)
+      paused_until_ = until;
+   tokens_ = 0;
+   refilled_ = paused_until_;
+}
+
+//------------------------------------------------------------------------------
+
+}; // namespace Kraken
@@ -0,0 +1,84 @@
+#ifndef _KRAKEN_KRETRY_HPP_
+#define _KRAKEN_KRETRY_HPP_
+
+#include <string>
+#include <mutex>
+#include <chrono>
+
+//------------------------------------------------------------------------------
+
+namespace Kraken {
+
+//------------------------------------------------------------------------------
+// how KClient retries public methods (see KClient::set_retry()). The
+// default is a single attempt with no deadline, i.e. the first failure
+// throws.
+//
+// Failures worth a retry are connection and transfer errors, HTTP 429
+// and 5xx, and the Kraken errors EAPI:Rate limit exceeded,
+// EService:Unavailable and EService:Busy. Between attempts KClient
+// sleeps a random time up to backoff * 2^(attempt - 1) (at most
+// max_backoff), never past the deadline.
+struct KRetryPolicy {
+   KRetryPolicy();
+
+   int attempts;                          // attempts per call, at least 1
+   std::chrono::milliseconds deadline;    // per call, 0 = none
+   std::chrono::milliseconds backoff;     // before the second attempt
+   std::chrono::milliseconds max_backoff;
+
+   // with hedging, a duplicate of an attempt is sent once it has taken
+   // longer than the 'hedge_percentile' of the method's TOTAL times (with
+   // metrics and at least HEDGE_SAMPLES of them) or than 'hedge_delay',
+   // and the first response wins
+   bool hedge;
+   double hedge_percentile;
+   std::chrono::milliseconds hedge_delay;
+
+   static const unsigned HEDGE_SAMPLES = 20;
+};
+
+//------------------------------------------------------------------------------
+// a token bucket shared by the KClients that count against the same
+// limit (see KClient::set_rate_limiter()): 'rate' requests per second
+// with bursts of 'burst'.
+class KRateLimiter {
+public:
+   typedef std::chrono::steady_clock Clock;
+
+   KRateLimiter(double rate, double burst);
+
+   // takes a token, waiting for it until 'deadline'; false if there is
+   // none by then
+   bool acquire(Clock::time_point deadline = Clock::time_point::max());
+
+   // takes a token if there is one now
+   bool try_acquire();
+
+   // hands out no tokens for 'pause', after the server said the limit
+   // was exceeded
+   void pause(std::chrono::milliseconds pause);
+
+private:
+   // adds the tokens earned since the last refill, called with mutex_ held
+   void refill(Clock::time_point now);
+
+   std::mutex mutex_;
+   double rate_;
+   double burst_;
+   double tokens_;
+   Clock::time_point refilled_;
+   Clock::time_point paused_until_;
+
+   // disallow copying
+   KRateLimiter(const KRateLimiter&);
+   KRateLimiter& operator=(const KRateLimiter&);
+};
+
+//------------------------------------------------------------------------------
+
+}; // namespace Kraken
+
+//------------------------------------------------------------------------------
+
+#endif
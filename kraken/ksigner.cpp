@@ -0,0 +1,126 @@
+#include <stdexcept>
+#include <algorithm>
+#include <vector>
+#include <atomic>
+#include <sys/time.h>
+
+#include <openssl/evp.h>
+#include <openssl/sha.h>
+
+#include "ksigner.hpp"
+
+//------------------------------------------------------------------------------
+
+namespace Kraken {
+
+//------------------------------------------------------------------------------
+// the last nonce given in the process:
+static std::atomic<unsigned long long> last_nonce(0);
+
+//------------------------------------------------------------------------------
+// helper function to decode the base64 secret:
+static std::vector<unsigned char> decode_secret(const std::string& secret)
+{
+   std::vector<unsigned char> out(secret.size() / 4 * 3 + 3);
+   int n = EVP_DecodeBlock(out.data(),
+			   reinterpret_cast<const unsigned char*>(secret.data()),
+			   int(secret.size()));
+   if (n < 0)
+      throw std::runtime_error("failed while decoding base64.");
+
+   // EVP_DecodeBlock() counts the padding as zero bytes
+   for (size_t i = secret.size(); i > 0 && secret[i - 1] == '='; --i)
+      --n;
+   out.resize(n);
+   return out;
+}
+
+//------------------------------------------------------------------------------
+
+KSigner::KSigner(const std::string& secret)
+   :keyed_(HMAC_CTX_new()), work_(HMAC_CTX_new())
+{
+   if (!keyed_ || !work_) {
+      HMAC_CTX_free(keyed_);
+      HMAC_CTX_free(work_);
+      throw std::runtime_error("cannot create HMAC_CTX");
+   }
+
+   std::vector<unsigned char> k = decode_secret(secret);
+   HMAC_Init_ex(keyed_, k.data(), int(k.size()), EVP_sha512(), NULL);
+}
+
+//------------------------------------------------------------------------------
+
+KSigner::~KSigner()
+{
+   HMAC_CTX_free(work_);
+   HMAC_CTX_free(keyed_);
+}
+
+//------------------------------------------------------------------------------
+
+void KSigner::sign(const std::string& path, const char* nonce, size_t nonce_len,
+		   const std::string& postdata, HMAC_CTX* work, char* out) const
+{
+   unsigned char digest[SHA256_DIGEST_LENGTH];
+   SHA256_CTX sha;
+   SHA256_Init(&sha);
+   SHA256_Update(&sha, nonce, nonce_len);
+   SHA256_Update(&sha, postdata.data(), postdata.size());
+   SHA256_Final(digest, &sha);
+
+   unsigned char mac[EVP_MAX_MD_SIZE];
+   unsigned int mac_len = 0;
+   HMAC_CTX_copy(work, keyed_);
+   HMAC_Update(work, reinterpret_cast<const unsigned char*>(path.data()),
+	       path.size());
+   HMAC_Update(work, digest, sizeof(digest));
+   HMAC_Final(work, mac, &mac_len);
+
+   // 64 bytes are always 88 characters; EVP_EncodeBlock() adds a NUL
+   unsigned char b64[SIZE + 1];
+   EVP_EncodeBlock(b64, mac, int(mac_len));
+   std::copy(b64, b64 + SIZE, out);
+}
+
+//------------------------------------------------------------------------------
+
+std::string KSigner::sign(const std::string& path, const std::string& nonce,
+			  const std::string& postdata) const
+{
+   std::string out(SIZE, '\0');
+   sign(path, nonce.data(), nonce.size(), postdata, work_, &out[0]);
+   return out;
+}
+
+//------------------------------------------------------------------------------
+
+unsigned long long KSigner::next_nonce()
+{
+   timeval tp;
+   gettimeofday(&tp, NULL);
+   unsigned long long now = (unsigned long long)tp.tv_sec * 1000000 + tp.tv_usec;
+
+   unsigned long long last = last_nonce.load();
+   unsigned long long n;
+   do {
+      n = now > last ? now : last + 1;
+   } while (!last_nonce.compare_exchange_weak(last, n));
+   return n;
+}
+
+//------------------------------------------------------------------------------
+
+char* KSigner::format_nonce(unsigned long long nonce, char* end)
+{
+   do {
+      *--end = char('0' + nonce % 10);
+      nonce /= 10;
+   } while (nonce);
+   return end;
+}
+
+//------------------------------------------------------------------------------
+
+}; // namespace Kraken
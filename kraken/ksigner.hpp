@@ -0,0 +1,61 @@
+#ifndef _KRAKEN_KSIGNER_HPP_
+#define _KRAKEN_KSIGNER_HPP_
+
+#include <string>
+#include <openssl/hmac.h>
+
+//------------------------------------------------------------------------------
+
+namespace Kraken {
+
+//------------------------------------------------------------------------------
+// signs private requests with an API secret. The API-Sign of a request is
+//
+//   base64(hmac_sha512(path + sha256(nonce + postdata), base64decode(secret)))
+//
+// The secret is decoded and the HMAC keyed once, in the constructor;
+// signing copies the keyed context rather than keying it again.
+class KSigner {
+public:
+   // length of an API-Sign value (a base64 HMAC-SHA512)
+   static const size_t SIZE = 88;
+
+   // 'secret' as Kraken gives it, base64
+   explicit KSigner(const std::string& secret);
+
+   ~KSigner();
+
+   // writes the API-Sign of a request to 'out' (SIZE characters, not
+   // terminated), with 'work' as scratch; threads can sign at the same
+   // time with a 'work' each
+   void sign(const std::string& path, const char* nonce, size_t nonce_len,
+	     const std::string& postdata, HMAC_CTX* work, char* out) const;
+
+   // the same with the signer's own scratch, one thread at a time
+   std::string sign(const std::string& path, const std::string& nonce,
+		    const std::string& postdata) const;
+
+   // microseconds since the epoch, bumped past the last nonce given in
+   // the process when two requests fall in the same microsecond
+   static unsigned long long next_nonce();
+
+   // writes the digits of 'nonce' ending at 'end', returns where they
+   // begin (20 characters are enough)
+   static char* format_nonce(unsigned long long nonce, char* end);
+
+private:
+   HMAC_CTX* keyed_;  // keyed with the secret
+   HMAC_CTX* work_;   // scratch of sign() without one
+
+   // disallow copying
+   KSigner(const KSigner&);
+   KSigner& operator=(const KSigner&);
+};
+
+//------------------------------------------------------------------------------
+
+}; // namespace Kraken
+
+//------------------------------------------------------------------------------
+
+#endif
@@ -7,7 +7,7 @@ namespace Kraken {
 
 //------------------------------------------------------------------------------
 // construct from a JSONNode:
-KTrade::KTrade(JSONNode node) 
+KTrade::KTrade(const JSONNode& node) 
 {
    price  = node[0].as_float();
    volume = node[1].as_float();
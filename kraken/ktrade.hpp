@@ -4,11 +4,23 @@
 #include <string>
 #include <sstream>
 #include "../libjson/libjson.h"
+#include "kregistry.hpp"
 
 //------------------------------------------------------------------------------
 
 namespace Kraken { 
 
+//------------------------------------------------------------------------------
+// a trade as a fixed size record, what queues between threads carry
+// (see KSpscQueue); 'misc' is dropped, it is almost always empty:
+struct KTradeRecord {
+   double price, volume;
+   time_t time;
+   KPairId pair;   // -1 if not told
+   char order;     // KTrade::Order_t
+   char otype;     // KTrade::Otype_t
+};
+
 //------------------------------------------------------------------------------
 // deals with recent trade data:
 struct KTrade {
@@ -28,7 +40,21 @@ struct KTrade {
 	     order(KTrade::BUY) { }
 
    // construct from a JSONNode 
-   KTrade(JSONNode node);
+   KTrade(const JSONNode& node);
+
+   // construct from a record, with an empty 'misc'
+   explicit KTrade(const KTradeRecord& r)
+      :price(r.price), volume(r.volume), time(r.time),
+       otype(static_cast<Otype_t>(r.otype)),
+       order(static_cast<Order_t>(r.order)) { }
+
+   // the trade as a record of 'pair'
+   KTradeRecord record(KPairId pair = -1) const
+   {
+      KTradeRecord r = { price, volume, time, pair,
+			 static_cast<char>(order), static_cast<char>(otype) };
+      return r;
+   }
 };
 
 //------------------------------------------------------------------------------
@@ -0,0 +1,296 @@
+#include <stdexcept>
+#include <sstream>
+#include <chrono>
+#include <thread>
+#include <cstdlib>
+
+#include "ktransport.hpp"
+
+//------------------------------------------------------------------------------
+
+namespace Kraken {
+
+//------------------------------------------------------------------------------
+// first line of a recording:
+static const char RECORDING_MAGIC[] = "KRAKENAPI-RECORDING 1";
+
+//------------------------------------------------------------------------------
+// 1L logs every exchange to stderr:
+#define CURL_VERBOSE 0L
+
+//------------------------------------------------------------------------------
+// CURL write function callback:
+static size_t write_cb(char* ptr, size_t size, size_t nmemb, void* userdata)
+{
+   std::string* response = reinterpret_cast<std::string*>(userdata);
+   size_t real_size = size * nmemb;
+
+   response->append(ptr, real_size);
+   return real_size;
+}
+
+//------------------------------------------------------------------------------
+
+void setup_handle(CURL* curl, const KCurlOptions& options)
+{
+   curl_easy_setopt(curl, CURLOPT_VERBOSE, CURL_VERBOSE);
+   curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 1L);
+   curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 2L);
+   if (!options.ca_file.empty())
+      curl_easy_setopt(curl, CURLOPT_CAINFO, options.ca_file.c_str());
+   curl_easy_setopt(curl, CURLOPT_USERAGENT, "Kraken C++ API Client");
+   curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, options.http_version);
+   // "" offers every encoding curl was built with, 0 none
+   curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING,
+		    options.compression ? "" : NULL);
+   curl_easy_setopt(curl, CURLOPT_TCP_NODELAY, 1L);
+   curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+   curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_cb);
+}
+
+//------------------------------------------------------------------------------
+
+void prepare_handle(CURL* curl, const std::string& url,
+		    const std::string* body, curl_slist* headers,
+		    long timeout_ms, std::string& response)
+{
+   curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+   if (body) {
+      curl_easy_setopt(curl, CURLOPT_POSTFIELDS, body->c_str());
+      curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, long(body->size()));
+   }
+   else {
+      curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+   }
+   curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+   curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, timeout_ms);
+   curl_easy_setopt(curl, CURLOPT_WRITEDATA, static_cast<void*>(&response));
+}
+
+//------------------------------------------------------------------------------
+
+KHttpTimes handle_times(CURL* curl)
+{
+   KHttpTimes t;
+   curl_easy_getinfo(curl, CURLINFO_NAMELOOKUP_TIME_T, &t.dns);
+   curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME_T, &t.connect);
+   curl_easy_getinfo(curl, CURLINFO_APPCONNECT_TIME_T, &t.tls);
+   curl_easy_getinfo(curl, CURLINFO_PRETRANSFER_TIME_T, &t.pretransfer);
+   curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME_T, &t.start);
+   curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME_T, &t.total);
+   return t;
+}
+
+//------------------------------------------------------------------------------
+
+std::string perform_error(CURLcode result)
+{
+   std::ostringstream oss;
+   oss << "curl_easy_perform() failed: " << curl_easy_strerror(result);
+   return oss.str();
+}
+
+//------------------------------------------------------------------------------
+
+void check_perform(CURLcode result)
+{
+   if (result != CURLE_OK)
+      throw std::runtime_error(perform_error(result));
+}
+
+//------------------------------------------------------------------------------
+
+KCurlTransport::KCurlTransport(const KCurlOptions& options)
+{
+   curl_ = curl_easy_init();
+   if (!curl_)
+      throw std::runtime_error("can't create curl handle");
+   setup_handle(curl_, options);
+}
+
+//------------------------------------------------------------------------------
+
+KCurlTransport::~KCurlTransport()
+{
+   curl_easy_cleanup(curl_);
+}
+
+//------------------------------------------------------------------------------
+
+void KCurlTransport::configure(const KCurlOptions& options)
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   setup_handle(curl_, options);
+}
+
+//------------------------------------------------------------------------------
+
+CURLcode KCurlTransport::perform(const KHttpRequest& request,
+				 KHttpResponse& response)
+{
+   curl_slist* headers = NULL;
+   for (size_t i = 0; i < request.headers.size(); ++i)
+      headers = curl_slist_append(headers, request.headers[i].c_str());
+
+   std::lock_guard<std::mutex> lock(mutex_);
+   response.body.clear();
+   prepare_handle(curl_, request.url, request.post ? &request.body : 0,
+		  headers, request.timeout_ms, response.body);
+
+   CURLcode result = curl_easy_perform(curl_);
+   curl_easy_setopt(curl_, CURLOPT_HTTPHEADER, NULL);
+   curl_slist_free_all(headers);
+
+   curl_easy_getinfo(curl_, CURLINFO_RESPONSE_CODE, &response.status);
+   response.times = handle_times(curl_);
+   response.seconds = response.times.total / 1e6;
+   return result;
+}
+
+//------------------------------------------------------------------------------
+// the file is appended to, so one recording can span several runs:
+KRecorder::KRecorder(const std::shared_ptr<KTransport>& next,
+		     const std::string& path)
+   :next_(next)
+{
+   std::ifstream existing(path.c_str());
+   bool fresh = existing.peek() == std::ifstream::traits_type::eof();
+   existing.close();
+
+   out_.open(path.c_str(), std::ios::out | std::ios::app | std::ios::binary);
+   if (!out_) {
+      std::ostringstream oss;
+      oss << "can't open " << path;
+      throw std::runtime_error(oss.str());
+   }
+   if (fresh)
+      out_ << RECORDING_MAGIC << '\n';
+}
+
+//------------------------------------------------------------------------------
+// an exchange is a line
+//
+//   <G|P> <seconds> <status> <url size> <body size> <response size>
+//
+// followed by the url, the body and the response, and a newline:
+CURLcode KRecorder::perform(const KHttpRequest& request,
+			    KHttpResponse& response)
+{
+   CURLcode result = next_->perform(request, response);
+   if (result != CURLE_OK)
+      return result;
+
+   std::lock_guard<std::mutex> lock(mutex_);
+   out_ << (request.post ? 'P' : 'G') << ' ' << response.seconds << ' '
+	<< response.status << ' ' << request.url.size() << ' '
+	<< (request.post ? request.body.size() : 0) << ' '
+	<< response.body.size() << '\n'
+	<< request.url;
+   if (request.post)
+      out_ << request.body;
+   out_ << response.body << '\n';
+   out_.flush();
+   return result;
+}
+
+//------------------------------------------------------------------------------
+
+KReplayer::KReplayer(const std::string& path, Pace pace)
+   :pace_(pace), size_(0)
+{
+   std::ifstream in(path.c_str(), std::ios::in | std::ios::binary);
+   std::string magic;
+   if (!in || !std::getline(in, magic) || magic != RECORDING_MAGIC) {
+      std::ostringstream oss;
+      oss << "can't read a recording from " << path;
+      throw std::runtime_error(oss.str());
+   }
+
+   char method;
+   Exchange e;
+   size_t url_size, body_size, response_size;
+   while (in >> method >> e.seconds >> e.status
+	  >> url_size >> body_size >> response_size) {
+      in.ignore(1);
+      std::string url(url_size, '\0'), body(body_size, '\0');
+      e.body.assign(response_size, '\0');
+      in.read(&url[0], url_size);
+      in.read(&body[0], body_size);
+      in.read(&e.body[0], response_size);
+      if (!in)
+	 throw std::runtime_error("truncated recording " + path);
+
+      Queue& q = queues_[key(method == 'P', url, body)];
+      q.next = 0;
+      q.exchanges.push_back(e);
+      ++size_;
+   }
+}
+
+//------------------------------------------------------------------------------
+// private requests differ by their nonce only, so it is left out:
+std::string KReplayer::key(bool post, const std::string& url,
+			   const std::string& body)
+{
+   std::string k(post ? "P " : "G ");
+   k.append(url).append(1, ' ');
+
+   size_t begin = 0;
+   while (begin < body.size()) {
+      size_t end = body.find('&', begin);
+      if (end == std::string::npos) end = body.size();
+      if (body.compare(begin, 6, "nonce=") != 0) {
+	 if (k[k.size() - 1] != ' ') k += '&';
+	 k.append(body, begin, end - begin);
+      }
+      begin = end + 1;
+   }
+   return k;
+}
+
+//------------------------------------------------------------------------------
+
+CURLcode KReplayer::perform(const KHttpRequest& request,
+			    KHttpResponse& response)
+{
+   const Exchange* e;
+   {
+      std::lock_guard<std::mutex> lock(mutex_);
+      std::map<std::string, Queue>::iterator
+	 it = queues_.find(key(request.post, request.url,
+			       request.post ? request.body : std::string()));
+      if (it == queues_.end())
+	 throw std::runtime_error("no recorded response to " + request.url);
+
+      Queue& q = it->second;
+      e = &q.exchanges[q.next];
+      q.next = (q.next + 1) % q.exchanges.size();
+   }
+
+   if (pace_ == RECORDED)
+      std::this_thread::sleep_for(std::chrono::duration<double>(e->seconds));
+
+   response.status = e->status;
+   response.body = e->body;
+   response.seconds = e->seconds;
+   return CURLE_OK;
+}
+
+//------------------------------------------------------------------------------
+
+std::shared_ptr<KTransport> transport_from_env()
+{
+   if (const char* replay = std::getenv("KRAKENAPI_REPLAY")) {
+      KReplayer::Pace pace = std::getenv("KRAKENAPI_REPLAY_PACE")
+	 ? KReplayer::RECORDED : KReplayer::FAST;
+      return std::make_shared<KReplayer>(replay, pace);
+   }
+   if (const char* record = std::getenv("KRAKENAPI_RECORD"))
+      return std::make_shared<KRecorder>(std::make_shared<KCurlTransport>(),
+					 record);
+   return std::shared_ptr<KTransport>();
+}
+
+//------------------------------------------------------------------------------
+
+}; // namespace Kraken
@@ -0,0 +1,198 @@
+#ifndef _KRAKEN_KTRANSPORT_HPP_
+#define _KRAKEN_KTRANSPORT_HPP_
+
+#include <map>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <fstream>
+#include <curl/curl.h>
+
+//------------------------------------------------------------------------------
+
+namespace Kraken {
+
+//------------------------------------------------------------------------------
+// an HTTP exchange as KClient and KAPI make it:
+struct KHttpRequest {
+   bool post;                         // GET otherwise
+   std::string url;                   // with the query of a GET
+   std::string body;                  // of a POST
+   std::vector<std::string> headers;  // "Name: value"
+   long timeout_ms;                   // 0 = none
+
+   KHttpRequest() :post(true), timeout_ms(0) { }
+};
+
+// the times curl reports, in microseconds from the start of an exchange
+// to the end of each phase; -1 where they aren't known (e.g. replayed)
+struct KHttpTimes {
+   curl_off_t dns, connect, tls, pretransfer, start, total;
+
+   KHttpTimes() :dns(-1), connect(-1), tls(-1), pretransfer(-1), start(-1),
+		 total(-1) { }
+};
+
+struct KHttpResponse {
+   long status;       // HTTP status
+   std::string body;
+   double seconds;    // how long the exchange took
+   KHttpTimes times;  // its phases
+
+   KHttpResponse() :status(0), seconds(0) { }
+};
+
+//------------------------------------------------------------------------------
+// the options of the library's curl handles (see KClient::set_http2(),
+// set_compression() and set_ca_file()):
+struct KCurlOptions {
+   long http_version;     // CURL_HTTP_VERSION_*
+   bool compression;      // Accept-Encoding sent
+   std::string ca_file;   // CA certificates ("" = the system's)
+
+   KCurlOptions() :http_version(CURL_HTTP_VERSION_NONE), compression(false) { }
+};
+
+//------------------------------------------------------------------------------
+// what KClient, KOrderEntry and KCurlTransport do with a curl handle:
+
+// sets the options every handle has: TLS verification, user agent,
+// TCP_NODELAY and keepalive, 'options', and a write callback appending
+// to the std::string given as CURLOPT_WRITEDATA
+void setup_handle(CURL* curl, const KCurlOptions& options);
+
+// sets up the next request of 'curl': a POST of '*body', or a GET if
+// 'body' is 0, with 'headers' (0 for none) and 'timeout_ms' (0 = none);
+// the response is appended to 'response'
+void prepare_handle(CURL* curl, const std::string& url,
+		    const std::string* body, curl_slist* headers,
+		    long timeout_ms, std::string& response);
+
+// the times of the last request of 'curl'
+KHttpTimes handle_times(CURL* curl);
+
+// "curl_easy_perform() failed: " and why
+std::string perform_error(CURLcode result);
+
+// throws std::runtime_error with perform_error() if 'result' isn't
+// CURLE_OK
+void check_perform(CURLcode result);
+
+//------------------------------------------------------------------------------
+// what carries the requests of KClient and KAPI (see set_transport()),
+// libcurl unless told otherwise. Transports may be shared between
+// threads (a client and its metadata refresh share one).
+class KTransport {
+public:
+   virtual ~KTransport() { }
+
+   // makes an exchange; returns CURLE_OK, or why there is no response
+   // (an HTTP error status is a response)
+   virtual CURLcode perform(const KHttpRequest& request,
+			    KHttpResponse& response) = 0;
+
+   // takes the curl options of the client it is set on; a transport
+   // shared by clients has the options of the last one
+   virtual void configure(const KCurlOptions& options) { }
+};
+
+//------------------------------------------------------------------------------
+// libcurl, with one handle and its connection cache; concurrent exchanges
+// wait for each other:
+class KCurlTransport : public KTransport {
+public:
+   KCurlTransport(const KCurlOptions& options = KCurlOptions());
+   ~KCurlTransport();
+
+   CURLcode perform(const KHttpRequest& request, KHttpResponse& response);
+   void configure(const KCurlOptions& options);
+
+private:
+   std::mutex mutex_;    // guards curl_
+   CURL* curl_;
+
+   // disallow copying
+   KCurlTransport(const KCurlTransport&);
+   KCurlTransport& operator=(const KCurlTransport&);
+};
+
+//------------------------------------------------------------------------------
+// passes exchanges to another transport and appends them to a file, with
+// their timings, for KReplayer. Headers (API-Key, API-Sign) are not
+// recorded.
+class KRecorder : public KTransport {
+public:
+   KRecorder(const std::shared_ptr<KTransport>& next, const std::string& path);
+
+   CURLcode perform(const KHttpRequest& request, KHttpResponse& response);
+   void configure(const KCurlOptions& options) { next_->configure(options); }
+
+private:
+   std::shared_ptr<KTransport> next_;
+   std::mutex mutex_;    // guards out_
+   std::ofstream out_;
+
+   // disallow copying
+   KRecorder(const KRecorder&);
+   KRecorder& operator=(const KRecorder&);
+};
+
+//------------------------------------------------------------------------------
+// answers from a KRecorder file, without a network. A request gets the
+// responses recorded for the same method, URL and body (nonce aside) in
+// the recorded order, starting over once they are used up; one that
+// wasn't recorded throws std::runtime_error.
+class KReplayer : public KTransport {
+public:
+   enum Pace {
+      FAST,       // at once
+      RECORDED    // after the time the exchange took when recorded
+   };
+
+   KReplayer(const std::string& path, Pace pace = FAST);
+
+   CURLcode perform(const KHttpRequest& request, KHttpResponse& response);
+
+   // exchanges loaded
+   size_t size() const { return size_; }
+
+private:
+   struct Exchange {
+      long status;
+      std::string body;
+      double seconds;
+   };
+
+   struct Queue {
+      std::vector<Exchange> exchanges;
+      size_t next;
+   };
+
+   // what requests are matched by
+   static std::string key(bool post, const std::string& url,
+			  const std::string& body);
+
+   Pace pace_;
+   size_t size_;
+   std::mutex mutex_;    // guards the 'next's
+   std::map<std::string, Queue> queues_;
+
+   // disallow copying
+   KReplayer(const KReplayer&);
+   KReplayer& operator=(const KReplayer&);
+};
+
+//------------------------------------------------------------------------------
+// a transport as the environment asks: a KReplayer of the file in
+// KRAKENAPI_REPLAY (paced as recorded if KRAKENAPI_REPLAY_PACE is set),
+// a KRecorder of libcurl to the file in KRAKENAPI_RECORD, or 0
+std::shared_ptr<KTransport> transport_from_env();
+
+//------------------------------------------------------------------------------
+
+}; // namespace Kraken
+
+//------------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,625 @@
+#include <stdexcept>
+#include <sstream>
+#include <cstring>
+#include <cerrno>
+#include <cctype>
+#include <cstdint>
+
+#include <unistd.h>
+#include <strings.h>
+#include <netdb.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include <openssl/bio.h>
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include <openssl/sha.h>
+
+#include "kwebsocket.hpp"
+
+// not every platform can turn SIGPIPE off per call
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+//------------------------------------------------------------------------------
+
+namespace Kraken {
+
+//------------------------------------------------------------------------------
+// largest message accepted from the peer:
+static const size_t MAX_MESSAGE = 64 * 1024 * 1024;
+
+//------------------------------------------------------------------------------
+// helper function to build an error message with errno:
+static std::string errno_message(const char* what)
+{
+   std::ostringstream oss;
+   oss << what << ": " << std::strerror(errno);
+   return oss.str();
+}
+
+//------------------------------------------------------------------------------
+// helper function to build an error message with the OpenSSL error queue:
+static std::string ssl_message(const char* what)
+{
+   std::ostringstream oss;
+   oss << what;
+   unsigned long code = ERR_get_error();
+   if (code) {
+      char buf[256];
+      ERR_error_string_n(code, buf, sizeof(buf));
+      oss << ": " << buf;
+   }
+   ERR_clear_error();
+   return oss.str();
+}
+
+//------------------------------------------------------------------------------
+// a socket BIO that writes with MSG_NOSIGNAL: SSL_set_fd()'s BIO writes
+// with write(), so a peer's reset raised SIGPIPE in SSL_write() or
+// SSL_shutdown() and killed the process instead of throwing. The fd is
+// the BIO's data.
+static int nosignal_write(BIO* bio, const char* data, int len)
+{
+   int fd = int(reinterpret_cast<intptr_t>(BIO_get_data(bio)));
+   ssize_t n;
+   do
+      n = ::send(fd, data, size_t(len), MSG_NOSIGNAL);
+   while (n < 0 && errno == EINTR);
+
+   BIO_clear_retry_flags(bio);
+   if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+      BIO_set_retry_write(bio);
+   return int(n);
+}
+
+static int nosignal_read(BIO* bio, char* data, int len)
+{
+   int fd = int(reinterpret_cast<intptr_t>(BIO_get_data(bio)));
+   ssize_t n;
+   do
+      n = ::recv(fd, data, size_t(len), 0);
+   while (n < 0 && errno == EINTR);
+
+   BIO_clear_retry_flags(bio);
+   if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+      BIO_set_retry_read(bio);
+   return int(n);
+}
+
+static long nosignal_ctrl(BIO* bio, int cmd, long, void* ptr)
+{
+   int fd = int(reinterpret_cast<intptr_t>(BIO_get_data(bio)));
+   switch (cmd) {
+   case BIO_CTRL_FLUSH:
+      return 1;
+   case BIO_C_GET_FD:
+      if (ptr)
+	 *static_cast<int*>(ptr) = fd;
+      return fd;
+   default:
+      return 0;
+   }
+}
+
+static BIO* nosignal_bio(int fd)
+{
+   static BIO_METHOD* method = []() {
+      BIO_METHOD* m = BIO_meth_new(BIO_get_new_index() | BIO_TYPE_SOURCE_SINK
+				   | BIO_TYPE_DESCRIPTOR, "nosignal socket");
+      if (m) {
+	 BIO_meth_set_write(m, nosignal_write);
+	 BIO_meth_set_read(m, nosignal_read);
+	 BIO_meth_set_ctrl(m, nosignal_ctrl);
+      }
+      return m;
+   }();
+
+   BIO* bio = method ? BIO_new(method) : 0;
+   if (bio) {
+      BIO_set_data(bio, reinterpret_cast<void*>(intptr_t(fd)));
+      BIO_set_init(bio, 1);
+   }
+   return bio;
+}
+
+//------------------------------------------------------------------------------
+// computes the Sec-WebSocket-Accept value for a Sec-WebSocket-Key:
+static std::string accept_key(const std::string& key)
+{
+   std::string s = key + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+   unsigned char digest[SHA_DIGEST_LENGTH];
+   SHA1(reinterpret_cast<const unsigned char*>(s.data()), s.size(), digest);
+
+   unsigned char b64[4 * ((SHA_DIGEST_LENGTH + 2) / 3) + 1];
+   int len = EVP_EncodeBlock(b64, digest, SHA_DIGEST_LENGTH);
+   return std::string(reinterpret_cast<char*>(b64), len);
+}
+
+//------------------------------------------------------------------------------
+// returns the value of header 'name' in an HTTP head (case-insensitive
+// name), or an empty string:
+static std::string header_value(const std::string& head, const char* name)
+{
+   size_t name_len = std::strlen(name);
+   size_t pos = head.find("\r\n");
+
+   while (pos != std::string::npos) {
+      size_t start = pos + 2;
+      size_t end = head.find("\r\n", start);
+      if (end == std::string::npos) end = head.size();
+
+      if (end - start > name_len && head[start + name_len] == ':' &&
+	  strncasecmp(head.c_str() + start, name, name_len) == 0) {
+	 size_t v = start + name_len + 1;
+	 while (v < end && (head[v] == ' ' || head[v] == '\t')) ++v;
+	 size_t e = end;
+	 while (e > v && (head[e - 1] == ' ' || head[e - 1] == '\t')) --e;
+	 return head.substr(v, e - v);
+      }
+      pos = (end < head.size()) ? end : std::string::npos;
+   }
+   return std::string();
+}
+
+//------------------------------------------------------------------------------
+
+KWebSocket::KWebSocket()
+   :fd_(-1), ctx_(0), ssl_(0), client_(true), rpos_(0), message_opcode_(0)
+{
+}
+
+//------------------------------------------------------------------------------
+
+KWebSocket::~KWebSocket()
+{
+   close();
+}
+
+//------------------------------------------------------------------------------
+// opens a connection and makes the opening handshake:
+void KWebSocket::connect(const std::string& url)
+{
+   close();
+   client_ = true;
+
+   // split the URL into scheme, host, port and path
+   bool tls;
+   std::string rest;
+   if (url.compare(0, 6, "wss://") == 0) {
+      tls = true;
+      rest = url.substr(6);
+   }
+   else if (url.compare(0, 5, "ws://") == 0) {
+      tls = false;
+      rest = url.substr(5);
+   }
+   else {
+      throw std::runtime_error("unsupported WebSocket URL: " + url);
+   }
+
+   size_t slash = rest.find('/');
+   std::string authority = rest.substr(0, slash);
+   std::string path = (slash == std::string::npos) ? "/" : rest.substr(slash);
+
+   std::string host = authority;
+   std::string port = tls ? "443" : "80";
+   size_t colon = authority.rfind(':');
+   if (colon != std::string::npos) {
+      host = authority.substr(0, colon);
+      port = authority.substr(colon + 1);
+   }
+
+   // resolve and connect
+   addrinfo hints;
+   std::memset(&hints, 0, sizeof(hints));
+   hints.ai_family = AF_UNSPEC;
+   hints.ai_socktype = SOCK_STREAM;
+
+   addrinfo* res = 0;
+   int rc = getaddrinfo(host.c_str(), port.c_str(), &hints, &res);
+   if (rc != 0) {
+      std::ostringstream oss;
+      oss << "can't resolve " << host << ": " << gai_strerror(rc);
+      throw std::runtime_error(oss.str());
+   }
+
+   for (addrinfo* ai = res; ai && fd_ < 0; ai = ai->ai_next) {
+      fd_ = ::socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+      if (fd_ < 0) continue;
+      if (::connect(fd_, ai->ai_addr, ai->ai_addrlen) != 0) {
+	 ::close(fd_);
+	 fd_ = -1;
+      }
+   }
+   freeaddrinfo(res);
+
+   if (fd_ < 0) {
+      std::string what = "can't connect to " + authority;
+      throw std::runtime_error(errno_message(what.c_str()));
+   }
+
+   // small frames (subscriptions, pongs) shouldn't wait for Nagle
+   int one = 1;
+   setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+   try {
+      if (tls) {
+	 ctx_ = SSL_CTX_new(TLS_client_method());
+	 if (!ctx_)
+	    throw std::runtime_error(ssl_message("SSL_CTX_new() failed"));
+	 SSL_CTX_set_default_verify_paths(ctx_);
+	 SSL_CTX_set_verify(ctx_, SSL_VERIFY_PEER, 0);
+
+	 ssl_ = SSL_new(ctx_);
+	 if (!ssl_)
+	    throw std::runtime_error(ssl_message("SSL_new() failed"));
+	 SSL_set_tlsext_host_name(ssl_, host.c_str());
+	 SSL_set1_host(ssl_, host.c_str());
+	 BIO* bio = nosignal_bio(fd_);
+	 if (!bio)
+	    throw std::runtime_error(ssl_message("BIO_new() failed"));
+	 SSL_set_bio(ssl_, bio, bio);
+
+	 if (SSL_connect(ssl_) != 1) {
+	    std::string what = "TLS handshake with " + host + " failed";
+	    throw std::runtime_error(ssl_message(what.c_str()));
+	 }
+      }
+
+      // opening handshake
+      unsigned char nonce[16];
+      unsigned char b64[25];
+      RAND_bytes(nonce, sizeof(nonce));
+      int len = EVP_EncodeBlock(b64, nonce, sizeof(nonce));
+      std::string key(reinterpret_cast<char*>(b64), len);
+
+      std::ostringstream req;
+      req << "GET " << path << " HTTP/1.1\r\n"
+	  << "Host: " << authority << "\r\n"
+	  << "Upgrade: websocket\r\n"
+	  << "Connection: Upgrade\r\n"
+	  << "Sec-WebSocket-Key: " << key << "\r\n"
+	  << "Sec-WebSocket-Version: 13\r\n\r\n";
+      std::string s = req.str();
+      write_all(s.data(), s.size());
+
+      std::string head;
+      read_head(head);
+
+      if (head.compare(0, 12, "HTTP/1.1 101") != 0)
+	 throw std::runtime_error("WebSocket handshake refused: " +
+				  head.substr(0, head.find("\r\n")));
+      if (header_value(head, "Sec-WebSocket-Accept") != accept_key(key))
+	 throw std::runtime_error("WebSocket handshake: bad Sec-WebSocket-Accept");
+   }
+   catch (...) {
+      close();
+      throw;
+   }
+}
+
+//------------------------------------------------------------------------------
+// answers the opening handshake of a client:
+void KWebSocket::accept(int fd)
+{
+   close();
+   client_ = false;
+   fd_ = fd;
+
+   int one = 1;
+   setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+   try {
+      std::string head;
+      read_head(head);
+
+      std::string key = header_value(head, "Sec-WebSocket-Key");
+      if (head.compare(0, 4, "GET ") != 0 || key.empty()) {
+	 static const char bad[] = "HTTP/1.1 400 Bad Request\r\n\r\n";
+	 write_all(bad, sizeof(bad) - 1);
+	 throw std::runtime_error("not a WebSocket handshake");
+      }
+
+      std::ostringstream res;
+      res << "HTTP/1.1 101 Switching Protocols\r\n"
+	  << "Upgrade: websocket\r\n"
+	  << "Connection: Upgrade\r\n"
+	  << "Sec-WebSocket-Accept: " << accept_key(key) << "\r\n\r\n";
+      std::string s = res.str();
+      write_all(s.data(), s.size());
+   }
+   catch (...) {
+      close();
+      throw;
+   }
+}
+
+//------------------------------------------------------------------------------
+// reads up to the empty line that ends an HTTP head, bytes after it are
+// left in rbuf_ as the start of the first frame:
+void KWebSocket::read_head(std::string& head)
+{
+   size_t end;
+   while ((end = rbuf_.find("\r\n\r\n", rpos_)) == std::string::npos) {
+      if (rbuf_.size() - rpos_ > 16384)
+	 throw std::runtime_error("WebSocket handshake: HTTP head too long");
+      if (!wait_readable(10000))
+	 throw std::runtime_error("WebSocket handshake: timed out");
+      read_some();
+   }
+
+   head = rbuf_.substr(rpos_, end + 4 - rpos_);
+   rpos_ = end + 4;
+}
+
+//------------------------------------------------------------------------------
+
+void KWebSocket::send_text(const std::string& msg)
+{
+   send_frame(TEXT, msg.data(), msg.size());
+}
+
+//------------------------------------------------------------------------------
+// writes one frame with the FIN bit set:
+void KWebSocket::send_frame(int opcode, const char* data, size_t len)
+{
+   if (fd_ < 0)
+      throw std::runtime_error("WebSocket is not open");
+
+   std::string frame;
+   frame.reserve(len + 14);
+   frame += char(0x80 | opcode);
+
+   unsigned char mask_bit = client_ ? 0x80 : 0;
+   if (len < 126) {
+      frame += char(mask_bit | len);
+   }
+   else if (len <= 0xFFFF) {
+      frame += char(mask_bit | 126);
+      frame += char(len >> 8);
+      frame += char(len & 0xFF);
+   }
+   else {
+      frame += char(mask_bit | 127);
+      for (int shift = 56; shift >= 0; shift -= 8)
+	 frame += char((unsigned long long)len >> shift & 0xFF);
+   }
+
+   if (client_) {
+      unsigned char mask[4];
+      RAND_bytes(mask, sizeof(mask));
+      frame.append(reinterpret_cast<char*>(mask), 4);
+      for (size_t i = 0; i < len; ++i)
+	 frame += char(data[i] ^ mask[i & 3]);
+   }
+   else {
+      frame.append(data, len);
+   }
+
+   write_all(frame.data(), frame.size());
+}
+
+//------------------------------------------------------------------------------
+// takes one frame out of rbuf_ if it has been read completely:
+bool KWebSocket::parse_frame(int& opcode, bool& fin, std::string& payload)
+{
+   const unsigned char* p =
+      reinterpret_cast<const unsigned char*>(rbuf_.data()) + rpos_;
+   size_t avail = rbuf_.size() - rpos_;
+   if (avail < 2) return false;
+
+   fin = (p[0] & 0x80) != 0;
+   opcode = p[0] & 0x0F;
+   bool masked = (p[1] & 0x80) != 0;
+   unsigned long long len = p[1] & 0x7F;
+
+   size_t header = 2;
+   if (len == 126) {
+      if (avail < 4) return false;
+      len = (p[2] << 8) | p[3];
+      header = 4;
+   }
+   else if (len == 127) {
+      if (avail < 10) return false;
+      len = 0;
+      for (int i = 2; i < 10; ++i)
+	 len = (len << 8) | p[i];
+      header = 10;
+   }
+
+   if (len > MAX_MESSAGE)
+      throw std::runtime_error("WebSocket frame too large");
+
+   size_t mask_at = header;
+   if (masked) header += 4;
+   if (avail < header + len) return false;
+
+   payload.assign(reinterpret_cast<const char*>(p) + header, len);
+   if (masked) {
+      const unsigned char* mask = p + mask_at;
+      for (size_t i = 0; i < len; ++i)
+	 payload[i] = char(payload[i] ^ mask[i & 3]);
+   }
+
+   rpos_ += header + len;
+   return true;
+}
+
+//------------------------------------------------------------------------------
+// returns the next whole data message, handling control frames on the way:
+bool KWebSocket::receive(std::string& msg, int timeout_ms)
+{
+   if (fd_ < 0)
+      throw std::runtime_error("WebSocket is not open");
+
+   std::string payload;
+   while (true) {
+      int opcode;
+      bool fin;
+
+      while (parse_frame(opcode, fin, payload)) {
+	 switch (opcode) {
+	 case PING:
+	    send_frame(PONG, payload.data(), payload.size());
+	    break;
+	 case PONG:
+	    break;
+	 case CLOSE:
+	    if (payload.size() <= 125)
+	       send_frame(CLOSE, payload.data(), payload.size());
+	    close();
+	    throw std::runtime_error("WebSocket closed by peer");
+	 case CONTINUATION:
+	 case TEXT:
+	 case BINARY:
+	    if (opcode != CONTINUATION) {
+	       message_opcode_ = opcode;
+	       message_.clear();
+	    }
+	    if (message_.size() + payload.size() > MAX_MESSAGE)
+	       throw std::runtime_error("WebSocket message too large");
+
+	    if (fin && message_.empty()) {
+	       msg.swap(payload);
+	       return true;
+	    }
+	    message_ += payload;
+	    if (fin) {
+	       msg.swap(message_);
+	       message_.clear();
+	       return true;
+	    }
+	    break;
+	 default:
+	    throw std::runtime_error("WebSocket: unknown opcode");
+	 }
+      }
+
+      // drop the parsed bytes before reading more
+      if (rpos_) {
+	 rbuf_.erase(0, rpos_);
+	 rpos_ = 0;
+      }
+
+      if (!wait_readable(timeout_ms))
+	 return false;
+      read_some();
+   }
+}
+
+//------------------------------------------------------------------------------
+
+void KWebSocket::close()
+{
+   if (fd_ >= 0) {
+      if (ssl_) SSL_shutdown(ssl_);
+      ::close(fd_);
+      fd_ = -1;
+   }
+   if (ssl_) {
+      SSL_free(ssl_);
+      ssl_ = 0;
+   }
+   if (ctx_) {
+      SSL_CTX_free(ctx_);
+      ctx_ = 0;
+   }
+   rbuf_.clear();
+   rpos_ = 0;
+   message_.clear();
+}
+
+//------------------------------------------------------------------------------
+// waits until there is something to read, bytes already decrypted by
+// OpenSSL don't show up on the socket:
+bool KWebSocket::wait_readable(int timeout_ms)
+{
+   if (ssl_ && SSL_pending(ssl_) > 0)
+      return true;
+
+   pollfd pfd;
+   pfd.fd = fd_;
+   pfd.events = POLLIN;
+   pfd.revents = 0;
+
+   int rc;
+   do {
+      rc = ::poll(&pfd, 1, timeout_ms);
+   } while (rc < 0 && errno == EINTR);
+
+   if (rc < 0)
+      throw std::runtime_error(errno_message("poll() failed"));
+   return rc > 0;
+}
+
+//------------------------------------------------------------------------------
+// appends what can be read without blocking (after wait_readable()) to rbuf_:
+size_t KWebSocket::read_some()
+{
+   char buf[65536];
+   long n;
+
+   if (ssl_) {
+      n = SSL_read(ssl_, buf, sizeof(buf));
+      if (n <= 0) {
+	 int err = SSL_get_error(ssl_, n);
+	 // renegotiation or a partial record, just wait again
+	 if (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE)
+	    return 0;
+	 close();
+	 throw std::runtime_error(ssl_message("WebSocket connection lost"));
+      }
+   }
+   else {
+      do {
+	 n = ::recv(fd_, buf, sizeof(buf), 0);
+      } while (n < 0 && errno == EINTR);
+      if (n <= 0) {
+	 std::string what = (n == 0) ? std::string("WebSocket connection closed")
+	    : errno_message("WebSocket connection lost");
+	 close();
+	 throw std::runtime_error(what);
+      }
+   }
+
+   rbuf_.append(buf, n);
+   return n;
+}
+
+//------------------------------------------------------------------------------
+
+void KWebSocket::write_all(const char* data, size_t len)
+{
+   while (len) {
+      long n;
+      if (ssl_) {
+	 n = SSL_write(ssl_, data, len);
+	 if (n <= 0) {
+	    close();
+	    throw std::runtime_error(ssl_message("WebSocket write failed"));
+	 }
+      }
+      else {
+	 n = ::send(fd_, data, len, MSG_NOSIGNAL);
+	 if (n < 0) {
+	    if (errno == EINTR) continue;
+	    std::string what = errno_message("WebSocket write failed");
+	    close();
+	    throw std::runtime_error(what);
+	 }
+      }
+      data += n;
+      len -= n;
+   }
+}
+
+//------------------------------------------------------------------------------
+
+}; // namespace Kraken
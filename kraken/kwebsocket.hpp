@@ -0,0 +1,88 @@
+#ifndef _KRAKEN_KWEBSOCKET_HPP_
+#define _KRAKEN_KWEBSOCKET_HPP_
+
+#include <string>
+#include <cstddef>
+#include <openssl/ssl.h>
+
+//------------------------------------------------------------------------------
+
+namespace Kraken {
+
+//------------------------------------------------------------------------------
+// a minimal RFC 6455 WebSocket endpoint over a blocking socket, with TLS
+// for wss:// URLs. Clients call connect(), servers (e.g. a local test
+// server) call accept() on a socket returned by ::accept(). Text and
+// binary messages are returned whole; pings are answered and close
+// frames are acknowledged inside receive().
+//
+// receive() and send_text() may not be called concurrently: an SSL
+// connection can't be read and written from two threads at once.
+class KWebSocket {
+public:
+
+   KWebSocket();
+
+   // closes the connection
+   ~KWebSocket();
+
+   // opens a connection to ws://host[:port][/path] or wss://...
+   void connect(const std::string& url);
+
+   // takes over an accepted plain TCP socket and answers its handshake
+   void accept(int fd);
+
+   // sends a text message
+   void send_text(const std::string& msg);
+
+   // waits up to 'timeout_ms' milliseconds (-1 = forever) for a message,
+   // returns false on timeout. Throws std::runtime_error when the
+   // connection fails or is closed by the peer.
+   bool receive(std::string& msg, int timeout_ms);
+
+   // sends a close frame (if still open) and releases the connection
+   void close();
+
+   // true between a successful connect()/accept() and close()
+   bool is_open() const { return fd_ >= 0; }
+
+private:
+   enum Opcode_t { CONTINUATION=0x0, TEXT=0x1, BINARY=0x2,
+		   CLOSE=0x8, PING=0x9, PONG=0xA };
+
+   // writes a single frame, masked when this is the client side
+   void send_frame(int opcode, const char* data, size_t len);
+
+   // tries to take a whole frame out of rbuf_, returns false if more
+   // bytes are needed
+   bool parse_frame(int& opcode, bool& fin, std::string& payload);
+
+   // reads the HTTP head of the handshake into 'head'
+   void read_head(std::string& head);
+
+   // raw I/O on the socket, or on the SSL connection if any
+   bool wait_readable(int timeout_ms);
+   size_t read_some();
+   void write_all(const char* data, size_t len);
+
+   int fd_;          // socket, -1 when closed
+   SSL_CTX* ctx_;    // TLS context (wss:// only)
+   SSL* ssl_;        // TLS connection (wss:// only)
+   bool client_;     // client frames are masked, server frames aren't
+   std::string rbuf_;     // bytes read from the socket
+   size_t rpos_;          // where the unparsed bytes of rbuf_ start
+   std::string message_;  // fragments of the message being received
+   int message_opcode_;   // opcode of the first fragment
+
+   // disallow copying
+   KWebSocket(const KWebSocket&);
+   KWebSocket& operator=(const KWebSocket&);
+};
+
+//------------------------------------------------------------------------------
+
+}; // namespace Kraken
+
+//------------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,248 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include "kwriter.hpp"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+//------------------------------------------------------------------------------
+
+namespace Kraken {
+
+//------------------------------------------------------------------------------
+// true if 'c' can't appear unescaped in a JSON string:
+static inline bool needs_escape(unsigned char c)
+{
+   return c < 0x20 || c == '"' || c == '\\';
+}
+
+//------------------------------------------------------------------------------
+// returns the length of the prefix of 'str' that needs no escaping:
+static size_t safe_prefix(const char* str, size_t len)
+{
+   size_t i = 0;
+
+#ifdef __SSE2__
+   // 16 bytes at a time: a byte needs escaping when it is below 0x20
+   // (max(byte, 0x1f) == 0x1f) or equal to '"' or '\\'
+   const __m128i ctrl  = _mm_set1_epi8(0x1f);
+   const __m128i quote = _mm_set1_epi8('"');
+   const __m128i slash = _mm_set1_epi8('\\');
+
+   for (; i + 16 <= len; i += 16) {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(str + i));
+      __m128i m = _mm_or_si128(_mm_cmpeq_epi8(_mm_max_epu8(v, ctrl), ctrl),
+			       _mm_or_si128(_mm_cmpeq_epi8(v, quote),
+					    _mm_cmpeq_epi8(v, slash)));
+      int mask = _mm_movemask_epi8(m);
+      if (mask)
+	 return i + __builtin_ctz(mask);
+   }
+#endif
+
+   for (; i < len; ++i)
+      if (needs_escape(str[i])) break;
+   return i;
+}
+
+//------------------------------------------------------------------------------
+// appends 'str' between double quotes, escaped:
+void KWriter::quoted(const char* str, size_t len)
+{
+   static const char hex[] = "0123456789abcdef";
+
+   out_ += '"';
+   while (len) {
+      size_t n = safe_prefix(str, len);
+      out_.append(str, n);
+      if (n == len) break;
+
+      unsigned char c = str[n];
+      char esc[6] = { '\\', 0, 0, 0, 0, 0 };
+      size_t esc_len = 2;
+      switch (c) {
+      case '"':  esc[1] = '"';  break;
+      case '\\': esc[1] = '\\'; break;
+      case '\b': esc[1] = 'b';  break;
+      case '\f': esc[1] = 'f';  break;
+      case '\n': esc[1] = 'n';  break;
+      case '\r': esc[1] = 'r';  break;
+      case '\t': esc[1] = 't';  break;
+      default:
+	 esc[1] = 'u'; esc[2] = '0'; esc[3] = '0';
+	 esc[4] = hex[c >> 4]; esc[5] = hex[c & 0xf];
+	 esc_len = 6;
+      }
+      out_.append(esc, esc_len);
+
+      str += n + 1;
+      len -= n + 1;
+   }
+   out_ += '"';
+}
+
+//------------------------------------------------------------------------------
+
+KWriter& KWriter::key(const char* str, size_t len)
+{
+   separator();
+   quoted(str, len);
+   out_ += ':';
+   comma_ = false;
+   return *this;
+}
+
+KWriter& KWriter::key(const char* str)
+{
+   return key(str, std::strlen(str));
+}
+
+//------------------------------------------------------------------------------
+
+KWriter& KWriter::value(const char* str, size_t len)
+{
+   separator();
+   quoted(str, len);
+   comma_ = true;
+   return *this;
+}
+
+KWriter& KWriter::value(const char* str)
+{
+   return value(str, std::strlen(str));
+}
+
+//------------------------------------------------------------------------------
+
+KWriter& KWriter::value(unsigned long long n)
+{
+   char buf[24];
+   char* p = buf + sizeof(buf);
+   do {
+      *--p = char('0' + n % 10);
+      n /= 10;
+   } while (n);
+
+   separator();
+   out_.append(p, buf + sizeof(buf) - p);
+   comma_ = true;
+   return *this;
+}
+
+KWriter& KWriter::value(long long n)
+{
+   if (n >= 0)
+      return value((unsigned long long)n);
+
+   separator();
+   out_ += '-';
+   comma_ = false;
+   // negate as unsigned so that LLONG_MIN doesn't overflow
+   return value(0ULL - (unsigned long long)n);
+}
+
+//------------------------------------------------------------------------------
+// writes 'n' as the shortest decimal with at most 17 fractional digits
+// that reads back as 'n', returns 0 if there is none whose digits fit in
+// 53 bits (prices and volumes read from decimal text usually have one):
+static int format_decimal(double n, char* buf)
+{
+   static const double pow10[] = {
+      1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8,
+      1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17
+   };
+   const double max_digits = 9007199254740992.0; // 2^53
+
+   bool negative = std::signbit(n);
+   double a = std::fabs(n);
+   if (a != 0 && (a < 1e-5 || a >= 1e15))
+      return 0;
+
+   for (int d = 0; d < 18 && a * pow10[d] < max_digits; ++d) {
+      // m / 10^d is correctly rounded, just like strtod() of its digits
+      double m = std::floor(a * pow10[d] + 0.5);
+      if (m / pow10[d] != a)
+	 continue;
+
+      char digits[24];
+      char* end = digits + sizeof(digits);
+      char* p = end;
+      unsigned long long u = (unsigned long long)m;
+      do {
+	 *--p = char('0' + u % 10);
+	 u /= 10;
+      } while (u);
+      while (end - p <= d)
+	 *--p = '0';
+
+      int len = 0;
+      if (negative) buf[len++] = '-';
+      int whole = int(end - p) - d;
+      std::memcpy(buf + len, p, whole);
+      len += whole;
+      if (d) {
+	 buf[len++] = '.';
+	 std::memcpy(buf + len, p + whole, d);
+	 len += d;
+      }
+      return len;
+   }
+   return 0;
+}
+
+//------------------------------------------------------------------------------
+// doubles are written as the shortest text that reads back the same
+// value: format_decimal() covers the usual prices and volumes, anything
+// else takes the shortest of %.15g, %.16g and %.17g that round trips (17
+// significant digits always do):
+KWriter& KWriter::value(double n)
+{
+   if (!std::isfinite(n))
+      return null();
+
+   char buf[32];
+   int len = format_decimal(n, buf);
+   for (int prec = 15; !len && prec <= 17; ++prec) {
+      int l = std::snprintf(buf, sizeof(buf), "%.*g", prec, n);
+      if (prec == 17 || std::strtod(buf, 0) == n) len = l;
+   }
+
+   separator();
+   out_.append(buf, len);
+   comma_ = true;
+   return *this;
+}
+
+//------------------------------------------------------------------------------
+
+KWriter& KWriter::value(bool b)
+{
+   separator();
+   if (b) out_.append("true", 4);
+   else   out_.append("false", 5);
+   comma_ = true;
+   return *this;
+}
+
+KWriter& KWriter::null()
+{
+   separator();
+   out_.append("null", 4);
+   comma_ = true;
+   return *this;
+}
+
+KWriter& KWriter::raw(const char* json, size_t len)
+{
+   separator();
+   out_.append(json, len);
+   comma_ = true;
+   return *this;
+}
+
+//------------------------------------------------------------------------------
+
+}; // namespace Kraken
@@ -0,0 +1,89 @@
+#ifndef _KRAKEN_KWRITER_HPP_
+#define _KRAKEN_KWRITER_HPP_
+
+#include <string>
+#include <cstddef>
+
+//------------------------------------------------------------------------------
+
+namespace Kraken {
+
+//------------------------------------------------------------------------------
+// writes compact JSON straight into a caller's buffer, without building
+// a JSONNode tree first:
+//
+//    std::string buf;
+//    KWriter w(buf);
+//    w.begin_object().key("pair").value("XXBTZEUR")
+//     .key("price").value(30000.1).end_object();
+//
+// the buffer is only appended to, so it can be reused between messages
+// (clear() keeps its capacity). Strings are expected to be UTF-8 and are
+// written as they are, apart from the escapes JSON requires.
+class KWriter {
+public:
+
+   // appends to 'out'
+   explicit KWriter(std::string& out)
+      :out_(out), comma_(false) { }
+
+   KWriter& begin_object() { open('{'); return *this; }
+   KWriter& end_object()   { close('}'); return *this; }
+   KWriter& begin_array()  { open('['); return *this; }
+   KWriter& end_array()    { close(']'); return *this; }
+
+   // writes the name of the next member of an object
+   KWriter& key(const char* str, size_t len);
+   KWriter& key(const char* str);
+   KWriter& key(const std::string& str) { return key(str.data(), str.size()); }
+
+   // strings
+   KWriter& value(const char* str, size_t len);
+   KWriter& value(const char* str);
+   KWriter& value(const std::string& str) { return value(str.data(), str.size()); }
+
+   // numbers, doubles use the shortest text that reads back the same
+   // value, NaN and infinities are written as null
+   KWriter& value(int n)                { return value((long long)n); }
+   KWriter& value(long n)               { return value((long long)n); }
+   KWriter& value(long long n);
+   KWriter& value(unsigned int n)       { return value((unsigned long long)n); }
+   KWriter& value(unsigned long n)      { return value((unsigned long long)n); }
+   KWriter& value(unsigned long long n);
+   KWriter& value(double n);
+
+   KWriter& value(bool b);
+   KWriter& null();
+
+   // appends already serialized JSON as the next value
+   KWriter& raw(const char* json, size_t len);
+   KWriter& raw(const std::string& json) { return raw(json.data(), json.size()); }
+
+   // the buffer being written to
+   std::string& buffer() const { return out_; }
+
+private:
+   // writes the ',' between members and elements
+   void separator() { if (comma_) out_ += ','; }
+
+   void open(char c)  { separator(); out_ += c; comma_ = false; }
+   void close(char c) { out_ += c; comma_ = true; }
+
+   // appends 'str' between double quotes, escaped
+   void quoted(const char* str, size_t len);
+
+   std::string& out_;
+   bool comma_;  // a value has been written at the current level
+
+   // disallow copying
+   KWriter(const KWriter&);
+   KWriter& operator=(const KWriter&);
+};
+
+//------------------------------------------------------------------------------
+
+}; // namespace Kraken
+
+//------------------------------------------------------------------------------
+
+#endif
@@ -1,13 +1,18 @@
 #include <iostream>
 #include <iomanip>
+#include <fstream>
 #include <sstream>
 #include <stdexcept>
 #include <ctime>
+#include <cstdio>
 
 #include <chrono>
 #include <thread>
+#include <memory>
 
 #include "kraken/kclient.hpp"
+#include "kraken/kfeed.hpp"
+#include "kraken/kpoll.hpp"
 #include "libjson/libjson.h"
 
 using namespace std;
@@ -109,6 +114,137 @@ ostream& operator<<(ostream& os, const KAsset_pair& a)
 	     << '"';
 }
 
+//------------------------------------------------------------------------------
+// a pair followed in daemon mode:
+struct Follow {
+   string pair;
+   string last;               // the cursor, since of the next request
+   string last_path;          // where it is saved, <dir>/<pair>.last
+   ofstream out;              // trades, <dir>/<pair>.csv
+};
+
+//------------------------------------------------------------------------------
+// reads the pairs of daemon mode: "<pair>,<pair>,..." or "@<file>", a
+// file with a pair per line, each optionally followed by its since
+// (lines starting with # are comments):
+static vector<pair<string, string> > read_pairs(const string& arg)
+{
+   vector<pair<string, string> > pairs;
+
+   if (arg.empty() || arg[0] != '@') {
+      istringstream list(arg);
+      for (string p; getline(list, p, ','); )
+	 if (!p.empty()) pairs.push_back(make_pair(p, string("0")));
+      return pairs;
+   }
+
+   ifstream in(arg.substr(1).c_str());
+   if (!in)
+      throw runtime_error("can't read " + arg.substr(1));
+   for (string line; getline(in, line); ) {
+      istringstream fields(line);
+      string p, since = "0";
+      if (!(fields >> p) || p[0] == '#') continue;
+      fields >> since;
+      pairs.push_back(make_pair(p, since));
+   }
+   return pairs;
+}
+
+//------------------------------------------------------------------------------
+// saves the cursor of a pair, atomically (temporary file and rename):
+static void save_cursor(const Follow& f)
+{
+   string tmp = f.last_path + ".tmp";
+   {
+      ofstream out(tmp.c_str(), ios::out | ios::trunc);
+      out << f.last << endl;
+      if (!out) throw runtime_error("can't write " + tmp);
+   }
+   if (rename(tmp.c_str(), f.last_path.c_str()) != 0)
+      throw runtime_error("can't write " + f.last_path);
+}
+
+//------------------------------------------------------------------------------
+// follows every pair from one loop on one KClient (one connection and
+// one rate limit): the pair due first is polled and its trades appended
+// to its file. When a pair is due is up to a KPollScheduler, which
+// spends the rate limit where trades come most often, every pair polled
+// between 'min' and 'max' seconds apart; a failed poll counts as one
+// without trades. Cursors saved by an earlier run take the place of the
+// given since.
+static void run_daemon(const vector<pair<string, string> >& pairs,
+		       const string& dir, double min, double max)
+{
+   typedef chrono::system_clock Clock;
+
+   if (pairs.empty())
+      throw runtime_error("no pairs to follow");
+
+   // about 1 public call/s is allowed
+   const double budget = 1;
+   KPollScheduler scheduler(budget, min, max);
+
+   vector<unique_ptr<Follow> > follows;
+   for (size_t i = 0; i < pairs.size(); ++i) {
+      unique_ptr<Follow> f(new Follow);
+      f->pair = pairs[i].first;
+      f->last = pairs[i].second;
+      f->last_path = dir + "/" + f->pair + ".last";
+
+      ifstream saved(f->last_path.c_str());
+      string last;
+      if (saved >> last) f->last = last;
+
+      string out_path = dir + "/" + f->pair + ".csv";
+      f->out.open(out_path.c_str(), ios::out | ios::app);
+      if (!f->out)
+	 throw runtime_error("can't open " + out_path);
+      follows.push_back(std::move(f));
+      scheduler.add();
+   }
+
+   KClient kc;
+   kc.set_transport(transport_from_env());
+
+   // ride out transient failures
+   KRetryPolicy retry;
+   retry.attempts = 5;
+   retry.deadline = chrono::seconds(30);
+   kc.set_retry(retry);
+   kc.set_rate_limiter(make_shared<KRateLimiter>(budget, 1));
+
+   vector<KTrade> vt;
+   vector<double> times;
+   while (true) {
+      double due;
+      size_t next = scheduler.next(due);
+      this_thread::sleep_until(Clock::time_point(
+	 chrono::duration_cast<Clock::duration>(chrono::duration<double>(due))));
+
+      Follow& f = *follows[next];
+      times.clear();
+      try {
+	 f.last = kc.trades(f.pair, f.last, vt);
+	 for (size_t i = 0; i < vt.size(); ++i) {
+	    f.out << vt[i] << '\n';
+	    times.push_back(double(vt[i].time));
+	 }
+	 f.out.flush();
+	 save_cursor(f);
+      }
+      catch(exception& e) {
+	 cerr << "Error: " << f.pair << ": " << e.what() << endl;
+      }
+
+      // a full page (1000 trades) means more are waiting
+      double now = chrono::duration<double>(
+	 Clock::now().time_since_epoch()).count();
+      scheduler.polled(next, now, times.data(), times.size(),
+		       times.size() >= 1000);
+   }
+}
+
 //------------------------------------------------------------------------------
 
 int main(int argc, char* argv[]) 
@@ -123,7 +259,53 @@ int main(int argc, char* argv[])
       //
       // usage:
       //     krt <pair> [interval] [since]
+      //     krt <wsname> ws [url]
+      //     krt <pairs> daemon <dir> [min] [max]
       // 
+      // KRAKENAPI_RECORD and KRAKENAPI_REPLAY record and replay the
+      // REST exchanges (see transport_from_env()).
+      //
+
+      // stream trades from the WebSocket feed instead of polling
+      if (argc >= 3 && string(argv[2]) == "ws") {
+	 if (argc > 4)
+	    throw runtime_error("wrong number of arguments");
+
+	 KFeed feed(argc == 4 ? argv[3] : "wss://ws.kraken.com");
+	 feed.on_trades([](const string&, const vector<KTrade>& vt) {
+	       for (size_t i = 0; i < vt.size(); ++i)
+		  cout << vt[i] << endl;
+	    });
+	 feed.on_error([](const string& what) {
+	       cerr << "Error: " << what << endl;
+	    });
+	 feed.subscribe_trades(vector<string>(1, argv[1]));
+	 feed.start();
+
+	 // trades are printed by the feed's thread until krt is killed
+	 while (true)
+	    this_thread::sleep_for(chrono::hours(1));
+      }
+
+      // follow many pairs, a file each, until krt is killed
+      if (argc >= 4 && string(argv[2]) == "daemon") {
+	 int min = 1, max = 60;
+
+	 switch (argc) {
+	 case 6:
+	    istringstream(argv[5]) >> max;
+	 case 5:
+	    istringstream(argv[4]) >> min;
+	 case 4:
+	    break;
+	 default:
+	    throw runtime_error("wrong number of arguments");
+	 };
+	 if (min <= 0 || max < min)
+	    throw runtime_error("intervals must be positive, [min] <= [max]");
+
+	 run_daemon(read_pairs(argv[1]), argv[3], min, max);
+      }
 
       string pair;
       string last = "0"; // by default: the oldest possible trade data
@@ -144,8 +326,16 @@ int main(int argc, char* argv[])
       chrono::seconds dura(interval);
 
       KClient kc;
+      kc.set_transport(transport_from_env());
       vector<KTrade> vt;
 
+      // ride out transient failures (about 1 public call/s is allowed)
+      KRetryPolicy retry;
+      retry.attempts = 5;
+      retry.deadline = chrono::seconds(30);
+      kc.set_retry(retry);
+      kc.set_rate_limiter(make_shared<KRateLimiter>(1, 1));
+
       while (true) {
 	 // store and print trades
 	 last = kc.trades(pair, last, vt);
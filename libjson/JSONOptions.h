@@ -38,6 +38,14 @@
 //#define JSON_ISO_STRICT
 
 
+/*
+ *  JSON_OBJECT_STATS counts the constructors, copies, assignments and destructors of every
+ *  libjson object and prints them when the program exits.  It is independent of JSON_DEBUG,
+ *  so that debug builds don't pay for the counters on every node they create
+ */
+//#define JSON_OBJECT_STATS
+
+
 /*
  *  JSON_SAFE performs similarly to JSON_DEBUG, except this option does protect
  *  from the errors that it encounters.  This option is recommended for those who
@@ -90,6 +98,27 @@
 #define JSON_REF_COUNT
 
 
+/*
+ *  JSON_THREAD_SAFE_REF_COUNT makes the reference counts of JSONNodes atomic, so that
+ *  copies of the same tree can be created, read and destroyed by several threads at once
+ *  without external locks or deep copies.  Call preparse() on the root before sharing it,
+ *  after that the const interface of the tree never writes to the shared nodes, and the
+ *  non-const interface copies on write as usual.  Requires JSON_REF_COUNT and C++11
+ */
+//#define JSON_THREAD_SAFE_REF_COUNT
+
+
+/*
+ *  JSON_PARALLEL_ARRAYS makes libjson split arrays that are at least this many characters
+ *  long into chunks at row boundaries, parse the chunks on all cores and put the children
+ *  back together in order.  It pays off for big arrays of small rows, like trade histories.
+ *  If the rows can't be split safely the array is parsed on one thread as usual.  It is
+ *  ignored when JSON_OBJECT_STATS is on, and can not be used with JSON_MEMORY_POOL.  Requires C++11
+ *  JSON_PARALLEL_CHUNKS sets the number of chunks, the number of cores by default
+ */
+//#define JSON_PARALLEL_ARRAYS 262144
+
+
 /*
  *  JSON_BINARY is used to support binary, which is base64 encoded and decoded by libjson,
  *  if this option is not turned off, no base64 support is included
@@ -73,6 +73,18 @@
 #endif
 
 
+/* rvalue references let temporaries hand over their strings and internals */
+#if !defined(JSON_NO_MOVE_SEMANTICS) && ((__cplusplus >= 201103L) || (defined(_MSC_VER) && _MSC_VER >= 1600))
+    #define JSON_MOVE_SEMANTICS
+    #define JSON_MOVE(x) std::move(x)
+    #ifdef __cplusplus
+	   #include <utility>
+    #endif
+#else
+    #define JSON_MOVE(x) x
+#endif
+
+
 #ifdef JSON_NUMBER_TYPE
 	typedef JSON_NUMBER_TYPE json_number;
 	#define JSON_FLOAT_THRESHHOLD 0.00001
@@ -173,6 +185,19 @@ typedef void (*json_free_t)(void *);
 	   #error, JSON_STREAM also requires JSON_READ_PRIORITY
     #endif
 #endif
+#ifdef JSON_THREAD_SAFE_REF_COUNT
+    #ifndef JSON_REF_COUNT
+	   #error, JSON_THREAD_SAFE_REF_COUNT also requires JSON_REF_COUNT
+    #endif
+    #ifdef JSON_LESS_MEMORY
+	   #error, JSON_THREAD_SAFE_REF_COUNT can not be used with JSON_LESS_MEMORY (packed atomics)
+    #endif
+#endif
+#ifdef JSON_PARALLEL_ARRAYS
+    #ifdef JSON_MEMORY_POOL
+	   #error, JSON_PARALLEL_ARRAYS can not be used with JSON_MEMORY_POOL
+    #endif
+#endif
 #ifdef JSON_VALIDATE
     #ifndef JSON_READ_PRIORITY
 	   #error, JSON_VALIDATE also requires JSON_READ_PRIORITY
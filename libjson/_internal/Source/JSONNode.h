@@ -137,6 +137,10 @@ public:
     DECLARE_FOR_ALL_TYPES(DECLARE_CTOR)
 
     JSONNode(const JSONNode & orig) json_nothrow json_hot;
+    #ifdef JSON_MOVE_SEMANTICS
+	   //a moved from node can only be destroyed or assigned another JSONNode
+	   JSONNode(JSONNode && orig) json_nothrow json_hot;
+    #endif
     ~JSONNode(void) json_nothrow json_hot;
     
     #if (defined(JSON_PREPARSE) && defined(JSON_READ_PRIORITY))
@@ -195,6 +199,9 @@ public:
 	   void push_back(JSONNode * node) json_nothrow;
     #else
 	   void push_back(const JSONNode & node) json_nothrow;
+	   #ifdef JSON_MOVE_SEMANTICS
+		  void push_back(JSONNode && node) json_nothrow;
+	   #endif
     #endif
     void reserve(json_index_t siz) json_nothrow;
     JSONNode JSON_PTR_LIB pop_back(json_index_t pos) json_throws(std::out_of_range);
@@ -205,6 +212,9 @@ public:
 
     DECLARE_FOR_ALL_TYPES(JSONNode & operator =)
     JSONNode & operator = (const JSONNode &) json_nothrow;
+    #ifdef JSON_MOVE_SEMANTICS
+	   JSONNode & operator = (JSONNode &&) json_nothrow;
+    #endif
 
     DECLARE_FOR_ALL_TYPES_CONST(bool operator ==)
     DECLARE_FOR_ALL_TYPES_CONST(bool operator !=)
@@ -533,7 +543,7 @@ JSON_PRIVATE
     static JSONNode * newJSONNode(internalJSONNode * internal_t) json_hot;
     #ifdef JSON_READ_PRIORITY
 	   //used by JSONWorker
-	   JSONNode(const json_string & unparsed) json_nothrow : internal(internalJSONNode::newInternal(unparsed)){ //root, specialized because it can only be array or node
+	   JSONNode(json_string unparsed) json_nothrow : internal(internalJSONNode::newInternal(JSON_MOVE(unparsed))){ //root, specialized because it can only be array or node
 		  LIBJSON_CTOR;
 	   }
     #endif
@@ -602,6 +612,13 @@ inline JSONNode::JSONNode(const JSONNode & orig) json_nothrow : internal(orig.in
     LIBJSON_COPY_CTOR;
 }
 
+#ifdef JSON_MOVE_SEMANTICS
+    inline JSONNode::JSONNode(JSONNode && orig) json_nothrow : internal(orig.internal){
+	   orig.internal = 0;
+	   LIBJSON_CTOR;
+    }
+#endif
+
 //this allows a temp node to simply transfer its contents, even with ref counting off
 inline JSONNode::JSONNode(bool, JSONNode & orig) json_nothrow : internal(orig.internal){
     orig.internal = 0;
@@ -716,21 +733,40 @@ inline void JSONNode::push_back(const JSONNode & child) json_nothrow{
     internal -> push_back(child);
 }
 
+#if defined(JSON_MOVE_SEMANTICS) && !defined(JSON_LIBRARY)
+    inline void JSONNode::push_back(JSONNode && child) json_nothrow{
+	   JSON_CHECK_INTERNAL();
+	   makeUniqueInternal();
+	   internal -> push_back(JSON_MOVE(child));
+    }
+#endif
+
 inline void JSONNode::reserve(json_index_t siz) json_nothrow{
     makeUniqueInternal();
     internal -> reserve(siz);
 }
 
 inline JSONNode & JSONNode::operator = (const JSONNode & orig) json_nothrow {
-    JSON_CHECK_INTERNAL();
+    JSON_ASSERT(orig.internal != 0, JSON_TEXT("assigning a moved from node"));
     #ifdef JSON_REF_COUNT
 	   if (internal == orig.internal) return *this;  //don't want it accidentally deleting itself
     #endif
-    decRef();  //dereference my current one
+    if (internal != 0) decRef();  //dereference my current one, unless I was moved from
     internal = orig.internal -> incRef();  //increase reference of original
     return *this;
 }
 
+#ifdef JSON_MOVE_SEMANTICS
+    inline JSONNode & JSONNode::operator = (JSONNode && orig) json_nothrow {
+	   JSON_ASSERT(orig.internal != 0, JSON_TEXT("assigning a moved from node"));
+	   if (this == &orig) return *this;
+	   if (internal != 0) decRef();
+	   internal = orig.internal;  //no reference changes hands twice
+	   orig.internal = 0;
+	   return *this;
+    }
+#endif
+
 #ifndef JSON_LIBRARY
     inline JSONNode & JSONNode::operator = (const json_char * val) json_nothrow {
 	   JSON_CHECK_INTERNAL();
@@ -818,8 +854,7 @@ inline void JSONNode::swap(JSONNode & other) json_nothrow {
 inline void JSONNode::decRef(void) json_nothrow { //decrements internal's counter, deletes it if needed
     JSON_CHECK_INTERNAL();
     #ifdef JSON_REF_COUNT
-	   internal -> decRef();
-	   if (internal -> hasNoReferences()){
+	   if (internal -> decRef()){
 		  internalJSONNode::deleteInternal(internal);
 	   }
     #else
@@ -3,7 +3,7 @@
 
 #include "../../JSONOptions.h"
 
-#if defined(JSON_UNIT_TEST) || defined(JSON_DEBUG)
+#if defined(JSON_UNIT_TEST) || defined(JSON_OBJECT_STATS)
 	#define LIBJSON_OBJECT(name)\
 		static size_t & getCtorCounter(void){\
 			static size_t count = 0;\
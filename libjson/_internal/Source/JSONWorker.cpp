@@ -1,8 +1,22 @@
 #include "JSONWorker.h"
+#include <atomic>
 
-bool used_ascii_one = false;  //used to know whether or not to check for intermediates when writing, once flipped, can't be unflipped
+#if defined(JSON_PARALLEL_ARRAYS) && defined(JSON_READ_PRIORITY) && !defined(JSON_UNIT_TEST) && !defined(JSON_OBJECT_STATS)
+	//the JSONStats counters are plain integers, so those builds stay on one thread
+	#define JSON_PARALLEL_DOARRAY
+	#ifndef JSON_PARALLEL_CHUNKS
+		#define JSON_PARALLEL_CHUNKS std::thread::hardware_concurrency()
+	#endif
+	#include <thread>
+	#include <system_error>
+	#include <vector>
+#endif
+
+//used to know whether or not to check for intermediates when writing, once flipped, can't be unflipped
+//atomic because the rows of a parallel array are parsed on other threads, relaxed because it only ever goes to true
+std::atomic<bool> used_ascii_one(false);
 inline json_char ascii_one(void) json_nothrow {
-	used_ascii_one = true;
+	if (!used_ascii_one.load(std::memory_order_relaxed)) used_ascii_one.store(true, std::memory_order_relaxed);
 	return JSON_TEXT('\1');
 }
 
@@ -563,7 +577,7 @@ void JSONWorker::UnfixString(const json_string & value_t, bool flag, json_string
 #else
     #define ARRAY_PARAM bool
 #endif
-inline void JSONWorker::NewNode(const internalJSONNode * parent, const json_string & name, const json_string & value, ARRAY_PARAM) json_nothrow {
+inline JSONNode * JSONWorker::MakeNode(const json_string & name, json_string value, ARRAY_PARAM) json_nothrow {
     #ifdef JSON_COMMENTS
 	   JSONNode * child;
 	   START_MEM_SCOPE
@@ -591,24 +605,32 @@ inline void JSONWorker::NewNode(const internalJSONNode * parent, const json_stri
 			 }
 			 internalJSONNode * myinternal;
 			 if (array){
-				myinternal = internalJSONNode::newInternal(name, runner);
+				if (runner == value.data()){  //no comment in front, the value can be handed over
+				    myinternal = internalJSONNode::newInternal(name, JSON_MOVE(value));
+				} else {
+				    myinternal = internalJSONNode::newInternal(name, runner);
+				}
 			 } else {
-				myinternal = internalJSONNode::newInternal(++runner, value);
+				myinternal = internalJSONNode::newInternal(++runner, JSON_MOVE(value));
 			 }
 			 child = JSONNode::newJSONNode(myinternal);
 		  END_MEM_SCOPE
 		  child -> set_comment(_comment);
 	   END_MEM_SCOPE
-	   const_cast<internalJSONNode*>(parent) -> CHILDREN -> push_back(child);   //attach it to the parent node
+	   return child;
     #else
 	if (name.empty()){
-	   	const_cast<internalJSONNode*>(parent) -> CHILDREN -> push_back(JSONNode::newJSONNode(internalJSONNode::newInternal(name, value)));	    //attach it to the parent node
+	   	return JSONNode::newJSONNode(internalJSONNode::newInternal(name, JSON_MOVE(value)));
 	} else {
-		const_cast<internalJSONNode*>(parent) -> CHILDREN -> push_back(JSONNode::newJSONNode(internalJSONNode::newInternal(json_string(name.begin() + 1, name.end()), value)));	    //attach it to the parent node
+		return JSONNode::newJSONNode(internalJSONNode::newInternal(json_string(name.begin() + 1, name.end()), JSON_MOVE(value)));
 	}
     #endif
 }
 
+inline void JSONWorker::NewNode(const internalJSONNode * parent, const json_string & name, json_string value, bool array) json_nothrow {
+	const_cast<internalJSONNode*>(parent) -> CHILDREN -> push_back(MakeNode(name, JSON_MOVE(value), array));	    //attach it to the parent node
+}
+
 //Create a subarray
 void JSONWorker::DoArray(const internalJSONNode * parent, const json_string & value_t) json_nothrow {
 	//This takes an array and creates nodes out of them
@@ -616,6 +638,10 @@ void JSONWorker::DoArray(const internalJSONNode * parent, const json_string & va
 	JSON_ASSERT_SAFE(value_t[0] == JSON_TEXT('['), JSON_TEXT("DoArray is not an array"), parent -> Nullify(); return;);
 	if (json_unlikely(value_t.length() <= 2)) return;  // just a [] (blank array)
 	
+	#ifdef JSON_PARALLEL_DOARRAY
+		if (value_t.length() >= JSON_PARALLEL_ARRAYS && DoArrayParallel(parent, value_t)) return;
+	#endif
+	
 	#ifdef JSON_SAFE
 		json_string newValue;  //share this so it has a reserved buffer
 	#endif
@@ -647,6 +673,129 @@ void JSONWorker::DoArray(const internalJSONNode * parent, const json_string & va
 }
 
 
+#ifdef JSON_PARALLEL_DOARRAY
+//A comma that sits between two rows, ],[ or },{, only a guess until the chunk before it ends there
+static size_t GuessRowBoundary(const json_string & value_t, size_t pos) json_nothrow {
+	for(const size_t end = value_t.length() - 1; pos < end; ++pos){
+		if (value_t[pos] == JSON_TEXT(',') &&
+			(value_t[pos - 1] == JSON_TEXT(']') || value_t[pos - 1] == JSON_TEXT('}')) &&
+			(value_t[pos + 1] == JSON_TEXT('[') || value_t[pos + 1] == JSON_TEXT('{'))) return pos;
+	}
+	return json_string::npos;
+}
+
+//Runs fn(0) ... fn(count - 1), all but the first on their own thread
+template<class Function>
+static void ForEachChunk(size_t count, Function fn) json_nothrow {
+	std::vector<std::thread> workers;
+	workers.reserve(count);
+	size_t spawned = 1;
+	json_try {
+		for(; spawned < count; ++spawned){
+			workers.push_back(std::thread(fn, spawned));
+		}
+	} json_catch (const std::system_error &, (void)0;)
+	for(size_t i = spawned; i < count; ++i) fn(i);  //no thread left for these
+	fn(0);
+	for(size_t i = 0; i < workers.size(); ++i) workers[i].join();
+}
+
+//Same as DoArray, but the rows are split and parsed on all cores, returns false if it can't split
+bool JSONWorker::DoArrayParallel(const internalJSONNode * parent, const json_string & value_t) json_nothrow {
+	size_t count = JSON_PARALLEL_CHUNKS;
+	if (value_t.length() / JSON_PARALLEL_ARRAYS < count) count = value_t.length() / JSON_PARALLEL_ARRAYS;
+	if (count < 2) return false;
+
+	//bounds[k] is the [ or the comma in front of chunk k, the last chunk runs up to the ]
+	std::vector<size_t> bounds(1, 0);
+	for(size_t k = 1; k < count; ++k){
+		size_t pos = k * (value_t.length() / count);
+		if (pos < bounds.back() + 2) pos = bounds.back() + 2;
+		pos = GuessRowBoundary(value_t, pos);
+		if (pos == json_string::npos) break;
+		bounds.push_back(pos);
+	}
+	count = bounds.size();
+	if (count < 2) return false;
+	bounds.push_back(json_string::npos);
+
+	struct Chunk {
+		std::vector<std::pair<size_t, size_t> > rows;
+		std::vector<JSONNode *> nodes;
+		bool proven;
+		bool keyvalue;
+	};
+	std::vector<Chunk> chunks(count);
+
+	//find the rows of each chunk, exactly the way DoArray would from the same starting point
+	ForEachChunk(count, [&](size_t k){
+		Chunk & chunk = chunks[k];
+		const size_t stop = bounds[k + 1];
+		size_t starting = bounds[k] + 1;
+		size_t ending;
+		for(;;){
+			ending = FIND_NEXT_RELEVANT(JSON_TEXT(','), value_t, starting);
+			if (ending == json_string::npos || ending > stop) break;
+			chunk.rows.push_back(std::make_pair(starting, ending));
+			if (ending == stop) break;  //the row in front of the next chunk's comma is still ours
+			starting = ending + 1;
+		}
+		if (stop == json_string::npos){
+			chunk.rows.push_back(std::make_pair(starting, value_t.length() - 1));  //ignore the final ]
+			chunk.proven = true;
+		} else {
+			chunk.proven = (ending == stop);  //otherwise the guessed comma was inside a row or a string
+		}
+	});
+
+	//chunk 0 starts at the [, so if every chunk ends on the next guess, every guess was right
+	for(size_t k = 0; k < count; ++k){
+		if (!chunks[k].proven) return false;
+	}
+
+	ForEachChunk(count, [&](size_t k){
+		Chunk & chunk = chunks[k];
+		chunk.keyvalue = false;
+		chunk.nodes.reserve(chunk.rows.size());
+		for(size_t i = 0; i < chunk.rows.size(); ++i){
+			json_string row(value_t.begin() + chunk.rows[i].first, value_t.begin() + chunk.rows[i].second);
+			#ifdef JSON_SAFE
+				if (json_unlikely(FIND_NEXT_RELEVANT(JSON_TEXT(':'), row, 0) != json_string::npos)){
+					chunk.keyvalue = true;  //reported by the calling thread
+					return;
+				}
+			#endif
+			JSONNode * child = MakeNode(json_global(EMPTY_JSON_STRING), JSON_MOVE(row), true);
+			#ifndef JSON_PREPARSE
+				child -> preparse();
+			#endif
+			chunk.nodes.push_back(child);
+		}
+	});
+
+	size_t total = 0;
+	bool keyvalue = false;
+	for(size_t k = 0; k < count; ++k){
+		total += chunks[k].nodes.size();
+		keyvalue |= chunks[k].keyvalue;
+	}
+	if (json_unlikely(keyvalue)){
+		for(size_t k = 0; k < count; ++k){
+			for(size_t i = 0; i < chunks[k].nodes.size(); ++i) JSONNode::deleteJSONNode(chunks[k].nodes[i]);
+		}
+		JSON_FAIL_SAFE(JSON_TEXT("Key/Value pairs are not allowed in arrays"), parent -> Nullify(););
+		return true;
+	}
+
+	jsonChildren * children = const_cast<internalJSONNode*>(parent) -> CHILDREN;
+	children -> reserve((json_index_t)total);
+	for(size_t k = 0; k < count; ++k){
+		for(size_t i = 0; i < chunks[k].nodes.size(); ++i) children -> push_back(chunks[k].nodes[i]);
+	}
+	return true;
+}
+#endif
+
 //Create all child nodes
 void JSONWorker::DoNode(const internalJSONNode * parent, const json_string & value_t) json_nothrow {	
 	//This take a node and creates its members and such
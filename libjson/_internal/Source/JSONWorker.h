@@ -19,6 +19,9 @@ public:
 
 	   static void DoArray(const internalJSONNode * parent, const json_string & value_t) json_nothrow json_read_priority;
 	   static void DoNode(const internalJSONNode * parent, const json_string & value_t) json_nothrow json_read_priority;
+	   #if defined(JSON_PARALLEL_ARRAYS) && !defined(JSON_UNIT_TEST) && !defined(JSON_OBJECT_STATS)
+		  static bool DoArrayParallel(const internalJSONNode * parent, const json_string & value_t) json_nothrow json_read_priority;
+	   #endif
 
 	   #ifdef JSON_LESS_MEMORY
 		  #define NAME_ENCODED this, true
@@ -56,7 +59,8 @@ JSON_PRIVATE
     #endif
     #ifdef JSON_READ_PRIORITY
 	   static void SpecialChar(const json_char * & pos, const json_char * const end, json_string & res) json_nothrow;
-	   static void NewNode(const internalJSONNode * parent, const json_string & name, const json_string & value, bool array) json_nothrow;
+	   static JSONNode * MakeNode(const json_string & name, json_string value, bool array) json_nothrow;
+	   static void NewNode(const internalJSONNode * parent, const json_string & name, json_string value, bool array) json_nothrow;
     #endif
 private:
     JSONWorker(void);
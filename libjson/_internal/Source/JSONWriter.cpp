@@ -2,8 +2,9 @@
 #ifdef JSON_WRITE_PRIORITY
 #include "JSONWorker.h"
 #include "JSONGlobals.h"
+#include <atomic>
 
-extern bool used_ascii_one;
+extern std::atomic<bool> used_ascii_one;
 
 #ifdef JSON_INDENT
     inline json_string makeIndent(unsigned int amount) json_nothrow json_write_priority;
@@ -180,7 +181,7 @@ void internalJSONNode::WriteChildren(unsigned int indent, json_string & output)
 
 void internalJSONNode::DumpRawString(json_string & output) const json_nothrow {
 	//first remove the \1 characters
-	if (used_ascii_one){  //if it hasn't been used yet, don't bother checking
+	if (used_ascii_one.load(std::memory_order_relaxed)){  //if it hasn't been used yet, don't bother checking
 		json_string result(_string.begin(), _string.end());
 		for(json_string::iterator beg = result.begin(), en = result.end(); beg != en; ++beg){
 			if (*beg == JSON_TEXT('\1')) *beg = JSON_TEXT('\"');
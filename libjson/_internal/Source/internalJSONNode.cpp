@@ -20,7 +20,7 @@ internalJSONNode::internalJSONNode(const internalJSONNode & orig) json_nothrow :
 	   if (json_likely(!orig.CHILDREN -> empty())){
 		  CHILDREN -> reserve(orig.CHILDREN -> size());
 		  json_foreach(orig.CHILDREN, myrunner){
-			 CHILDREN -> push_back(JSONNode::newJSONNode((*myrunner) -> duplicate()));
+			 CHILDREN -> push_back(JSONNode::newJSONNode_Shallow((*myrunner) -> duplicate()));  //take over the temporary's internal
 		  }
 	   }
     }
@@ -37,7 +37,7 @@ internalJSONNode::internalJSONNode(const internalJSONNode & orig) json_nothrow :
 
 //this one is specialized because the root can only be array or node
 #ifdef JSON_READ_PRIORITY /*-> JSON_READ_PRIORITY */
-internalJSONNode::internalJSONNode(const json_string & unparsed) json_nothrow : _type(), _name(),_name_encoded(false), _string(unparsed), _string_encoded(), _value()
+internalJSONNode::internalJSONNode(json_string unparsed) json_nothrow : _type(), _name(),_name_encoded(false), _string(), _string_encoded(), _value()
     initializeMutex(0)
     initializeRefCount(1)
     initializeFetch(false)
@@ -45,7 +45,8 @@ internalJSONNode::internalJSONNode(const json_string & unparsed) json_nothrow :
     initializeChildren(0){
 
     LIBJSON_CTOR;
-    switch (unparsed[0]){
+    _string.swap(unparsed);  //the whole document, don't copy it
+    switch (_string[0]){
 	   case JSON_TEXT('{'):  //node
 		  _type = JSON_NODE;
 		  CHILDREN = jsonChildren::newChildren();
@@ -75,7 +76,7 @@ internalJSONNode::internalJSONNode(const json_string & unparsed) json_nothrow :
 	   case JSON_TEXT(x)
 #endif
 
-internalJSONNode::internalJSONNode(const json_string & name_t, const json_string & value_t) json_nothrow : _type(), _name_encoded(), _name(JSONWorker::FixString(name_t, NAME_ENCODED)), _string(), _string_encoded(), _value()
+internalJSONNode::internalJSONNode(const json_string & name_t, json_string value_t) json_nothrow : _type(), _name_encoded(), _name(JSONWorker::FixString(name_t, NAME_ENCODED)), _string(), _string_encoded(), _value()
     initializeMutex(0)
     initializeRefCount(1)
     initializeFetch(false)
@@ -94,11 +95,11 @@ internalJSONNode::internalJSONNode(const json_string & name_t, const json_string
 	   }
     #endif
 
-    _string = value_t;
+    _string.swap(value_t);  //value_t is our own copy, or was moved in
 
-    const json_char firstchar = value_t[0];
+    const json_char firstchar = _string[0];
     #if defined JSON_DEBUG || defined JSON_SAFE
-	   const json_char lastchar = value_t[value_t.length() - 1];
+	   const json_char lastchar = _string[_string.length() - 1];
     #endif
 
     switch (firstchar){
@@ -120,24 +121,24 @@ internalJSONNode::internalJSONNode(const json_string & name_t, const json_string
 			SetFetchedFalseOrDo(FetchArray());
             break;
         LETTERCASE('t', 'T'):
-            JSON_ASSERT_SAFE(value_t == json_global(CONST_TRUE), json_string(json_global(ERROR_UNKNOWN_LITERAL) + value_t).c_str(), Nullify(); return;);
+            JSON_ASSERT_SAFE(_string == json_global(CONST_TRUE), json_string(json_global(ERROR_UNKNOWN_LITERAL) + _string).c_str(), Nullify(); return;);
             _value._bool = true;
             _type = JSON_BOOL;
 			SetFetched(true);
             break;
         LETTERCASE('f', 'F'):
-            JSON_ASSERT_SAFE(value_t == json_global(CONST_FALSE), json_string(json_global(ERROR_UNKNOWN_LITERAL) + value_t).c_str(), Nullify(); return;);
+            JSON_ASSERT_SAFE(_string == json_global(CONST_FALSE), json_string(json_global(ERROR_UNKNOWN_LITERAL) + _string).c_str(), Nullify(); return;);
             _value._bool = false;
             _type = JSON_BOOL;
 			SetFetched(true);
             break;
         LETTERCASE('n', 'N'):
-            JSON_ASSERT_SAFE(value_t == json_global(CONST_NULL), json_string(json_global(ERROR_UNKNOWN_LITERAL) + value_t).c_str(), Nullify(); return;);
+            JSON_ASSERT_SAFE(_string == json_global(CONST_NULL), json_string(json_global(ERROR_UNKNOWN_LITERAL) + _string).c_str(), Nullify(); return;);
             _type = JSON_NULL;
 			SetFetched(true);
             break;
         default:
-            JSON_ASSERT_SAFE(NumberToString::isNumeric(value_t), json_string(json_global(ERROR_UNKNOWN_LITERAL) + value_t).c_str(), Nullify(); return;);
+            JSON_ASSERT_SAFE(NumberToString::isNumeric(_string), json_string(json_global(ERROR_UNKNOWN_LITERAL) + _string).c_str(), Nullify(); return;);
 			_type = JSON_NUMBER;
 			SetFetchedFalseOrDo(FetchNumber());
             break;
@@ -186,8 +187,16 @@ internalJSONNode::~internalJSONNode(void) json_nothrow {
 
 //This one is used by as_int and as_float, so even non-readers need it
 void internalJSONNode::FetchNumber(void) const json_nothrow {
+    _value._number = ParseNumber();
+    #if((!defined(JSON_CASTABLE) && defined(JSON_LESS_MEMORY)) && !defined(JSON_WRITE_PRIORITY))
+	   clearString(_string);
+    #endif
+}
+
+//converts _string without touching the node, so that casting a string is a pure read
+json_number internalJSONNode::ParseNumber(void) const json_nothrow {
     #ifdef JSON_STRICT
-		_value._number = NumberToString::_atof(_string.c_str());
+		return NumberToString::_atof(_string.c_str());
     #else 
 	   #ifdef JSON_UNICODE
 		  const size_t len = _string.length();
@@ -197,30 +206,25 @@ void internalJSONNode::FetchNumber(void) const json_nothrow {
 			 size_t res;
 			 errno_t err = wcstombs_s(&res, temp.ptr, bytes, _string.c_str(), len);
 			 if (err != 0){
-				_value._number = (json_number)0.0;
-				return;
+				return (json_number)0.0;
 			 }
 		  #elif defined(JSON_SAFE)
 			 const size_t bytes = (len * (sizeof(json_char) / sizeof(char))) + 1;
 			 json_auto<char> temp(bytes);
 			 size_t res = std::wcstombs(temp.ptr, _string.c_str(), len);
 			 if (res == (size_t)-1){
-				_value._number = (json_number)0.0;
-				return;
+				return (json_number)0.0;
 			 }
 		  #else 
 			 json_auto<char> temp(len + 1);
 			 size_t res = std::wcstombs(temp.ptr, _string.c_str(), len);
 		  #endif 
 		  temp.ptr[res] = '\0';
-		  _value._number = (json_number)std::atof(temp.ptr);
+		  return (json_number)std::atof(temp.ptr);
 	   #else
-		  _value._number = (json_number)std::atof(_string.c_str());
+		  return (json_number)std::atof(_string.c_str());
 	   #endif
     #endif
-    #if((!defined(JSON_CASTABLE) && defined(JSON_LESS_MEMORY)) && !defined(JSON_WRITE_PRIORITY))
-	   clearString(_string);
-    #endif
 }
 
 #if !defined(JSON_PREPARSE) && defined(JSON_READ_PRIORITY)
@@ -408,6 +412,17 @@ void internalJSONNode::push_back(const JSONNode & node) json_nothrow {
     #endif /*<- */
 }
 
+#if defined(JSON_MOVE_SEMANTICS) && !defined(JSON_LIBRARY) /*-> JSON_MOVE_SEMANTICS */
+void internalJSONNode::push_back(JSONNode && node) json_nothrow {
+    JSON_ASSERT_SAFE(isContainer(), json_global(ERROR_NON_CONTAINER) + JSON_TEXT("push_back"), return;);
+    JSONNode * child = JSONNode::newJSONNode_Shallow(node);  //node's internal changes hands, no refcount traffic
+    #ifdef JSON_MUTEX_CALLBACKS /*-> JSON_MUTEX_CALLBACKS */
+	   if (mylock != 0) child -> set_mutex(mylock);
+    #endif /*<- */
+    CHILDREN -> push_back(child);
+}
+#endif /*<- */
+
 void internalJSONNode::push_front(const JSONNode & node) json_nothrow {
     JSON_ASSERT_SAFE(isContainer(), json_global(ERROR_NON_CONTAINER) + JSON_TEXT("push_front"), return;);
     CHILDREN -> push_front(JSONNode::newJSONNode(node   JSON_MUTEX_COPY));
@@ -520,7 +535,7 @@ internalJSONNode::operator bool() const json_nothrow {
 			 case JSON_BOOL:
 				return (json_number)(_value._bool ? 1.0 : 0.0);
 			 case JSON_STRING:
-				FetchNumber();
+				return (json_number)ParseNumber();
 		  }
 	   #endif /*<- */
 	   JSON_ASSERT(type() == JSON_NUMBER, json_global(ERROR_UNDEFINED) + JSON_TEXT("as_float"));
@@ -536,7 +551,7 @@ internalJSONNode::operator bool() const json_nothrow {
 			 case JSON_BOOL:
 				return _value._bool ? 1 : 0;
 			 case JSON_STRING:
-				FetchNumber();
+				return (json_int_t)ParseNumber();
 		  }
 	   #endif /*<- */
 	   JSON_ASSERT(type() == JSON_NUMBER, json_global(ERROR_UNDEFINED) + JSON_TEXT("as_int"));
@@ -554,7 +569,7 @@ internalJSONNode::operator bool() const json_nothrow {
 				case JSON_BOOL:
 				    return (long double)(_value._bool ? 1.0 : 0.0);
 				case JSON_STRING:
-				    FetchNumber();
+				    return (long double)ParseNumber();
 			 }
 		  #endif /*<- */
 		  JSON_ASSERT(type() == JSON_NUMBER, json_global(ERROR_UNDEFINED) + JSON_TEXT("(long double)"));
@@ -570,7 +585,7 @@ internalJSONNode::operator bool() const json_nothrow {
 				case JSON_BOOL:
 				    return (double)(_value._bool ? 1.0 : 0.0);
 				case JSON_STRING:
-				    FetchNumber();
+				    return (double)ParseNumber();
 			 }
 		  #endif /*<- */
 		  JSON_ASSERT(type() == JSON_NUMBER, json_global(ERROR_UNDEFINED) + JSON_TEXT("(double)"));
@@ -593,7 +608,7 @@ internalJSONNode::operator bool() const json_nothrow {
 			 case JSON_BOOL:
 				return _value._bool ? 1 : 0;
 			 case JSON_STRING:
-				FetchNumber();
+				return (BASE_CONVERT_TYPE)ParseNumber();
 		  }
 	   #endif /*<- */
 	   #ifdef JSON_ISO_STRICT /*-> JSON_ISO_STRICT */
@@ -634,7 +649,7 @@ internalJSONNode::operator bool() const json_nothrow {
 			 case JSON_BOOL:
 				return _value._bool ? 1 : 0;
 			 case JSON_STRING:
-				FetchNumber();
+				return (unsigned BASE_CONVERT_TYPE)ParseNumber();
 		  }
 	   #endif /*<- */
 	   #ifdef JSON_ISO_STRICT /*-> JSON_ISO_STRICT */
@@ -689,23 +704,23 @@ internalJSONNode * internalJSONNode::newInternal(char mytype) {
 }
 	
 #ifdef JSON_READ_PRIORITY /*-> JSON_READ_PRIORITY */
-internalJSONNode * internalJSONNode::newInternal(const json_string & unparsed) {
+internalJSONNode * internalJSONNode::newInternal(json_string unparsed) {
 	#ifdef JSON_MEMORY_POOL /*-> JSON_MEMORY_POOL */
-		return new((internalJSONNode*)json_internal_mempool.allocate()) internalJSONNode(unparsed);
+		return new((internalJSONNode*)json_internal_mempool.allocate()) internalJSONNode(JSON_MOVE(unparsed));
 	#elif defined(JSON_MEMORY_CALLBACKS) /*<- else JSON_MEMORY_CALLBACKS */
-		return new(json_malloc<internalJSONNode>(1)) internalJSONNode(unparsed);
+		return new(json_malloc<internalJSONNode>(1)) internalJSONNode(JSON_MOVE(unparsed));
 	#else /*<- else */
-		return new internalJSONNode(unparsed);
+		return new internalJSONNode(JSON_MOVE(unparsed));
 	#endif /*<- */
 }
 	
-internalJSONNode * internalJSONNode::newInternal(const json_string & name_t, const json_string & value_t) {
+internalJSONNode * internalJSONNode::newInternal(const json_string & name_t, json_string value_t) {
 	#ifdef JSON_MEMORY_POOL /*-> JSON_MEMORY_POOL */
-		return new((internalJSONNode*)json_internal_mempool.allocate()) internalJSONNode(name_t, value_t);
+		return new((internalJSONNode*)json_internal_mempool.allocate()) internalJSONNode(name_t, JSON_MOVE(value_t));
 	#elif defined(JSON_MEMORY_CALLBACKS) /*<- else JSON_MEMORY_CALLBACKS */
-		return new(json_malloc<internalJSONNode>(1)) internalJSONNode(name_t, value_t);
+		return new(json_malloc<internalJSONNode>(1)) internalJSONNode(name_t, JSON_MOVE(value_t));
 	#else /*<- else */
-		return new internalJSONNode(name_t, value_t);
+		return new internalJSONNode(name_t, JSON_MOVE(value_t));
 	#endif /*<- */
 }
 	
@@ -745,7 +760,7 @@ internalJSONNode * internalJSONNode::newInternal(const internalJSONNode & orig)
 
 
 		  #ifdef JSON_REF_COUNT /*-> JSON_REF_COUNT */
-			 dumpage.push_back(JSON_NEW(JSONNode(JSON_TEXT("refcount"), refcount)));
+			 dumpage.push_back(JSON_NEW(JSONNode(JSON_TEXT("refcount"), static_cast<size_t>(refcount))));
 		  #endif /*<- */
 		  #ifdef JSON_MUTEX_CALLBACKS /*-> JSON_MUTEX_CALLBACKS */
 			 dumpage.push_back(JSON_NEW(DumpMutex()));
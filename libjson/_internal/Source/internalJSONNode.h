@@ -9,6 +9,9 @@
     #include <climits>  //to check int value
 #endif
 #include "JSONSharedString.h"
+#ifdef JSON_THREAD_SAFE_REF_COUNT
+    #include <atomic>  //refcount shared between threads
+#endif
 
 #ifdef JSON_LESS_MEMORY
     #ifdef __GNUC__
@@ -83,8 +86,8 @@ public:
 	LIBJSON_OBJECT(internalJSONNode);
     internalJSONNode(char mytype = JSON_NULL) json_nothrow json_hot;
     #ifdef JSON_READ_PRIORITY
-	   internalJSONNode(const json_string & unparsed) json_nothrow json_hot;
-	   internalJSONNode(const json_string & name_t, const json_string & value_t) json_nothrow json_read_priority;
+	   internalJSONNode(json_string unparsed) json_nothrow json_hot;
+	   internalJSONNode(const json_string & name_t, json_string value_t) json_nothrow json_read_priority;
     #endif
     internalJSONNode(const internalJSONNode & orig) json_nothrow json_hot;
     internalJSONNode & operator = (const internalJSONNode &) json_nothrow json_hot;
@@ -92,8 +95,8 @@ public:
 
     static internalJSONNode * newInternal(char mytype = JSON_NULL) json_hot;
     #ifdef JSON_READ_PRIORITY
-	   static internalJSONNode * newInternal(const json_string & unparsed) json_hot;
-	   static internalJSONNode * newInternal(const json_string & name_t, const json_string & value_t) json_hot;
+	   static internalJSONNode * newInternal(json_string unparsed) json_hot;
+	   static internalJSONNode * newInternal(const json_string & name_t, json_string value_t) json_hot;
     #endif
     static internalJSONNode * newInternal(const internalJSONNode & orig) json_hot;  //not copyable, only by this class
     static void deleteInternal(internalJSONNode * ptr) json_nothrow json_hot;
@@ -117,6 +120,9 @@ public:
 	   void push_back(JSONNode * node) json_nothrow;
     #else
 	   void push_back(const JSONNode & node) json_nothrow;
+	   #ifdef JSON_MOVE_SEMANTICS
+		  void push_back(JSONNode && node) json_nothrow;
+	   #endif
     #endif
     void reserve(json_index_t siz) json_nothrow;
     void push_front(const JSONNode & node) json_nothrow;
@@ -176,7 +182,7 @@ public:
 
     internalJSONNode * incRef(void) json_nothrow;
     #ifdef JSON_REF_COUNT
-	   void decRef(void) json_nothrow json_hot;
+	   bool decRef(void) json_nothrow json_hot;  //true when the last reference was released
 	   bool hasNoReferences(void) json_nothrow json_hot;
     #endif
     internalJSONNode * makeUnique(void) json_nothrow json_hot;
@@ -234,6 +240,7 @@ public:
 	   void FetchArray(void) const json_nothrow json_read_priority;
     #endif
     void FetchNumber(void) const json_nothrow json_read_priority;
+    json_number ParseNumber(void) const json_nothrow json_read_priority;
 
     #ifdef JSON_CASE_INSENSITIVE_FUNCTIONS
 	   static bool AreEqualNoCase(const json_char * ch_one, const json_char * ch_two) json_nothrow json_read_priority;
@@ -274,7 +281,11 @@ public:
     #endif
 
     #ifdef JSON_REF_COUNT
-	   size_t refcount PACKED(20);
+	   #ifdef JSON_THREAD_SAFE_REF_COUNT
+		  std::atomic<size_t> refcount;
+	   #else
+		  size_t refcount PACKED(20);
+	   #endif
     #endif
 
     #if !defined(JSON_PREPARSE) && defined(JSON_READ_PRIORITY)
@@ -309,7 +320,12 @@ inline internalJSONNode::internalJSONNode(char mytype) json_nothrow : _type(myty
 
 inline internalJSONNode * internalJSONNode::incRef(void) json_nothrow {
     #ifdef JSON_REF_COUNT
-	   ++refcount;
+	   #ifdef JSON_THREAD_SAFE_REF_COUNT
+		  //the caller already owns a reference, so no ordering is needed
+		  refcount.fetch_add(1, std::memory_order_relaxed);
+	   #else
+		  ++refcount;
+	   #endif
 	   return this;
     #else
 	   return makeUnique();
@@ -374,9 +390,14 @@ inline bool internalJSONNode::IsEqualToNum(T val) const json_nothrow {
 }
 
 #ifdef JSON_REF_COUNT
-    inline void internalJSONNode::decRef(void) json_nothrow {
+    inline bool internalJSONNode::decRef(void) json_nothrow {
 	   JSON_ASSERT(refcount != 0, JSON_TEXT("decRef on a 0 refcount internal"));
-	   --refcount;
+	   #ifdef JSON_THREAD_SAFE_REF_COUNT
+		  //release our writes, and acquire everybody else's before the last one deletes
+		  return refcount.fetch_sub(1, std::memory_order_acq_rel) == 1;
+	   #else
+		  return --refcount == 0;
+	   #endif
     }
 
     inline bool internalJSONNode::hasNoReferences(void) json_nothrow {
@@ -385,7 +406,16 @@ inline bool internalJSONNode::IsEqualToNum(T val) const json_nothrow {
 #endif
 
 inline internalJSONNode * internalJSONNode::makeUnique(void) json_nothrow {
-    #ifdef JSON_REF_COUNT
+    #ifdef JSON_THREAD_SAFE_REF_COUNT
+	   if (refcount.load(std::memory_order_acquire) > 1){
+		  //copy before letting go, another thread may drop the last reference meanwhile
+		  internalJSONNode * mycopy = newInternal(*this);
+		  if (decRef()) deleteInternal(this);
+		  return mycopy;
+	   }
+	   JSON_ASSERT(refcount == 1, JSON_TEXT("makeUnique on a 0 refcount internal"));
+	   return this;
+    #elif defined(JSON_REF_COUNT)
 	   if (refcount > 1){
 		  decRef();
 		  return newInternal(*this);
@@ -0,0 +1,141 @@
+/*
+
+  json_parallel_arrays checks that arrays long enough to be parsed in
+  parallel (JSON_PARALLEL_ARRAYS) give the same tree as rows parsed one
+  by one, which are too short for it:
+
+    json_parallel_arrays
+
+  Built with its own libjson, with a small JSON_PARALLEL_ARRAYS and
+  JSON_PARALLEL_CHUNKS set, so the array is split on any machine. The
+  rows nest arrays and objects and have escaped quotes; in two cases
+  strings have ],[ and },{ in them, once long enough for the guessed row
+  boundaries to fall inside them. Exits 0 when every row of every case
+  matches.
+
+*/
+
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../libjson/libjson.h"
+
+using namespace std;
+
+//------------------------------------------------------------------------------
+// the rows of a case:
+enum Rows {
+   PLAIN,   // trades, nested arrays and objects, escaped quotes
+   MIXED,   // PLAIN with a row in 50 having ],[ and },{ in strings
+            // and between nested rows
+   TRAP     // strings of ],[ as long as a chunk, with a prefix that
+            // varies, so the guessed boundaries fall inside them
+};
+
+//------------------------------------------------------------------------------
+// row 'i' of a case of 'rows':
+static string make_row(size_t i, Rows rows)
+{
+   ostringstream row;
+   if (rows == TRAP) {
+      row << "[\"" << string(i % 7, 'x');
+      for (size_t k = 0; k < JSON_PARALLEL_ARRAYS / 3; ++k)
+	 row << "],[";
+      row << "\"," << i << "]";
+      return row.str();
+   }
+   if (rows == MIXED && i % 50 == 49) {
+      row << "[[" << i << ",[\"a],[b\",\"c},{d\"]],[{},{}],{\"k\":\"],[\"}]";
+      return row.str();
+   }
+
+   switch (i % 4) {
+   case 0:   // a trade
+      row << "[\"" << 30000 + i % 97 << ".3\",\"0." << i << "\","
+	  << 1500000000 + i << ".7982066,\"s\",\"l\",\"\"]";
+      break;
+   case 1:   // nested arrays
+      row << "[[" << i << ",[\"a\",[]]],true,{\"k\":[1,{\"n\":null}]}]";
+      break;
+   case 2:   // an object
+      row << "{\"id\":" << i << ",\"s\":\"x\",\"a\":[[],1,{}]}";
+      break;
+   default:  // escaped quotes and backslashes
+      row << "[\"say \\\"" << i << "\\\"\",\"\\\\\",\"\\\"\"]";
+      break;
+   }
+   return row.str();
+}
+
+//------------------------------------------------------------------------------
+// an array of rows at least 'size' characters long, under 'prefix' and
+// 'suffix'; compares each parsed row with the row parsed alone
+static bool check(const string& name, size_t size, Rows kind,
+		  const string& prefix, const string& suffix,
+		  const vector<string>& path)
+{
+   vector<string> rows;
+   string array("[");
+   while (array.size() < size) {
+      if (!rows.empty()) array += ',';
+      rows.push_back(make_row(rows.size(), kind));
+      array += rows.back();
+   }
+   array += ']';
+
+   JSONNode root = libjson::parse(prefix + array + suffix);
+   const JSONNode* node = &root;
+   for (size_t i = 0; i < path.size(); ++i)
+      node = &node->at(path[i]);
+
+   if (node->type() != JSON_ARRAY || node->size() != rows.size()) {
+      cout << name << ": " << node->size() << " rows, "
+	   << rows.size() << " expected" << endl;
+      return false;
+   }
+
+   for (size_t i = 0; i < rows.size(); ++i) {
+      string got = (*node)[json_index_t(i)].write();
+      string expected = libjson::parse(rows[i]).write();
+      if (got != expected) {
+	 cout << name << ": row " << i << " is " << got
+	      << ", " << expected << " expected" << endl;
+	 return false;
+      }
+   }
+
+   cout << name << ": " << rows.size() << " rows ok" << endl;
+   return true;
+}
+
+//------------------------------------------------------------------------------
+
+int main()
+{
+   try {
+      const size_t size = 8 * JSON_PARALLEL_ARRAYS;
+      vector<string> root, trades;
+      trades.push_back("result");
+      trades.push_back("XXBTZEUR");
+
+      bool ok = check("root array", size, PLAIN, "", "", root);
+      ok = check("trades", size, PLAIN,
+		 "{\"error\":[],\"result\":{\"XXBTZEUR\":",
+		 ",\"last\":\"1500000014798206600\"}}", trades) && ok;
+      ok = check("separators in strings", size, MIXED, "", "", root) && ok;
+      ok = check("rows inside strings", size, TRAP, "", "", root) && ok;
+
+      if (!ok)
+	 throw runtime_error("parallel and serial parses differ");
+   }
+   catch(exception& e) {
+      cerr << "Error: " << e.what() << endl;
+      return 1;
+   }
+
+   cout << "ok" << endl;
+   return 0;
+}
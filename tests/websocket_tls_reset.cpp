@@ -0,0 +1,230 @@
+/*
+
+  websocket_tls_reset checks that a wss:// peer resetting the connection
+  mid-stream surfaces as an exception, which KFeed reconnects on, and
+  doesn't kill the process with SIGPIPE:
+
+    websocket_tls_reset
+
+  An in-process TLS server with a throwaway self-signed certificate for
+  localhost (trusted through SSL_CERT_FILE) answers the handshake, sends
+  a message and resets the connection (SO_LINGER 0) once the client has
+  read it. The client then reads, or writes, on the reset connection.
+  SIGPIPE is left at its default action, so the process dies if any
+  write raises it. Exits 0 when both cases throw.
+
+*/
+
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <openssl/ssl.h>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/sha.h>
+#include <openssl/x509v3.h>
+
+#include "../kraken/kwebsocket.hpp"
+
+using namespace std;
+using namespace Kraken;
+
+//------------------------------------------------------------------------------
+// a self-signed certificate for localhost, written to 'cert_path' for the
+// client to trust:
+static SSL_CTX* server_context(const string& cert_path)
+{
+   EVP_PKEY* key = EVP_EC_gen("P-256");
+   X509* cert = X509_new();
+   if (!key || !cert)
+      throw runtime_error("can't make a key and a certificate");
+
+   ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+   X509_gmtime_adj(X509_getm_notBefore(cert), -60);
+   X509_gmtime_adj(X509_getm_notAfter(cert), 3600);
+   X509_set_pubkey(cert, key);
+   X509_NAME* name = X509_get_subject_name(cert);
+   X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+			      (const unsigned char*)"localhost", -1, -1, 0);
+   X509_set_issuer_name(cert, name);
+
+   X509V3_CTX v3;
+   X509V3_set_ctx(&v3, cert, cert, 0, 0, 0);
+   X509_EXTENSION* san = X509V3_EXT_conf_nid(0, &v3, NID_subject_alt_name,
+					     "DNS:localhost,IP:127.0.0.1");
+   X509_add_ext(cert, san, -1);
+   X509_EXTENSION_free(san);
+   X509_sign(cert, key, EVP_sha256());
+
+   FILE* f = fopen(cert_path.c_str(), "w");
+   if (!f)
+      throw runtime_error("can't write " + cert_path);
+   PEM_write_X509(f, cert);
+   fclose(f);
+
+   SSL_CTX* ctx = SSL_CTX_new(TLS_server_method());
+   SSL_CTX_use_certificate(ctx, cert);
+   SSL_CTX_use_PrivateKey(ctx, key);
+   X509_free(cert);
+   EVP_PKEY_free(key);
+   return ctx;
+}
+
+//------------------------------------------------------------------------------
+// Sec-WebSocket-Accept for 'key':
+static string accept_key(const string& key)
+{
+   string s = key + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+   unsigned char digest[SHA_DIGEST_LENGTH];
+   SHA1(reinterpret_cast<const unsigned char*>(s.data()), s.size(), digest);
+   unsigned char b64[32];
+   int len = EVP_EncodeBlock(b64, digest, sizeof(digest));
+   return string(reinterpret_cast<char*>(b64), len);
+}
+
+//------------------------------------------------------------------------------
+// serves one connection of 'listener': handshake, a text message, then a
+// reset once 'go' is readable
+static void serve(SSL_CTX* ctx, int listener, int go)
+{
+   int fd = ::accept(listener, 0, 0);
+   if (fd < 0)
+      return;
+
+   SSL* ssl = SSL_new(ctx);
+   SSL_set_fd(ssl, fd);
+   if (SSL_accept(ssl) == 1) {
+      string head;
+      char buf[4096];
+      while (head.find("\r\n\r\n") == string::npos) {
+	 int n = SSL_read(ssl, buf, sizeof(buf));
+	 if (n <= 0) break;
+	 head.append(buf, n);
+      }
+
+      string key;
+      size_t at = head.find("Sec-WebSocket-Key: ");
+      if (at != string::npos) {
+	 at += 19;
+	 key = head.substr(at, head.find("\r\n", at) - at);
+      }
+
+      ostringstream res;
+      res << "HTTP/1.1 101 Switching Protocols\r\n"
+	  << "Upgrade: websocket\r\n"
+	  << "Connection: Upgrade\r\n"
+	  << "Sec-WebSocket-Accept: " << accept_key(key) << "\r\n\r\n"
+	  << "\x81\x05hello";
+      string s = res.str();
+      SSL_write(ssl, s.data(), int(s.size()));
+
+      char c;
+      if (::read(go, &c, 1) < 0)
+	 perror("read");
+   }
+
+   // a reset rather than a close
+   linger lg;
+   lg.l_onoff = 1;
+   lg.l_linger = 0;
+   setsockopt(fd, SOL_SOCKET, SO_LINGER, &lg, sizeof(lg));
+   ::close(fd);
+   SSL_free(ssl);
+}
+
+//------------------------------------------------------------------------------
+// one connection reset by the peer, then a read ('write' false) or a
+// write on it; true if that threw
+static bool reset_case(SSL_CTX* ctx, int listener, int port, bool write)
+{
+   int go[2];
+   if (pipe(go) != 0)
+      throw runtime_error("pipe() failed");
+   thread server(serve, ctx, listener, go[0]);
+
+   bool thrown = false;
+   KWebSocket ws;
+   try {
+      ostringstream url;
+      url << "wss://localhost:" << port << "/";
+      ws.connect(url.str());
+
+      string msg;
+      if (!ws.receive(msg, 5000) || msg != "hello")
+	 throw logic_error("no message before the reset");
+
+      if (::write(go[1], "x", 1) != 1)
+	 throw logic_error("write() to the server failed");
+      usleep(200000);
+
+      if (write)
+	 for (int i = 0; i < 100; ++i)
+	    ws.send_text("after the reset");
+      else
+	 ws.receive(msg, 5000);
+   }
+   catch (runtime_error& e) {
+      thrown = true;
+      cout << (write ? "write" : "read") << ": " << e.what() << endl;
+   }
+
+   server.join();
+   ::close(go[0]);
+   ::close(go[1]);
+   return thrown;
+}
+
+//------------------------------------------------------------------------------
+
+int main()
+{
+   try {
+      char dir[] = "/tmp/websocket_tls_resetXXXXXX";
+      if (!mkdtemp(dir))
+	 throw runtime_error("mkdtemp() failed");
+      string cert_path = string(dir) + "/cert.pem";
+      SSL_CTX* ctx = server_context(cert_path);
+      setenv("SSL_CERT_FILE", cert_path.c_str(), 1);
+
+      int listener = ::socket(AF_INET, SOCK_STREAM, 0);
+      sockaddr_in addr;
+      memset(&addr, 0, sizeof(addr));
+      addr.sin_family = AF_INET;
+      addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+      socklen_t len = sizeof(addr);
+      if (::bind(listener, (sockaddr*)&addr, len) != 0
+	  || ::listen(listener, 4) != 0
+	  || getsockname(listener, (sockaddr*)&addr, &len) != 0)
+	 throw runtime_error("can't listen on the loopback");
+      int port = ntohs(addr.sin_port);
+
+      bool read_thrown = reset_case(ctx, listener, port, false);
+      bool write_thrown = reset_case(ctx, listener, port, true);
+
+      ::close(listener);
+      SSL_CTX_free(ctx);
+      unlink(cert_path.c_str());
+      rmdir(dir);
+
+      if (!read_thrown || !write_thrown)
+	 throw runtime_error("a reset connection didn't throw");
+   }
+   catch(exception& e) {
+      cerr << "Error: " << e.what() << endl;
+      return 1;
+   }
+
+   cout << "ok" << endl;
+   return 0;
+}